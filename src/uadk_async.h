@@ -51,6 +51,7 @@ enum task_type {
 	ASYNC_TASK_RSA,
 	ASYNC_TASK_DH,
 	ASYNC_TASK_ECC,
+	ASYNC_TASK_MAC,
 	ASYNC_TASK_MAX
 };
 
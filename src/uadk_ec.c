@@ -25,6 +25,7 @@
 #include <uadk/wd_ecc.h>
 #include <uadk/wd_sched.h>
 #include "uadk_pkey.h"
+#include "uadk_ecc_curve.h"
 #include "uadk.h"
 
 #define ECC128BITS	128
@@ -35,19 +36,6 @@
 #define ECC384BITS	384
 #define ECC521BITS	521
 
-struct curve_param {
-	/* Prime */
-	BIGNUM *p;
-	/* ECC coefficient 'a' */
-	BIGNUM *a;
-	/* ECC coefficient 'b' */
-	BIGNUM *b;
-	/* Base point */
-	const EC_POINT *g;
-	/* Order of base point */
-	const BIGNUM *order;
-};
-
 typedef ECDSA_SIG* (*PFUNC_SIGN_SIG)(const unsigned char *,
 				     int,
 				     const BIGNUM *,
@@ -69,112 +57,6 @@ typedef int (*PFUNC_COMP_KEY)(unsigned char **,
 
 static EC_KEY_METHOD *uadk_ec_method;
 
-static void init_dtb_param(void *dtb, char *start,
-			   __u32 dsz, __u32 bsz, __u32 num)
-{
-	struct wd_dtb *tmp = dtb;
-	char *buff = start;
-	__u32 i = 0;
-
-	while (i++ < num) {
-		tmp->data = buff;
-		tmp->dsize = dsz;
-		tmp->bsize = bsz;
-		tmp += 1;
-		buff += bsz;
-	}
-}
-
-static void fill_ecc_cv_param(struct wd_ecc_curve *pparam,
-			      struct curve_param *cv_param,
-			      BIGNUM *g_x, BIGNUM *g_y)
-{
-	pparam->p.dsize = BN_bn2bin(cv_param->p, (void *)pparam->p.data);
-	pparam->a.dsize = BN_bn2bin(cv_param->a, (void *)pparam->a.data);
-	if (!pparam->a.dsize) {
-		pparam->a.dsize = 1;
-		pparam->a.data[0] = 0;
-	}
-
-	pparam->b.dsize = BN_bn2bin(cv_param->b, (void *)pparam->b.data);
-	if (!pparam->b.dsize) {
-		pparam->b.dsize = 1;
-		pparam->b.data[0] = 0;
-	}
-
-	pparam->g.x.dsize = BN_bn2bin(g_x, (void *)pparam->g.x.data);
-	pparam->g.y.dsize = BN_bn2bin(g_y, (void *)pparam->g.y.data);
-	pparam->n.dsize = BN_bn2bin(cv_param->order, (void *)pparam->n.data);
-}
-
-static int set_sess_setup_cv(const EC_GROUP *group,
-			     struct wd_ecc_curve_cfg *cv)
-{
-	struct wd_ecc_curve *pparam = cv->cfg.pparam;
-	struct curve_param *cv_param;
-	BIGNUM *g_x, *g_y;
-	int ret = -1;
-	BN_CTX *ctx;
-
-	ctx = BN_CTX_new();
-	if (!ctx)
-		return ret;
-
-	BN_CTX_start(ctx);
-
-	cv_param = OPENSSL_malloc(sizeof(struct curve_param));
-	if (!cv_param)
-		goto free_ctx;
-
-	cv_param->p = BN_CTX_get(ctx);
-	if (!cv_param->p)
-		goto free_cv;
-
-	cv_param->a = BN_CTX_get(ctx);
-	if (!cv_param->a)
-		goto free_cv;
-
-	cv_param->b = BN_CTX_get(ctx);
-	if (!cv_param->b)
-		goto free_cv;
-
-	g_x = BN_CTX_get(ctx);
-	if (!g_x)
-		goto free_cv;
-
-	g_y = BN_CTX_get(ctx);
-	if (!g_y)
-		goto free_cv;
-
-	ret = uadk_get_curve(group, cv_param->p, cv_param->a, cv_param->b, ctx);
-	if (ret)
-		goto free_cv;
-
-	cv_param->g = EC_GROUP_get0_generator(group);
-	if (!cv_param->g)
-		goto free_cv;
-
-	ret = uadk_get_affine_coordinates(group, cv_param->g, g_x, g_y, ctx);
-	if (ret)
-		goto free_cv;
-
-	cv_param->order = EC_GROUP_get0_order(group);
-	if (!cv_param->order)
-		goto free_cv;
-
-	fill_ecc_cv_param(pparam, cv_param, g_x, g_y);
-	cv->type = WD_CV_CFG_PARAM;
-	ret = 0;
-
-free_cv:
-	OPENSSL_free(cv_param);
-free_ctx:
-	BN_CTX_end(ctx);
-	BN_CTX_free(ctx);
-
-	return ret;
-}
-
 static int get_smallest_hw_keybits(int bits)
 {
 	if (bits > ECC384BITS)
@@ -193,22 +75,17 @@ static int get_smallest_hw_keybits(int bits)
 
 static handle_t ecc_alloc_sess(const EC_KEY *eckey, const char *alg)
 {
-	char buff[UADK_ECC_MAX_KEY_BYTES * UADK_ECC_CV_PARAM_NUM];
 	struct sched_params sch_p = {0};
+	struct uadk_ecc_curve_buf cv_buf;
 	struct wd_ecc_sess_setup sp;
-	struct wd_ecc_curve param;
 	const EC_GROUP *group;
 	const BIGNUM *order;
 	int ret, key_bits;
 	handle_t sess;
 
-	init_dtb_param(&param, buff, 0, UADK_ECC_MAX_KEY_BYTES,
-		       UADK_ECC_CV_PARAM_NUM);
-
 	memset(&sp, 0, sizeof(sp));
-	sp.cv.cfg.pparam = &param;
 	group = EC_KEY_get0_group(eckey);
-	ret = set_sess_setup_cv(group, &sp.cv);
+	ret = uadk_ecc_curve_set_cfg(group, &sp.cv, &cv_buf);
 	if (ret)
 		return (handle_t)0;
 
@@ -0,0 +1,200 @@
+/*
+ * Copyright 2020-2022 Huawei Technologies Co.,Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include <pthread.h>
+#include <string.h>
+#include <openssl/bn.h>
+#include <openssl/obj_mac.h>
+#include "uadk_ecc_curve.h"
+
+#define ARRAY_SIZE(x)		(sizeof(x) / sizeof((x)[0]))
+
+struct ecc_curve_cache {
+	int nid;
+	int ready;
+	struct uadk_ecc_curve_buf buf;
+};
+
+/* named curves within the key sizes of the hardware, filled on first use */
+static struct ecc_curve_cache ecc_curve_cache[] = {
+	{ .nid = NID_X9_62_prime192v1 },
+	{ .nid = NID_secp224r1 },
+	{ .nid = NID_X9_62_prime256v1 },
+	{ .nid = NID_secp256k1 },
+	{ .nid = NID_secp384r1 },
+	{ .nid = NID_secp521r1 },
+	{ .nid = NID_sm2 },
+	{ .nid = NID_brainpoolP256r1 },
+	{ .nid = NID_brainpoolP320r1 },
+	{ .nid = NID_brainpoolP384r1 },
+};
+
+static pthread_mutex_t ecc_curve_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static void ecc_curve_init_buf(struct uadk_ecc_curve_buf *buf)
+{
+	struct wd_dtb *dtb = (struct wd_dtb *)&buf->param;
+	char *data = buf->data;
+	int i;
+
+	for (i = 0; i < UADK_ECC_CURVE_PARAM_NUM; i++) {
+		dtb[i].data = data;
+		dtb[i].dsize = 0;
+		dtb[i].bsize = UADK_ECC_CURVE_MAX_BYTES;
+		data += UADK_ECC_CURVE_MAX_BYTES;
+	}
+}
+
+static int ecc_curve_bn2dtb(const BIGNUM *bn, struct wd_dtb *dtb)
+{
+	if (BN_num_bytes(bn) > (int)dtb->bsize)
+		return -1;
+
+	dtb->dsize = BN_bn2bin(bn, (void *)dtb->data);
+	/* the hardware wants at least one byte for a zero coefficient */
+	if (!dtb->dsize) {
+		dtb->dsize = 1;
+		dtb->data[0] = 0;
+	}
+
+	return 0;
+}
+
+const struct wd_ecc_curve *uadk_ecc_curve_fill(const EC_GROUP *group,
+					       struct uadk_ecc_curve_buf *buf)
+{
+	struct wd_ecc_curve *param = &buf->param;
+	BIGNUM *p, *a, *b, *g_x, *g_y;
+	const struct wd_ecc_curve *ret = NULL;
+	const EC_POINT *g;
+	const BIGNUM *n;
+	BN_CTX *ctx;
+
+	ctx = BN_CTX_new();
+	if (!ctx)
+		return NULL;
+
+	BN_CTX_start(ctx);
+	p = BN_CTX_get(ctx);
+	a = BN_CTX_get(ctx);
+	b = BN_CTX_get(ctx);
+	g_x = BN_CTX_get(ctx);
+	g_y = BN_CTX_get(ctx);
+	if (!g_y)
+		goto free_ctx;
+
+	g = EC_GROUP_get0_generator(group);
+	n = EC_GROUP_get0_order(group);
+	if (!g || !n)
+		goto free_ctx;
+
+# if OPENSSL_VERSION_NUMBER > 0x10101000L
+	if (!EC_GROUP_get_curve(group, p, a, b, ctx) ||
+	    !EC_POINT_get_affine_coordinates(group, g, g_x, g_y, ctx))
+		goto free_ctx;
+# else
+	if (!EC_GROUP_get_curve_GFp(group, p, a, b, ctx) ||
+	    !EC_POINT_get_affine_coordinates_GFp(group, g, g_x, g_y, ctx))
+		goto free_ctx;
+# endif
+
+	ecc_curve_init_buf(buf);
+	if (ecc_curve_bn2dtb(p, &param->p) || ecc_curve_bn2dtb(a, &param->a) ||
+	    ecc_curve_bn2dtb(b, &param->b) || ecc_curve_bn2dtb(g_x, &param->g.x) ||
+	    ecc_curve_bn2dtb(g_y, &param->g.y) || ecc_curve_bn2dtb(n, &param->n))
+		goto free_ctx;
+
+	ret = param;
+
+free_ctx:
+	BN_CTX_end(ctx);
+	BN_CTX_free(ctx);
+	return ret;
+}
+
+static struct ecc_curve_cache *ecc_curve_cache_find(int nid)
+{
+	size_t i;
+
+	if (nid == NID_undef)
+		return NULL;
+
+	for (i = 0; i < ARRAY_SIZE(ecc_curve_cache); i++) {
+		if (ecc_curve_cache[i].nid == nid)
+			return &ecc_curve_cache[i];
+	}
+
+	return NULL;
+}
+
+static int ecc_curve_cache_load(struct ecc_curve_cache *cache)
+{
+	EC_GROUP *group;
+	int ret = 0;
+
+	pthread_mutex_lock(&ecc_curve_mutex);
+	if (cache->ready)
+		goto unlock;
+
+	/* from the builtin curve, not the caller's group, so every user sees the same */
+	group = EC_GROUP_new_by_curve_name(cache->nid);
+	if (!group) {
+		ret = -1;
+		goto unlock;
+	}
+
+	if (uadk_ecc_curve_fill(group, &cache->buf))
+		__atomic_store_n(&cache->ready, 1, __ATOMIC_RELEASE);
+	else
+		ret = -1;
+	EC_GROUP_free(group);
+
+unlock:
+	pthread_mutex_unlock(&ecc_curve_mutex);
+	return ret;
+}
+
+const struct wd_ecc_curve *uadk_ecc_curve_get(const EC_GROUP *group,
+					      struct uadk_ecc_curve_buf *buf)
+{
+	struct ecc_curve_cache *cache;
+
+	cache = ecc_curve_cache_find(EC_GROUP_get_curve_name(group));
+	if (!cache)
+		return uadk_ecc_curve_fill(group, buf);
+
+	if (!__atomic_load_n(&cache->ready, __ATOMIC_ACQUIRE) &&
+	    ecc_curve_cache_load(cache))
+		return uadk_ecc_curve_fill(group, buf);
+
+	return &cache->buf.param;
+}
+
+int uadk_ecc_curve_set_cfg(const EC_GROUP *group, struct wd_ecc_curve_cfg *cv,
+			   struct uadk_ecc_curve_buf *buf)
+{
+	const struct wd_ecc_curve *param;
+
+	param = uadk_ecc_curve_get(group, buf);
+	if (!param)
+		return -1;
+
+	/* wd_ecc_alloc_sess copies the parameters and never writes them */
+	cv->type = WD_CV_CFG_PARAM;
+	cv->cfg.pparam = (struct wd_ecc_curve *)param;
+
+	return 0;
+}
@@ -0,0 +1,49 @@
+/*
+ * Copyright 2020-2022 Huawei Technologies Co.,Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef UADK_ECC_CURVE_H
+#define UADK_ECC_CURVE_H
+#include <openssl/ec.h>
+#include <uadk/wd_ecc.h>
+
+#define UADK_ECC_CURVE_MAX_BYTES	66
+/* p, a, b, g.x, g.y and n, in the order of struct wd_ecc_curve */
+#define UADK_ECC_CURVE_PARAM_NUM	6
+
+struct uadk_ecc_curve_buf {
+	struct wd_ecc_curve param;
+	char data[UADK_ECC_CURVE_MAX_BYTES * UADK_ECC_CURVE_PARAM_NUM];
+};
+
+/*
+ * Serialise the curve of group into buf, whatever the curve is.
+ * Returns &buf->param, or NULL on failure.
+ */
+const struct wd_ecc_curve *uadk_ecc_curve_fill(const EC_GROUP *group,
+					       struct uadk_ecc_curve_buf *buf);
+
+/*
+ * Same as uadk_ecc_curve_fill, but named curves the hardware supports are
+ * serialised once per process and shared: the result must not be modified.
+ */
+const struct wd_ecc_curve *uadk_ecc_curve_get(const EC_GROUP *group,
+					      struct uadk_ecc_curve_buf *buf);
+
+/* Fill the session curve config from group, returns 0 or -1 on failure. */
+int uadk_ecc_curve_set_cfg(const EC_GROUP *group, struct wd_ecc_curve_cfg *cv,
+			   struct uadk_ecc_curve_buf *buf);
+
+#endif
@@ -0,0 +1,271 @@
+/*
+ * Copyright 2020-2022 Huawei Technologies Co.,Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#define _GNU_SOURCE
+#include <stdint.h>
+#include <stdlib.h>
+#include "uadk_utils.h"
+
+#if defined(__aarch64__)
+#include <sys/auxv.h>
+#ifndef HWCAP_ASIMD
+#define HWCAP_ASIMD			(1 << 1)
+#endif
+#ifndef HWCAP_SVE
+#define HWCAP_SVE			(1 << 22)
+#endif
+#elif defined(__x86_64__)
+#include <cpuid.h>
+#include <immintrin.h>
+#define CPUID_LEAF7_EBX_ERMS		(1 << 9)
+#endif
+
+/*
+ * Copies shorter than the threshold of the selected strategy go to libc,
+ * which inlines or dispatches them better than any out of line loop.
+ * Retune with test/uadk_memcpy_bench.c.
+ */
+#define UADK_MEM_IMPROVE_THRESHOLD	1024
+#define UADK_MEM_SVE_THRESHOLD		512
+#define UADK_MEM_AVX2_THRESHOLD		512
+#define UADK_MEM_ERMS_THRESHOLD		4096
+
+/* pick a strategy by name, e.g. UADK_MEMCPY=sve */
+#define UADK_MEMCPY_ENV			"UADK_MEMCPY"
+
+#define ARRAY_SIZE(x)			(sizeof(x) / sizeof((x)[0]))
+
+static void *memcpy_libc(void *dstpp, const void *srcpp, size_t len)
+{
+	return memcpy(dstpp, srcpp, len);
+}
+
+static int memcpy_always(void)
+{
+	return 1;
+}
+
+#if defined(__aarch64__)
+
+static void *memcpy_neon(void *dstpp, const void *srcpp, size_t len)
+{
+	/* the head and tail stores below assume at least 80 bytes */
+	if (len < 80)
+		return memcpy(dstpp, srcpp, len);
+
+	__asm__ __volatile__(
+			"add x4, %[src], %[count]\n\t"
+			"add x5, %[res], %[count]\n\t"
+			"ldr q0, [%[src]]\n\t"
+			"str q0, [%[res]]\n\t"
+			"sub %[count], %[count], 80\n\t"
+			"and x14, %[src], 15\n\t"
+			"bic %[src], %[src], 15\n\t"
+			"sub x3, %[res], x14\n\t"
+			"add %[count], %[count], x14\n\t"
+
+			"1:\n\t"
+			"ldp q0, q1, [%[src], 16]\n\t"
+			"stp q0, q1, [x3, 16]\n\t"
+			"ldp q0, q1, [%[src], 48]\n\t"
+			"stp q0, q1, [x3, 48]\n\t"
+			"add %[src], %[src], 64\n\t"
+			"add x3, x3, 64\n\t"
+			"subs %[count], %[count], 64\n\t"
+			"b.hi 1b\n\t"
+
+			"ldp q0, q1, [x4, -64]\n\t"
+			"stp q0, q1, [x5, -64]\n\t"
+			"ldp q0, q1, [x4, -32]\n\t"
+			"stp q0, q1, [x5, -32]\n\t"
+
+			: [res] "+r"(dstpp), [src] "+r"(srcpp), [count] "+r"(len)
+			:
+			: "x3", "x4", "x5", "x14", "v0", "v1", "cc", "memory"
+				  );
+
+	return dstpp;
+}
+
+static void *memcpy_sve(void *dstpp, const void *srcpp, size_t len)
+{
+	__asm__ __volatile__(
+			".arch_extension sve\n\t"
+			"mov x3, 0\n\t"
+			"whilelo p0.b, x3, %[count]\n\t"
+			"b.none 2f\n\t"
+
+			"1:\n\t"
+			"ld1b z0.b, p0/z, [%[src], x3]\n\t"
+			"st1b z0.b, p0, [%[res], x3]\n\t"
+			"incb x3\n\t"
+			"whilelo p0.b, x3, %[count]\n\t"
+			"b.first 1b\n\t"
+			"2:\n\t"
+
+			:
+			: [res] "r"(dstpp), [src] "r"(srcpp), [count] "r"(len)
+			: "x3", "v0", "p0", "cc", "memory"
+				  );
+
+	return dstpp;
+}
+
+static int memcpy_has_neon(void)
+{
+	return !!(getauxval(AT_HWCAP) & HWCAP_ASIMD);
+}
+
+static int memcpy_has_sve(void)
+{
+	return !!(getauxval(AT_HWCAP) & HWCAP_SVE);
+}
+
+#elif defined(__x86_64__)
+
+static __attribute__((target("avx2"))) void *memcpy_avx2(void *dstpp, const void *srcpp,
+							 size_t len)
+{
+	const unsigned char *src = srcpp;
+	unsigned char *dst = dstpp;
+	__m256i head, tail, v0, v1;
+	size_t i;
+
+	/* the unaligned head and tail overlap the loop, so need 64 bytes */
+	if (len < 64)
+		return memcpy(dstpp, srcpp, len);
+
+	head = _mm256_loadu_si256((const __m256i *)src);
+	tail = _mm256_loadu_si256((const __m256i *)(src + len - 32));
+	for (i = 32; i + 64 <= len - 32; i += 64) {
+		v0 = _mm256_loadu_si256((const __m256i *)(src + i));
+		v1 = _mm256_loadu_si256((const __m256i *)(src + i + 32));
+		_mm256_storeu_si256((__m256i *)(dst + i), v0);
+		_mm256_storeu_si256((__m256i *)(dst + i + 32), v1);
+	}
+	for (; i < len - 32; i += 32) {
+		v0 = _mm256_loadu_si256((const __m256i *)(src + i));
+		_mm256_storeu_si256((__m256i *)(dst + i), v0);
+	}
+	_mm256_storeu_si256((__m256i *)dst, head);
+	_mm256_storeu_si256((__m256i *)(dst + len - 32), tail);
+	_mm256_zeroupper();
+
+	return dstpp;
+}
+
+static void *memcpy_erms(void *dstpp, const void *srcpp, size_t len)
+{
+	void *dst = dstpp;
+
+	__asm__ __volatile__(
+			"rep movsb"
+			: "+D"(dst), "+S"(srcpp), "+c"(len)
+			:
+			: "memory"
+				  );
+
+	return dstpp;
+}
+
+static int memcpy_has_avx2(void)
+{
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx2");
+}
+
+static int memcpy_has_erms(void)
+{
+	unsigned int eax, ebx, ecx, edx;
+
+	if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx))
+		return 0;
+
+	return !!(ebx & CPUID_LEAF7_EBX_ERMS);
+}
+
+#endif
+
+/*
+ * In order of preference, the first supported entry is used: the NEON copy
+ * above its threshold on aarch64 as before, ERMS or AVX2 on x86-64 when
+ * cpuid reports them. libc is always supported, so the entries after it,
+ * SVE with no measurement on a target yet, are only picked through
+ * UADK_MEMCPY.
+ */
+static const struct uadk_memcpy_strategy memcpy_strategies[] = {
+#if defined(__aarch64__)
+	{ "neon", memcpy_neon, memcpy_has_neon, UADK_MEM_IMPROVE_THRESHOLD },
+#elif defined(__x86_64__)
+	{ "erms", memcpy_erms, memcpy_has_erms, UADK_MEM_ERMS_THRESHOLD },
+	{ "avx2", memcpy_avx2, memcpy_has_avx2, UADK_MEM_AVX2_THRESHOLD },
+#endif
+	{ "libc", memcpy_libc, memcpy_always, 0 },
+#if defined(__aarch64__)
+	{ "sve", memcpy_sve, memcpy_has_sve, UADK_MEM_SVE_THRESHOLD },
+#endif
+};
+
+static const struct uadk_memcpy_strategy *memcpy_selected = &memcpy_strategies[0];
+
+static void __attribute__((constructor)) uadk_memcpy_init(void)
+{
+	const char *name = secure_getenv(UADK_MEMCPY_ENV);
+	size_t i;
+
+	if (name) {
+		for (i = 0; i < ARRAY_SIZE(memcpy_strategies); i++) {
+			if (!strcmp(memcpy_strategies[i].name, name) &&
+			    memcpy_strategies[i].supported()) {
+				memcpy_selected = &memcpy_strategies[i];
+				return;
+			}
+		}
+	}
+
+	for (i = 0; i < ARRAY_SIZE(memcpy_strategies); i++) {
+		if (memcpy_strategies[i].supported()) {
+			memcpy_selected = &memcpy_strategies[i];
+			return;
+		}
+	}
+}
+
+void *uadk_memcpy(void *dstpp, const void *srcpp, size_t len)
+{
+	if (len < memcpy_selected->threshold)
+		return memcpy(dstpp, srcpp, len);
+
+	return memcpy_selected->copy(dstpp, srcpp, len);
+}
+
+int uadk_memcpy_strategy_num(void)
+{
+	return ARRAY_SIZE(memcpy_strategies);
+}
+
+const struct uadk_memcpy_strategy *uadk_memcpy_strategy_get(int idx)
+{
+	if (idx < 0 || idx >= (int)ARRAY_SIZE(memcpy_strategies))
+		return NULL;
+
+	return &memcpy_strategies[idx];
+}
+
+const struct uadk_memcpy_strategy *uadk_memcpy_strategy_selected(void)
+{
+	return memcpy_selected;
+}
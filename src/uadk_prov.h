@@ -17,8 +17,11 @@
  */
 #ifndef UADK_PROV_H
 #define UADK_PROV_H
+#include <stdbool.h>
 #include <openssl/bio.h>
 #include <openssl/core_dispatch.h>
+#include <openssl/crypto.h>
+#include <openssl/evp.h>
 
 #define FUNC_MAX_NUM			32
 #define CTX_ASYNC			1
@@ -131,10 +134,30 @@ typedef struct bio_method_st {
 	long (*callback_ctrl)(BIO *bio, int cmd, BIO_info_cb *fp);
 } UADK_BIO_METHOD;
 
+#define UADK_PROV_SOFT_ALG_MAX		64
+#define UADK_PROV_SOFT_NAME_SIZE	32
+
+enum uadk_prov_soft_type {
+	UADK_PROV_SOFT_CIPHER,
+	UADK_PROV_SOFT_MD,
+	UADK_PROV_SOFT_MAC,
+	UADK_PROV_SOFT_KDF,
+};
+
+/* a software fallback algorithm fetched from the default provider */
+struct uadk_prov_soft_alg {
+	enum uadk_prov_soft_type type;
+	char name[UADK_PROV_SOFT_NAME_SIZE];
+	void *alg;
+};
+
 typedef struct uadk_prov_ctx {
 	const OSSL_CORE_HANDLE *handle;
 	OSSL_LIB_CTX *libctx;
 	UADK_BIO_METHOD *corebiometh;
+	/* fetched once for the libctx, entries are only added until teardown */
+	int soft_num;
+	struct uadk_prov_soft_alg soft_algs[UADK_PROV_SOFT_ALG_MAX];
 } UADK_PROV_CTX;
 
 static inline OSSL_LIB_CTX *prov_libctx_of(struct uadk_prov_ctx *ctx)
@@ -144,6 +167,72 @@ static inline OSSL_LIB_CTX *prov_libctx_of(struct uadk_prov_ctx *ctx)
 	return ctx->libctx;
 }
 
+/*
+ * A session or buffer shared by a ctx and its duplicates until one of them
+ * changes it. The counter is NULL while the ctx has the object to itself.
+ */
+static inline bool uadk_prov_ref_share(int **refs)
+{
+	if (!*refs) {
+		*refs = OPENSSL_malloc(sizeof(int));
+		if (!*refs)
+			return false;
+		**refs = 1;
+	}
+
+	__atomic_add_fetch(*refs, 1, __ATOMIC_RELAXED);
+
+	return true;
+}
+
+static inline bool uadk_prov_ref_shared(const int *refs)
+{
+	return refs && __atomic_load_n(refs, __ATOMIC_ACQUIRE) > 1;
+}
+
+/* Leave the share, returns true if the caller was the last and owns the object. */
+static inline bool uadk_prov_ref_drop(int **refs)
+{
+	bool last;
+
+	if (!*refs)
+		return true;
+
+	last = !__atomic_sub_fetch(*refs, 1, __ATOMIC_ACQ_REL);
+	if (last)
+		OPENSSL_free(*refs);
+	*refs = NULL;
+
+	return last;
+}
+
+/* EVP_CIPHER_CTX_dup() and EVP_MD_CTX_dup() came with OpenSSL 3.1 */
+#if OPENSSL_VERSION_NUMBER < 0x30100000L
+static inline EVP_CIPHER_CTX *EVP_CIPHER_CTX_dup(const EVP_CIPHER_CTX *in)
+{
+	EVP_CIPHER_CTX *out = EVP_CIPHER_CTX_new();
+
+	if (out != NULL && !EVP_CIPHER_CTX_copy(out, in)) {
+		EVP_CIPHER_CTX_free(out);
+		out = NULL;
+	}
+
+	return out;
+}
+
+static inline EVP_MD_CTX *EVP_MD_CTX_dup(const EVP_MD_CTX *in)
+{
+	EVP_MD_CTX *out = EVP_MD_CTX_new();
+
+	if (out != NULL && !EVP_MD_CTX_copy_ex(out, in)) {
+		EVP_MD_CTX_free(out);
+		out = NULL;
+	}
+
+	return out;
+}
+#endif
+
 extern const OSSL_DISPATCH uadk_md5_functions[FUNC_MAX_NUM];
 extern const OSSL_DISPATCH uadk_sm3_functions[FUNC_MAX_NUM];
 extern const OSSL_DISPATCH uadk_sha1_functions[FUNC_MAX_NUM];
@@ -154,6 +243,11 @@ extern const OSSL_DISPATCH uadk_sha512_functions[FUNC_MAX_NUM];
 extern const OSSL_DISPATCH uadk_sha512_224_functions[FUNC_MAX_NUM];
 extern const OSSL_DISPATCH uadk_sha512_256_functions[FUNC_MAX_NUM];
 extern const OSSL_DISPATCH uadk_hmac_functions[FUNC_MAX_NUM];
+extern const OSSL_DISPATCH uadk_cmac_functions[FUNC_MAX_NUM];
+extern const OSSL_DISPATCH uadk_gmac_functions[FUNC_MAX_NUM];
+extern const OSSL_DISPATCH uadk_hkdf_functions[FUNC_MAX_NUM];
+extern const OSSL_DISPATCH uadk_tls13_kdf_functions[FUNC_MAX_NUM];
+extern const OSSL_DISPATCH uadk_tls1_prf_functions[FUNC_MAX_NUM];
 
 extern const OSSL_DISPATCH uadk_aes_128_cbc_functions[FUNC_MAX_NUM];
 extern const OSSL_DISPATCH uadk_aes_192_cbc_functions[FUNC_MAX_NUM];
@@ -180,11 +274,21 @@ extern const OSSL_DISPATCH uadk_sm4_ecb_functions[FUNC_MAX_NUM];
 extern const OSSL_DISPATCH uadk_sm4_ofb128_functions[FUNC_MAX_NUM];
 extern const OSSL_DISPATCH uadk_sm4_cfb128_functions[FUNC_MAX_NUM];
 extern const OSSL_DISPATCH uadk_sm4_ctr_functions[FUNC_MAX_NUM];
+extern const OSSL_DISPATCH uadk_sm4_xts_functions[FUNC_MAX_NUM];
 extern const OSSL_DISPATCH uadk_aes_128_gcm_functions[FUNC_MAX_NUM];
 extern const OSSL_DISPATCH uadk_aes_192_gcm_functions[FUNC_MAX_NUM];
 extern const OSSL_DISPATCH uadk_aes_256_gcm_functions[FUNC_MAX_NUM];
+extern const OSSL_DISPATCH uadk_aes_128_ccm_functions[FUNC_MAX_NUM];
+extern const OSSL_DISPATCH uadk_aes_192_ccm_functions[FUNC_MAX_NUM];
+extern const OSSL_DISPATCH uadk_aes_256_ccm_functions[FUNC_MAX_NUM];
+extern const OSSL_DISPATCH uadk_sm4_gcm_functions[FUNC_MAX_NUM];
+extern const OSSL_DISPATCH uadk_sm4_ccm_functions[FUNC_MAX_NUM];
 extern const OSSL_DISPATCH uadk_des_ede3_cbc_functions[FUNC_MAX_NUM];
 extern const OSSL_DISPATCH uadk_des_ede3_ecb_functions[FUNC_MAX_NUM];
+extern const OSSL_DISPATCH uadk_aes_128_cbc_hmac_sha1_functions[FUNC_MAX_NUM];
+extern const OSSL_DISPATCH uadk_aes_256_cbc_hmac_sha1_functions[FUNC_MAX_NUM];
+extern const OSSL_DISPATCH uadk_aes_128_cbc_hmac_sha256_functions[FUNC_MAX_NUM];
+extern const OSSL_DISPATCH uadk_aes_256_cbc_hmac_sha256_functions[FUNC_MAX_NUM];
 
 extern const OSSL_DISPATCH uadk_rsa_signature_functions[FUNC_MAX_NUM];
 extern const OSSL_DISPATCH uadk_rsa_keymgmt_functions[FUNC_MAX_NUM];
@@ -211,6 +315,7 @@ extern const OSSL_DISPATCH uadk_ecdsa_signature_functions[FUNC_MAX_NUM];
 
 void uadk_prov_destroy_digest(void);
 void uadk_prov_destroy_hmac(void);
+void uadk_prov_destroy_mac(void);
 void uadk_prov_destroy_cipher(void);
 void uadk_prov_destroy_aead(void);
 void uadk_prov_destroy_rsa(void);
@@ -220,6 +325,11 @@ void uadk_prov_dh_uninit(void);
 int uadk_prov_cipher_version(void);
 int uadk_prov_digest_version(void);
 int uadk_get_sw_offload_state(void);
+/* Fallback algorithms from the default provider, returned with a reference taken. */
+EVP_CIPHER *uadk_prov_soft_cipher(UADK_PROV_CTX *ctx, const char *name);
+EVP_MD *uadk_prov_soft_md(UADK_PROV_CTX *ctx, const char *name);
+EVP_MAC *uadk_prov_soft_mac(UADK_PROV_CTX *ctx, const char *name);
+EVP_KDF *uadk_prov_soft_kdf(UADK_PROV_CTX *ctx, const char *name);
 void uadk_set_sw_offload_state(int enable);
 void set_default_dh_keymgmt(void);
 void set_default_dh_keyexch(void);
@@ -21,9 +21,12 @@
 #include <stdbool.h>
 #include <string.h>
 #include <dlfcn.h>
+#include <limits.h>
 #include <numa.h>
 #include <openssl/core_names.h>
+#include <openssl/prov_ssl.h>
 #include <openssl/proverr.h>
+#include <openssl/rand.h>
 #include <uadk/wd_aead.h>
 #include <uadk/wd_sched.h>
 #include "uadk.h"
@@ -38,6 +41,30 @@
 #define AES_GCM_TAG_LEN			16
 /* The max data length is 16M-512B */
 #define AEAD_BLOCK_SIZE			0xFFFE00
+/* The length in the TLS aad is 16 bits */
+#define AEAD_TLS_MAX_LEN		0xFFFF
+/* TLS max_send_fragment unless libssl sets another */
+#define AEAD_TLS_MAX_FRAG		16384
+#define AEAD_TLS_HDR_LEN		5
+#define AEAD_TLS_RECORD_LEN(len)	(AEAD_TLS_HDR_LEN + EVP_GCM_TLS_EXPLICIT_IV_LEN + \
+					 (len) + EVP_GCM_TLS_TAG_LEN)
+/* libssl interleaves 4 or 8 records in a multiblock write */
+#define AEAD_MB_MAX_RECORDS		8
+/* The ccm nonce leaves 15 - ivlen bytes for the message length */
+#define CCM_MIN_IV_LEN			7
+#define CCM_MAX_IV_LEN			13
+#define CCM_DEF_TAG_LEN			12
+#define CCM_BLOCK_SIZE			16
+/* The driver puts a 16 bits message length in B0 */
+#define CCM_HW_MAX_LEN			0xFFFF
+
+/* Not in obj_mac.h before OpenSSL 3.2 */
+#ifndef NID_sm4_gcm
+#define NID_sm4_gcm			1248
+#endif
+#ifndef NID_sm4_ccm
+#define NID_sm4_ccm			1249
+#endif
 
 #define UADK_OSSL_FAIL			0
 #define UADK_AEAD_SUCCESS		1
@@ -52,7 +79,9 @@
 /* Internal flags that can be queried */
 #define PROV_CIPHER_FLAG_AEAD		0x0001
 #define PROV_CIPHER_FLAG_CUSTOM_IV	0x0002
+#define PROV_CIPHER_FLAG_TLS1_MULTIBLOCK	0x0008
 #define AEAD_FLAGS			(PROV_CIPHER_FLAG_AEAD | PROV_CIPHER_FLAG_CUSTOM_IV)
+#define AEAD_GCM_FLAGS			(AEAD_FLAGS | PROV_CIPHER_FLAG_TLS1_MULTIBLOCK)
 
 #define UADK_DO_HW			(-0xF0)
 #define UADK_AEAD_DEF_CTXS		2
@@ -76,6 +105,17 @@ enum aead_tag_status {
 	SET_TAG      /* The MAC has been set to req. */
 };
 
+/* the records of one multiblock write, in flight together */
+struct aead_mb_ctx {
+	struct wd_aead_req req[AEAD_MB_MAX_RECORDS];
+	unsigned char iv[AEAD_MB_MAX_RECORDS][MAX_IV_LEN];
+	unsigned char *buf;           /* aad and payload of each record */
+	size_t buf_len;
+	int done;
+	int failed;
+	int soft;                     /* no hardware, the soft cipher builds the records */
+};
+
 struct aead_priv_ctx {
 	int nid;
 	char alg_name[ALG_NAME_SIZE];
@@ -86,12 +126,29 @@ struct aead_priv_ctx {
 	unsigned int enc : 1;
 	unsigned int key_set : 1;     /* Whether key is copied to priv key buffers */
 	unsigned int iv_set : 1;      /* Whether iv is copied to priv iv buffers */
+	unsigned int iv_gen : 1;      /* Whether iv is a TLS fixed and invocation field */
+	unsigned int ccm : 1;         /* CCM, the whole message goes in one update */
+	unsigned int ccm_len_set : 1; /* Whether the ccm message length is known */
+	unsigned int ccm_done : 1;    /* Whether the ccm tag is ready to be read */
 	enum aead_tag_status tag_set; /* Whether mac is copied to priv mac buffers */
 
 	unsigned char iv[MAX_IV_LEN];
 	unsigned char key[MAX_KEY_LEN];
 	unsigned char buf[AES_GCM_TAG_LEN];       /* mac buffers */
-	unsigned char *data;          /* store input and output when block mode */
+	unsigned char tls_aad[EVP_AEAD_TLS1_AAD_LEN];
+	size_t tls_aad_len;           /* Set while the next update is a whole TLS record */
+	unsigned char *blk_buf;       /* aad and payload, then aad and output, of a block */
+	size_t blk_buf_len;
+	size_t ccm_len;
+	unsigned char *aad;           /* ccm aad, kept until the payload comes */
+	size_t aad_len;
+	size_t aad_size;
+	size_t mb_max_frag;           /* TLS max_send_fragment of multiblock writes */
+	unsigned char mb_aad[EVP_AEAD_TLS1_AAD_LEN];
+	size_t mb_len;                /* Payload of the multiblock write set up by mb_aad */
+	unsigned int mb_interleave;
+	size_t mb_enc_len;
+	struct aead_mb_ctx *mb;
 
 	struct wd_aead_sess_setup setup;
 	struct wd_aead_req req;
@@ -101,6 +158,7 @@ struct aead_priv_ctx {
 	int stream_switch_flag;    /* soft calculation switch flag for stream mode */
 	EVP_CIPHER_CTX *sw_ctx;
 	EVP_CIPHER *sw_aead;
+	UADK_PROV_CTX *provctx;
 };
 
 struct aead_info {
@@ -112,23 +170,14 @@ struct aead_info {
 static struct aead_info aead_info_table[] = {
 	{ NID_aes_128_gcm, WD_CIPHER_AES, WD_CIPHER_GCM },
 	{ NID_aes_192_gcm, WD_CIPHER_AES, WD_CIPHER_GCM },
-	{ NID_aes_256_gcm, WD_CIPHER_AES, WD_CIPHER_GCM }
+	{ NID_aes_256_gcm, WD_CIPHER_AES, WD_CIPHER_GCM },
+	{ NID_aes_128_ccm, WD_CIPHER_AES, WD_CIPHER_CCM },
+	{ NID_aes_192_ccm, WD_CIPHER_AES, WD_CIPHER_CCM },
+	{ NID_aes_256_ccm, WD_CIPHER_AES, WD_CIPHER_CCM },
+	{ NID_sm4_gcm, WD_CIPHER_SM4, WD_CIPHER_GCM },
+	{ NID_sm4_ccm, WD_CIPHER_SM4, WD_CIPHER_CCM }
 };
 
-# if OPENSSL_VERSION_NUMBER <= 0x30200000L
-static EVP_CIPHER_CTX *EVP_CIPHER_CTX_dup(const EVP_CIPHER_CTX *in)
-{
-	EVP_CIPHER_CTX *out = EVP_CIPHER_CTX_new();
-
-	if (out != NULL && !EVP_CIPHER_CTX_copy(out, in)) {
-		EVP_CIPHER_CTX_free(out);
-		out = NULL;
-	}
-
-	return out;
-}
-# endif
-
 static int uadk_aead_poll(void *ctx)
 {
 	__u64 rx_cnt = 0;
@@ -162,13 +211,28 @@ static int uadk_create_aead_soft_ctx(struct aead_priv_ctx *priv)
 
 	switch (priv->nid) {
 	case NID_aes_128_gcm:
-		priv->sw_aead = EVP_CIPHER_fetch(NULL, "AES-128-GCM", "provider=default");
+		priv->sw_aead = uadk_prov_soft_cipher(priv->provctx, "AES-128-GCM");
 		break;
 	case NID_aes_192_gcm:
-		priv->sw_aead = EVP_CIPHER_fetch(NULL, "AES-192-GCM", "provider=default");
+		priv->sw_aead = uadk_prov_soft_cipher(priv->provctx, "AES-192-GCM");
 		break;
 	case NID_aes_256_gcm:
-		priv->sw_aead = EVP_CIPHER_fetch(NULL, "AES-256-GCM", "provider=default");
+		priv->sw_aead = uadk_prov_soft_cipher(priv->provctx, "AES-256-GCM");
+		break;
+	case NID_aes_128_ccm:
+		priv->sw_aead = uadk_prov_soft_cipher(priv->provctx, "AES-128-CCM");
+		break;
+	case NID_aes_192_ccm:
+		priv->sw_aead = uadk_prov_soft_cipher(priv->provctx, "AES-192-CCM");
+		break;
+	case NID_aes_256_ccm:
+		priv->sw_aead = uadk_prov_soft_cipher(priv->provctx, "AES-256-CCM");
+		break;
+	case NID_sm4_gcm:
+		priv->sw_aead = uadk_prov_soft_cipher(priv->provctx, "SM4-GCM");
+		break;
+	case NID_sm4_ccm:
+		priv->sw_aead = uadk_prov_soft_cipher(priv->provctx, "SM4-CCM");
 		break;
 	default:
 		break;
@@ -730,6 +794,629 @@ static int uadk_prov_do_aes_gcm(struct aead_priv_ctx *priv, unsigned char *out,
 	return uadk_prov_do_aes_gcm_final(priv, out, NULL, 0);
 }
 
+static int uadk_prov_aead_tls_init(struct aead_priv_ctx *priv, const unsigned char *aad,
+				   size_t aad_len)
+{
+	size_t len;
+
+	if (aad_len != EVP_AEAD_TLS1_AAD_LEN) {
+		UADK_ERR("invalid tls aad length %zu.\n", aad_len);
+		return UADK_OSSL_FAIL;
+	}
+
+	memcpy(priv->tls_aad, aad, aad_len);
+
+	/* the record length in the aad still counts the explicit iv and the tag */
+	len = priv->tls_aad[aad_len - 2] << 8 | priv->tls_aad[aad_len - 1];
+	if (len < EVP_GCM_TLS_EXPLICIT_IV_LEN)
+		return UADK_OSSL_FAIL;
+	len -= EVP_GCM_TLS_EXPLICIT_IV_LEN;
+
+	if (!priv->enc) {
+		if (len < priv->taglen)
+			return UADK_OSSL_FAIL;
+		len -= priv->taglen;
+	}
+
+	priv->tls_aad[aad_len - 2] = (unsigned char)(len >> 8);
+	priv->tls_aad[aad_len - 1] = (unsigned char)(len & 0xff);
+	priv->tls_aad_len = aad_len;
+
+	return UADK_AEAD_SUCCESS;
+}
+
+static int uadk_prov_aead_set_iv_fixed(struct aead_priv_ctx *priv, const unsigned char *iv,
+				       size_t len)
+{
+	/* -1 restores the whole iv */
+	if (len == (size_t)-1) {
+		memcpy(priv->iv, iv, priv->ivlen);
+		goto out;
+	}
+
+	/* The fixed field is at least 4 bytes and the invocation field at least 8 */
+	if (len < EVP_GCM_TLS_FIXED_IV_LEN ||
+	    priv->ivlen < len + EVP_GCM_TLS_EXPLICIT_IV_LEN) {
+		UADK_ERR("invalid tls fixed iv length %zu.\n", len);
+		return UADK_OSSL_FAIL;
+	}
+
+	/* ccm records take the rest from the sequence number */
+	memcpy(priv->iv, iv, len);
+	if (priv->enc && !priv->ccm &&
+	    RAND_bytes_ex(prov_libctx_of(priv->provctx), priv->iv + len,
+			  priv->ivlen - len, 0) <= 0)
+		return UADK_OSSL_FAIL;
+
+out:
+	priv->iv_gen = 1;
+	priv->iv_set = IV_STATE_SET;
+
+	return UADK_AEAD_SUCCESS;
+}
+
+static void uadk_prov_aead_tls_iv_inc(unsigned char *counter)
+{
+	int n = EVP_GCM_TLS_EXPLICIT_IV_LEN;
+
+	do {
+		if (++counter[--n])
+			return;
+	} while (n);
+}
+
+static int uadk_prov_aead_blk_buf(struct aead_priv_ctx *priv, size_t buf_len)
+{
+	if (priv->blk_buf_len >= buf_len)
+		return UADK_AEAD_SUCCESS;
+
+	OPENSSL_clear_free(priv->blk_buf, priv->blk_buf_len << 1);
+	priv->blk_buf_len = 0;
+	priv->blk_buf = OPENSSL_malloc(buf_len << 1);
+	if (!priv->blk_buf)
+		return UADK_AEAD_FAIL;
+	priv->blk_buf_len = buf_len;
+
+	return UADK_AEAD_SUCCESS;
+}
+
+/*
+ * The aad and the payload of a whole message go in one block request,
+ * with the tag in req.mac. A gcm stream takes a first, a middle and an
+ * end request instead.
+ */
+static int uadk_prov_aead_block_hw(struct aead_priv_ctx *priv, const unsigned char *aad,
+				   size_t aad_len, unsigned char *out, const unsigned char *in,
+				   size_t len, unsigned char *tag)
+{
+	unsigned char ccm_iv[CCM_BLOCK_SIZE];
+	size_t buf_len = aad_len + len;
+	unsigned char *src, *dst;
+	struct async_op op;
+	int ret;
+
+	if (priv->stream_switch_flag == UADK_DO_SOFT || buf_len > AEAD_BLOCK_SIZE)
+		return SWITCH_TO_SOFT;
+
+	if (priv->ccm && (!len || len > CCM_HW_MAX_LEN || aad_len > MAX_AAD_LEN))
+		return SWITCH_TO_SOFT;
+
+	if (uadk_prov_aead_blk_buf(priv, buf_len) != UADK_AEAD_SUCCESS)
+		return SWITCH_TO_SOFT;
+
+	ret = uadk_prov_aead_ctx_init(priv);
+	if (ret != UADK_AEAD_SUCCESS)
+		return SWITCH_TO_SOFT;
+
+	ret = do_aes_gcm_prepare(priv);
+	if (unlikely(ret < 0))
+		return UADK_AEAD_FAIL;
+
+	src = priv->blk_buf;
+	dst = priv->blk_buf + priv->blk_buf_len;
+	memcpy(src, aad, aad_len);
+	memcpy(src + aad_len, in, len);
+	priv->req.assoc_bytes = aad_len;
+	if (!priv->enc) {
+		if (tag != priv->req.mac)
+			memcpy(priv->req.mac, tag, priv->taglen);
+		priv->tag_set = SET_TAG;
+	}
+
+	if (priv->ccm) {
+		/* counter block 0: the flags with L - 1, the nonce and a zero counter */
+		memset(ccm_iv, 0, sizeof(ccm_iv));
+		ccm_iv[0] = CCM_BLOCK_SIZE - 2 - priv->ivlen;
+		memcpy(ccm_iv + 1, priv->iv, priv->ivlen);
+		priv->req.iv = ccm_iv;
+		priv->req.iv_bytes = CCM_BLOCK_SIZE;
+	}
+
+	if (priv->mode == ASYNC_MODE) {
+		ret = async_setup_async_event_notification(&op);
+		if (unlikely(!ret)) {
+			UADK_ERR("failed to setup async event notification.\n");
+			ret = UADK_AEAD_FAIL;
+			goto out;
+		}
+
+		priv->req.msg_state = AEAD_MSG_BLOCK;
+		ret = uadk_do_aead_async_inner(priv, &op, dst, src, len);
+		if (unlikely(ret < 0))
+			(void)async_clear_async_event_notification();
+	} else {
+		ret = uadk_do_aead_sync_inner(priv, dst, src, len, AEAD_MSG_BLOCK);
+	}
+
+	if (unlikely(ret < 0)) {
+		UADK_ERR("aead block request failed, switch to soft.\n");
+		ret = SWITCH_TO_SOFT;
+		goto out;
+	}
+
+	memcpy(out, dst + aad_len, len);
+	if (priv->enc && tag != priv->req.mac)
+		memcpy(tag, priv->req.mac, priv->taglen);
+	ret = UADK_AEAD_SUCCESS;
+
+out:
+	priv->req.iv = priv->iv;
+	priv->req.iv_bytes = priv->ivlen;
+	priv->tag_set = INIT_TAG;
+	priv->mode = UNINIT_MODE;
+	return ret;
+}
+
+/* A whole message with the software cipher, ccm needs its lengths first */
+static int uadk_prov_aead_soft_block(struct aead_priv_ctx *priv, const unsigned char *iv,
+				     const unsigned char *aad, size_t aad_len,
+				     unsigned char *out, const unsigned char *in, size_t len,
+				     unsigned char *tag)
+{
+	OSSL_PARAM params[3], *p = params;
+	int outl, final_len;
+
+	if (!priv->sw_aead || len > INT_MAX || aad_len > INT_MAX)
+		return UADK_AEAD_FAIL;
+
+	*p++ = OSSL_PARAM_construct_size_t(OSSL_CIPHER_PARAM_AEAD_IVLEN, &priv->ivlen);
+	if (priv->ccm)
+		*p++ = OSSL_PARAM_construct_octet_string(OSSL_CIPHER_PARAM_AEAD_TAG,
+							 priv->enc ? NULL : tag, priv->taglen);
+	*p = OSSL_PARAM_construct_end();
+
+	if (!EVP_CipherInit_ex2(priv->sw_ctx, priv->sw_aead, NULL, NULL, priv->enc, params) ||
+	    !EVP_CipherInit_ex2(priv->sw_ctx, NULL, priv->key, iv, priv->enc, NULL) ||
+	    (priv->ccm && !EVP_CipherUpdate(priv->sw_ctx, NULL, &outl, NULL, (int)len)) ||
+	    (aad_len && !EVP_CipherUpdate(priv->sw_ctx, NULL, &outl, aad, (int)aad_len)) ||
+	    !EVP_CipherUpdate(priv->sw_ctx, out, &outl, in, (int)len))
+		goto err;
+
+	if (!priv->enc && !priv->ccm &&
+	    EVP_CIPHER_CTX_ctrl(priv->sw_ctx, EVP_CTRL_AEAD_SET_TAG, priv->taglen, tag) <= 0)
+		goto err;
+
+	if (!EVP_CipherFinal_ex(priv->sw_ctx, out + outl, &final_len))
+		goto err;
+
+	if (priv->enc &&
+	    EVP_CIPHER_CTX_ctrl(priv->sw_ctx, EVP_CTRL_AEAD_GET_TAG, priv->taglen, tag) <= 0)
+		goto err;
+
+	return UADK_AEAD_SUCCESS;
+
+err:
+	UADK_ERR("aead soft block failed.\n");
+	return UADK_AEAD_FAIL;
+}
+
+/*
+ * A TLS 1.2 record after OSSL_CIPHER_PARAM_AEAD_TLS1_AAD, processed in place:
+ * explicit iv || payload || tag, as the default provider does. The explicit
+ * iv is 8 bytes for ccm as well.
+ */
+static int uadk_prov_aead_tls_cipher(struct aead_priv_ctx *priv, unsigned char *out,
+				     size_t *outl, const unsigned char *in, size_t len)
+{
+	unsigned char *explicit_iv = priv->iv + priv->ivlen - EVP_GCM_TLS_EXPLICIT_IV_LEN;
+	unsigned char *tag;
+	size_t plen;
+	int ret = UADK_OSSL_FAIL;
+
+	if (out != in || len < EVP_GCM_TLS_EXPLICIT_IV_LEN + priv->taglen ||
+	    len - EVP_GCM_TLS_EXPLICIT_IV_LEN - priv->taglen > AEAD_TLS_MAX_LEN ||
+	    !priv->iv_gen || !priv->key_set ||
+	    (!priv->ccm && priv->taglen != EVP_GCM_TLS_TAG_LEN)) {
+		UADK_ERR("invalid tls record or aead state.\n");
+		goto out;
+	}
+
+	/* The explicit part of the iv is sent with the record, ccm sends the sequence */
+	if (priv->enc) {
+		if (priv->ccm)
+			memcpy(explicit_iv, priv->tls_aad, EVP_GCM_TLS_EXPLICIT_IV_LEN);
+		memcpy(out, explicit_iv, EVP_GCM_TLS_EXPLICIT_IV_LEN);
+	} else {
+		memcpy(explicit_iv, in, EVP_GCM_TLS_EXPLICIT_IV_LEN);
+	}
+
+	in += EVP_GCM_TLS_EXPLICIT_IV_LEN;
+	out += EVP_GCM_TLS_EXPLICIT_IV_LEN;
+	plen = len - EVP_GCM_TLS_EXPLICIT_IV_LEN - priv->taglen;
+	tag = out + plen;
+
+	ret = uadk_prov_aead_block_hw(priv, priv->tls_aad, priv->tls_aad_len, out, in, plen, tag);
+	if (ret == SWITCH_TO_SOFT)
+		ret = uadk_prov_aead_soft_block(priv, priv->iv, priv->tls_aad, priv->tls_aad_len,
+						out, in, plen, tag);
+
+	/* Every gcm record uses a new invocation field, as in the default provider */
+	if (priv->enc && !priv->ccm)
+		uadk_prov_aead_tls_iv_inc(explicit_iv);
+
+	if (ret != UADK_AEAD_SUCCESS) {
+		if (!priv->enc)
+			OPENSSL_cleanse(out, plen);
+		ret = UADK_OSSL_FAIL;
+		goto out;
+	}
+
+	*outl = priv->enc ? len : plen;
+	ret = UADK_AEAD_SUCCESS;
+
+out:
+	priv->tls_aad_len = 0;
+	return ret;
+}
+
+/* The message length has to fit the 15 - ivlen bytes left by the nonce */
+static int uadk_prov_aead_ccm_len_ok(struct aead_priv_ctx *priv, size_t len)
+{
+	size_t l = CCM_BLOCK_SIZE - 1 - priv->ivlen;
+
+	return l >= sizeof(size_t) || len < ((size_t)1 << (l * 8));
+}
+
+static int uadk_prov_aead_ccm_set_aad(struct aead_priv_ctx *priv, const unsigned char *aad,
+				      size_t len)
+{
+	unsigned char *buf;
+
+	if (priv->aad_size < len) {
+		buf = OPENSSL_malloc(len);
+		if (!buf)
+			return UADK_OSSL_FAIL;
+		OPENSSL_clear_free(priv->aad, priv->aad_size);
+		priv->aad = buf;
+		priv->aad_size = len;
+	}
+
+	memcpy(priv->aad, aad, len);
+	priv->aad_len = len;
+
+	return UADK_AEAD_SUCCESS;
+}
+
+/*
+ * CCM as the default provider takes it: the message length with no input
+ * and no output, then the aad, then the whole payload in one update.
+ */
+static int uadk_prov_aead_ccm_update(struct aead_priv_ctx *priv, unsigned char *out,
+				     size_t *outl, const unsigned char *in, size_t inl)
+{
+	int ret;
+
+	if (!priv->key_set || !priv->iv_set) {
+		UADK_ERR("ccm key or iv is not set yet!\n");
+		return UADK_OSSL_FAIL;
+	}
+
+	if (!out) {
+		if (!in) {
+			if (!uadk_prov_aead_ccm_len_ok(priv, inl))
+				return UADK_OSSL_FAIL;
+			priv->ccm_len = inl;
+			priv->ccm_len_set = 1;
+		} else {
+			/* the length goes in B0, which the aad follows */
+			if ((!priv->ccm_len_set && inl) ||
+			    !uadk_prov_aead_ccm_set_aad(priv, in, inl))
+				return UADK_OSSL_FAIL;
+		}
+
+		*outl = inl;
+		return UADK_AEAD_SUCCESS;
+	}
+
+	if (priv->ccm_len_set ? inl != priv->ccm_len : !uadk_prov_aead_ccm_len_ok(priv, inl)) {
+		UADK_ERR("invalid ccm message length %zu.\n", inl);
+		return UADK_OSSL_FAIL;
+	}
+
+	if (!priv->enc && priv->tag_set != READ_TAG) {
+		UADK_ERR("the tag for ccm decryption is not set.\n");
+		return UADK_OSSL_FAIL;
+	}
+
+	ret = uadk_prov_aead_block_hw(priv, priv->aad, priv->aad_len, out, in, inl, priv->buf);
+	if (ret == SWITCH_TO_SOFT)
+		ret = uadk_prov_aead_soft_block(priv, priv->iv, priv->aad, priv->aad_len,
+						out, in, inl, priv->buf);
+
+	priv->aad_len = 0;
+	priv->ccm_len_set = 0;
+	priv->tag_set = INIT_TAG;
+	if (ret != UADK_AEAD_SUCCESS) {
+		if (!priv->enc)
+			OPENSSL_cleanse(out, inl);
+		return UADK_OSSL_FAIL;
+	}
+
+	/* a nonce is good for one message only */
+	if (priv->enc)
+		priv->ccm_done = 1;
+	else
+		priv->iv_set = IV_STATE_UNINITIALISED;
+
+	*outl = inl;
+	return UADK_AEAD_SUCCESS;
+}
+
+/*
+ * OSSL_CIPHER_PARAM_TLS1_MULTIBLOCK_AAD: the aad of the first record and
+ * the payload of the whole write, split in interleave records. libssl from
+ * 3.2 on takes a failure here as fatal to the connection, so without the
+ * hardware the records are built by the soft cipher instead.
+ */
+static int uadk_prov_aead_mb_init(struct aead_priv_ctx *priv, const unsigned char *aad,
+				  size_t len, unsigned int interleave)
+{
+	size_t frag, last, buf_len;
+	int soft = 0;
+
+	if (!priv->enc || priv->ccm || !priv->iv_gen || !priv->key_set ||
+	    priv->taglen != EVP_GCM_TLS_TAG_LEN)
+		return UADK_OSSL_FAIL;
+
+	/* the explicit iv is in TLS 1.2 records only */
+	if ((aad[9] << 8 | aad[10]) < TLS1_2_VERSION || !interleave ||
+	    interleave > AEAD_MB_MAX_RECORDS || len < interleave)
+		return UADK_OSSL_FAIL;
+
+	frag = len / interleave;
+	last = len - frag * (interleave - 1);
+	if (AEAD_TLS_RECORD_LEN(last) - AEAD_TLS_HDR_LEN > AEAD_TLS_MAX_LEN)
+		return UADK_OSSL_FAIL;
+
+	/*
+	 * The flag is reported whether or not enable_sw_offload is set, and a
+	 * record the queue gives back still has to be sent, so the soft cipher
+	 * is there for every multiblock write.
+	 */
+	if (uadk_create_aead_soft_ctx(priv) != UADK_AEAD_SUCCESS)
+		return UADK_OSSL_FAIL;
+
+	if (priv->stream_switch_flag == UADK_DO_SOFT ||
+	    uadk_prov_aead_ctx_init(priv) != UADK_AEAD_SUCCESS)
+		soft = 1;
+
+	if (!priv->mb) {
+		priv->mb = OPENSSL_zalloc(sizeof(*priv->mb));
+		if (!priv->mb)
+			return UADK_OSSL_FAIL;
+	}
+	priv->mb->soft = soft;
+
+	buf_len = interleave * (EVP_AEAD_TLS1_AAD_LEN + last);
+	if (priv->mb->buf_len < buf_len) {
+		OPENSSL_clear_free(priv->mb->buf, priv->mb->buf_len);
+		priv->mb->buf_len = 0;
+		priv->mb->buf = OPENSSL_malloc(buf_len);
+		if (!priv->mb->buf)
+			return UADK_OSSL_FAIL;
+		priv->mb->buf_len = buf_len;
+	}
+
+	memcpy(priv->mb_aad, aad, EVP_AEAD_TLS1_AAD_LEN);
+	priv->mb_len = len;
+	priv->mb_interleave = interleave;
+
+	return UADK_AEAD_SUCCESS;
+}
+
+static void *uadk_prov_aead_mb_cb(struct wd_aead_req *req, void *data)
+{
+	struct aead_mb_ctx *mb;
+
+	if (!req || !req->cb_param)
+		return NULL;
+
+	mb = req->cb_param;
+	if (req->state)
+		__atomic_store_n(&mb->failed, 1, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&mb->done, 1, __ATOMIC_RELEASE);
+
+	return NULL;
+}
+
+/*
+ * Every record is sent before the first one is waited for, so the queue
+ * works on all of them instead of one round trip per record.
+ */
+static int uadk_prov_aead_mb_hw(struct aead_priv_ctx *priv, unsigned int num)
+{
+	struct aead_mb_ctx *mb = priv->mb;
+	unsigned int sent, cnt;
+	__u64 rx_cnt = 0;
+	__u32 recv;
+	int done, ret = 0;
+
+	mb->done = 0;
+	mb->failed = 0;
+	for (sent = 0; sent < num; sent++) {
+		cnt = 0;
+		do {
+			ret = wd_do_aead_async(priv->sess, &mb->req[sent]);
+			/* a full queue drains as the records already sent come back */
+			if (ret == -EBUSY)
+				(void)wd_aead_poll(1, &recv);
+		} while (ret == -EBUSY && cnt++ < ENGINE_SEND_MAX_CNT);
+
+		if (unlikely(ret < 0)) {
+			UADK_ERR("failed to send multiblock record, ret = %d.\n", ret);
+			break;
+		}
+	}
+
+	/* the buffers belong to the hardware until every record sent is back */
+	while ((done = __atomic_load_n(&mb->done, __ATOMIC_ACQUIRE)) < (int)sent) {
+		if (unlikely(rx_cnt++ >= PROV_SCH_RECV_MAX_CNT)) {
+			UADK_ERR("failed to poll multiblock records: timeout!\n");
+			/* a late record still writes to them, so they are not reused */
+			priv->mb = NULL;
+			return UADK_AEAD_FAIL;
+		}
+		(void)wd_aead_poll(sent - done, &recv);
+	}
+
+	if (sent < num || mb->failed)
+		return SWITCH_TO_SOFT;
+
+	return UADK_AEAD_SUCCESS;
+}
+
+/*
+ * OSSL_CIPHER_PARAM_TLS1_MULTIBLOCK_ENC: the payload set up by the aad,
+ * written to out as interleave whole records, headers included.
+ */
+static int uadk_prov_aead_mb_enc(struct aead_priv_ctx *priv, unsigned char *out,
+				 const unsigned char *in, size_t len, unsigned int interleave)
+{
+	unsigned char *explicit_iv = priv->iv + priv->ivlen - EVP_GCM_TLS_EXPLICIT_IV_LEN;
+	size_t frag, rec_len, stride, enc_len = 0;
+	struct aead_mb_ctx *mb = priv->mb;
+	unsigned char *rec, *src;
+	struct wd_aead_req *req;
+	unsigned int i, seq;
+	int n, ret;
+
+	if (!mb || !out || !in || len != priv->mb_len || interleave != priv->mb_interleave) {
+		UADK_ERR("multiblock write does not match its aad.\n");
+		return UADK_OSSL_FAIL;
+	}
+
+	frag = len / interleave;
+	stride = EVP_AEAD_TLS1_AAD_LEN + len - frag * (interleave - 1);
+	for (i = 0; i < interleave; i++) {
+		rec_len = i == interleave - 1 ? len - frag * i : frag;
+		rec = out + i * AEAD_TLS_RECORD_LEN(frag);
+		src = mb->buf + i * stride;
+
+		/* the sequence number goes up by one for each record */
+		memcpy(src, priv->mb_aad, EVP_AEAD_TLS1_AAD_LEN);
+		for (n = 7, seq = i; n >= 0 && seq; n--) {
+			seq += src[n];
+			src[n] = (unsigned char)seq;
+			seq >>= 8;
+		}
+		src[11] = (unsigned char)(rec_len >> 8);
+		src[12] = (unsigned char)rec_len;
+		memcpy(src + EVP_AEAD_TLS1_AAD_LEN, in + i * frag, rec_len);
+
+		memcpy(mb->iv[i], priv->iv, priv->ivlen);
+		uadk_prov_aead_tls_iv_inc(explicit_iv);
+
+		/* the aad is as long as the header and explicit iv it lands on */
+		req = &mb->req[i];
+		*req = priv->req;
+		req->op_type = WD_CIPHER_ENCRYPTION_DIGEST;
+		req->msg_state = AEAD_MSG_BLOCK;
+		req->src = src;
+		req->dst = rec;
+		req->in_bytes = rec_len;
+		req->assoc_bytes = EVP_AEAD_TLS1_AAD_LEN;
+		req->iv = mb->iv[i];
+		req->iv_bytes = priv->ivlen;
+		req->mac = rec + EVP_AEAD_TLS1_AAD_LEN + rec_len;
+		req->mac_bytes = EVP_GCM_TLS_TAG_LEN;
+		req->cb = uadk_prov_aead_mb_cb;
+		req->cb_param = mb;
+		req->state = POLL_ERROR;
+	}
+
+	ret = mb->soft ? SWITCH_TO_SOFT : uadk_prov_aead_mb_hw(priv, interleave);
+	if (ret == UADK_AEAD_FAIL)
+		return UADK_OSSL_FAIL;
+
+	for (i = 0; i < interleave; i++) {
+		rec_len = i == interleave - 1 ? len - frag * i : frag;
+		rec = out + i * AEAD_TLS_RECORD_LEN(frag);
+		src = mb->buf + i * stride;
+
+		if (ret == SWITCH_TO_SOFT &&
+		    uadk_prov_aead_soft_block(priv, mb->iv[i], src, EVP_AEAD_TLS1_AAD_LEN,
+					      rec + EVP_AEAD_TLS1_AAD_LEN,
+					      src + EVP_AEAD_TLS1_AAD_LEN, rec_len,
+					      rec + EVP_AEAD_TLS1_AAD_LEN + rec_len) != UADK_AEAD_SUCCESS) {
+			UADK_ERR("failed to encrypt multiblock record in soft.\n");
+			return UADK_OSSL_FAIL;
+		}
+
+		rec_len = AEAD_TLS_RECORD_LEN(rec_len) - AEAD_TLS_HDR_LEN;
+		rec[0] = priv->mb_aad[8];
+		rec[1] = priv->mb_aad[9];
+		rec[2] = priv->mb_aad[10];
+		rec[3] = (unsigned char)(rec_len >> 8);
+		rec[4] = (unsigned char)rec_len;
+		memcpy(rec + AEAD_TLS_HDR_LEN, mb->iv[i] + priv->ivlen - EVP_GCM_TLS_EXPLICIT_IV_LEN,
+		       EVP_GCM_TLS_EXPLICIT_IV_LEN);
+		enc_len += AEAD_TLS_HDR_LEN + rec_len;
+	}
+
+	priv->mb_enc_len = enc_len;
+	priv->mb_len = 0;
+
+	return UADK_AEAD_SUCCESS;
+}
+
+static int uadk_prov_aead_set_mb_params(struct aead_priv_ctx *priv, const OSSL_PARAM params[])
+{
+	const OSSL_PARAM *p, *p1;
+	unsigned int interleave = 0;
+
+	p = OSSL_PARAM_locate_const(params, OSSL_CIPHER_PARAM_TLS1_MULTIBLOCK_MAX_SEND_FRAGMENT);
+	if (p) {
+		if (!OSSL_PARAM_get_size_t(p, &priv->mb_max_frag) ||
+		    priv->mb_max_frag > AEAD_TLS_MAX_LEN) {
+			UADK_ERR("invalid multiblock max send fragment.\n");
+			return UADK_OSSL_FAIL;
+		}
+	}
+
+	p = OSSL_PARAM_locate_const(params, OSSL_CIPHER_PARAM_TLS1_MULTIBLOCK_INTERLEAVE);
+	if (p && !OSSL_PARAM_get_uint(p, &interleave))
+		return UADK_OSSL_FAIL;
+
+	/* the octet string is the aad, its size the payload of the write */
+	p = OSSL_PARAM_locate_const(params, OSSL_CIPHER_PARAM_TLS1_MULTIBLOCK_AAD);
+	if (p) {
+		if (p->data_type != OSSL_PARAM_OCTET_STRING || !p->data ||
+		    !uadk_prov_aead_mb_init(priv, p->data, p->data_size, interleave))
+			return UADK_OSSL_FAIL;
+	}
+
+	p = OSSL_PARAM_locate_const(params, OSSL_CIPHER_PARAM_TLS1_MULTIBLOCK_ENC);
+	if (p) {
+		p1 = OSSL_PARAM_locate_const(params, OSSL_CIPHER_PARAM_TLS1_MULTIBLOCK_ENC_IN);
+		if (p->data_type != OSSL_PARAM_OCTET_STRING || !p1 ||
+		    p1->data_type != OSSL_PARAM_OCTET_STRING ||
+		    !uadk_prov_aead_mb_enc(priv, p->data, p1->data, p1->data_size, interleave))
+			return UADK_OSSL_FAIL;
+	}
+
+	return UADK_AEAD_SUCCESS;
+}
+
 void uadk_prov_destroy_aead(void)
 {
 	pthread_mutex_lock(&aead_mutex);
@@ -756,7 +1443,7 @@ static int uadk_prov_aead_cipher(void *vctx, unsigned char *out, size_t *outl,
 	struct aead_priv_ctx *priv = (struct aead_priv_ctx *)vctx;
 	int ret;
 
-	if (!vctx || !out || !outl)
+	if (!vctx || !outl)
 		return UADK_OSSL_FAIL;
 
 	if (outsize < inl) {
@@ -764,6 +1451,16 @@ static int uadk_prov_aead_cipher(void *vctx, unsigned char *out, size_t *outl,
 		return UADK_OSSL_FAIL;
 	}
 
+	if (priv->tls_aad_len)
+		return uadk_prov_aead_tls_cipher(priv, out, outl, in, inl);
+
+	/* the ccm length and aad come with no output */
+	if (priv->ccm)
+		return uadk_prov_aead_ccm_update(priv, out, outl, in, inl);
+
+	if (!out)
+		return UADK_OSSL_FAIL;
+
 	ret = uadk_prov_do_aes_gcm(priv, out, outl, outsize, in, inl);
 	if (ret < 0)
 		return UADK_OSSL_FAIL;
@@ -787,6 +1484,13 @@ static int uadk_prov_aead_stream_update(void *vctx, unsigned char *out,
 		return UADK_OSSL_FAIL;
 	}
 
+	/* libssl hands a whole record to update once the tls aad is set */
+	if (priv->tls_aad_len)
+		return uadk_prov_aead_tls_cipher(priv, out, outl, in, inl);
+
+	if (priv->ccm)
+		return uadk_prov_aead_ccm_update(priv, out, outl, in, inl);
+
 	if (priv->stream_switch_flag == UADK_DO_SOFT)
 		goto do_soft;
 	ret = uadk_prov_do_aes_gcm(priv, out, outl, outsize, in, inl);
@@ -824,6 +1528,12 @@ static int uadk_prov_aead_stream_final(void *vctx, unsigned char *out,
 	if (!vctx || !out || !outl)
 		return UADK_OSSL_FAIL;
 
+	/* the ccm payload update did all the work */
+	if (priv->ccm) {
+		*outl = 0;
+		return UADK_AEAD_SUCCESS;
+	}
+
 	if (priv->stream_switch_flag == UADK_DO_SOFT)
 		goto do_soft;
 
@@ -892,6 +1602,10 @@ static int uadk_prov_aead_init(struct aead_priv_ctx *priv, const unsigned char *
 	}
 
 	priv->stream_switch_flag = 0;
+	priv->tls_aad_len = 0;
+	priv->ccm_len_set = 0;
+	priv->ccm_done = 0;
+	priv->aad_len = 0;
 
 	if (uadk_get_sw_offload_state())
 		uadk_create_aead_soft_ctx(priv);
@@ -899,6 +1613,11 @@ static int uadk_prov_aead_init(struct aead_priv_ctx *priv, const unsigned char *
 	ret = uadk_prov_aead_dev_init(priv);
 	if (unlikely(ret < 0)) {
 		UADK_ERR("aead switch to soft init.!\n");
+		/* ccm sets up the soft cipher for each message */
+		if (priv->ccm) {
+			priv->stream_switch_flag = UADK_DO_SOFT;
+			return priv->sw_aead ? UADK_AEAD_SUCCESS : UADK_OSSL_FAIL;
+		}
 		return uadk_prov_aead_soft_init(priv, key, iv, params);
 	}
 
@@ -939,6 +1658,13 @@ static const OSSL_PARAM uadk_prov_settable_ctx_params[] = {
 	OSSL_PARAM_size_t(OSSL_CIPHER_PARAM_KEYLEN, NULL),
 	OSSL_PARAM_size_t(OSSL_CIPHER_PARAM_AEAD_IVLEN, NULL),
 	OSSL_PARAM_octet_string(OSSL_CIPHER_PARAM_AEAD_TAG, NULL, 0),
+	OSSL_PARAM_octet_string(OSSL_CIPHER_PARAM_AEAD_TLS1_AAD, NULL, 0),
+	OSSL_PARAM_octet_string(OSSL_CIPHER_PARAM_AEAD_TLS1_IV_FIXED, NULL, 0),
+	OSSL_PARAM_size_t(OSSL_CIPHER_PARAM_TLS1_MULTIBLOCK_MAX_SEND_FRAGMENT, NULL),
+	OSSL_PARAM_octet_string(OSSL_CIPHER_PARAM_TLS1_MULTIBLOCK_AAD, NULL, 0),
+	OSSL_PARAM_uint(OSSL_CIPHER_PARAM_TLS1_MULTIBLOCK_INTERLEAVE, NULL),
+	OSSL_PARAM_octet_string(OSSL_CIPHER_PARAM_TLS1_MULTIBLOCK_ENC, NULL, 0),
+	OSSL_PARAM_octet_string(OSSL_CIPHER_PARAM_TLS1_MULTIBLOCK_ENC_IN, NULL, 0),
 	OSSL_PARAM_END
 };
 
@@ -959,7 +1685,27 @@ static int uadk_prov_aead_set_ctx_params(void *vctx, const OSSL_PARAM params[])
 		return UADK_OSSL_FAIL;
 
 	p = OSSL_PARAM_locate_const(params, OSSL_CIPHER_PARAM_AEAD_TAG);
-	if (p) {
+	if (p && priv->ccm) {
+		/* ccm also takes the tag length alone, before encryption */
+		if (p->data_type != OSSL_PARAM_OCTET_STRING || p->data_size < 4 ||
+		    p->data_size > AES_GCM_TAG_LEN || (p->data_size & 1) ||
+		    (p->data && priv->enc)) {
+			UADK_ERR("invalid ccm tag.\n");
+			return UADK_OSSL_FAIL;
+		}
+
+		if (p->data) {
+			memcpy(priv->buf, p->data, p->data_size);
+			priv->tag_set = READ_TAG;
+		}
+
+		/* the session has the tag length in it */
+		if (priv->taglen != p->data_size && priv->sess) {
+			wd_aead_free_sess(priv->sess);
+			priv->sess = 0;
+		}
+		priv->taglen = p->data_size;
+	} else if (p) {
 		vp = priv->buf;
 		if (!OSSL_PARAM_get_octet_string(p, &vp, EVP_GCM_TLS_TAG_LEN, &sz)) {
 			UADK_ERR("failed to get string parameter: sz.\n");
@@ -994,14 +1740,33 @@ static int uadk_prov_aead_set_ctx_params(void *vctx, const OSSL_PARAM params[])
 			UADK_ERR("failed to get size parameter: sz.\n");
 			return UADK_OSSL_FAIL;
 		}
-		if (sz == 0 || sz > priv->ivlen) {
+		if (priv->ccm ? sz < CCM_MIN_IV_LEN || sz > CCM_MAX_IV_LEN :
+				sz == 0 || sz > priv->ivlen) {
 			UADK_ERR("invalid sz or ivlen.\n");
 			return UADK_OSSL_FAIL;
 		}
 		priv->ivlen = sz;
 	}
 
-	return UADK_AEAD_SUCCESS;
+	p = OSSL_PARAM_locate_const(params, OSSL_CIPHER_PARAM_AEAD_TLS1_AAD);
+	if (p) {
+		if (p->data_type != OSSL_PARAM_OCTET_STRING ||
+		    !uadk_prov_aead_tls_init(priv, p->data, p->data_size)) {
+			UADK_ERR("failed to set tls aad.\n");
+			return UADK_OSSL_FAIL;
+		}
+	}
+
+	p = OSSL_PARAM_locate_const(params, OSSL_CIPHER_PARAM_AEAD_TLS1_IV_FIXED);
+	if (p) {
+		if (p->data_type != OSSL_PARAM_OCTET_STRING ||
+		    !uadk_prov_aead_set_iv_fixed(priv, p->data, p->data_size)) {
+			UADK_ERR("failed to set tls fixed iv.\n");
+			return UADK_OSSL_FAIL;
+		}
+	}
+
+	return uadk_prov_aead_set_mb_params(priv, params);
 }
 
 static const OSSL_PARAM uadk_prov_aead_ctx_params[] = {
@@ -1011,6 +1776,11 @@ static const OSSL_PARAM uadk_prov_aead_ctx_params[] = {
 	OSSL_PARAM_octet_string(OSSL_CIPHER_PARAM_IV, NULL, 0),
 	OSSL_PARAM_octet_string(OSSL_CIPHER_PARAM_UPDATED_IV, NULL, 0),
 	OSSL_PARAM_octet_string(OSSL_CIPHER_PARAM_AEAD_TAG, NULL, 0),
+	OSSL_PARAM_size_t(OSSL_CIPHER_PARAM_AEAD_TLS1_AAD_PAD, NULL),
+	OSSL_PARAM_size_t(OSSL_CIPHER_PARAM_TLS1_MULTIBLOCK_MAX_BUFSIZE, NULL),
+	OSSL_PARAM_uint(OSSL_CIPHER_PARAM_TLS1_MULTIBLOCK_INTERLEAVE, NULL),
+	OSSL_PARAM_size_t(OSSL_CIPHER_PARAM_TLS1_MULTIBLOCK_AAD_PACKLEN, NULL),
+	OSSL_PARAM_size_t(OSSL_CIPHER_PARAM_TLS1_MULTIBLOCK_ENC_LEN, NULL),
 	OSSL_PARAM_END
 };
 
@@ -1039,6 +1809,40 @@ static int uadk_prov_aead_get_ctx_iv(OSSL_PARAM *p, struct aead_priv_ctx *priv)
 	return UADK_AEAD_SUCCESS;
 }
 
+static int uadk_prov_aead_get_mb_params(struct aead_priv_ctx *priv, OSSL_PARAM params[])
+{
+	size_t frag = priv->mb_max_frag ? priv->mb_max_frag : AEAD_TLS_MAX_FRAG;
+	OSSL_PARAM *p;
+
+	/* one record of max_send_fragment, libssl allocates interleave of them */
+	p = OSSL_PARAM_locate(params, OSSL_CIPHER_PARAM_TLS1_MULTIBLOCK_MAX_BUFSIZE);
+	if (p && !OSSL_PARAM_set_size_t(p, AEAD_TLS_RECORD_LEN(frag))) {
+		UADK_ERR("failed to set size parameter: multiblock max bufsize.\n");
+		return UADK_OSSL_FAIL;
+	}
+
+	p = OSSL_PARAM_locate(params, OSSL_CIPHER_PARAM_TLS1_MULTIBLOCK_INTERLEAVE);
+	if (p && !OSSL_PARAM_set_uint(p, priv->mb_interleave)) {
+		UADK_ERR("failed to set uint parameter: multiblock interleave.\n");
+		return UADK_OSSL_FAIL;
+	}
+
+	p = OSSL_PARAM_locate(params, OSSL_CIPHER_PARAM_TLS1_MULTIBLOCK_AAD_PACKLEN);
+	if (p && !OSSL_PARAM_set_size_t(p, priv->mb_interleave *
+					AEAD_TLS_RECORD_LEN(0) + priv->mb_len)) {
+		UADK_ERR("failed to set size parameter: multiblock aad packlen.\n");
+		return UADK_OSSL_FAIL;
+	}
+
+	p = OSSL_PARAM_locate(params, OSSL_CIPHER_PARAM_TLS1_MULTIBLOCK_ENC_LEN);
+	if (p && !OSSL_PARAM_set_size_t(p, priv->mb_enc_len)) {
+		UADK_ERR("failed to set size parameter: multiblock enc len.\n");
+		return UADK_OSSL_FAIL;
+	}
+
+	return UADK_AEAD_SUCCESS;
+}
+
 static int uadk_prov_aead_get_ctx_params(void *vctx, OSSL_PARAM params[])
 {
 	struct aead_priv_ctx *priv = (struct aead_priv_ctx *)vctx;
@@ -1083,7 +1887,8 @@ static int uadk_prov_aead_get_ctx_params(void *vctx, OSSL_PARAM params[])
 		size_t sz = p->data_size;
 
 		if (sz == 0 || sz > EVP_GCM_TLS_TAG_LEN || !priv->enc
-			|| priv->taglen == UNINITIALISED_SIZET) {
+			|| priv->taglen == UNINITIALISED_SIZET
+			|| (priv->ccm && (!priv->ccm_done || sz != priv->taglen))) {
 			UADK_ERR("invalid size enc or taglen.\n");
 			return UADK_OSSL_FAIL;
 		}
@@ -1092,9 +1897,22 @@ static int uadk_prov_aead_get_ctx_params(void *vctx, OSSL_PARAM params[])
 			UADK_ERR("failed to set octet string parameter: sz.\n");
 			return UADK_OSSL_FAIL;
 		}
+
+		/* a ccm nonce is good for one message only */
+		if (priv->ccm) {
+			priv->ccm_done = 0;
+			priv->iv_set = IV_STATE_UNINITIALISED;
+		}
 	}
 
-	return UADK_AEAD_SUCCESS;
+	/* The tag is appended to a tls record */
+	p = OSSL_PARAM_locate(params, OSSL_CIPHER_PARAM_AEAD_TLS1_AAD_PAD);
+	if (p && !OSSL_PARAM_set_size_t(p, priv->taglen)) {
+		UADK_ERR("failed to set size parameter: tls aad pad.\n");
+		return UADK_OSSL_FAIL;
+	}
+
+	return uadk_prov_aead_get_mb_params(priv, params);
 }
 
 static const OSSL_PARAM aead_known_gettable_params[] = {
@@ -1104,6 +1922,7 @@ static const OSSL_PARAM aead_known_gettable_params[] = {
 	OSSL_PARAM_size_t(OSSL_CIPHER_PARAM_BLOCK_SIZE, NULL),
 	OSSL_PARAM_int(OSSL_CIPHER_PARAM_AEAD, NULL),
 	OSSL_PARAM_int(OSSL_CIPHER_PARAM_CUSTOM_IV, NULL),
+	OSSL_PARAM_int(OSSL_CIPHER_PARAM_TLS1_MULTIBLOCK, NULL),
 	OSSL_PARAM_END
 };
 
@@ -1133,6 +1952,13 @@ static int uadk_cipher_aead_get_params(OSSL_PARAM params[], unsigned int md,
 		UADK_ERR("failed to set int parameter: flag custom iv.\n");
 		return UADK_OSSL_FAIL;
 	}
+	/* only worth it with the hardware, the records go to it together */
+	p = OSSL_PARAM_locate(params, OSSL_CIPHER_PARAM_TLS1_MULTIBLOCK);
+	if (p && !OSSL_PARAM_set_int(p, (flags & PROV_CIPHER_FLAG_TLS1_MULTIBLOCK) &&
+				     uadk_prov_cipher_version() != HW_SYMM_ENC_INVALID)) {
+		UADK_ERR("failed to set int parameter: flag tls1 multiblock.\n");
+		return UADK_OSSL_FAIL;
+	}
 	p = OSSL_PARAM_locate(params, OSSL_CIPHER_PARAM_KEYLEN);
 	if (p && !OSSL_PARAM_set_size_t(p, kbits)) {
 		UADK_ERR("failed to set size parameter: kbits.\n");
@@ -1165,16 +1991,24 @@ static void *uadk_prov_aead_dupctx(void *ctx)
 	if (!dst_ctx)
 		return NULL;
 
+	/* every gcm request carries stream state, so the copy gets its own session */
 	dst_ctx->sess = 0;
-	dst_ctx->data = OPENSSL_memdup(src_ctx->data, AEAD_BLOCK_SIZE << 1);
-	if (!dst_ctx->data)
-		goto free_ctx;
+	dst_ctx->blk_buf = NULL;
+	dst_ctx->blk_buf_len = 0;
+	dst_ctx->mb = NULL;
+	dst_ctx->mb_len = 0;
+
+	if (src_ctx->aad) {
+		dst_ctx->aad = OPENSSL_memdup(src_ctx->aad, src_ctx->aad_size);
+		if (!dst_ctx->aad)
+			goto free_ctx;
+	}
 
 	if (dst_ctx->sw_ctx) {
 		dst_ctx->sw_ctx = EVP_CIPHER_CTX_dup(src_ctx->sw_ctx);
 		if (!dst_ctx->sw_ctx) {
 			UADK_ERR("EVP_CIPHER_CTX_dup failed in ctx copy.\n");
-			goto free_data;
+			goto free_aad;
 		}
 
 		ret = EVP_CIPHER_up_ref(dst_ctx->sw_aead);
@@ -1187,8 +2021,8 @@ static void *uadk_prov_aead_dupctx(void *ctx)
 free_dup:
 	if (dst_ctx->sw_ctx)
 		EVP_CIPHER_CTX_free(dst_ctx->sw_ctx);
-free_data:
-	OPENSSL_clear_free(dst_ctx->data, AEAD_BLOCK_SIZE << 1);
+free_aad:
+	OPENSSL_clear_free(dst_ctx->aad, dst_ctx->aad_size);
 free_ctx:
 	OPENSSL_clear_free(dst_ctx, sizeof(*dst_ctx));
 	return NULL;
@@ -1204,8 +2038,12 @@ static void uadk_prov_aead_freectx(void *ctx)
 	if (priv->sess)
 		wd_aead_free_sess(priv->sess);
 
-	if (priv->data)
-		OPENSSL_clear_free(priv->data, AEAD_BLOCK_SIZE << 1);
+	OPENSSL_clear_free(priv->blk_buf, priv->blk_buf_len << 1);
+	OPENSSL_clear_free(priv->aad, priv->aad_size);
+	if (priv->mb) {
+		OPENSSL_clear_free(priv->mb->buf, priv->mb->buf_len);
+		OPENSSL_free(priv->mb);
+	}
 
 	if (priv->sw_ctx)
 		uadk_aead_soft_cleanup(priv);
@@ -1222,16 +2060,12 @@ static void *uadk_##nm##_newctx(void *provctx)					\
 	if (!ctx)								\
 		return NULL;							\
 										\
-	ctx->data = OPENSSL_zalloc(AEAD_BLOCK_SIZE << 1);			\
-	if (!ctx->data) {							\
-		OPENSSL_free(ctx);						\
-		return NULL;							\
-	}									\
-										\
 	ctx->keylen = key_len;							\
+	ctx->provctx = provctx;							\
 	ctx->ivlen = iv_len;							\
 	ctx->nid = e_nid;							\
 	ctx->taglen = tag_len;							\
+	ctx->ccm = (mode == EVP_CIPH_CCM_MODE);					\
 	strncpy(ctx->alg_name, #algnm, ALG_NAME_SIZE - 1);			\
 										\
 	return ctx;								\
@@ -1270,9 +2104,19 @@ const OSSL_DISPATCH uadk_##nm##_functions[] = {					\
 	{ 0, NULL }								\
 }
 
-UADK_AEAD_DESCR(aes_128_gcm, AES_GCM_TAG_LEN, 16, 12, 8, AEAD_FLAGS, NID_aes_128_gcm, gcm(aes),
+UADK_AEAD_DESCR(aes_128_gcm, AES_GCM_TAG_LEN, 16, 12, 8, AEAD_GCM_FLAGS, NID_aes_128_gcm, gcm(aes),
+		EVP_CIPH_GCM_MODE);
+UADK_AEAD_DESCR(aes_192_gcm, AES_GCM_TAG_LEN, 24, 12, 8, AEAD_GCM_FLAGS, NID_aes_192_gcm, gcm(aes),
 		EVP_CIPH_GCM_MODE);
-UADK_AEAD_DESCR(aes_192_gcm, AES_GCM_TAG_LEN, 24, 12, 8, AEAD_FLAGS, NID_aes_192_gcm, gcm(aes),
+UADK_AEAD_DESCR(aes_256_gcm, AES_GCM_TAG_LEN, 32, 12, 8, AEAD_GCM_FLAGS, NID_aes_256_gcm, gcm(aes),
 		EVP_CIPH_GCM_MODE);
-UADK_AEAD_DESCR(aes_256_gcm, AES_GCM_TAG_LEN, 32, 12, 8, AEAD_FLAGS, NID_aes_256_gcm, gcm(aes),
+UADK_AEAD_DESCR(aes_128_ccm, CCM_DEF_TAG_LEN, 16, CCM_MIN_IV_LEN, 8, AEAD_FLAGS, NID_aes_128_ccm,
+		ccm(aes), EVP_CIPH_CCM_MODE);
+UADK_AEAD_DESCR(aes_192_ccm, CCM_DEF_TAG_LEN, 24, CCM_MIN_IV_LEN, 8, AEAD_FLAGS, NID_aes_192_ccm,
+		ccm(aes), EVP_CIPH_CCM_MODE);
+UADK_AEAD_DESCR(aes_256_ccm, CCM_DEF_TAG_LEN, 32, CCM_MIN_IV_LEN, 8, AEAD_FLAGS, NID_aes_256_ccm,
+		ccm(aes), EVP_CIPH_CCM_MODE);
+UADK_AEAD_DESCR(sm4_gcm, AES_GCM_TAG_LEN, 16, 12, 8, AEAD_FLAGS, NID_sm4_gcm, gcm(sm4),
 		EVP_CIPH_GCM_MODE);
+UADK_AEAD_DESCR(sm4_ccm, CCM_DEF_TAG_LEN, 16, CCM_MIN_IV_LEN, 8, AEAD_FLAGS, NID_sm4_ccm,
+		ccm(sm4), EVP_CIPH_CCM_MODE);
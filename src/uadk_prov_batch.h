@@ -0,0 +1,182 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/*
+ * Copyright 2024 Huawei Technologies Co.,Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef UADK_PROV_BATCH_H
+#define UADK_PROV_BATCH_H
+
+/*
+ * Batch signing and verification with uadk_provider.
+ *
+ * A batch is a set of independent sign or verify operations under the key
+ * of one EVP_PKEY_CTX. The provider sends all of them to the accelerator
+ * before waiting for any, instead of one request and one round trip per
+ * EVP_PKEY_sign() or EVP_PKEY_verify() call.
+ *
+ * The batch goes in through one EVP_PKEY_CTX_get_params() call, so nothing
+ * but this header is needed by an application:
+ *
+ *	EVP_PKEY_sign_init(ctx);
+ *	uadk_prov_batch_sign(ctx, items, num);
+ *
+ * Each item then has its own status. The helpers fall back to plain
+ * EVP_PKEY_sign() and EVP_PKEY_verify() calls, item by item, when the ctx
+ * has no batches, so they can be used unconditionally.
+ *
+ * ECDSA and SM2 ctxs take batches, RSA ones pad in software around each
+ * request and have none. The items are digests, as for EVP_PKEY_sign(),
+ * and the signatures are DER encoded.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <openssl/crypto.h>
+#include <openssl/evp.h>
+#include <openssl/params.h>
+
+/*
+ * The params of a batch, in this order: the op, then a tbs, sig and status
+ * param for each item, then done. It is a get call as the provider writes
+ * the status, the signature length and done back. A ctx with batches lists
+ * UADK_PROV_PARAM_BATCH_DONE in its gettable ctx params.
+ */
+/* uint, enum uadk_prov_batch_op, it must match the init of the ctx */
+#define UADK_PROV_PARAM_BATCH_OP	"uadk-batch-op"
+/* octet string, the digest */
+#define UADK_PROV_PARAM_BATCH_TBS	"uadk-batch-tbs"
+/* octet string; sign: the buffer, return_size the signature length; verify: the signature */
+#define UADK_PROV_PARAM_BATCH_SIG	"uadk-batch-sig"
+/* int, out: 1 signed or verified, 0 failed or a bad signature */
+#define UADK_PROV_PARAM_BATCH_STATUS	"uadk-batch-status"
+/* size_t, out: the items done by the provider, the first ones */
+#define UADK_PROV_PARAM_BATCH_DONE	"uadk-batch-done"
+/* params for the op and done, beside the items */
+#define UADK_PROV_BATCH_PARAMS		2
+#define UADK_PROV_BATCH_ITEM_PARAMS	3
+
+enum uadk_prov_batch_op {
+	UADK_PROV_BATCH_SIGN = 1,
+	UADK_PROV_BATCH_VERIFY,
+};
+
+struct uadk_prov_batch_item {
+	/* digest to sign or to verify the signature of */
+	const unsigned char *tbs;
+	size_t tbslen;
+	/* sign: out, at least EVP_PKEY_get_size() bytes; verify: in */
+	unsigned char *sig;
+	/* sign: size of sig in, signature length out; verify: signature length */
+	size_t siglen;
+	/* out: 1 signed or verified, 0 failed or a bad signature */
+	int status;
+};
+
+static inline int uadk_prov_batch_supported(EVP_PKEY_CTX *ctx)
+{
+	const OSSL_PARAM *gettable = EVP_PKEY_CTX_gettable_params(ctx);
+
+	return gettable && OSSL_PARAM_locate_const(gettable, UADK_PROV_PARAM_BATCH_DONE);
+}
+
+/* the items the provider did, done is 0 if it did none or wrote no count */
+static inline size_t uadk_prov_batch_send(EVP_PKEY_CTX *ctx, unsigned int op,
+					  struct uadk_prov_batch_item *items, size_t num)
+{
+	OSSL_PARAM *params, *p, *done_param;
+	size_t i, done = 0;
+
+	if (num > (SIZE_MAX / sizeof(*params) - UADK_PROV_BATCH_PARAMS - 1) /
+		  UADK_PROV_BATCH_ITEM_PARAMS)
+		return 0;
+
+	params = OPENSSL_malloc((UADK_PROV_BATCH_ITEM_PARAMS * num + UADK_PROV_BATCH_PARAMS + 1) *
+				sizeof(*params));
+	if (!params)
+		return 0;
+
+	p = params;
+	*p++ = OSSL_PARAM_construct_uint(UADK_PROV_PARAM_BATCH_OP, &op);
+	for (i = 0; i < num; i++) {
+		*p++ = OSSL_PARAM_construct_octet_string(UADK_PROV_PARAM_BATCH_TBS,
+							 (void *)items[i].tbs, items[i].tbslen);
+		*p++ = OSSL_PARAM_construct_octet_string(UADK_PROV_PARAM_BATCH_SIG,
+							 items[i].sig, items[i].siglen);
+		*p++ = OSSL_PARAM_construct_int(UADK_PROV_PARAM_BATCH_STATUS, &items[i].status);
+	}
+	done_param = p;
+	*p++ = OSSL_PARAM_construct_size_t(UADK_PROV_PARAM_BATCH_DONE, &done);
+	*p = OSSL_PARAM_construct_end();
+
+	/* a count the provider did not write, or a bad one, is no batch at all */
+	if (EVP_PKEY_CTX_get_params(ctx, params) <= 0 ||
+	    !OSSL_PARAM_modified(done_param) || done > num)
+		done = 0;
+
+	for (i = 0; op == UADK_PROV_BATCH_SIGN && i < done; i++) {
+		if (items[i].status == 1)
+			items[i].siglen = params[1 + UADK_PROV_BATCH_ITEM_PARAMS * i + 1].return_size;
+	}
+	OPENSSL_free(params);
+
+	return done;
+}
+
+static inline int uadk_prov_batch_run(EVP_PKEY_CTX *ctx, unsigned int op,
+				      struct uadk_prov_batch_item *items, size_t num)
+{
+	size_t i, sigsize, done = 0;
+	int ret;
+
+	if (!ctx || (!items && num) ||
+	    (op != UADK_PROV_BATCH_SIGN && op != UADK_PROV_BATCH_VERIFY))
+		return 0;
+
+	if (num && uadk_prov_batch_supported(ctx))
+		done = uadk_prov_batch_send(ctx, op, items, num);
+
+	/* no batches in the ctx, or the provider gave up part way through */
+	for (i = done; i < num; i++) {
+		if (op == UADK_PROV_BATCH_SIGN) {
+			sigsize = items[i].siglen;
+			ret = EVP_PKEY_sign(ctx, items[i].sig, &sigsize,
+					    items[i].tbs, items[i].tbslen);
+			if (ret > 0)
+				items[i].siglen = sigsize;
+		} else {
+			ret = EVP_PKEY_verify(ctx, items[i].sig, items[i].siglen,
+					      items[i].tbs, items[i].tbslen);
+		}
+		items[i].status = ret > 0;
+	}
+
+	return 1;
+}
+
+/* sign num digests with the key of a ctx set up by EVP_PKEY_sign_init() */
+static inline int uadk_prov_batch_sign(EVP_PKEY_CTX *ctx,
+				       struct uadk_prov_batch_item *items, size_t num)
+{
+	return uadk_prov_batch_run(ctx, UADK_PROV_BATCH_SIGN, items, num);
+}
+
+/* verify num signatures with the key of a ctx set up by EVP_PKEY_verify_init() */
+static inline int uadk_prov_batch_verify(EVP_PKEY_CTX *ctx,
+					 struct uadk_prov_batch_item *items, size_t num)
+{
+	return uadk_prov_batch_run(ctx, UADK_PROV_BATCH_VERIFY, items, num);
+}
+
+#endif
@@ -22,7 +22,10 @@
 #include <dlfcn.h>
 #include <numa.h>
 #include <openssl/core_names.h>
+#include <openssl/prov_ssl.h>
 #include <openssl/proverr.h>
+#include <openssl/rand.h>
+#include <openssl/sha.h>
 #include <uadk/wd_cipher.h>
 #include <uadk/wd_sched.h>
 #include "uadk.h"
@@ -60,6 +63,18 @@
 # define UADK_CIPHER_CTS_CS2_NAME	"cbc-cs2(aes)"
 # define UADK_CIPHER_CTS_CS3_NAME	"cbc-cs3(aes)"
 
+#ifndef OSSL_CIPHER_PARAM_XTS_STANDARD
+# define OSSL_CIPHER_PARAM_XTS_STANDARD	"xts_standard"
+#endif
+/* OSSL_CIPHER_PARAM_XTS_STANDARD Values */
+# define UADK_CIPHER_XTS_GB		"GB"
+# define UADK_CIPHER_XTS_IEEE		"IEEE"
+
+/* an xts update is one data unit, IEEE P1619 caps it at 2^20 blocks */
+#define XTS_MAX_BLOCKS_PER_DATA_UNIT	(1 << 20)
+#define XTS_TWEAK_BATCH			32
+#define SM4_KEY_SIZE			16
+
 enum uadk_cipher_alg_id {
 	ID_aes_128_ecb,
 	ID_aes_192_ecb,
@@ -86,6 +101,7 @@ enum uadk_cipher_alg_id {
 	ID_sm4_cfb128,
 	ID_sm4_ecb,
 	ID_sm4_ctr,
+	ID_sm4_xts,
 	ID_des_ede3_cbc,
 	ID_des_ede3_ecb,
 };
@@ -106,6 +122,7 @@ static pthread_mutex_t cipher_mutex = PTHREAD_MUTEX_INITIALIZER;
 struct cipher_priv_ctx {
 	int nid;
 	handle_t sess;
+	int *sess_refs;          /* Set while the session is shared with duplicates */
 	struct wd_cipher_sess_setup setup;
 	struct wd_cipher_req req;
 	unsigned char iv[IV_LEN];
@@ -115,13 +132,16 @@ struct cipher_priv_ctx {
 	int switch_flag;
 	EVP_CIPHER_CTX *sw_ctx;
 	EVP_CIPHER *sw_cipher;
+	UADK_PROV_CTX *provctx;
 	/* Crypto small packet offload threshold */
 	size_t switch_threshold;
 	unsigned int enc : 1;
 	unsigned int pad : 1;    /* Whether padding should be used or not */
 	unsigned int cts_mode;   /* Use to set the type for CTS modes */
+	unsigned int xts_gb : 1;    /* SM4-XTS tweaks follow GB/T 17964, not IEEE P1619 */
 	unsigned int key_set : 1;    /* Whether key is copied to priv key buffers */
 	unsigned int iv_set : 1;    /* Whether iv is copied to priv iv buffers */
+	unsigned int key_prog : 1;  /* Whether the session holds the current key */
 	size_t blksize;
 	size_t keylen;
 	size_t ivlen;
@@ -161,6 +181,7 @@ static struct cipher_info cipher_info_table[] = {
 	{ ID_sm4_cfb128, WD_CIPHER_SM4, WD_CIPHER_CFB},
 	{ ID_sm4_ecb, WD_CIPHER_SM4, WD_CIPHER_ECB},
 	{ ID_sm4_ctr, WD_CIPHER_SM4, WD_CIPHER_CTR},
+	{ ID_sm4_xts, WD_CIPHER_SM4, WD_CIPHER_XTS},
 	{ ID_des_ede3_cbc, WD_CIPHER_3DES, WD_CIPHER_CBC},
 	{ ID_des_ede3_ecb, WD_CIPHER_3DES, WD_CIPHER_ECB},
 };
@@ -210,85 +231,89 @@ static int uadk_create_cipher_soft_ctx(struct cipher_priv_ctx *priv)
 
 	switch (priv->nid) {
 	case ID_aes_128_cbc:
-		priv->sw_cipher = EVP_CIPHER_fetch(NULL, "AES-128-CBC", "provider=default");
+		priv->sw_cipher = uadk_prov_soft_cipher(priv->provctx, "AES-128-CBC");
 		break;
 	case ID_aes_192_cbc:
-		priv->sw_cipher = EVP_CIPHER_fetch(NULL, "AES-192-CBC", "provider=default");
+		priv->sw_cipher = uadk_prov_soft_cipher(priv->provctx, "AES-192-CBC");
 		break;
 	case ID_aes_256_cbc:
-		priv->sw_cipher = EVP_CIPHER_fetch(NULL, "AES-256-CBC", "provider=default");
+		priv->sw_cipher = uadk_prov_soft_cipher(priv->provctx, "AES-256-CBC");
 		break;
 	case ID_aes_128_cts:
-		priv->sw_cipher = EVP_CIPHER_fetch(NULL, "AES-128-CBC-CTS", "provider=default");
+		priv->sw_cipher = uadk_prov_soft_cipher(priv->provctx, "AES-128-CBC-CTS");
 		break;
 	case ID_aes_192_cts:
-		priv->sw_cipher = EVP_CIPHER_fetch(NULL, "AES-192-CBC-CTS", "provider=default");
+		priv->sw_cipher = uadk_prov_soft_cipher(priv->provctx, "AES-192-CBC-CTS");
 		break;
 	case ID_aes_256_cts:
-		priv->sw_cipher = EVP_CIPHER_fetch(NULL, "AES-256-CBC-CTS", "provider=default");
+		priv->sw_cipher = uadk_prov_soft_cipher(priv->provctx, "AES-256-CBC-CTS");
 		break;
 	case ID_aes_128_ecb:
-		priv->sw_cipher = EVP_CIPHER_fetch(NULL, "AES-128-ECB", "provider=default");
+		priv->sw_cipher = uadk_prov_soft_cipher(priv->provctx, "AES-128-ECB");
 		break;
 	case ID_aes_192_ecb:
-		priv->sw_cipher = EVP_CIPHER_fetch(NULL, "AES-192-ECB", "provider=default");
+		priv->sw_cipher = uadk_prov_soft_cipher(priv->provctx, "AES-192-ECB");
 		break;
 	case ID_aes_256_ecb:
-		priv->sw_cipher = EVP_CIPHER_fetch(NULL, "AES-256-ECB", "provider=default");
+		priv->sw_cipher = uadk_prov_soft_cipher(priv->provctx, "AES-256-ECB");
 		break;
 	case ID_sm4_cbc:
-		priv->sw_cipher = EVP_CIPHER_fetch(NULL, "SM4-CBC", "provider=default");
+		priv->sw_cipher = uadk_prov_soft_cipher(priv->provctx, "SM4-CBC");
 		break;
 	case ID_sm4_ecb:
-		priv->sw_cipher = EVP_CIPHER_fetch(NULL, "SM4-ECB", "provider=default");
+		priv->sw_cipher = uadk_prov_soft_cipher(priv->provctx, "SM4-ECB");
 		break;
 	case ID_des_ede3_cbc:
-		priv->sw_cipher = EVP_CIPHER_fetch(NULL, "DES-EDE3-CBC", "provider=default");
+		priv->sw_cipher = uadk_prov_soft_cipher(priv->provctx, "DES-EDE3-CBC");
 		break;
 	case ID_des_ede3_ecb:
-		priv->sw_cipher = EVP_CIPHER_fetch(NULL, "DES-EDE3-ECB", "provider=default");
+		priv->sw_cipher = uadk_prov_soft_cipher(priv->provctx, "DES-EDE3-ECB");
 		break;
 	case ID_aes_128_ctr:
-		priv->sw_cipher = EVP_CIPHER_fetch(NULL, "AES-128-CTR", "provider=default");
+		priv->sw_cipher = uadk_prov_soft_cipher(priv->provctx, "AES-128-CTR");
 		break;
 	case ID_aes_192_ctr:
-		priv->sw_cipher = EVP_CIPHER_fetch(NULL, "AES-192-CTR", "provider=default");
+		priv->sw_cipher = uadk_prov_soft_cipher(priv->provctx, "AES-192-CTR");
 		break;
 	case ID_aes_256_ctr:
-		priv->sw_cipher = EVP_CIPHER_fetch(NULL, "AES-256-CTR", "provider=default");
+		priv->sw_cipher = uadk_prov_soft_cipher(priv->provctx, "AES-256-CTR");
 		break;
 	case ID_aes_128_ofb128:
-		priv->sw_cipher = EVP_CIPHER_fetch(NULL, "AES-128-OFB", "provider=default");
+		priv->sw_cipher = uadk_prov_soft_cipher(priv->provctx, "AES-128-OFB");
 		break;
 	case ID_aes_192_ofb128:
-		priv->sw_cipher = EVP_CIPHER_fetch(NULL, "AES-192-OFB", "provider=default");
+		priv->sw_cipher = uadk_prov_soft_cipher(priv->provctx, "AES-192-OFB");
 		break;
 	case ID_aes_256_ofb128:
-		priv->sw_cipher = EVP_CIPHER_fetch(NULL, "AES-256-OFB", "provider=default");
+		priv->sw_cipher = uadk_prov_soft_cipher(priv->provctx, "AES-256-OFB");
 		break;
 	case ID_aes_128_cfb128:
-		priv->sw_cipher = EVP_CIPHER_fetch(NULL, "AES-128-CFB", "provider=default");
+		priv->sw_cipher = uadk_prov_soft_cipher(priv->provctx, "AES-128-CFB");
 		break;
 	case ID_aes_192_cfb128:
-		priv->sw_cipher = EVP_CIPHER_fetch(NULL, "AES-192-CFB", "provider=default");
+		priv->sw_cipher = uadk_prov_soft_cipher(priv->provctx, "AES-192-CFB");
 		break;
 	case ID_aes_256_cfb128:
-		priv->sw_cipher = EVP_CIPHER_fetch(NULL, "AES-256-CFB", "provider=default");
+		priv->sw_cipher = uadk_prov_soft_cipher(priv->provctx, "AES-256-CFB");
 		break;
 	case ID_sm4_ofb128:
-		priv->sw_cipher = EVP_CIPHER_fetch(NULL, "SM4-OFB", "provider=default");
+		priv->sw_cipher = uadk_prov_soft_cipher(priv->provctx, "SM4-OFB");
 		break;
 	case ID_sm4_cfb128:
-		priv->sw_cipher = EVP_CIPHER_fetch(NULL, "SM4-CFB", "provider=default");
+		priv->sw_cipher = uadk_prov_soft_cipher(priv->provctx, "SM4-CFB");
 		break;
 	case ID_sm4_ctr:
-		priv->sw_cipher = EVP_CIPHER_fetch(NULL, "SM4-CTR", "provider=default");
+		priv->sw_cipher = uadk_prov_soft_cipher(priv->provctx, "SM4-CTR");
 		break;
 	case ID_aes_128_xts:
-		priv->sw_cipher = EVP_CIPHER_fetch(NULL, "AES-128-XTS", "provider=default");
+		priv->sw_cipher = uadk_prov_soft_cipher(priv->provctx, "AES-128-XTS");
 		break;
 	case ID_aes_256_xts:
-		priv->sw_cipher = EVP_CIPHER_fetch(NULL, "AES-256-XTS", "provider=default");
+		priv->sw_cipher = uadk_prov_soft_cipher(priv->provctx, "AES-256-XTS");
+		break;
+	case ID_sm4_xts:
+		/* the default provider has no SM4-XTS before 3.2, it is built on ecb */
+		priv->sw_cipher = uadk_prov_soft_cipher(priv->provctx, "SM4-ECB");
 		break;
 	default:
 		break;
@@ -332,12 +357,137 @@ static int uadk_prov_cipher_sw_init(struct cipher_priv_ctx *priv,
 	return UADK_P_SUCCESS;
 }
 
+/* multiply the tweak by x, in the GB/T 17964 bit order or the IEEE P1619 one */
+static void uadk_xts_tweak_next(unsigned char *t, unsigned int gb)
+{
+	unsigned char carry;
+	int i;
+
+	if (gb) {
+		carry = t[GENERIC_BLOCK_SIZE - 1] & 1;
+		for (i = GENERIC_BLOCK_SIZE - 1; i > 0; i--)
+			t[i] = (t[i] >> 1) | (t[i - 1] << 7);
+		t[0] = (t[0] >> 1) ^ (carry ? 0xe1 : 0);
+		return;
+	}
+
+	carry = t[GENERIC_BLOCK_SIZE - 1] >> 7;
+	for (i = GENERIC_BLOCK_SIZE - 1; i > 0; i--)
+		t[i] = (t[i] << 1) | (t[i - 1] >> 7);
+	t[0] = (t[0] << 1) ^ (carry ? 0x87 : 0);
+}
+
+/* out = E(in ^ T) ^ T over whole blocks, t is left at the tweak of the next block */
+static int uadk_xts_soft_blocks(struct cipher_priv_ctx *priv, unsigned char *out,
+				const unsigned char *in, size_t blocks, unsigned char *t)
+{
+	unsigned char tweaks[XTS_TWEAK_BATCH][GENERIC_BLOCK_SIZE];
+	size_t i, j, n;
+	int len;
+
+	while (blocks) {
+		n = blocks < XTS_TWEAK_BATCH ? blocks : XTS_TWEAK_BATCH;
+		for (i = 0; i < n; i++) {
+			memcpy(tweaks[i], t, GENERIC_BLOCK_SIZE);
+			for (j = 0; j < GENERIC_BLOCK_SIZE; j++)
+				out[i * GENERIC_BLOCK_SIZE + j] = in[i * GENERIC_BLOCK_SIZE + j] ^ t[j];
+			uadk_xts_tweak_next(t, priv->xts_gb);
+		}
+
+		/* one ecb call for the batch, the tweaks are applied around it */
+		if (!EVP_CipherUpdate(priv->sw_ctx, out, &len, out, n * GENERIC_BLOCK_SIZE))
+			return UADK_P_FAIL;
+
+		for (i = 0; i < n * GENERIC_BLOCK_SIZE; i++)
+			out[i] ^= tweaks[i / GENERIC_BLOCK_SIZE][i % GENERIC_BLOCK_SIZE];
+
+		in += n * GENERIC_BLOCK_SIZE;
+		out += n * GENERIC_BLOCK_SIZE;
+		blocks -= n;
+	}
+	OPENSSL_cleanse(tweaks, sizeof(tweaks));
+
+	return UADK_P_SUCCESS;
+}
+
+/*
+ * SM4-XTS on the soft SM4-ECB, one data unit per call as the hardware takes it.
+ * A trailing partial block is handled by ciphertext stealing.
+ */
+static int uadk_xts_soft_update(struct cipher_priv_ctx *priv, unsigned char *out,
+				int *outl, const unsigned char *in, size_t len)
+{
+	unsigned char t[GENERIC_BLOCK_SIZE], cc[GENERIC_BLOCK_SIZE], pp[GENERIC_BLOCK_SIZE];
+	size_t tail = len % GENERIC_BLOCK_SIZE;
+	size_t blocks = len / GENERIC_BLOCK_SIZE;
+	int ret = UADK_P_FAIL;
+	int tl;
+
+	/* T0 = E_k2(iv), the data is then done with k1 */
+	if (!EVP_CipherInit_ex2(priv->sw_ctx, priv->sw_cipher, priv->key + SM4_KEY_SIZE,
+				NULL, 1, NULL) ||
+	    !EVP_CIPHER_CTX_set_padding(priv->sw_ctx, 0) ||
+	    !EVP_CipherUpdate(priv->sw_ctx, t, &tl, priv->iv, GENERIC_BLOCK_SIZE) ||
+	    !EVP_CipherInit_ex2(priv->sw_ctx, priv->sw_cipher, priv->key, NULL,
+				priv->enc, NULL) ||
+	    !EVP_CIPHER_CTX_set_padding(priv->sw_ctx, 0))
+		goto out;
+
+	if (tail)
+		blocks--;
+
+	if (!uadk_xts_soft_blocks(priv, out, in, blocks, t))
+		goto out;
+
+	if (tail) {
+		in += blocks * GENERIC_BLOCK_SIZE;
+		out += blocks * GENERIC_BLOCK_SIZE;
+
+		if (priv->enc) {
+			/* the last whole block with T(m-1), its head is the stolen tail */
+			if (!uadk_xts_soft_blocks(priv, cc, in, 1, t))
+				goto out;
+			memcpy(pp, in + GENERIC_BLOCK_SIZE, tail);
+			memcpy(pp + tail, cc + tail, GENERIC_BLOCK_SIZE - tail);
+			memcpy(out + GENERIC_BLOCK_SIZE, cc, tail);
+			if (!uadk_xts_soft_blocks(priv, out, pp, 1, t))
+				goto out;
+		} else {
+			/* decryption takes the two tweaks the other way round */
+			memcpy(cc, t, GENERIC_BLOCK_SIZE);
+			uadk_xts_tweak_next(cc, priv->xts_gb);
+			if (!uadk_xts_soft_blocks(priv, pp, in, 1, cc))
+				goto out;
+			memcpy(cc, in + GENERIC_BLOCK_SIZE, tail);
+			memcpy(cc + tail, pp + tail, GENERIC_BLOCK_SIZE - tail);
+			memcpy(out + GENERIC_BLOCK_SIZE, pp, tail);
+			if (!uadk_xts_soft_blocks(priv, out, cc, 1, t))
+				goto out;
+		}
+	}
+
+	*outl = len;
+	priv->switch_flag = UADK_DO_SOFT;
+	ret = UADK_P_SUCCESS;
+
+out:
+	if (!ret)
+		UADK_ERR("cipher soft xts update error!\n");
+	OPENSSL_cleanse(t, sizeof(t));
+	OPENSSL_cleanse(cc, sizeof(cc));
+	OPENSSL_cleanse(pp, sizeof(pp));
+	return ret;
+}
+
 static int uadk_prov_cipher_soft_update(struct cipher_priv_ctx *priv, unsigned char *out,
 					int *outl, const unsigned char *in, size_t len)
 {
 	if (!priv->sw_cipher)
 		return UADK_P_FAIL;
 
+	if (priv->nid == ID_sm4_xts)
+		return uadk_xts_soft_update(priv, out, outl, in, len);
+
 	if (!EVP_CipherInit_ex2(priv->sw_ctx, priv->sw_cipher, priv->key, priv->iv,
 				priv->enc, NULL)) {
 		UADK_ERR("cipher soft init error!\n");
@@ -362,6 +512,13 @@ static int uadk_prov_cipher_soft_final(struct cipher_priv_ctx *priv, unsigned ch
 	if (!priv->sw_cipher)
 		return UADK_P_FAIL;
 
+	/* the xts built on ecb has nothing held back after an update */
+	if (priv->nid == ID_sm4_xts) {
+		*outl = 0;
+		priv->switch_flag = 0;
+		return UADK_P_SUCCESS;
+	}
+
 	if (!EVP_CipherFinal_ex(priv->sw_ctx, out, &sw_final_len)) {
 		UADK_ERR("cipher soft final failed.\n");
 		return UADK_P_FAIL;
@@ -404,6 +561,8 @@ static int uadk_get_cipher_info(struct cipher_priv_ctx *priv)
 		if (priv->nid == cipher_info_table[i].nid) {
 			priv->setup.alg = cipher_info_table[i].alg;
 			priv->setup.mode = cipher_info_table[i].mode;
+			if (priv->xts_gb)
+				priv->setup.mode = WD_CIPHER_XTS_GB;
 			return UADK_P_SUCCESS;
 		}
 	}
@@ -433,9 +592,11 @@ static int uadk_prov_cipher_init(struct cipher_priv_ctx *priv,
 	if (unlikely(!ret))
 		return UADK_P_FAIL;
 
-	if (key) {
+	/* a reinit with only a new iv, as TLS does per record, keeps the session key */
+	if (key && (!priv->key_set || CRYPTO_memcmp(priv->key, key, keylen))) {
 		memcpy(priv->key, key, keylen);
 		priv->key_set = 1;
+		priv->key_prog = 0;
 	}
 
 	priv->switch_flag = 0;
@@ -586,6 +747,14 @@ init_err:
 	return ret;
 }
 
+/* Leave the session to its other users, or free it if there are none. */
+static void uadk_cipher_release_sess(struct cipher_priv_ctx *priv)
+{
+	if (uadk_prov_ref_drop(&priv->sess_refs) && priv->sess)
+		wd_cipher_free_sess(priv->sess);
+	priv->sess = 0;
+}
+
 static int uadk_prov_cipher_ctx_init(struct cipher_priv_ctx *priv)
 {
 	struct wd_cipher_sess_setup setup = {0};
@@ -615,21 +784,29 @@ static int uadk_prov_cipher_ctx_init(struct cipher_priv_ctx *priv)
 	setup.alg = priv->setup.alg;
 	setup.mode = priv->setup.mode;
 
+	/* a duplicate may still be using the session with the old key */
+	if (!priv->key_prog && uadk_prov_ref_shared(priv->sess_refs))
+		uadk_cipher_release_sess(priv);
+
 	if (!priv->sess) {
 		priv->sess = wd_cipher_alloc_sess(&setup);
 		if (!priv->sess) {
 			UADK_ERR("uadk failed to alloc session!\n");
 			return UADK_P_FAIL;
 		}
+		priv->key_prog = 0;
 	}
 
+	if (priv->key_prog)
+		return UADK_P_SUCCESS;
+
 	ret = wd_cipher_set_key(priv->sess, priv->key, priv->keylen);
 	if (ret) {
-		wd_cipher_free_sess(priv->sess);
-		priv->sess = 0;
+		uadk_cipher_release_sess(priv);
 		UADK_ERR("uadk failed to set key!\n");
 		return UADK_P_FAIL;
 	}
+	priv->key_prog = 1;
 
 	return UADK_P_SUCCESS;
 }
@@ -872,6 +1049,7 @@ void uadk_prov_destroy_cipher(void)
 static OSSL_FUNC_cipher_encrypt_init_fn uadk_prov_cipher_einit;
 static OSSL_FUNC_cipher_decrypt_init_fn uadk_prov_cipher_dinit;
 static OSSL_FUNC_cipher_freectx_fn uadk_prov_cipher_freectx;
+static OSSL_FUNC_cipher_dupctx_fn uadk_prov_cipher_dupctx;
 static OSSL_FUNC_cipher_get_ctx_params_fn uadk_prov_cipher_get_ctx_params;
 static OSSL_FUNC_cipher_gettable_ctx_params_fn uadk_prov_cipher_gettable_ctx_params;
 static OSSL_FUNC_cipher_set_ctx_params_fn uadk_prov_cipher_set_ctx_params;
@@ -1040,6 +1218,14 @@ static int uadk_prov_cipher_stream_update(void *vctx, unsigned char *output,
 		return UADK_P_FAIL;
 	}
 
+	/* each update is a whole data unit, so a sector goes in a single request */
+	if ((priv->setup.mode == WD_CIPHER_XTS || priv->setup.mode == WD_CIPHER_XTS_GB) &&
+	    (inl < GENERIC_BLOCK_SIZE ||
+	     inl > XTS_MAX_BLOCKS_PER_DATA_UNIT * GENERIC_BLOCK_SIZE)) {
+		UADK_ERR("invalid: xts data unit length %zu.\n", inl);
+		return UADK_P_FAIL;
+	}
+
 	if (priv->sw_cipher &&
 	    (priv->switch_flag == UADK_DO_SOFT ||
 	    (priv->switch_flag != UADK_DO_HW &&
@@ -1098,7 +1284,10 @@ static int uadk_prov_cipher_einit(void *vctx, const unsigned char *key, size_t k
 	priv->req.op_type = WD_CIPHER_ENCRYPTION;
 	priv->enc = 1;
 
-	return uadk_prov_cipher_init(priv, key, keylen, iv, ivlen);
+	if (!uadk_prov_cipher_init(priv, key, keylen, iv, ivlen))
+		return UADK_P_FAIL;
+
+	return uadk_prov_cipher_set_ctx_params(priv, params);
 }
 
 static int uadk_prov_cipher_dinit(void *vctx, const unsigned char *key, size_t keylen,
@@ -1113,7 +1302,10 @@ static int uadk_prov_cipher_dinit(void *vctx, const unsigned char *key, size_t k
 	priv->req.op_type = WD_CIPHER_DECRYPTION;
 	priv->enc = 0;
 
-	return uadk_prov_cipher_init(priv, key, keylen, iv, ivlen);
+	if (!uadk_prov_cipher_init(priv, key, keylen, iv, ivlen))
+		return UADK_P_FAIL;
+
+	return uadk_prov_cipher_set_ctx_params(priv, params);
 }
 
 static const OSSL_PARAM uadk_prov_settable_ctx_params[] = {
@@ -1121,6 +1313,7 @@ static const OSSL_PARAM uadk_prov_settable_ctx_params[] = {
 	OSSL_PARAM_size_t(OSSL_CIPHER_PARAM_IVLEN, NULL),
 	OSSL_PARAM_uint(OSSL_CIPHER_PARAM_PADDING, NULL),
 	OSSL_PARAM_utf8_string(OSSL_CIPHER_PARAM_CTS_MODE, NULL, 0),
+	OSSL_PARAM_utf8_string(OSSL_CIPHER_PARAM_XTS_STANDARD, NULL, 0),
 	OSSL_PARAM_END
 };
 
@@ -1194,12 +1387,42 @@ static int uadk_prov_cipher_set_ctx_params(void *vctx, const OSSL_PARAM params[]
 			return UADK_P_FAIL;
 		}
 
+		/* the session was set up for the previous mode */
+		if (priv->sess && priv->cts_mode != (unsigned int)id)
+			uadk_cipher_release_sess(priv);
+
 		priv->cts_mode = (unsigned int)id;
 		priv->setup.mode = priv->cts_mode;
 		strncpy(priv->alg_name, cts_modes[id - WD_CIPHER_CBC_CS1].uadk_alg_name,
 			ALG_NAME_SIZE - 1);
 	}
 
+	p = OSSL_PARAM_locate_const(params, OSSL_CIPHER_PARAM_XTS_STANDARD);
+	if (p != NULL && priv->nid == ID_sm4_xts) {
+		unsigned int gb;
+
+		if (p->data_type != OSSL_PARAM_UTF8_STRING) {
+			UADK_ERR("failed to get cipher xts standard: data_type.\n");
+			return UADK_P_FAIL;
+		}
+
+		if (OPENSSL_strcasecmp(p->data, UADK_CIPHER_XTS_GB) == 0) {
+			gb = 1;
+		} else if (OPENSSL_strcasecmp(p->data, UADK_CIPHER_XTS_IEEE) == 0) {
+			gb = 0;
+		} else {
+			UADK_ERR("invalid: cipher xts standard %s.\n", (char *)p->data);
+			return UADK_P_FAIL;
+		}
+
+		/* the session was set up for the other standard */
+		if (priv->sess && priv->xts_gb != gb)
+			uadk_cipher_release_sess(priv);
+
+		priv->xts_gb = gb;
+		priv->setup.mode = gb ? WD_CIPHER_XTS_GB : WD_CIPHER_XTS;
+	}
+
 	return UADK_P_SUCCESS;
 }
 
@@ -1247,6 +1470,13 @@ static int uadk_prov_cipher_get_ctx_params(void *vctx, OSSL_PARAM params[])
 			return UADK_P_FAIL;
 		}
 	}
+	p = OSSL_PARAM_locate(params, OSSL_CIPHER_PARAM_XTS_STANDARD);
+	if (p != NULL && priv->nid == ID_sm4_xts &&
+	    !OSSL_PARAM_set_utf8_string(p, priv->xts_gb ? UADK_CIPHER_XTS_GB :
+					UADK_CIPHER_XTS_IEEE)) {
+		UADK_ERR("failed to set cipher utf8 parameter: xts standard.\n");
+		return UADK_P_FAIL;
+	}
 	return UADK_P_SUCCESS;
 }
 
@@ -1257,6 +1487,7 @@ static const OSSL_PARAM uadk_prov_default_ctx_params[] = {
 	OSSL_PARAM_octet_string(OSSL_CIPHER_PARAM_IV, NULL, 0),
 	OSSL_PARAM_octet_string(OSSL_CIPHER_PARAM_UPDATED_IV, NULL, 0),
 	OSSL_PARAM_utf8_string(OSSL_CIPHER_PARAM_CTS_MODE, NULL, 0),
+	OSSL_PARAM_utf8_string(OSSL_CIPHER_PARAM_XTS_STANDARD, NULL, 0),
 	OSSL_PARAM_END
 };
 
@@ -1275,6 +1506,7 @@ static const OSSL_PARAM cipher_known_gettable_params[] = {
 	OSSL_PARAM_int(OSSL_CIPHER_PARAM_CUSTOM_IV, NULL),
 	OSSL_PARAM_int(OSSL_CIPHER_PARAM_CTS, NULL),
 	OSSL_PARAM_int(OSSL_CIPHER_PARAM_HAS_RAND_KEY, NULL),
+	OSSL_PARAM_int(OSSL_CIPHER_PARAM_TLS1_MULTIBLOCK, NULL),
 	OSSL_PARAM_END
 };
 
@@ -1294,11 +1526,23 @@ static int ossl_cipher_generic_get_params(OSSL_PARAM params[], unsigned int md,
 		UADK_ERR("failed to set cipher uint parameter: md.\n");
 		return UADK_P_FAIL;
 	}
+	p = OSSL_PARAM_locate(params, OSSL_CIPHER_PARAM_AEAD);
+	if (p != NULL && !OSSL_PARAM_set_int(p, (flags & PROV_CIPHER_FLAG_AEAD) != 0)) {
+		UADK_ERR("failed to set cipher int parameter: aead.\n");
+		return UADK_P_FAIL;
+	}
 	p = OSSL_PARAM_locate(params, OSSL_CIPHER_PARAM_CUSTOM_IV);
 	if (p != NULL && !OSSL_PARAM_set_int(p, (flags & PROV_CIPHER_FLAG_CUSTOM_IV) != 0)) {
 		UADK_ERR("failed to set cipher int parameter: custom iv.\n");
 		return UADK_P_FAIL;
 	}
+	/* only worth it with the hardware, the records go to it together */
+	p = OSSL_PARAM_locate(params, OSSL_CIPHER_PARAM_TLS1_MULTIBLOCK);
+	if (p != NULL && !OSSL_PARAM_set_int(p, (flags & PROV_CIPHER_FLAG_TLS1_MULTIBLOCK) &&
+					     uadk_prov_cipher_version() != HW_SYMM_ENC_INVALID)) {
+		UADK_ERR("failed to set cipher int parameter: tls1 multiblock.\n");
+		return UADK_P_FAIL;
+	}
 	p = OSSL_PARAM_locate(params, OSSL_CIPHER_PARAM_KEYLEN);
 	if (p != NULL && !OSSL_PARAM_set_size_t(p, kbits)) {
 		UADK_ERR("failed to set cipher size parameter: kbits.\n");
@@ -1318,6 +1562,17 @@ static int ossl_cipher_generic_get_params(OSSL_PARAM params[], unsigned int md,
 	return UADK_P_SUCCESS;
 }
 
+static void uadk_prov_cipher_cleanup(struct cipher_priv_ctx *priv)
+{
+	if (priv->sw_cipher)
+		EVP_CIPHER_free(priv->sw_cipher);
+
+	if (priv->sw_ctx)
+		EVP_CIPHER_CTX_free(priv->sw_ctx);
+
+	uadk_cipher_release_sess(priv);
+}
+
 static void uadk_prov_cipher_freectx(void *ctx)
 {
 	struct cipher_priv_ctx *priv = (struct cipher_priv_ctx *)ctx;
@@ -1325,16 +1580,60 @@ static void uadk_prov_cipher_freectx(void *ctx)
 	if (ctx == NULL)
 		return;
 
-	if (priv->sw_cipher)
-		EVP_CIPHER_free(priv->sw_cipher);
+	uadk_prov_cipher_cleanup(priv);
+	OPENSSL_clear_free(priv, sizeof(*priv));
+}
 
-	if (priv->sw_ctx)
-		EVP_CIPHER_CTX_free(priv->sw_ctx);
+/* Duplicate a ctx of size bytes that starts with the cipher ctx. */
+static void *uadk_prov_cipher_dup(struct cipher_priv_ctx *src_ctx, size_t size)
+{
+	struct cipher_priv_ctx *dst_ctx;
+	bool share_sess;
 
-	if (priv->sess)
-		wd_cipher_free_sess(priv->sess);
+	/* the session only carries the key, both sides use it until one rekeys */
+	share_sess = src_ctx->sess && src_ctx->key_prog &&
+		     uadk_prov_ref_share(&src_ctx->sess_refs);
 
-	OPENSSL_clear_free(priv, sizeof(*priv));
+	dst_ctx = OPENSSL_memdup(src_ctx, size);
+	if (!dst_ctx)
+		goto drop_ref;
+
+	if (!share_sess) {
+		dst_ctx->sess = 0;
+		dst_ctx->sess_refs = NULL;
+		dst_ctx->key_prog = 0;
+	}
+
+	if (dst_ctx->sw_ctx) {
+		dst_ctx->sw_ctx = EVP_CIPHER_CTX_dup(src_ctx->sw_ctx);
+		if (!dst_ctx->sw_ctx) {
+			UADK_ERR("EVP_CIPHER_CTX_dup failed in ctx copy.\n");
+			goto free_ctx;
+		}
+	}
+
+	if (dst_ctx->sw_cipher && !EVP_CIPHER_up_ref(dst_ctx->sw_cipher))
+		goto free_dup;
+
+	return dst_ctx;
+
+free_dup:
+	EVP_CIPHER_CTX_free(dst_ctx->sw_ctx);
+free_ctx:
+	OPENSSL_clear_free(dst_ctx, size);
+drop_ref:
+	/* src keeps the session, it still holds a reference */
+	if (share_sess)
+		__atomic_sub_fetch(src_ctx->sess_refs, 1, __ATOMIC_RELAXED);
+	return NULL;
+}
+
+static void *uadk_prov_cipher_dupctx(void *ctx)
+{
+	if (!ctx)
+		return NULL;
+
+	return uadk_prov_cipher_dup(ctx, sizeof(struct cipher_priv_ctx));
 }
 
 int uadk_prov_cipher_version(void)
@@ -1371,10 +1670,13 @@ static void *uadk_##nm##_newctx(void *provctx)					\
 		return NULL;							\
 										\
 	ctx->blksize = blk_size;						\
+	ctx->provctx = provctx;							\
 	ctx->keylen = key_len;							\
 	ctx->ivlen = iv_len;							\
 	ctx->nid = e_nid;							\
 	ctx->cts_mode = WD_CIPHER_CBC_CS1;					\
+	/* GB/T 17964 is the default SM4-XTS standard, as in OpenSSL */		\
+	ctx->xts_gb = (e_nid == ID_sm4_xts);					\
 	strncpy(ctx->alg_name, #algnm, ALG_NAME_SIZE - 1);			\
 	if (strcmp(#typ, "block") == 0)						\
 		ctx->pad = 1;							\
@@ -1389,6 +1691,7 @@ static int uadk_##nm##_get_params(OSSL_PARAM params[])				\
 const OSSL_DISPATCH uadk_##nm##_functions[] = {					\
 	{ OSSL_FUNC_CIPHER_NEWCTX, (void (*)(void))uadk_##nm##_newctx },	\
 	{ OSSL_FUNC_CIPHER_FREECTX, (void (*)(void))uadk_prov_cipher_freectx },	\
+	{ OSSL_FUNC_CIPHER_DUPCTX, (void (*)(void))uadk_prov_cipher_dupctx },	\
 	{ OSSL_FUNC_CIPHER_ENCRYPT_INIT,					\
 		(void (*)(void))uadk_prov_cipher_einit },			\
 	{ OSSL_FUNC_CIPHER_DECRYPT_INIT,					\
@@ -1442,3 +1745,1092 @@ UADK_CIPHER_DESCR(aes_256_cfb128, 1, 32, 16, 0, ID_aes_256_cfb128, cfb(aes), EVP
 UADK_CIPHER_DESCR(sm4_ofb128, 1, 16, 16, 0, ID_sm4_ofb128, ofb(sm4), EVP_CIPH_OFB_MODE, stream);
 UADK_CIPHER_DESCR(sm4_cfb128, 1, 16, 16, 0, ID_sm4_cfb128, cfb(sm4), EVP_CIPH_CFB_MODE, stream);
 UADK_CIPHER_DESCR(sm4_ctr, 1, 16, 16, 0, ID_sm4_ctr, ctr(sm4), EVP_CIPH_CTR_MODE, stream);
+UADK_CIPHER_DESCR(sm4_xts, 1, 32, 16, PROV_CIPHER_FLAG_CUSTOM_IV, ID_sm4_xts, xts(sm4), EVP_CIPH_XTS_MODE, stream);
+
+/*
+ * AES-CBC-HMAC-SHA1/SHA256 for the MAC-then-encrypt TLS suites. The SEC
+ * only chains cipher-then-MAC, so the record MAC is computed on the cpu and
+ * the payload, MAC and padding go to the device as one CBC request, where a
+ * separate cipher and digest would take two trips.
+ */
+#define CBC_HMAC_BLOCK_SIZE	64
+#define CBC_HMAC_NO_PAYLOAD	((size_t)-1)
+/* the bit length closing the last block of sha1 and sha256 */
+#define CBC_HMAC_LEN_BYTES	8
+/* blocks the mac may end in, for up to 256 bytes of padding and the mac */
+#define CBC_HMAC_VAR_BLOCKS(md)	((256 + (md) + CBC_HMAC_BLOCK_SIZE - 1) / \
+				 CBC_HMAC_BLOCK_SIZE + 1)
+#define CBC_HMAC_SHA1_LEN	20
+/* uadk_cbc_hmac_mb_hw gives the records back to the soft cipher */
+#define SWITCH_TO_SOFT		2
+#define CBC_HMAC_TLS_HDR_LEN	5
+#define CBC_HMAC_TLS_MAX_FRAG	16384
+#define CBC_HMAC_TLS_MAX_LEN	0xFFFF
+#define CBC_HMAC_MB_MAX_RECORDS	8
+/* header, explicit iv, then payload, mac and padding in whole blocks */
+#define CBC_HMAC_RECORD_LEN(len, mac)	(CBC_HMAC_TLS_HDR_LEN + AES_BLOCK_SIZE + \
+					 (((len) + (mac) + AES_BLOCK_SIZE) & \
+					  ~(size_t)(AES_BLOCK_SIZE - 1)))
+
+/* the records of one multiblock write, in flight together */
+struct cbc_hmac_mb_ctx {
+	struct wd_cipher_req req[CBC_HMAC_MB_MAX_RECORDS];
+	unsigned char iv[CBC_HMAC_MB_MAX_RECORDS][IV_LEN];
+	/* payload, mac and padding, kept for the soft cipher if the device fails */
+	unsigned char *buf;
+	size_t buf_len;
+	int done;
+	int failed;
+};
+
+struct cbc_hmac_priv_ctx {
+	struct cipher_priv_ctx base;
+	const char *md_name;
+	EVP_MD *md;
+	EVP_MD_CTX *head;	/* after the inner key pad */
+	EVP_MD_CTX *tail;	/* after the outer key pad */
+	EVP_MD_CTX *md_ctx;
+	/* the inner hash after the key pad again, for the constant time check */
+	union {
+		SHA_CTX sha1;
+		SHA256_CTX sha256;
+	} ct_head;
+	size_t mac_len;
+	/* record length from the tls aad, payload and explicit iv */
+	size_t payload_len;
+	size_t tls_aad_pad;
+	unsigned int tls_version;
+	unsigned char tls_aad[EVP_AEAD_TLS1_AAD_LEN];
+	/* OSSL_CIPHER_PARAM_TLS1_MULTIBLOCK_*, for one write at a time */
+	struct cbc_hmac_mb_ctx *mb;
+	size_t mb_max_frag;
+	size_t mb_len;
+	size_t mb_enc_len;
+	unsigned int mb_interleave;
+	unsigned char mb_aad[EVP_AEAD_TLS1_AAD_LEN];
+};
+
+/* all ones if a >= b, without a branch */
+static inline size_t cbc_hmac_ct_ge(size_t a, size_t b)
+{
+	return ((a - b) >> (sizeof(size_t) * 8 - 1)) - 1;
+}
+
+static inline size_t cbc_hmac_ct_eq(size_t a, size_t b)
+{
+	return cbc_hmac_ct_ge(a, b) & cbc_hmac_ct_ge(b, a);
+}
+
+static int uadk_cbc_hmac_set_mac_key(struct cbc_hmac_priv_ctx *priv,
+				     const unsigned char *key, size_t keylen)
+{
+	unsigned char hkey[CBC_HMAC_BLOCK_SIZE] = {0};
+	unsigned char pad[CBC_HMAC_BLOCK_SIZE];
+	int ret = UADK_P_FAIL;
+	size_t i;
+
+	if (!priv->md) {
+		priv->md = uadk_prov_soft_md(priv->base.provctx, priv->md_name);
+		if (!priv->md) {
+			UADK_ERR("failed to fetch %s for the record mac.\n", priv->md_name);
+			return UADK_P_FAIL;
+		}
+	}
+
+	if (!priv->md_ctx) {
+		priv->head = EVP_MD_CTX_new();
+		priv->tail = EVP_MD_CTX_new();
+		priv->md_ctx = EVP_MD_CTX_new();
+		if (!priv->head || !priv->tail || !priv->md_ctx)
+			goto out;
+	}
+
+	if (keylen > CBC_HMAC_BLOCK_SIZE) {
+		if (!EVP_Digest(key, keylen, hkey, NULL, priv->md, NULL))
+			goto out;
+	} else {
+		memcpy(hkey, key, keylen);
+	}
+
+	for (i = 0; i < CBC_HMAC_BLOCK_SIZE; i++)
+		pad[i] = hkey[i] ^ 0x36;
+	if (!EVP_DigestInit_ex2(priv->head, priv->md, NULL) ||
+	    !EVP_DigestUpdate(priv->head, pad, CBC_HMAC_BLOCK_SIZE))
+		goto out;
+
+	if (priv->mac_len == CBC_HMAC_SHA1_LEN) {
+		if (!SHA1_Init(&priv->ct_head.sha1) ||
+		    !SHA1_Update(&priv->ct_head.sha1, pad, CBC_HMAC_BLOCK_SIZE))
+			goto out;
+	} else if (!SHA256_Init(&priv->ct_head.sha256) ||
+		   !SHA256_Update(&priv->ct_head.sha256, pad, CBC_HMAC_BLOCK_SIZE)) {
+		goto out;
+	}
+
+	for (i = 0; i < CBC_HMAC_BLOCK_SIZE; i++)
+		pad[i] = hkey[i] ^ 0x5c;
+	if (!EVP_DigestInit_ex2(priv->tail, priv->md, NULL) ||
+	    !EVP_DigestUpdate(priv->tail, pad, CBC_HMAC_BLOCK_SIZE))
+		goto out;
+
+	ret = UADK_P_SUCCESS;
+
+out:
+	if (!ret)
+		UADK_ERR("failed to set the record mac key.\n");
+	OPENSSL_cleanse(hkey, sizeof(hkey));
+	OPENSSL_cleanse(pad, sizeof(pad));
+	return ret;
+}
+
+/* hmac of the tls aad and the payload */
+static int uadk_cbc_hmac_mac(struct cbc_hmac_priv_ctx *priv, const unsigned char *in,
+			     size_t len, unsigned char *mac)
+{
+	unsigned char inner[EVP_MAX_MD_SIZE];
+	unsigned int inner_len;
+
+	if (!priv->md_ctx) {
+		UADK_ERR("the record mac key is not set.\n");
+		return UADK_P_FAIL;
+	}
+
+	return EVP_MD_CTX_copy_ex(priv->md_ctx, priv->head) &&
+	       EVP_DigestUpdate(priv->md_ctx, priv->tls_aad, EVP_AEAD_TLS1_AAD_LEN) &&
+	       EVP_DigestUpdate(priv->md_ctx, in, len) &&
+	       EVP_DigestFinal_ex(priv->md_ctx, inner, &inner_len) &&
+	       EVP_MD_CTX_copy_ex(priv->md_ctx, priv->tail) &&
+	       EVP_DigestUpdate(priv->md_ctx, inner, inner_len) &&
+	       EVP_DigestFinal_ex(priv->md_ctx, mac, &inner_len);
+}
+
+/* one CBC pass over whole blocks, the iv moves on to the last cipher block */
+static int uadk_cbc_hmac_cbc(struct cbc_hmac_priv_ctx *priv, unsigned char *out,
+			     const unsigned char *in, size_t len)
+{
+	struct cipher_priv_ctx *base = &priv->base;
+	unsigned char next_iv[IV_LEN];
+	size_t outl;
+	int sw_len;
+
+	if (!len)
+		return UADK_P_SUCCESS;
+
+	/* in place decryption overwrites it */
+	if (!base->enc)
+		memcpy(next_iv, in + len - IV_LEN, IV_LEN);
+
+	if (base->switch_flag == UADK_DO_SOFT ||
+	    (uadk_get_sw_offload_state() && len <= base->switch_threshold) ||
+	    uadk_prov_hw_cipher(base, out, &outl, len, in, len) != UADK_P_SUCCESS) {
+		if (!EVP_CipherInit_ex2(base->sw_ctx, NULL, NULL, base->iv, base->enc, NULL) ||
+		    !EVP_CipherUpdate(base->sw_ctx, out, &sw_len, in, len)) {
+			UADK_ERR("cipher soft update error!\n");
+			return UADK_P_FAIL;
+		}
+	}
+
+	memcpy(base->iv, base->enc ? out + len - IV_LEN : next_iv, IV_LEN);
+
+	return UADK_P_SUCCESS;
+}
+
+static int uadk_cbc_hmac_set_tls_aad(struct cbc_hmac_priv_ctx *priv,
+				     const unsigned char *aad, size_t aad_len)
+{
+	size_t len;
+
+	if (aad_len != EVP_AEAD_TLS1_AAD_LEN) {
+		UADK_ERR("invalid: tls aad length %zu.\n", aad_len);
+		return UADK_P_FAIL;
+	}
+
+	memcpy(priv->tls_aad, aad, aad_len);
+	if (!priv->base.enc) {
+		/* the payload length is only known once the padding is off */
+		priv->payload_len = aad_len;
+		priv->tls_aad_pad = priv->mac_len;
+		return UADK_P_SUCCESS;
+	}
+
+	len = aad[aad_len - 2] << 8 | aad[aad_len - 1];
+	priv->payload_len = len;
+	if ((aad[aad_len - 4] << 8 | aad[aad_len - 3]) >= TLS1_1_VERSION) {
+		if (len < AES_BLOCK_SIZE) {
+			UADK_ERR("invalid: tls record shorter than its iv.\n");
+			return UADK_P_FAIL;
+		}
+		/* the explicit iv is not part of the mac */
+		len -= AES_BLOCK_SIZE;
+		priv->tls_aad[aad_len - 2] = len >> 8;
+		priv->tls_aad[aad_len - 1] = len;
+	}
+
+	priv->tls_aad_pad = ((len + priv->mac_len + AES_BLOCK_SIZE) &
+			     ~(size_t)(AES_BLOCK_SIZE - 1)) - len;
+
+	return UADK_P_SUCCESS;
+}
+
+static int uadk_cbc_hmac_tls_enc(struct cbc_hmac_priv_ctx *priv, unsigned char *out,
+				 const unsigned char *in, size_t len, size_t plen)
+{
+	size_t iv = 0;
+	size_t pad;
+
+	if (len != ((plen + priv->mac_len + AES_BLOCK_SIZE) & ~(size_t)(AES_BLOCK_SIZE - 1))) {
+		UADK_ERR("invalid: tls record length %zu for payload %zu.\n", len, plen);
+		return UADK_P_FAIL;
+	}
+
+	if ((priv->tls_aad[EVP_AEAD_TLS1_AAD_LEN - 4] << 8 |
+	     priv->tls_aad[EVP_AEAD_TLS1_AAD_LEN - 3]) >= TLS1_1_VERSION)
+		iv = AES_BLOCK_SIZE;
+
+	if (out != in)
+		memmove(out, in, plen);
+
+	if (!uadk_cbc_hmac_mac(priv, out + iv, plen - iv, out + plen))
+		return UADK_P_FAIL;
+
+	/* pad payload and mac to whole blocks, then encrypt all of it at once */
+	pad = len - plen - priv->mac_len - 1;
+	memset(out + plen + priv->mac_len, (int)pad, pad + 1);
+
+	return uadk_cbc_hmac_cbc(priv, out, out, len);
+}
+
+static unsigned char *cbc_hmac_put_be32(unsigned char *p, unsigned int v)
+{
+	*p++ = (unsigned char)(v >> 24);
+	*p++ = (unsigned char)(v >> 16);
+	*p++ = (unsigned char)(v >> 8);
+	*p++ = (unsigned char)v;
+
+	return p;
+}
+
+/* hashes one block, and leaves the raw hash state in it without the final padding */
+static void cbc_hmac_ct_block(struct cbc_hmac_priv_ctx *priv, SHA_CTX *sha1,
+			      SHA256_CTX *sha256, unsigned char *block)
+{
+	unsigned char *p = block;
+	size_t i, words;
+
+	if (priv->mac_len == CBC_HMAC_SHA1_LEN) {
+		SHA1_Transform(sha1, block);
+		p = cbc_hmac_put_be32(p, sha1->h0);
+		p = cbc_hmac_put_be32(p, sha1->h1);
+		p = cbc_hmac_put_be32(p, sha1->h2);
+		p = cbc_hmac_put_be32(p, sha1->h3);
+		cbc_hmac_put_be32(p, sha1->h4);
+		return;
+	}
+
+	SHA256_Transform(sha256, block);
+	words = priv->mac_len / sizeof(sha256->h[0]);
+	for (i = 0; i < words; i++)
+		p = cbc_hmac_put_be32(p, sha256->h[i]);
+}
+
+/*
+ * The record mac as ssl3_cbc_digest_record() in libssl makes it: every
+ * block the mac may end in is hashed, the length is only ever used in masks,
+ * and the inner hash of the block it really ends in is picked out with them.
+ * len is public, the decrypted record less its iv; plen is secret.
+ */
+static int uadk_cbc_hmac_ct_mac(struct cbc_hmac_priv_ctx *priv, const unsigned char *data,
+				size_t plen, size_t len, unsigned char *mac)
+{
+	const size_t hdr = EVP_AEAD_TLS1_AAD_LEN;
+	const size_t bs = CBC_HMAC_BLOCK_SIZE;
+	size_t md_size = priv->mac_len;
+	size_t var_blocks = CBC_HMAC_VAR_BLOCKS(md_size);
+	unsigned char len_bytes[CBC_HMAC_LEN_BYTES];
+	unsigned char block[CBC_HMAC_BLOCK_SIZE];
+	unsigned char inner[EVP_MAX_MD_SIZE] = {0};
+	size_t total, num_blocks, start, k, i, j;
+	size_t mac_end, c, index_a, index_b;
+	unsigned char is_a, is_b, past_c, past_c1, b;
+	SHA256_CTX sha256;
+	unsigned int out_len;
+	SHA_CTX sha1;
+	__u64 bits;
+	int ret;
+
+	memcpy(&sha1, &priv->ct_head.sha1, sizeof(sha1));
+	memcpy(&sha256, &priv->ct_head.sha256, sizeof(sha256));
+
+	/* header, payload, mac and padding: the most there is to hash */
+	total = hdr + len;
+	num_blocks = (total - md_size - 1 + 1 + CBC_HMAC_LEN_BYTES + bs - 1) / bs;
+	start = num_blocks > var_blocks ? num_blocks - var_blocks : 0;
+
+	/* where the payload ends, a division by a constant power of two */
+	mac_end = hdr + plen;
+	c = mac_end % bs;
+	index_a = mac_end / bs;
+	index_b = (mac_end + CBC_HMAC_LEN_BYTES) / bs;
+	/* the key pad block is hashed in front */
+	bits = (__u64)(mac_end + bs) << 3;
+	for (i = 0; i < CBC_HMAC_LEN_BYTES; i++)
+		len_bytes[i] = (unsigned char)(bits >> ((CBC_HMAC_LEN_BYTES - 1 - i) << 3));
+
+	/* blocks before any place the mac may end in are hashed as they are */
+	k = start * bs;
+	if (k) {
+		memcpy(block, priv->tls_aad, hdr);
+		memcpy(block + hdr, data, bs - hdr);
+		cbc_hmac_ct_block(priv, &sha1, &sha256, block);
+		for (i = 1; i < start; i++) {
+			memcpy(block, data + bs * i - hdr, bs);
+			cbc_hmac_ct_block(priv, &sha1, &sha256, block);
+		}
+	}
+
+	for (i = start; i <= start + var_blocks; i++) {
+		is_a = (unsigned char)cbc_hmac_ct_eq(i, index_a);
+		is_b = (unsigned char)cbc_hmac_ct_eq(i, index_b);
+		for (j = 0; j < bs; j++, k++) {
+			b = 0;
+			if (k < hdr)
+				b = priv->tls_aad[k];
+			else if (k < total)
+				b = data[k - hdr];
+
+			/* 0x80 right after the payload, zeros after that */
+			past_c = is_a & (unsigned char)cbc_hmac_ct_ge(j, c);
+			past_c1 = is_a & (unsigned char)cbc_hmac_ct_ge(j, c + 1);
+			b = (b & ~past_c) | (0x80 & past_c);
+			b &= ~past_c1;
+			/* the block with the length is zeros up to it */
+			b &= ~is_b | is_a;
+			if (j >= bs - CBC_HMAC_LEN_BYTES)
+				b = (b & ~is_b) |
+				    (len_bytes[j - (bs - CBC_HMAC_LEN_BYTES)] & is_b);
+			block[j] = b;
+		}
+
+		cbc_hmac_ct_block(priv, &sha1, &sha256, block);
+		for (j = 0; j < md_size; j++)
+			inner[j] |= block[j] & is_b;
+	}
+
+	ret = EVP_MD_CTX_copy_ex(priv->md_ctx, priv->tail) &&
+	      EVP_DigestUpdate(priv->md_ctx, inner, md_size) &&
+	      EVP_DigestFinal_ex(priv->md_ctx, mac, &out_len);
+
+	OPENSSL_cleanse(&sha1, sizeof(sha1));
+	OPENSSL_cleanse(&sha256, sizeof(sha256));
+	OPENSSL_cleanse(block, sizeof(block));
+	OPENSSL_cleanse(inner, sizeof(inner));
+
+	return ret;
+}
+
+/*
+ * The record mac out of the decrypted record as ssl3_cbc_copy_mac() in
+ * libssl: the last 256 + mac bytes are all read, and the mac is rotated into
+ * place without an address that depends on where it starts.
+ */
+static void uadk_cbc_hmac_ct_copy_mac(const unsigned char *rec, size_t len,
+				      size_t plen, size_t md_size, unsigned char *out)
+{
+	unsigned char rotated[EVP_MAX_MD_SIZE] = {0};
+	size_t mac_end = plen + md_size;
+	size_t scan, i, j, rot = 0;
+	size_t in_mac = 0;
+
+	scan = len > md_size + 256 ? len - (md_size + 256) : 0;
+	for (i = scan, j = 0; i < len; i++) {
+		size_t started = cbc_hmac_ct_eq(i, plen);
+		size_t ended = ~cbc_hmac_ct_ge(i, mac_end);
+
+		in_mac |= started;
+		in_mac &= ended;
+		rot |= j & started;
+		rotated[j++] |= rec[i] & (unsigned char)in_mac;
+		j &= ~cbc_hmac_ct_ge(j, md_size);
+	}
+
+	memset(out, 0, md_size);
+	rot = md_size - rot;
+	rot &= ~cbc_hmac_ct_ge(rot, md_size);
+	for (i = 0; i < md_size; i++) {
+		for (j = 0; j < md_size; j++)
+			out[j] |= rotated[i] & (unsigned char)cbc_hmac_ct_eq(j, rot);
+		rot++;
+		rot &= ~cbc_hmac_ct_ge(rot, md_size);
+	}
+
+	OPENSSL_cleanse(rotated, sizeof(rotated));
+}
+
+/*
+ * Nothing here branches on or indexes by the padding or the payload length
+ * (Lucky13): the padding check scans the most padding there can be, the
+ * mac goes over every block it may end in and is copied out by rotation.
+ */
+static int uadk_cbc_hmac_tls_dec(struct cbc_hmac_priv_ctx *priv, unsigned char *out,
+				 size_t *outl, const unsigned char *in, size_t len)
+{
+	unsigned char *aad = priv->tls_aad;
+	unsigned char rec_mac[EVP_MAX_MD_SIZE];
+	unsigned char mac[EVP_MAX_MD_SIZE];
+	size_t mac_len = priv->mac_len;
+	size_t maxpad, pad, plen, good, i;
+	size_t iv = 0, inl = len;
+	unsigned char res = 0;
+
+	if ((aad[EVP_AEAD_TLS1_AAD_LEN - 4] << 8 | aad[EVP_AEAD_TLS1_AAD_LEN - 3]) >=
+	    TLS1_1_VERSION) {
+		if (len < AES_BLOCK_SIZE + mac_len + 1)
+			return UADK_P_FAIL;
+		/* the explicit iv only chains into the first block, it is not output */
+		memcpy(priv->base.iv, in, AES_BLOCK_SIZE);
+		iv = AES_BLOCK_SIZE;
+	} else if (len < mac_len + 1) {
+		return UADK_P_FAIL;
+	}
+
+	out += iv;
+	len -= iv;
+	if (!uadk_cbc_hmac_cbc(priv, out, in + iv, len))
+		return UADK_P_FAIL;
+
+	pad = out[len - 1];
+	maxpad = len - (mac_len + 1);
+	if (maxpad > 255)
+		maxpad = 255;
+
+	good = cbc_hmac_ct_ge(maxpad, pad);
+	pad = (pad & good) | (maxpad & ~good);
+	plen = len - (mac_len + pad + 1);
+
+	aad[EVP_AEAD_TLS1_AAD_LEN - 2] = plen >> 8;
+	aad[EVP_AEAD_TLS1_AAD_LEN - 1] = plen;
+	if (!priv->md_ctx || !uadk_cbc_hmac_ct_mac(priv, out, plen, len, mac))
+		return UADK_P_FAIL;
+	uadk_cbc_hmac_ct_copy_mac(out, len, plen, mac_len, rec_mac);
+
+	for (i = 0; i <= maxpad; i++)
+		res |= cbc_hmac_ct_ge(pad, i) & (out[len - 1 - i] ^ pad);
+	good &= cbc_hmac_ct_ge(0, res);
+	good &= cbc_hmac_ct_ge(0, (size_t)CRYPTO_memcmp(mac, rec_mac, mac_len));
+	OPENSSL_cleanse(rec_mac, sizeof(rec_mac));
+	if (!good)
+		return UADK_P_FAIL;
+
+	/* as the default provider, strip the tls parts once libssl set its version */
+	*outl = inl;
+	if (priv->tls_version)
+		*outl = priv->tls_version >= TLS1_1_VERSION ? plen : plen + iv;
+
+	return UADK_P_SUCCESS;
+}
+
+static int uadk_cbc_hmac_update(void *vctx, unsigned char *out, size_t *outl,
+				size_t outsize, const unsigned char *in, size_t inl)
+{
+	struct cbc_hmac_priv_ctx *priv = (struct cbc_hmac_priv_ctx *)vctx;
+	size_t plen;
+
+	if (!vctx || !out || !outl || (!in && inl))
+		return UADK_P_FAIL;
+
+	/* the tls aad announces one record */
+	plen = priv->payload_len;
+	priv->payload_len = CBC_HMAC_NO_PAYLOAD;
+
+	if (inl % AES_BLOCK_SIZE) {
+		UADK_ERR("invalid: cbc hmac input is not whole blocks.\n");
+		return UADK_P_FAIL;
+	}
+
+	if (outsize < inl) {
+		UADK_ERR("invalid: cipher outsize is too small.\n");
+		return UADK_P_FAIL;
+	}
+
+	if (plen == CBC_HMAC_NO_PAYLOAD) {
+		*outl = inl;
+		return uadk_cbc_hmac_cbc(priv, out, in, inl);
+	}
+
+	if (!priv->base.enc)
+		return uadk_cbc_hmac_tls_dec(priv, out, outl, in, inl);
+
+	*outl = inl;
+	return uadk_cbc_hmac_tls_enc(priv, out, in, inl, plen);
+}
+
+static int uadk_cbc_hmac_final(void *vctx, unsigned char *out, size_t *outl,
+			       size_t outsize)
+{
+	if (!vctx || !outl)
+		return UADK_P_FAIL;
+
+	*outl = 0;
+
+	return UADK_P_SUCCESS;
+}
+
+/* the payload of the whole write, split in interleave records of frag */
+static size_t uadk_cbc_hmac_mb_packlen(struct cbc_hmac_priv_ctx *priv, size_t len,
+				       unsigned int interleave)
+{
+	size_t frag = len / interleave;
+
+	return (interleave - 1) * CBC_HMAC_RECORD_LEN(frag, priv->mac_len) +
+	       CBC_HMAC_RECORD_LEN(len - frag * (interleave - 1), priv->mac_len);
+}
+
+/*
+ * OSSL_CIPHER_PARAM_TLS1_MULTIBLOCK_AAD: the aad of the first record and
+ * the payload of the whole write. The records are always built, by the
+ * soft cipher if not by the hardware, as libssl from 3.2 on takes a
+ * failure here as fatal to the connection.
+ */
+static int uadk_cbc_hmac_mb_init(struct cbc_hmac_priv_ctx *priv, const unsigned char *aad,
+				 size_t len, unsigned int interleave)
+{
+	struct cipher_priv_ctx *base = &priv->base;
+	size_t last, buf_len;
+
+	if (!base->enc || !base->key_set || !priv->md_ctx)
+		return UADK_P_FAIL;
+
+	/* the explicit iv is in TLS 1.1 records on */
+	if ((aad[9] << 8 | aad[10]) < TLS1_1_VERSION || !interleave ||
+	    interleave > CBC_HMAC_MB_MAX_RECORDS || len < interleave)
+		return UADK_P_FAIL;
+
+	last = len - len / interleave * (interleave - 1);
+	if (CBC_HMAC_RECORD_LEN(last, priv->mac_len) - CBC_HMAC_TLS_HDR_LEN >
+	    CBC_HMAC_TLS_MAX_LEN)
+		return UADK_P_FAIL;
+
+	if (!priv->mb) {
+		priv->mb = OPENSSL_zalloc(sizeof(*priv->mb));
+		if (!priv->mb)
+			return UADK_P_FAIL;
+	}
+
+	buf_len = interleave * (CBC_HMAC_RECORD_LEN(last, priv->mac_len) -
+				CBC_HMAC_TLS_HDR_LEN - AES_BLOCK_SIZE);
+	if (priv->mb->buf_len < buf_len) {
+		OPENSSL_clear_free(priv->mb->buf, priv->mb->buf_len);
+		priv->mb->buf_len = 0;
+		priv->mb->buf = OPENSSL_malloc(buf_len);
+		if (!priv->mb->buf)
+			return UADK_P_FAIL;
+		priv->mb->buf_len = buf_len;
+	}
+
+	memcpy(priv->mb_aad, aad, EVP_AEAD_TLS1_AAD_LEN);
+	priv->mb_len = len;
+	priv->mb_interleave = interleave;
+
+	return UADK_P_SUCCESS;
+}
+
+static void *uadk_cbc_hmac_mb_cb(struct wd_cipher_req *req, void *data)
+{
+	struct cbc_hmac_mb_ctx *mb;
+
+	if (!req || !req->cb_param)
+		return NULL;
+
+	mb = req->cb_param;
+	if (req->state)
+		__atomic_store_n(&mb->failed, 1, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&mb->done, 1, __ATOMIC_RELEASE);
+
+	return NULL;
+}
+
+/*
+ * Every record is sent before the first one is waited for, so the queue
+ * works on all of them instead of one round trip per record.
+ */
+static int uadk_cbc_hmac_mb_hw(struct cbc_hmac_priv_ctx *priv, unsigned int num)
+{
+	struct cbc_hmac_mb_ctx *mb = priv->mb;
+	unsigned int sent, cnt;
+	__u64 rx_cnt = 0;
+	__u32 recv;
+	int done, ret = 0;
+
+	if (priv->base.switch_flag == UADK_DO_SOFT ||
+	    uadk_prov_cipher_ctx_init(&priv->base) != UADK_P_SUCCESS)
+		return SWITCH_TO_SOFT;
+
+	mb->done = 0;
+	mb->failed = 0;
+	for (sent = 0; sent < num; sent++) {
+		cnt = 0;
+		do {
+			ret = wd_do_cipher_async(priv->base.sess, &mb->req[sent]);
+			/* a full queue drains as the records already sent come back */
+			if (ret == -EBUSY)
+				(void)wd_cipher_poll(1, &recv);
+		} while (ret == -EBUSY && cnt++ < PROV_SEND_MAX_CNT);
+
+		if (unlikely(ret < 0)) {
+			UADK_ERR("failed to send multiblock record, ret = %d.\n", ret);
+			break;
+		}
+	}
+
+	/* the buffers belong to the hardware until every record sent is back */
+	while ((done = __atomic_load_n(&mb->done, __ATOMIC_ACQUIRE)) < (int)sent) {
+		if (unlikely(rx_cnt++ >= PROV_SCH_RECV_MAX_CNT)) {
+			UADK_ERR("failed to poll multiblock records: timeout!\n");
+			/* a late record still writes to them, so they are not reused */
+			priv->mb = NULL;
+			return UADK_P_FAIL;
+		}
+		(void)wd_cipher_poll(sent - done, &recv);
+	}
+
+	if (sent < num || mb->failed)
+		return SWITCH_TO_SOFT;
+
+	return UADK_P_SUCCESS;
+}
+
+/*
+ * OSSL_CIPHER_PARAM_TLS1_MULTIBLOCK_ENC: the payload set up by the aad,
+ * written to out as interleave whole records. The macs are taken on the
+ * cpu first, then every record goes to the device as one CBC request
+ * under its own random explicit iv.
+ */
+static int uadk_cbc_hmac_mb_enc(struct cbc_hmac_priv_ctx *priv, unsigned char *out,
+				const unsigned char *in, size_t len, unsigned int interleave)
+{
+	struct cbc_hmac_mb_ctx *mb = priv->mb;
+	size_t frag, stride, rec_len, blk_len, pad, enc_len = 0;
+	unsigned char *rec, *src;
+	struct wd_cipher_req *req;
+	unsigned int i, seq;
+	int n, sw_len, ret;
+
+	if (!mb || !out || !in || len != priv->mb_len || interleave != priv->mb_interleave) {
+		UADK_ERR("multiblock write does not match its aad.\n");
+		return UADK_P_FAIL;
+	}
+
+	if (RAND_bytes_ex(prov_libctx_of(priv->base.provctx), mb->iv[0],
+			  interleave * IV_LEN, 0) <= 0)
+		return UADK_P_FAIL;
+
+	frag = len / interleave;
+	stride = mb->buf_len / interleave;
+	for (i = 0; i < interleave; i++) {
+		rec_len = i == interleave - 1 ? len - frag * i : frag;
+		rec = out + i * CBC_HMAC_RECORD_LEN(frag, priv->mac_len);
+		src = mb->buf + i * stride;
+
+		/* the sequence number goes up by one for each record */
+		memcpy(priv->tls_aad, priv->mb_aad, EVP_AEAD_TLS1_AAD_LEN);
+		for (n = 7, seq = i; n >= 0 && seq; n--) {
+			seq += priv->tls_aad[n];
+			priv->tls_aad[n] = (unsigned char)seq;
+			seq >>= 8;
+		}
+		priv->tls_aad[11] = (unsigned char)(rec_len >> 8);
+		priv->tls_aad[12] = (unsigned char)rec_len;
+
+		memcpy(src, in + i * frag, rec_len);
+		if (!uadk_cbc_hmac_mac(priv, src, rec_len, src + rec_len))
+			return UADK_P_FAIL;
+
+		blk_len = CBC_HMAC_RECORD_LEN(rec_len, priv->mac_len) -
+			  CBC_HMAC_TLS_HDR_LEN - AES_BLOCK_SIZE;
+		pad = blk_len - rec_len - priv->mac_len - 1;
+		memset(src + rec_len + priv->mac_len, (int)pad, pad + 1);
+
+		/* the iv goes out in the clear ahead of the blocks it starts */
+		memcpy(rec + CBC_HMAC_TLS_HDR_LEN, mb->iv[i], AES_BLOCK_SIZE);
+		rec_len = AES_BLOCK_SIZE + blk_len;
+		rec[0] = priv->mb_aad[8];
+		rec[1] = priv->mb_aad[9];
+		rec[2] = priv->mb_aad[10];
+		rec[3] = (unsigned char)(rec_len >> 8);
+		rec[4] = (unsigned char)rec_len;
+		enc_len += CBC_HMAC_TLS_HDR_LEN + rec_len;
+
+		req = &mb->req[i];
+		memset(req, 0, sizeof(*req));
+		req->op_type = WD_CIPHER_ENCRYPTION;
+		req->src = src;
+		req->dst = rec + CBC_HMAC_TLS_HDR_LEN + AES_BLOCK_SIZE;
+		req->in_bytes = blk_len;
+		req->out_bytes = blk_len;
+		req->out_buf_bytes = blk_len;
+		req->iv = mb->iv[i];
+		req->iv_bytes = IV_LEN;
+		req->cb = uadk_cbc_hmac_mb_cb;
+		req->cb_param = mb;
+		req->state = POLL_ERROR;
+	}
+	OPENSSL_cleanse(priv->tls_aad, sizeof(priv->tls_aad));
+
+	ret = uadk_cbc_hmac_mb_hw(priv, interleave);
+	if (ret == UADK_P_FAIL)
+		return UADK_P_FAIL;
+
+	for (i = 0; ret == SWITCH_TO_SOFT && i < interleave; i++) {
+		req = &mb->req[i];
+		rec = out + i * CBC_HMAC_RECORD_LEN(frag, priv->mac_len);
+		/* the device may have moved the iv in the request on */
+		if (!EVP_CipherInit_ex2(priv->base.sw_ctx, NULL, NULL,
+					rec + CBC_HMAC_TLS_HDR_LEN, 1, NULL) ||
+		    !EVP_CipherUpdate(priv->base.sw_ctx, req->dst, &sw_len, req->src,
+				      req->in_bytes)) {
+			UADK_ERR("failed to encrypt multiblock record in soft.\n");
+			return UADK_P_FAIL;
+		}
+	}
+
+	priv->mb_enc_len = enc_len;
+	priv->mb_len = 0;
+
+	return UADK_P_SUCCESS;
+}
+
+static int uadk_cbc_hmac_set_mb_params(struct cbc_hmac_priv_ctx *priv,
+				       const OSSL_PARAM params[])
+{
+	const OSSL_PARAM *p, *p1;
+	unsigned int interleave = 0;
+
+	p = OSSL_PARAM_locate_const(params, OSSL_CIPHER_PARAM_TLS1_MULTIBLOCK_MAX_SEND_FRAGMENT);
+	if (p) {
+		if (!OSSL_PARAM_get_size_t(p, &priv->mb_max_frag) ||
+		    priv->mb_max_frag > CBC_HMAC_TLS_MAX_FRAG) {
+			UADK_ERR("invalid multiblock max send fragment.\n");
+			return UADK_P_FAIL;
+		}
+	}
+
+	p = OSSL_PARAM_locate_const(params, OSSL_CIPHER_PARAM_TLS1_MULTIBLOCK_INTERLEAVE);
+	if (p && !OSSL_PARAM_get_uint(p, &interleave))
+		return UADK_P_FAIL;
+
+	/* the octet string is the aad, its size the payload of the write */
+	p = OSSL_PARAM_locate_const(params, OSSL_CIPHER_PARAM_TLS1_MULTIBLOCK_AAD);
+	if (p) {
+		if (p->data_type != OSSL_PARAM_OCTET_STRING || !p->data ||
+		    !uadk_cbc_hmac_mb_init(priv, p->data, p->data_size, interleave))
+			return UADK_P_FAIL;
+	}
+
+	p = OSSL_PARAM_locate_const(params, OSSL_CIPHER_PARAM_TLS1_MULTIBLOCK_ENC);
+	if (p) {
+		p1 = OSSL_PARAM_locate_const(params, OSSL_CIPHER_PARAM_TLS1_MULTIBLOCK_ENC_IN);
+		if (p->data_type != OSSL_PARAM_OCTET_STRING || !p1 ||
+		    p1->data_type != OSSL_PARAM_OCTET_STRING ||
+		    !uadk_cbc_hmac_mb_enc(priv, p->data, p1->data, p1->data_size, interleave))
+			return UADK_P_FAIL;
+	}
+
+	return UADK_P_SUCCESS;
+}
+
+static int uadk_cbc_hmac_get_mb_params(struct cbc_hmac_priv_ctx *priv, OSSL_PARAM params[])
+{
+	size_t frag = priv->mb_max_frag ? priv->mb_max_frag : CBC_HMAC_TLS_MAX_FRAG;
+	OSSL_PARAM *p;
+
+	/* one record of max_send_fragment, libssl allocates interleave of them */
+	p = OSSL_PARAM_locate(params, OSSL_CIPHER_PARAM_TLS1_MULTIBLOCK_MAX_BUFSIZE);
+	if (p && !OSSL_PARAM_set_size_t(p, CBC_HMAC_RECORD_LEN(frag, priv->mac_len))) {
+		UADK_ERR("failed to set size parameter: multiblock max bufsize.\n");
+		return UADK_P_FAIL;
+	}
+
+	p = OSSL_PARAM_locate(params, OSSL_CIPHER_PARAM_TLS1_MULTIBLOCK_INTERLEAVE);
+	if (p && !OSSL_PARAM_set_uint(p, priv->mb_interleave)) {
+		UADK_ERR("failed to set uint parameter: multiblock interleave.\n");
+		return UADK_P_FAIL;
+	}
+
+	p = OSSL_PARAM_locate(params, OSSL_CIPHER_PARAM_TLS1_MULTIBLOCK_AAD_PACKLEN);
+	if (p && !OSSL_PARAM_set_size_t(p, priv->mb_interleave ?
+					uadk_cbc_hmac_mb_packlen(priv, priv->mb_len,
+								 priv->mb_interleave) : 0)) {
+		UADK_ERR("failed to set size parameter: multiblock aad packlen.\n");
+		return UADK_P_FAIL;
+	}
+
+	p = OSSL_PARAM_locate(params, OSSL_CIPHER_PARAM_TLS1_MULTIBLOCK_ENC_LEN);
+	if (p && !OSSL_PARAM_set_size_t(p, priv->mb_enc_len)) {
+		UADK_ERR("failed to set size parameter: multiblock enc len.\n");
+		return UADK_P_FAIL;
+	}
+
+	return UADK_P_SUCCESS;
+}
+
+static const OSSL_PARAM uadk_cbc_hmac_settable_ctx_params[] = {
+	OSSL_PARAM_size_t(OSSL_CIPHER_PARAM_KEYLEN, NULL),
+	OSSL_PARAM_octet_string(OSSL_CIPHER_PARAM_AEAD_MAC_KEY, NULL, 0),
+	OSSL_PARAM_octet_string(OSSL_CIPHER_PARAM_AEAD_TLS1_AAD, NULL, 0),
+	OSSL_PARAM_uint(OSSL_CIPHER_PARAM_TLS_VERSION, NULL),
+	OSSL_PARAM_size_t(OSSL_CIPHER_PARAM_TLS1_MULTIBLOCK_MAX_SEND_FRAGMENT, NULL),
+	OSSL_PARAM_octet_string(OSSL_CIPHER_PARAM_TLS1_MULTIBLOCK_AAD, NULL, 0),
+	OSSL_PARAM_uint(OSSL_CIPHER_PARAM_TLS1_MULTIBLOCK_INTERLEAVE, NULL),
+	OSSL_PARAM_octet_string(OSSL_CIPHER_PARAM_TLS1_MULTIBLOCK_ENC, NULL, 0),
+	OSSL_PARAM_octet_string(OSSL_CIPHER_PARAM_TLS1_MULTIBLOCK_ENC_IN, NULL, 0),
+	OSSL_PARAM_END
+};
+
+static const OSSL_PARAM *uadk_cbc_hmac_settable_ctx_params_fn(ossl_unused void *cctx,
+							      ossl_unused void *provctx)
+{
+	return uadk_cbc_hmac_settable_ctx_params;
+}
+
+static int uadk_cbc_hmac_set_ctx_params(void *vctx, const OSSL_PARAM params[])
+{
+	struct cbc_hmac_priv_ctx *priv = (struct cbc_hmac_priv_ctx *)vctx;
+	const OSSL_PARAM *p;
+
+	if (!vctx)
+		return UADK_P_FAIL;
+
+	p = OSSL_PARAM_locate_const(params, OSSL_CIPHER_PARAM_AEAD_MAC_KEY);
+	if (p != NULL) {
+		if (p->data_type != OSSL_PARAM_OCTET_STRING ||
+		    !uadk_cbc_hmac_set_mac_key(priv, p->data, p->data_size))
+			return UADK_P_FAIL;
+	}
+
+	p = OSSL_PARAM_locate_const(params, OSSL_CIPHER_PARAM_AEAD_TLS1_AAD);
+	if (p != NULL) {
+		if (p->data_type != OSSL_PARAM_OCTET_STRING ||
+		    !uadk_cbc_hmac_set_tls_aad(priv, p->data, p->data_size))
+			return UADK_P_FAIL;
+	}
+
+	p = OSSL_PARAM_locate_const(params, OSSL_CIPHER_PARAM_TLS_VERSION);
+	if (p != NULL && !OSSL_PARAM_get_uint(p, &priv->tls_version)) {
+		UADK_ERR("failed to get cipher uint: tls version.\n");
+		return UADK_P_FAIL;
+	}
+
+	p = OSSL_PARAM_locate_const(params, OSSL_CIPHER_PARAM_KEYLEN);
+	if (p != NULL) {
+		size_t keylen;
+
+		if (!OSSL_PARAM_get_size_t(p, &keylen) || keylen != priv->base.keylen) {
+			UADK_ERR("invalid: cipher keylen.\n");
+			return UADK_P_FAIL;
+		}
+	}
+
+	return uadk_cbc_hmac_set_mb_params(priv, params);
+}
+
+static const OSSL_PARAM uadk_cbc_hmac_gettable_ctx_params[] = {
+	OSSL_PARAM_size_t(OSSL_CIPHER_PARAM_KEYLEN, NULL),
+	OSSL_PARAM_size_t(OSSL_CIPHER_PARAM_IVLEN, NULL),
+	OSSL_PARAM_octet_string(OSSL_CIPHER_PARAM_IV, NULL, 0),
+	OSSL_PARAM_octet_string(OSSL_CIPHER_PARAM_UPDATED_IV, NULL, 0),
+	OSSL_PARAM_size_t(OSSL_CIPHER_PARAM_AEAD_TLS1_AAD_PAD, NULL),
+	OSSL_PARAM_size_t(OSSL_CIPHER_PARAM_TLS1_MULTIBLOCK_MAX_BUFSIZE, NULL),
+	OSSL_PARAM_uint(OSSL_CIPHER_PARAM_TLS1_MULTIBLOCK_INTERLEAVE, NULL),
+	OSSL_PARAM_size_t(OSSL_CIPHER_PARAM_TLS1_MULTIBLOCK_AAD_PACKLEN, NULL),
+	OSSL_PARAM_size_t(OSSL_CIPHER_PARAM_TLS1_MULTIBLOCK_ENC_LEN, NULL),
+	OSSL_PARAM_END
+};
+
+static const OSSL_PARAM *uadk_cbc_hmac_gettable_ctx_params_fn(ossl_unused void *cctx,
+							      ossl_unused void *provctx)
+{
+	return uadk_cbc_hmac_gettable_ctx_params;
+}
+
+static int uadk_cbc_hmac_get_ctx_params(void *vctx, OSSL_PARAM params[])
+{
+	struct cbc_hmac_priv_ctx *priv = (struct cbc_hmac_priv_ctx *)vctx;
+	OSSL_PARAM *p;
+
+	if (!vctx || !params)
+		return UADK_P_FAIL;
+
+	p = OSSL_PARAM_locate(params, OSSL_CIPHER_PARAM_AEAD_TLS1_AAD_PAD);
+	if (p != NULL && !OSSL_PARAM_set_size_t(p, priv->tls_aad_pad)) {
+		UADK_ERR("failed to set cipher size parameter: tls aad pad.\n");
+		return UADK_P_FAIL;
+	}
+
+	if (!uadk_cbc_hmac_get_mb_params(priv, params))
+		return UADK_P_FAIL;
+
+	return uadk_prov_cipher_get_ctx_params(&priv->base, params);
+}
+
+static int uadk_cbc_hmac_init(struct cbc_hmac_priv_ctx *priv, const unsigned char *key,
+			      size_t keylen, const unsigned char *iv, size_t ivlen,
+			      const OSSL_PARAM params[], int enc)
+{
+	struct cipher_priv_ctx *base = &priv->base;
+
+	base->req.op_type = enc ? WD_CIPHER_ENCRYPTION : WD_CIPHER_DECRYPTION;
+	base->enc = enc;
+	priv->payload_len = CBC_HMAC_NO_PAYLOAD;
+
+	/* records fall back one by one whatever the offload setting */
+	if (!uadk_create_cipher_soft_ctx(base) ||
+	    !uadk_prov_cipher_init(base, key, keylen, iv, ivlen))
+		return UADK_P_FAIL;
+
+	/* keyed here once, the records only give it their iv */
+	if (base->key_set &&
+	    (!EVP_CipherInit_ex2(base->sw_ctx, base->sw_cipher, base->key, NULL, enc, NULL) ||
+	     !EVP_CIPHER_CTX_set_padding(base->sw_ctx, 0))) {
+		UADK_ERR("cipher soft init failed!\n");
+		return UADK_P_FAIL;
+	}
+
+	return uadk_cbc_hmac_set_ctx_params(priv, params);
+}
+
+static int uadk_cbc_hmac_einit(void *vctx, const unsigned char *key, size_t keylen,
+			       const unsigned char *iv, size_t ivlen,
+			       const OSSL_PARAM params[])
+{
+	if (!vctx)
+		return UADK_P_FAIL;
+
+	return uadk_cbc_hmac_init(vctx, key, keylen, iv, ivlen, params, 1);
+}
+
+static int uadk_cbc_hmac_dinit(void *vctx, const unsigned char *key, size_t keylen,
+			       const unsigned char *iv, size_t ivlen,
+			       const OSSL_PARAM params[])
+{
+	if (!vctx)
+		return UADK_P_FAIL;
+
+	return uadk_cbc_hmac_init(vctx, key, keylen, iv, ivlen, params, 0);
+}
+
+static void uadk_cbc_hmac_freectx(void *ctx)
+{
+	struct cbc_hmac_priv_ctx *priv = (struct cbc_hmac_priv_ctx *)ctx;
+
+	if (ctx == NULL)
+		return;
+
+	if (priv->mb) {
+		OPENSSL_clear_free(priv->mb->buf, priv->mb->buf_len);
+		OPENSSL_clear_free(priv->mb, sizeof(*priv->mb));
+	}
+	EVP_MD_CTX_free(priv->md_ctx);
+	EVP_MD_CTX_free(priv->tail);
+	EVP_MD_CTX_free(priv->head);
+	EVP_MD_free(priv->md);
+	uadk_prov_cipher_cleanup(&priv->base);
+	OPENSSL_clear_free(priv, sizeof(*priv));
+}
+
+static void *uadk_cbc_hmac_dupctx(void *ctx)
+{
+	struct cbc_hmac_priv_ctx *src = (struct cbc_hmac_priv_ctx *)ctx;
+	struct cbc_hmac_priv_ctx *dst;
+
+	if (!src)
+		return NULL;
+
+	dst = uadk_prov_cipher_dup(&src->base, sizeof(*src));
+	if (!dst)
+		return NULL;
+
+	dst->head = NULL;
+	dst->tail = NULL;
+	dst->md_ctx = NULL;
+	/* a write in progress is not carried over */
+	dst->mb = NULL;
+	dst->mb_len = 0;
+	if (dst->md && !EVP_MD_up_ref(dst->md)) {
+		dst->md = NULL;
+		goto free;
+	}
+
+	if (src->md_ctx) {
+		dst->head = EVP_MD_CTX_new();
+		dst->tail = EVP_MD_CTX_new();
+		dst->md_ctx = EVP_MD_CTX_new();
+		if (!dst->head || !dst->tail || !dst->md_ctx ||
+		    !EVP_MD_CTX_copy_ex(dst->head, src->head) ||
+		    !EVP_MD_CTX_copy_ex(dst->tail, src->tail))
+			goto free;
+	}
+
+	return dst;
+
+free:
+	UADK_ERR("failed to duplicate the record mac state.\n");
+	uadk_cbc_hmac_freectx(dst);
+	return NULL;
+}
+
+#define UADK_CBC_HMAC_DESCR(nm, key_len, e_nid, mdname, maclen)			\
+static OSSL_FUNC_cipher_newctx_fn uadk_##nm##_newctx;				\
+static void *uadk_##nm##_newctx(void *provctx)					\
+{										\
+	struct cbc_hmac_priv_ctx *ctx = OPENSSL_zalloc(sizeof(*ctx));		\
+	if (ctx == NULL)							\
+		return NULL;							\
+										\
+	ctx->base.blksize = AES_BLOCK_SIZE;					\
+	ctx->base.provctx = provctx;						\
+	ctx->base.keylen = key_len;						\
+	ctx->base.ivlen = IV_LEN;						\
+	ctx->base.nid = e_nid;							\
+	strncpy(ctx->base.alg_name, "cbc(aes)", ALG_NAME_SIZE - 1);		\
+	ctx->md_name = mdname;							\
+	ctx->mac_len = maclen;							\
+	ctx->payload_len = CBC_HMAC_NO_PAYLOAD;					\
+	return ctx;								\
+}										\
+static OSSL_FUNC_cipher_get_params_fn uadk_##nm##_get_params;			\
+static int uadk_##nm##_get_params(OSSL_PARAM params[])				\
+{										\
+	return ossl_cipher_generic_get_params(params, EVP_CIPH_CBC_MODE,	\
+					      PROV_CIPHER_FLAG_AEAD |		\
+					      PROV_CIPHER_FLAG_TLS1_MULTIBLOCK,	\
+					      key_len,				\
+					      AES_BLOCK_SIZE, IV_LEN);		\
+}										\
+const OSSL_DISPATCH uadk_##nm##_functions[] = {					\
+	{ OSSL_FUNC_CIPHER_NEWCTX, (void (*)(void))uadk_##nm##_newctx },	\
+	{ OSSL_FUNC_CIPHER_FREECTX, (void (*)(void))uadk_cbc_hmac_freectx },	\
+	{ OSSL_FUNC_CIPHER_DUPCTX, (void (*)(void))uadk_cbc_hmac_dupctx },	\
+	{ OSSL_FUNC_CIPHER_ENCRYPT_INIT, (void (*)(void))uadk_cbc_hmac_einit },	\
+	{ OSSL_FUNC_CIPHER_DECRYPT_INIT, (void (*)(void))uadk_cbc_hmac_dinit },	\
+	{ OSSL_FUNC_CIPHER_UPDATE, (void (*)(void))uadk_cbc_hmac_update },	\
+	{ OSSL_FUNC_CIPHER_FINAL, (void (*)(void))uadk_cbc_hmac_final },	\
+	{ OSSL_FUNC_CIPHER_CIPHER, (void (*)(void))uadk_cbc_hmac_update },	\
+	{ OSSL_FUNC_CIPHER_GET_PARAMS,						\
+		(void (*)(void))uadk_##nm##_get_params },			\
+	{ OSSL_FUNC_CIPHER_GETTABLE_PARAMS,					\
+		(void (*)(void))uadk_prov_cipher_gettable_params },		\
+	{ OSSL_FUNC_CIPHER_GET_CTX_PARAMS,					\
+		(void (*)(void))uadk_cbc_hmac_get_ctx_params },			\
+	{ OSSL_FUNC_CIPHER_GETTABLE_CTX_PARAMS,					\
+		(void (*)(void))uadk_cbc_hmac_gettable_ctx_params_fn },		\
+	{ OSSL_FUNC_CIPHER_SET_CTX_PARAMS,					\
+		(void (*)(void))uadk_cbc_hmac_set_ctx_params },			\
+	{ OSSL_FUNC_CIPHER_SETTABLE_CTX_PARAMS,					\
+		(void (*)(void))uadk_cbc_hmac_settable_ctx_params_fn },		\
+	{ 0, NULL }								\
+}
+
+UADK_CBC_HMAC_DESCR(aes_128_cbc_hmac_sha1, 16, ID_aes_128_cbc, "SHA1", 20);
+UADK_CBC_HMAC_DESCR(aes_256_cbc_hmac_sha1, 32, ID_aes_256_cbc, "SHA1", 20);
+UADK_CBC_HMAC_DESCR(aes_128_cbc_hmac_sha256, 16, ID_aes_128_cbc, "SHA2-256", 32);
+UADK_CBC_HMAC_DESCR(aes_256_cbc_hmac_sha256, 32, ID_aes_256_cbc, "SHA2-256", 32);
@@ -27,6 +27,7 @@
 #include "uadk_prov.h"
 #include "uadk_prov_ffc.h"
 #include "uadk_prov_pkey.h"
+#include "uadk_prov_rand.h"
 #include "uadk_utils.h"
 
 #define DH768BITS			768
@@ -55,6 +56,14 @@
 #define IGNORE_Q			1
 #define USE_PAD				1
 #define KDF_PARAM_NUM			5
+/* idle sessions kept for reuse, the least recently used goes first */
+#define DH_SESS_CACHE_MAX		32
+/* idle sessions kept per RFC 7919 group, apart from the ones above */
+#define DH_FFDHE_SESS_MAX		32
+/* private exponent bits of RFC 7919 section 5.2 */
+#define DH_FFDHE2048_XBITS		225
+#define DH_FFDHE3072_XBITS		275
+#define DH_FFDHE4096_XBITS		325
 
 UADK_PKEY_KEYMGMT_DESCR(dh, DH);
 UADK_PKEY_KEYEXCH_DESCR(dh, DH);
@@ -158,12 +167,63 @@ struct uadk_dh_sess {
 	 * 1 - key is generated by provider
 	 */
 	int key_flag;
+	/* group the session is set up for, g is loaded once at alloc */
+	BIGNUM *p;
+	BIGNUM *g;
+	unsigned char *p_bin;
+	__u32 pbytes;
+	int pid;
+	unsigned int gen;
+	/* RFC 7919 group of the session, NULL for any other p and g */
+	struct dh_ffdhe_group *grp;
+	struct uadk_dh_sess *prev;
+	struct uadk_dh_sess *next;
 };
 
 struct dh_res {
 	int pid;
 } g_dh_prov;
 
+struct dh_sess_cache {
+	int pid;
+	/* bumped on every flush, sessions of an older generation are stale */
+	unsigned int gen;
+	unsigned int num;
+	/* most recently used first */
+	struct uadk_dh_sess *head;
+	struct uadk_dh_sess *tail;
+	__u64 hits;
+	__u64 misses;
+	__u64 evictions;
+};
+
+static struct dh_sess_cache g_dh_sess_cache;
+static pthread_mutex_t dh_sess_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+ * The RFC 7919 groups the accelerator has a key size for. Their sessions
+ * are found by nid rather than by comparing p, share a p serialised once,
+ * and stay in a list of the group that sessions of other p and g never
+ * evict. ffdhe6144 and ffdhe8192 are beyond the accelerator and go soft.
+ */
+struct dh_ffdhe_group {
+	int nid;
+	__u16 bits;
+	int xbits;
+	const BIGNUM *p;
+	unsigned char p_bin[UADK_DH_MAX_MODULE_BIT >> CHAR_BIT_SIZE];
+	__u32 pbytes;
+	struct dh_sess_cache cache;
+};
+
+static struct dh_ffdhe_group g_dh_ffdhe[] = {
+	{ NID_ffdhe2048, DH2048BITS, DH_FFDHE2048_XBITS, &ossl_bignum_ffdhe2048_p },
+	{ NID_ffdhe3072, DH3072BITS, DH_FFDHE3072_XBITS, &ossl_bignum_ffdhe3072_p },
+	{ NID_ffdhe4096, DH4096BITS, DH_FFDHE4096_XBITS, &ossl_bignum_ffdhe4096_p },
+};
+
+static pthread_once_t dh_ffdhe_once = PTHREAD_ONCE_INIT;
+
 /*
  * This type is only really used to handle some legacy related functionality.
  * If you need to use other KDF's (such as SSKDF) just use PROV_DH_KDF_NONE
@@ -533,9 +593,10 @@ static int dh_gen_rand_prikey(const DH *dh, BIGNUM *new_prikey)
 	m = (BN_cmp(two_powN, dh->params.q) > 0) ? dh->params.q : two_powN;
 
 	do {
-		if (!BN_priv_rand_range_ex(new_prikey, two_powN, 0, NULL) ||
+		/* uniform below 2^n, as BN_priv_rand_range() of 2^n */
+		if (!uadk_prov_rand_bits_bn(new_prikey, n) ||
 		    !BN_add_word(new_prikey, 1)) {
-			UADK_ERR("failed to BN_priv_rand_range_ex\n");
+			UADK_ERR("failed to get random prikey\n");
 			goto err;
 		}
 		/* Step (6) : loop if c > M - 2 (i.e. c + 1 >= M) */
@@ -556,8 +617,33 @@ err:
 	return UADK_P_FAIL;
 }
 
+/*
+ * x in [1, 2^xbits - 1], what dh_gen_rand_prikey() picks for a group whose
+ * q is longer than the exponent, without the range arithmetic.
+ */
+static int dh_ffdhe_gen_prikey(const struct dh_ffdhe_group *grp, BIGNUM *new_prikey)
+{
+	int cnt = 0;
+
+	do {
+		if (!uadk_prov_rand_bits_bn(new_prikey, grp->xbits)) {
+			UADK_ERR("failed to get random prikey\n");
+			return UADK_P_FAIL;
+		}
+
+		if (!BN_is_zero(new_prikey))
+			return UADK_P_SUCCESS;
+	} while (cnt++ < RAND_MAX_CNT);
+
+	UADK_ERR("failed to get appropriate prikey, timeout\n");
+
+	return UADK_P_FAIL;
+}
+
 static int uadk_prov_dh_prepare_prikey(struct uadk_dh_sess *dh_sess, const DH *dh, BIGNUM **prikey)
 {
+	int ret;
+
 	*prikey = (BIGNUM *)uadk_DH_get0_priv_key(dh);
 
 	if (*prikey == NULL) {
@@ -567,7 +653,12 @@ static int uadk_prov_dh_prepare_prikey(struct uadk_dh_sess *dh_sess, const DH *d
 			return UADK_P_FAIL;
 		}
 
-		if (dh_gen_rand_prikey(dh, *prikey) == UADK_P_FAIL) {
+		/* a length asked for by the user goes the generic way */
+		if (dh_sess->grp && !dh->length)
+			ret = dh_ffdhe_gen_prikey(dh_sess->grp, *prikey);
+		else
+			ret = dh_gen_rand_prikey(dh, *prikey);
+		if (ret == UADK_P_FAIL) {
 			UADK_ERR("failed to generate new private key\n");
 			goto free_prikey;
 		}
@@ -651,6 +742,7 @@ static void uadk_prov_dh_mutex_infork(void)
 {
 	/* Release the replication lock of the child process */
 	pthread_mutex_unlock(&dh_mutex);
+	pthread_mutex_unlock(&dh_sess_mutex);
 }
 
 static int uadk_prov_dh_init(void)
@@ -681,20 +773,50 @@ static int uadk_prov_dh_init(void)
 	return UADK_P_INIT_SUCCESS;
 }
 
-/* Uninit only when the process exits, not uninit when thread exits */
-void uadk_prov_dh_uninit(void)
+static int dh_set_g(const BIGNUM *g, const __u16 key_size,
+		    unsigned char *g_bin, struct uadk_dh_sess *dh_sess)
 {
-	pthread_mutex_lock(&dh_mutex);
-	if (g_dh_prov.pid == getpid()) {
-		wd_dh_uninit2();
-		g_dh_prov.pid = 0;
+	struct wd_dtb g_dtb = {0};
+	__u32 gbytes;
+	int ret;
+
+	gbytes = BN_bn2bin(g, g_bin);
+	g_dtb.data = (char *)g_bin;
+	g_dtb.bsize = key_size;
+	g_dtb.dsize = gbytes;
+
+	ret = wd_dh_set_g(dh_sess->sess, &g_dtb);
+	if (ret) {
+		UADK_ERR("failed to set dh g\n");
+		return UADK_P_FAIL;
 	}
-	pthread_mutex_unlock(&dh_mutex);
+
+	return UADK_P_SUCCESS;
 }
 
-static struct uadk_dh_sess *uadk_prov_dh_new_session(DH *dh, __u16 bits, bool is_g2)
+static void uadk_prov_dh_free_session(struct uadk_dh_sess *dh_sess)
+{
+	if (dh_sess == NULL)
+		return;
+
+	/* sessions inherited over fork belong to the parent's queues */
+	if (dh_sess->sess && dh_sess->pid == getpid())
+		wd_dh_free_sess(dh_sess->sess);
+
+	BN_free(dh_sess->p);
+	BN_free(dh_sess->g);
+	/* p of a group session is the static one of the group */
+	if (!dh_sess->grp)
+		OPENSSL_free(dh_sess->p_bin);
+	OPENSSL_free(dh_sess);
+}
+
+static struct uadk_dh_sess *uadk_prov_dh_new_session(const BIGNUM *p, const BIGNUM *g,
+						     __u16 bits, struct dh_ffdhe_group *grp)
 {
 	struct uadk_dh_sess *dh_sess = OPENSSL_zalloc(sizeof(struct uadk_dh_sess));
+	unsigned char g_bin[UADK_DH_MAX_MODULE_BIT >> CHAR_BIT_SIZE];
+	struct dh_sess_cache *cache = grp ? &grp->cache : &g_dh_sess_cache;
 	__u16 key_size = bits >> CHAR_BIT_SIZE;
 	struct sched_params params = {0};
 
@@ -703,32 +825,264 @@ static struct uadk_dh_sess *uadk_prov_dh_new_session(DH *dh, __u16 bits, bool is
 		return NULL;
 	}
 
-	dh_sess->alg = dh;
+	dh_sess->pid = getpid();
+	dh_sess->gen = __atomic_load_n(&cache->gen, __ATOMIC_ACQUIRE);
 	dh_sess->key_size = key_size;
+	if (grp) {
+		/* only the cache of the group has these, nothing compares p or g */
+		dh_sess->grp = grp;
+		dh_sess->p_bin = grp->p_bin;
+		dh_sess->pbytes = grp->pbytes;
+	} else {
+		dh_sess->p = BN_dup(p);
+		dh_sess->g = BN_dup(g);
+		dh_sess->p_bin = OPENSSL_malloc(key_size);
+		if (!dh_sess->p || !dh_sess->g || !dh_sess->p_bin ||
+		    BN_num_bytes(p) > key_size || BN_num_bytes(g) > key_size)
+			goto free_sess;
+		dh_sess->pbytes = BN_bn2bin(p, dh_sess->p_bin);
+	}
+
 	dh_sess->setup.key_bits = bits;
-	dh_sess->setup.is_g2 = is_g2;
+	dh_sess->setup.is_g2 = BN_is_word(g, DH_GENERATOR_2);
 	/* Use the default numa parameters */
 	params.numa_id = -1;
 	dh_sess->setup.sched_param = &params;
 	dh_sess->sess = wd_dh_alloc_sess(&dh_sess->setup);
 	if (dh_sess->sess == (handle_t)0) {
 		UADK_ERR("failed to init dh sess\n");
-		OPENSSL_free(dh_sess);
+		goto free_sess;
+	}
+
+	if (dh_set_g(g, key_size, g_bin, dh_sess) == UADK_P_FAIL)
+		goto free_sess;
+
+	return dh_sess;
+
+free_sess:
+	uadk_prov_dh_free_session(dh_sess);
+	return NULL;
+}
+
+static void dh_sess_unlink(struct dh_sess_cache *cache, struct uadk_dh_sess *dh_sess)
+{
+	if (dh_sess->prev)
+		dh_sess->prev->next = dh_sess->next;
+	else
+		cache->head = dh_sess->next;
+
+	if (dh_sess->next)
+		dh_sess->next->prev = dh_sess->prev;
+	else
+		cache->tail = dh_sess->prev;
+
+	dh_sess->prev = NULL;
+	dh_sess->next = NULL;
+	cache->num--;
+}
+
+/* called with dh_sess_mutex held, returns the list for the caller to free */
+static struct uadk_dh_sess *dh_sess_cache_detach(struct dh_sess_cache *cache)
+{
+	struct uadk_dh_sess *list = cache->head;
+
+	cache->head = NULL;
+	cache->tail = NULL;
+	cache->num = 0;
+	__atomic_add_fetch(&cache->gen, 1, __ATOMIC_RELEASE);
+
+	return list;
+}
+
+/* called with dh_sess_mutex held, drops what a forked child inherited */
+static struct uadk_dh_sess *dh_sess_cache_check_pid(struct dh_sess_cache *cache)
+{
+	if (cache->pid == getpid())
 		return NULL;
+
+	cache->pid = getpid();
+	cache->hits = 0;
+	cache->misses = 0;
+	cache->evictions = 0;
+
+	return dh_sess_cache_detach(cache);
+}
+
+static void dh_sess_free_list(struct uadk_dh_sess *list)
+{
+	struct uadk_dh_sess *next;
+
+	while (list) {
+		next = list->next;
+		uadk_prov_dh_free_session(list);
+		list = next;
 	}
+}
+
+static void dh_ffdhe_init(void)
+{
+	size_t i;
+
+	for (i = 0; i < ARRAY_SIZE(g_dh_ffdhe); i++)
+		g_dh_ffdhe[i].pbytes = BN_bn2bin(g_dh_ffdhe[i].p, g_dh_ffdhe[i].p_bin);
+}
+
+/* the RFC 7919 group of a key, NULL if it has none or other p and g */
+static struct dh_ffdhe_group *dh_ffdhe_find(const DH *dh, const BIGNUM *p,
+					    const BIGNUM *g, __u16 bits)
+{
+	int nid = DH_get_nid(dh);
+	size_t i;
+
+	if (nid == NID_undef || !BN_is_word(g, DH_GENERATOR_2))
+		return NULL;
+
+	for (i = 0; i < ARRAY_SIZE(g_dh_ffdhe); i++) {
+		if (g_dh_ffdhe[i].nid != nid)
+			continue;
+
+		if (g_dh_ffdhe[i].bits != bits ||
+		    (p != g_dh_ffdhe[i].p && BN_cmp(p, g_dh_ffdhe[i].p)))
+			return NULL;
+
+		pthread_once(&dh_ffdhe_once, dh_ffdhe_init);
+		return &g_dh_ffdhe[i];
+	}
+
+	return NULL;
+}
+
+/*
+ * Sessions are set up per group, so one with the same p, g and size is
+ * picked from the cache when possible. The caller owns the session until
+ * uadk_prov_dh_put_session, concurrent users never share one.
+ */
+static struct uadk_dh_sess *uadk_prov_dh_get_session(DH *dh, const BIGNUM *p,
+						     const BIGNUM *g, __u16 bits)
+{
+	struct dh_ffdhe_group *grp = dh_ffdhe_find(dh, p, g, bits);
+	struct dh_sess_cache *cache = grp ? &grp->cache : &g_dh_sess_cache;
+	__u16 key_size = bits >> CHAR_BIT_SIZE;
+	struct uadk_dh_sess *dh_sess, *stale;
+
+	pthread_mutex_lock(&dh_sess_mutex);
+	stale = dh_sess_cache_check_pid(cache);
+	if (grp) {
+		/* all sessions of a group cache are alike */
+		dh_sess = cache->head;
+		if (dh_sess)
+			dh_sess_unlink(cache, dh_sess);
+	} else {
+		for (dh_sess = cache->head; dh_sess; dh_sess = dh_sess->next) {
+			if (dh_sess->key_size == key_size && !BN_cmp(dh_sess->g, g) &&
+			    !BN_cmp(dh_sess->p, p)) {
+				dh_sess_unlink(cache, dh_sess);
+				break;
+			}
+		}
+	}
+	if (dh_sess)
+		cache->hits++;
+	else
+		cache->misses++;
+	pthread_mutex_unlock(&dh_sess_mutex);
+
+	dh_sess_free_list(stale);
+
+	if (!dh_sess) {
+		dh_sess = uadk_prov_dh_new_session(p, g, bits, grp);
+		if (!dh_sess)
+			return NULL;
+	}
+
+	memset(&dh_sess->req, 0, sizeof(dh_sess->req));
+	dh_sess->alg = dh;
+	dh_sess->key_flag = KEY_GEN_BY_USR;
 
 	return dh_sess;
 }
 
-static void uadk_prov_dh_free_session(struct uadk_dh_sess *dh_sess)
+static void uadk_prov_dh_put_session(struct uadk_dh_sess *dh_sess)
 {
+	struct dh_sess_cache *cache = &g_dh_sess_cache;
+	struct uadk_dh_sess *victim = NULL;
+	struct uadk_dh_sess *stale;
+
 	if (dh_sess == NULL)
 		return;
 
-	if (dh_sess->sess)
-		wd_dh_free_sess(dh_sess->sess);
+	if (dh_sess->grp)
+		cache = &dh_sess->grp->cache;
 
-	OPENSSL_free(dh_sess);
+	dh_sess->alg = NULL;
+	if (dh_sess->pid != getpid()) {
+		uadk_prov_dh_free_session(dh_sess);
+		return;
+	}
+
+	pthread_mutex_lock(&dh_sess_mutex);
+	stale = dh_sess_cache_check_pid(cache);
+	/* the dh env was re-initialised while the session was out */
+	if (dh_sess->gen != cache->gen) {
+		pthread_mutex_unlock(&dh_sess_mutex);
+		dh_sess_free_list(stale);
+		uadk_prov_dh_free_session(dh_sess);
+		return;
+	}
+
+	dh_sess->next = cache->head;
+	if (cache->head)
+		cache->head->prev = dh_sess;
+	else
+		cache->tail = dh_sess;
+	cache->head = dh_sess;
+	cache->num++;
+
+	if (cache->num > (dh_sess->grp ? DH_FFDHE_SESS_MAX : DH_SESS_CACHE_MAX)) {
+		victim = cache->tail;
+		dh_sess_unlink(cache, victim);
+		cache->evictions++;
+	}
+	pthread_mutex_unlock(&dh_sess_mutex);
+
+	dh_sess_free_list(stale);
+	uadk_prov_dh_free_session(victim);
+}
+
+static void dh_sess_cache_flush_one(struct dh_sess_cache *cache, const char *name)
+{
+	struct uadk_dh_sess *list;
+
+	pthread_mutex_lock(&dh_sess_mutex);
+	if (cache->pid == getpid())
+		UADK_INFO("dh %s session cache: %llu hits, %llu misses, %llu evictions\n",
+			  name, cache->hits, cache->misses, cache->evictions);
+	list = dh_sess_cache_detach(cache);
+	pthread_mutex_unlock(&dh_sess_mutex);
+
+	dh_sess_free_list(list);
+}
+
+static void uadk_prov_dh_sess_cache_flush(void)
+{
+	size_t i;
+
+	dh_sess_cache_flush_one(&g_dh_sess_cache, "lru");
+	for (i = 0; i < ARRAY_SIZE(g_dh_ffdhe); i++)
+		dh_sess_cache_flush_one(&g_dh_ffdhe[i].cache, OBJ_nid2sn(g_dh_ffdhe[i].nid));
+}
+
+/* Uninit only when the process exits, not uninit when thread exits */
+void uadk_prov_dh_uninit(void)
+{
+	pthread_mutex_lock(&dh_mutex);
+	if (g_dh_prov.pid == getpid()) {
+		/* cached sessions hold ctxs released by wd_dh_uninit2 */
+		uadk_prov_dh_sess_cache_flush();
+		wd_dh_uninit2();
+		g_dh_prov.pid = 0;
+	}
+	pthread_mutex_unlock(&dh_mutex);
 }
 
 static int check_dh_bit_useful(const __u16 bits)
@@ -756,10 +1110,9 @@ static int check_dh_bit_useful(const __u16 bits)
 	return UADK_P_FAIL;
 }
 
-static int uadk_prov_dh_prepare_data(const BIGNUM *g, DH *dh, struct uadk_dh_sess **dh_sess,
-				     BIGNUM **prikey)
+static int uadk_prov_dh_prepare_data(const BIGNUM *p, const BIGNUM *g, DH *dh,
+				     struct uadk_dh_sess **dh_sess, BIGNUM **prikey)
 {
-	bool is_g2 = BN_is_word(g, DH_GENERATOR_2);
 	__u16 bits;
 	int ret;
 
@@ -779,7 +1132,7 @@ static int uadk_prov_dh_prepare_data(const BIGNUM *g, DH *dh, struct uadk_dh_ses
 		return UADK_DO_SOFT;
 	}
 
-	*dh_sess = uadk_prov_dh_new_session(dh, bits, is_g2);
+	*dh_sess = uadk_prov_dh_get_session(dh, p, g, bits);
 	if (*dh_sess == NULL) {
 		UADK_ERR("failed to get session\n");
 		return UADK_P_FAIL;
@@ -788,7 +1141,7 @@ static int uadk_prov_dh_prepare_data(const BIGNUM *g, DH *dh, struct uadk_dh_ses
 	ret = uadk_prov_dh_prepare_prikey(*dh_sess, dh, prikey);
 	if (ret == UADK_P_FAIL) {
 		UADK_ERR("failed to get private key\n");
-		uadk_prov_dh_free_session(*dh_sess);
+		uadk_prov_dh_put_session(*dh_sess);
 	}
 
 	return ret;
@@ -797,28 +1150,7 @@ static int uadk_prov_dh_prepare_data(const BIGNUM *g, DH *dh, struct uadk_dh_ses
 static void uadk_prov_dh_free_prepare_data(struct uadk_dh_sess *dh_sess, BIGNUM *prikey)
 {
 	uadk_prov_dh_free_prikey(dh_sess, prikey);
-	uadk_prov_dh_free_session(dh_sess);
-}
-
-static int dh_set_g(const BIGNUM *g, const __u16 key_size,
-		    unsigned char *g_bin, struct uadk_dh_sess *dh_sess)
-{
-	struct wd_dtb g_dtb = {0};
-	__u32 gbytes;
-	int ret;
-
-	gbytes = BN_bn2bin(g, g_bin);
-	g_dtb.data = (char *)g_bin;
-	g_dtb.bsize = key_size;
-	g_dtb.dsize = gbytes;
-
-	ret = wd_dh_set_g(dh_sess->sess, &g_dtb);
-	if (ret) {
-		UADK_ERR("failed to set dh g\n");
-		return UADK_P_FAIL;
-	}
-
-	return UADK_P_SUCCESS;
+	uadk_prov_dh_put_session(dh_sess);
 }
 
 static int uadk_prov_dh_get_pubkey(struct uadk_dh_sess *dh_sess, BIGNUM **pubkey)
@@ -840,49 +1172,30 @@ static int uadk_prov_dh_get_pubkey(struct uadk_dh_sess *dh_sess, BIGNUM **pubkey
 	return UADK_P_SUCCESS;
 }
 
-static int uadk_prov_dh_fill_genkey_req(const BIGNUM *g, const BIGNUM *p, const BIGNUM *prikey,
-					struct uadk_dh_sess *dh_sess)
+static int uadk_prov_dh_fill_genkey_req(const BIGNUM *prikey, struct uadk_dh_sess *dh_sess)
 {
-	unsigned char *g_bin, *x_bin, *p_bin, *pri_bin;
+	unsigned char *x_bin, *p_bin, *pri_bin;
 	__u16 key_size = dh_sess->key_size;
 
-	g_bin = OPENSSL_zalloc(key_size);
-	if (g_bin == NULL) {
-		UADK_ERR("failed to alloc g_bin\n");
-		return UADK_P_FAIL;
-	}
-
 	/* x is private key, x and p will be treated together in uadk */
 	x_bin = OPENSSL_zalloc(key_size * DH_PARAMS_CNT);
 	if (x_bin == NULL) {
 		UADK_ERR("failed to alloc x_bin\n");
-		goto free_g;
+		return UADK_P_FAIL;
 	}
 	p_bin = x_bin + key_size;
 	pri_bin = p_bin + key_size;
 
-	/* Construct data block of g */
-	if (dh_set_g(g, key_size, g_bin, dh_sess) == UADK_P_FAIL)
-		goto free_x_p_pri;
-
+	/* g is already in the session and p serialised with it */
 	dh_sess->req.xbytes = BN_bn2bin(prikey, x_bin);
-	dh_sess->req.pbytes = BN_bn2bin(p, p_bin);
+	memcpy(p_bin, dh_sess->p_bin, dh_sess->pbytes);
+	dh_sess->req.pbytes = dh_sess->pbytes;
 	dh_sess->req.x_p = (void *)x_bin;
 	dh_sess->req.pri = pri_bin;
 	dh_sess->req.pri_bytes = key_size;
 	dh_sess->req.op_type = WD_DH_PHASE1;
 
-	/* Free binary g right away, free other parameters later */
-	OPENSSL_free(g_bin);
-
 	return UADK_P_SUCCESS;
-
-free_x_p_pri:
-	OPENSSL_free(x_bin);
-free_g:
-	OPENSSL_free(g_bin);
-
-	return UADK_P_FAIL;
 }
 
 static void uadk_prov_dh_free_genkey_req(struct uadk_dh_sess *dh_sess)
@@ -992,13 +1305,13 @@ static int uadk_prov_dh_generate_key(DH *dh)
 	}
 
 	/* Get session and prepare private key */
-	ret = uadk_prov_dh_prepare_data(g, dh, &dh_sess, &prikey);
+	ret = uadk_prov_dh_prepare_data(p, g, dh, &dh_sess, &prikey);
 	if (ret != UADK_P_SUCCESS) {
 		UADK_ERR("failed to prepare dh data\n");
 		return ret;
 	}
 
-	ret = uadk_prov_dh_fill_genkey_req(g, p, prikey, dh_sess);
+	ret = uadk_prov_dh_fill_genkey_req(prikey, dh_sess);
 	if (ret == UADK_P_FAIL) {
 		UADK_ERR("failed to fill req\n");
 		goto free_data;
@@ -1020,7 +1333,7 @@ static int uadk_prov_dh_generate_key(DH *dh)
 	uadk_prov_dh_set_pkey(dh, pubkey, prikey);
 
 	uadk_prov_dh_free_genkey_req(dh_sess);
-	uadk_prov_dh_free_session(dh_sess);
+	uadk_prov_dh_put_session(dh_sess);
 
 	return UADK_P_SUCCESS;
 
@@ -1560,16 +1873,20 @@ static int uadk_keyexch_dh_set_peer(void *dhctx, void *dh)
 	return UADK_P_SUCCESS;
 }
 
-static int uadk_prov_dh_fill_compkey_req(const BIGNUM *g, const BIGNUM *p,
-					 const BIGNUM *prikey, const BIGNUM *pubkey,
+static int uadk_prov_dh_fill_compkey_req(const BIGNUM *prikey, const BIGNUM *pubkey,
 					 struct uadk_dh_sess *dh_sess)
 {
-	unsigned char *x_bin, *p_bin, *g_bin, *out_pri;
+	unsigned char *x_bin, *p_bin, *pv_bin, *out_pri;
 	__u16 key_size = dh_sess->key_size;
 
-	g_bin = OPENSSL_zalloc(key_size);
-	if (g_bin == NULL) {
-		UADK_ERR("failed to alloc g\n");
+	if (BN_num_bytes(pubkey) > key_size) {
+		UADK_ERR("invalid: peer key is longer than p\n");
+		return UADK_P_FAIL;
+	}
+
+	pv_bin = OPENSSL_zalloc(key_size);
+	if (pv_bin == NULL) {
+		UADK_ERR("failed to alloc pv\n");
 		return UADK_P_FAIL;
 	}
 
@@ -1577,34 +1894,26 @@ static int uadk_prov_dh_fill_compkey_req(const BIGNUM *g, const BIGNUM *p,
 	x_bin = OPENSSL_zalloc(key_size * DH_PARAMS_CNT);
 	if (x_bin == NULL) {
 		UADK_ERR("failed to alloc x_bin\n");
-		goto free_g;
+		OPENSSL_free(pv_bin);
+		return UADK_P_FAIL;
 	}
 
 	p_bin = x_bin + key_size;
 	out_pri = p_bin + key_size;
 
-	/* Construct data block of g */
-	if (dh_set_g(g, key_size, g_bin, dh_sess) == UADK_P_FAIL)
-		goto free_priv;
-
+	/* g is already in the session and p serialised with it */
 	dh_sess->req.x_p = x_bin;
 	dh_sess->req.xbytes = BN_bn2bin(prikey, x_bin);
-	dh_sess->req.pbytes = BN_bn2bin(p, p_bin);
+	memcpy(p_bin, dh_sess->p_bin, dh_sess->pbytes);
+	dh_sess->req.pbytes = dh_sess->pbytes;
 
-	dh_sess->req.pv = g_bin;
-	dh_sess->req.pvbytes = BN_bn2bin(pubkey, g_bin);
+	dh_sess->req.pv = pv_bin;
+	dh_sess->req.pvbytes = BN_bn2bin(pubkey, pv_bin);
 	dh_sess->req.pri = out_pri;
 	dh_sess->req.pri_bytes = key_size;
 	dh_sess->req.op_type = WD_DH_PHASE2;
 
 	return UADK_P_SUCCESS;
-
-free_priv:
-	OPENSSL_free(x_bin);
-free_g:
-	OPENSSL_free(g_bin);
-
-	return UADK_P_FAIL;
 }
 
 static void uadk_prov_dh_free_compkey_req(struct uadk_dh_sess *dh_sess)
@@ -1650,13 +1959,13 @@ static int uadk_dh_compute_key(unsigned char *key, const BIGNUM *pubkey, DH *dh)
 		return UADK_DO_SOFT;
 	}
 
-	ret = uadk_prov_dh_prepare_data(g, dh, &dh_sess, &prikey);
+	ret = uadk_prov_dh_prepare_data(p, g, dh, &dh_sess, &prikey);
 	if (ret != UADK_P_SUCCESS) {
 		UADK_ERR("failed to prepare dh data\n");
 		return ret;
 	}
 
-	ret = uadk_prov_dh_fill_compkey_req(g, p, prikey, pubkey, dh_sess);
+	ret = uadk_prov_dh_fill_compkey_req(prikey, pubkey, dh_sess);
 	if (ret == UADK_P_FAIL) {
 		UADK_ERR("failed to fill req\n");
 		goto free_data;
@@ -1673,7 +1982,7 @@ static int uadk_dh_compute_key(unsigned char *key, const BIGNUM *pubkey, DH *dh)
 	ret = dh_sess->req.pri_bytes;
 	uadk_prov_dh_free_compkey_req(dh_sess);
 	/* key will be used by user, do not free it here */
-	uadk_prov_dh_free_session(dh_sess);
+	uadk_prov_dh_put_session(dh_sess);
 
 	return ret;
 
@@ -82,6 +82,7 @@ struct digest_priv_ctx {
 	unsigned char out[MAX_DIGEST_LENGTH];
 	EVP_MD_CTX *soft_ctx;
 	EVP_MD *soft_md;
+	UADK_PROV_CTX *provctx;
 	size_t last_update_bufflen;
 	uint32_t e_nid;
 	uint32_t state;
@@ -92,6 +93,9 @@ struct digest_priv_ctx {
 	char alg_name[ALG_NAME_SIZE];
 	size_t total_data_len;
 	bool is_stream_copy;
+	/* shared with duplicated ctxs until either side changes them */
+	int *sess_refs;
+	int *data_refs;
 };
 
 struct digest_info {
@@ -123,19 +127,6 @@ static struct digest_info digest_info_table[] = {
 	32, SHA_SMALL_PACKET_OFFLOAD_THRESHOLD_DEFAULT},
 };
 
-# if OPENSSL_VERSION_NUMBER <= 0x30200000L
-static EVP_MD_CTX *EVP_MD_CTX_dup(const EVP_MD_CTX *in)
-{
-	EVP_MD_CTX *out = EVP_MD_CTX_new();
-
-	if (out != NULL && !EVP_MD_CTX_copy_ex(out, in)) {
-		EVP_MD_CTX_free(out);
-		out = NULL;
-	}
-	return out;
-}
-# endif
-
 static int uadk_create_digest_soft_ctx(struct digest_priv_ctx *priv)
 {
 	if (priv->soft_md)
@@ -143,33 +134,31 @@ static int uadk_create_digest_soft_ctx(struct digest_priv_ctx *priv)
 
 	switch (priv->e_nid) {
 	case NID_sm3:
-		priv->soft_md = EVP_MD_fetch(NULL, OSSL_DIGEST_NAME_SM3, "provider=default");
+		priv->soft_md = uadk_prov_soft_md(priv->provctx, OSSL_DIGEST_NAME_SM3);
 		break;
 	case NID_md5:
-		priv->soft_md = EVP_MD_fetch(NULL, OSSL_DIGEST_NAME_MD5, "provider=default");
+		priv->soft_md = uadk_prov_soft_md(priv->provctx, OSSL_DIGEST_NAME_MD5);
 		break;
 	case NID_sha1:
-		priv->soft_md = EVP_MD_fetch(NULL, OSSL_DIGEST_NAME_SHA1, "provider=default");
+		priv->soft_md = uadk_prov_soft_md(priv->provctx, OSSL_DIGEST_NAME_SHA1);
 		break;
 	case NID_sha224:
-		priv->soft_md = EVP_MD_fetch(NULL, OSSL_DIGEST_NAME_SHA2_224, "provider=default");
+		priv->soft_md = uadk_prov_soft_md(priv->provctx, OSSL_DIGEST_NAME_SHA2_224);
 		break;
 	case NID_sha256:
-		priv->soft_md = EVP_MD_fetch(NULL, OSSL_DIGEST_NAME_SHA2_256, "provider=default");
+		priv->soft_md = uadk_prov_soft_md(priv->provctx, OSSL_DIGEST_NAME_SHA2_256);
 		break;
 	case NID_sha384:
-		priv->soft_md = EVP_MD_fetch(NULL, OSSL_DIGEST_NAME_SHA2_384, "provider=default");
+		priv->soft_md = uadk_prov_soft_md(priv->provctx, OSSL_DIGEST_NAME_SHA2_384);
 		break;
 	case NID_sha512:
-		priv->soft_md = EVP_MD_fetch(NULL, OSSL_DIGEST_NAME_SHA2_512, "provider=default");
+		priv->soft_md = uadk_prov_soft_md(priv->provctx, OSSL_DIGEST_NAME_SHA2_512);
 		break;
 	case NID_sha512_224:
-		priv->soft_md = EVP_MD_fetch(NULL, OSSL_DIGEST_NAME_SHA2_512_224,
-					     "provider=default");
+		priv->soft_md = uadk_prov_soft_md(priv->provctx, OSSL_DIGEST_NAME_SHA2_512_224);
 		break;
 	case NID_sha512_256:
-		priv->soft_md = EVP_MD_fetch(NULL, OSSL_DIGEST_NAME_SHA2_512_256,
-					     "provider=default");
+		priv->soft_md = uadk_prov_soft_md(priv->provctx, OSSL_DIGEST_NAME_SHA2_512_256);
 		break;
 	default:
 		break;
@@ -385,6 +374,40 @@ free_nodemask:
 	return ret;
 }
 
+/* Take a private copy of the buffer before writing to it. */
+static int uadk_digest_own_data(struct digest_priv_ctx *priv)
+{
+	unsigned char *data;
+
+	if (!uadk_prov_ref_shared(priv->data_refs)) {
+		uadk_prov_ref_drop(&priv->data_refs);
+		return UADK_DIGEST_SUCCESS;
+	}
+
+	data = OPENSSL_malloc(DIGEST_BLOCK_SIZE);
+	if (!data) {
+		UADK_ERR("failed to copy shared digest data.\n");
+		return UADK_DIGEST_FAIL;
+	}
+
+	memcpy(data, priv->data, priv->last_update_bufflen);
+	if (uadk_prov_ref_drop(&priv->data_refs))
+		OPENSSL_clear_free(priv->data, DIGEST_BLOCK_SIZE);
+	priv->data = data;
+
+	return UADK_DIGEST_SUCCESS;
+}
+
+/*
+ * A shared session is only used for single requests, a stream keeps its
+ * state in the session so needs one of its own.
+ */
+static void uadk_digest_own_sess(struct digest_priv_ctx *priv)
+{
+	if (!uadk_prov_ref_drop(&priv->sess_refs))
+		priv->sess = 0;
+}
+
 static int uadk_digest_ctx_init(struct digest_priv_ctx *priv)
 {
 	struct wd_digest_sess_setup setup = {0};
@@ -452,6 +475,7 @@ static int uadk_digest_update_inner(struct digest_priv_ctx *priv, const void *da
 	size_t processing_len;
 	int ret;
 
+	uadk_digest_own_sess(priv);
 	ret = uadk_digest_ctx_init(priv);
 	if (ret != UADK_DIGEST_SUCCESS)
 		return UADK_DIGEST_FAIL;
@@ -548,6 +572,9 @@ static int uadk_digest_update(struct digest_priv_ctx *priv, const void *data, si
 	if (unlikely(priv->switch_flag == UADK_DO_SOFT))
 		goto soft_update;
 
+	if (unlikely(priv->data_refs) && !uadk_digest_own_data(priv))
+		return UADK_DIGEST_FAIL;
+
 	priv->total_data_len += data_len;
 
 	if (priv->last_update_bufflen + data_len <= DIGEST_BLOCK_SIZE) {
@@ -744,10 +771,10 @@ static int uadk_digest_digest(struct digest_priv_ctx *priv, const void *data,
 
 static void uadk_digest_cleanup(struct digest_priv_ctx *priv)
 {
-	if (priv->sess)
+	if (uadk_prov_ref_drop(&priv->sess_refs) && priv->sess)
 		wd_digest_free_sess(priv->sess);
 
-	if (priv->data)
+	if (uadk_prov_ref_drop(&priv->data_refs) && priv->data)
 		OPENSSL_clear_free(priv->data, DIGEST_BLOCK_SIZE);
 
 	digest_soft_cleanup(priv);
@@ -821,15 +848,26 @@ static void uadk_prov_freectx(void *dctx)
 static void *uadk_prov_dupctx(void *dctx)
 {
 	struct digest_priv_ctx *dst_ctx, *src_ctx;
+	bool share_sess;
 	int ret;
 
 	src_ctx = (struct digest_priv_ctx *)dctx;
 	if (!dctx)
 		return NULL;
 
+	/*
+	 * Transcript hashing duplicates the ctx for every handshake message,
+	 * so the buffer and an idle session are shared rather than copied.
+	 */
+	if (!uadk_prov_ref_share(&src_ctx->data_refs))
+		return NULL;
+
+	share_sess = src_ctx->sess && src_ctx->state == SEC_DIGEST_INIT &&
+		     uadk_prov_ref_share(&src_ctx->sess_refs);
+
 	dst_ctx = OPENSSL_memdup(src_ctx, sizeof(struct digest_priv_ctx));
 	if (!dst_ctx)
-		return NULL;
+		goto drop_refs;
 
 	/*
 	 * When a copy is performed during digest execution,
@@ -845,16 +883,16 @@ static void *uadk_prov_dupctx(void *dctx)
 					     dst_ctx->last_update_bufflen;
 	}
 
-	dst_ctx->sess = 0;
-	dst_ctx->data = OPENSSL_memdup(src_ctx->data, DIGEST_BLOCK_SIZE);
-	if (!dst_ctx->data)
-		goto free_ctx;
+	if (!share_sess) {
+		dst_ctx->sess = 0;
+		dst_ctx->sess_refs = NULL;
+	}
 
 	if (dst_ctx->soft_ctx) {
 		dst_ctx->soft_ctx = EVP_MD_CTX_dup(src_ctx->soft_ctx);
 		if (!dst_ctx->soft_ctx) {
 			UADK_ERR("EVP_MD_CTX_new failed in ctx copy.\n");
-			goto free_data;
+			goto free_ctx;
 		}
 
 		ret = EVP_MD_up_ref(dst_ctx->soft_md);
@@ -867,10 +905,13 @@ static void *uadk_prov_dupctx(void *dctx)
 free_dup:
 	if (dst_ctx->soft_ctx)
 		EVP_MD_CTX_free(dst_ctx->soft_ctx);
-free_data:
-	OPENSSL_clear_free(dst_ctx->data, DIGEST_BLOCK_SIZE);
 free_ctx:
 	OPENSSL_clear_free(dst_ctx, sizeof(*dst_ctx));
+drop_refs:
+	/* src keeps the objects, it still holds a reference */
+	if (share_sess)
+		__atomic_sub_fetch(src_ctx->sess_refs, 1, __ATOMIC_RELAXED);
+	__atomic_sub_fetch(src_ctx->data_refs, 1, __ATOMIC_RELAXED);
 	return NULL;
 }
 
@@ -1002,6 +1043,7 @@ static void *uadk_##name##_newctx(void *provctx)				\
 	}									\
 										\
 	ctx->blk_size = blksize;						\
+	ctx->provctx = provctx;							\
 	ctx->md_size = mdsize;							\
 	ctx->e_nid = nid;							\
 	strncpy(ctx->alg_name, #name, ALG_NAME_SIZE - 1);			\
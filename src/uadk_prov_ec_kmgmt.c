@@ -23,6 +23,7 @@
 #include "uadk_async.h"
 #include "uadk_prov.h"
 #include "uadk_prov_pkey.h"
+#include "uadk_prov_pool.h"
 #include "uadk_utils.h"
 
 #define UADK_PROV_ECC_PADDING		7
@@ -280,6 +281,96 @@ free_sess:
 	return ret;
 }
 
+static size_t ec_keypair_pub_len(const EC_GROUP *group)
+{
+	return 1 + ECC_POINT_SIZE((EC_GROUP_get_degree(group) + UADK_PROV_ECC_PADDING) >>
+				  TRANS_BITS_BYTES_SHIFT);
+}
+
+/* private key padded to the order, then the uncompressed public point */
+size_t uadk_prov_ec_keypair_size(int nid)
+{
+	EC_GROUP *group;
+	size_t size = 0;
+
+	group = EC_GROUP_new_by_curve_name(nid);
+	if (!group)
+		return 0;
+
+	if (EC_METHOD_get_field_type(EC_GROUP_method_of(group)) == NID_X9_62_prime_field &&
+	    uadk_prov_ecc_bit_check(group) == UADK_P_SUCCESS)
+		size = BN_num_bytes(EC_GROUP_get0_order(group)) + ec_keypair_pub_len(group);
+	EC_GROUP_free(group);
+
+	return size;
+}
+
+int uadk_prov_ec_keypair_fill(void *arg, unsigned char *item, size_t size)
+{
+	const EC_GROUP *group;
+	int ret = UADK_P_FAIL;
+	size_t priv_len;
+	EC_KEY *ec;
+
+	ec = EC_KEY_new_by_curve_name((int)(intptr_t)arg);
+	if (!ec)
+		return UADK_P_FAIL;
+
+	if (ec_hw_keygen(ec, NULL) != UADK_P_SUCCESS)
+		goto free_ec_key;
+
+	group = EC_KEY_get0_group(ec);
+	priv_len = BN_num_bytes(EC_GROUP_get0_order(group));
+	if (BN_bn2binpad(EC_KEY_get0_private_key(ec), item, priv_len) < 0 ||
+	    EC_POINT_point2oct(group, EC_KEY_get0_public_key(ec), POINT_CONVERSION_UNCOMPRESSED,
+			       item + priv_len, size - priv_len, NULL) != size - priv_len)
+		goto free_ec_key;
+
+	ret = UADK_P_SUCCESS;
+
+free_ec_key:
+	/* the private key is cleared as it goes */
+	EC_KEY_free(ec);
+	return ret;
+}
+
+/* an ephemeral key pair made ahead of time, when the curve has a pool */
+static int ec_keypool_get(struct ec_gen_ctx *gctx, EC_KEY *ec)
+{
+	unsigned char item[UADK_ECC_MAX_KEY_BYTES + UADK_ECC_SESS_KEY_BYTES];
+	const EC_GROUP *group = EC_KEY_get0_group(ec);
+	struct uadk_prov_pool *pool;
+	BIGNUM *priv_key = NULL;
+	EC_POINT *point = NULL;
+	int ret = UADK_P_FAIL;
+	size_t priv_len;
+
+	if (gctx->priv_key || gctx->dhkem_ikm)
+		return UADK_P_FAIL;
+
+	pool = uadk_prov_keypool_find(EC_GROUP_get_curve_name(group));
+	if (!pool || !uadk_prov_pool_get(pool, item))
+		return UADK_P_FAIL;
+
+	priv_len = BN_num_bytes(EC_GROUP_get0_order(group));
+	priv_key = BN_secure_new();
+	point = EC_POINT_new(group);
+	if (!priv_key || !point || !BN_bin2bn(item, priv_len, priv_key) ||
+	    !EC_POINT_oct2point(group, point, item + priv_len, ec_keypair_pub_len(group), NULL) ||
+	    !EC_KEY_set_private_key(ec, priv_key) || !EC_KEY_set_public_key(ec, point)) {
+		UADK_ERR("failed to set key pair from pool\n");
+		goto out;
+	}
+
+	ret = UADK_P_SUCCESS;
+
+out:
+	OPENSSL_cleanse(item, sizeof(item));
+	EC_POINT_free(point);
+	BN_clear_free(priv_key);
+	return ret;
+}
+
 static int ec_set_cofactor_mode(EC_KEY *ec, int mode)
 {
 	const EC_GROUP *group = EC_KEY_get0_group(ec);
@@ -376,7 +467,9 @@ static void *uadk_keymgmt_ec_gen(void *genctx, OSSL_CALLBACK *osslcb, void *cbar
 
 	/* Whether you want it or not, you get a keypair, not just one half */
 	if ((gctx->selection & OSSL_KEYMGMT_SELECT_KEYPAIR) != 0) {
-		ret = ec_hw_keygen(ec, gctx->priv_key);
+		ret = ec_keypool_get(gctx, ec);
+		if (ret != UADK_P_SUCCESS)
+			ret = ec_hw_keygen(ec, gctx->priv_key);
 		if (ret != UADK_P_SUCCESS) {
 			UADK_ERR("failed to gen public key!\n");
 			goto free_ec_key;
@@ -182,28 +182,27 @@ static int ecdh_set_privk(struct ecdh_ctx *pecdhctx,
 	return UADK_P_SUCCESS;
 }
 
-static handle_t ecdh_alloc_sess(EC_KEY *privk)
+static struct uadk_ecc_sess *ecdh_get_sess(EC_KEY *privk)
 {
+	struct uadk_ecc_sess_cfg cfg = {0};
 	int ret;
 
 	ret = uadk_prov_keyexch_get_support_state(KEYEXCH_ECDH);
 	if (!ret) {
 		UADK_ERR("invalid: hardware not support ecdh!\n");
-		return UADK_P_FAIL;
+		return NULL;
 	}
 
 	ret = uadk_prov_ecc_init("ecdh");
 	if (!ret) {
 		UADK_ERR("failed to init ecdh to compute key!\n");
-		return UADK_P_FAIL;
+		return NULL;
 	}
 
-	return uadk_prov_ecc_alloc_sess(privk, "ecdh");
-}
+	cfg.alg = "ecdh";
+	cfg.key_type = UADK_ECC_SESS_PRIKEY;
 
-static void ecdh_free_sess(handle_t sess)
-{
-	wd_ecc_free_sess(sess);
+	return uadk_prov_ecc_get_sess(privk, &cfg);
 }
 
 static int ecdh_init_req(struct ecdh_sess_ctx *sess_ctx,
@@ -297,21 +296,17 @@ static int ecdh_compute_key(struct ecdh_sess_ctx *sess_ctx,
 			    unsigned char *secret,
 			    size_t *psecretlen, size_t size)
 {
+	struct uadk_ecc_sess *ecc_sess;
 	struct wd_ecc_req req = {0};
 	handle_t sess;
 	int ret;
 
-	sess = ecdh_alloc_sess(sess_ctx->privk);
-	if (!sess) {
+	ecc_sess = ecdh_get_sess(sess_ctx->privk);
+	if (!ecc_sess) {
 		UADK_ERR("failed to alloc sess to compute key!\n");
 		return UADK_DO_SOFT;
 	}
-
-	ret = uadk_prov_ecc_set_private_key(sess, sess_ctx->privk);
-	if (!ret) {
-		UADK_ERR("failed to set private key!\n");
-		goto free_sess;
-	}
+	sess = ecc_sess->sess;
 
 	ret = ecdh_init_req(sess_ctx, &req, sess);
 	if (!ret) {
@@ -331,7 +326,7 @@ static int ecdh_compute_key(struct ecdh_sess_ctx *sess_ctx,
 uninit_req:
 	ecdh_uninit_req(&req, sess);
 free_sess:
-	ecdh_free_sess(sess);
+	uadk_prov_ecc_put_sess(ecc_sess, ret == UADK_P_SUCCESS);
 	return ret;
 }
 
@@ -23,6 +23,7 @@
 #include "uadk_prov.h"
 #include "uadk_prov_der_writer.h"
 #include "uadk_prov_pkey.h"
+#include "uadk_prov_pool.h"
 #include "uadk_utils.h"
 
 #define DIGEST_MAX_NAME_SIZE		50
@@ -415,28 +416,27 @@ static int ecdsa_common_params_check(struct ecdsa_ctx *ctx,
 	return uadk_prov_ecc_bit_check(group);
 }
 
-static handle_t ecdsa_alloc_sess(EC_KEY *ec)
+static struct uadk_ecc_sess *ecdsa_get_sess(EC_KEY *ec, int key_type)
 {
+	struct uadk_ecc_sess_cfg cfg = {0};
 	int ret;
 
 	ret = uadk_prov_signature_get_support_state(SIGNATURE_ECDSA);
 	if (!ret) {
 		UADK_ERR("failed to get hardware ecdsa support!\n");
-		return ret;
+		return NULL;
 	}
 
 	ret = uadk_prov_ecc_init(UADK_PROV_ECDSA);
 	if (!ret) {
 		UADK_ERR("failed to init ecdsa!\n");
-		return ret;
+		return NULL;
 	}
 
-	return uadk_prov_ecc_alloc_sess(ec, UADK_PROV_ECDSA);
-}
+	cfg.alg = UADK_PROV_ECDSA;
+	cfg.key_type = key_type;
 
-static void ecdsa_free_sess(handle_t sess)
-{
-	wd_ecc_free_sess(sess);
+	return uadk_prov_ecc_get_sess(ec, &cfg);
 }
 
 static bool ecdsa_data_is_all_zero(struct wd_dtb *e)
@@ -592,15 +592,17 @@ free_bn:
 
 static int ecdsa_hw_sign(struct ecdsa_opdata *opdata)
 {
+	struct uadk_ecc_sess *ecc_sess;
 	struct wd_ecc_req req = {0};
 	handle_t sess;
 	int ret;
 
-	sess = ecdsa_alloc_sess(opdata->ec);
-	if (unlikely(!sess)) {
+	ecc_sess = ecdsa_get_sess(opdata->ec, UADK_ECC_SESS_PRIKEY);
+	if (unlikely(!ecc_sess)) {
 		UADK_ERR("failed to alloc ecdsa sess!\n");
 		return UADK_DO_SOFT;
 	}
+	sess = ecc_sess->sess;
 
 	ret = ecdsa_sign_init_iot(sess, &req, opdata);
 	if (unlikely(!ret)) {
@@ -608,12 +610,6 @@ static int ecdsa_hw_sign(struct ecdsa_opdata *opdata)
 		goto free_sess;
 	}
 
-	ret = uadk_prov_ecc_set_private_key(sess, opdata->ec);
-	if (unlikely(!ret)) {
-		UADK_ERR("failed to set private key!\n");
-		goto free_iot;
-	}
-
 	ret = uadk_prov_ecc_crypto(sess, &req, (void *)sess);
 	if (unlikely(!ret || req.status)) {
 		UADK_ERR("failed to hardware sign!\n");
@@ -628,10 +624,125 @@ static int ecdsa_hw_sign(struct ecdsa_opdata *opdata)
 free_iot:
 	ecdsa_uninit_req_iot(sess, &req);
 free_sess:
-	ecdsa_free_sess(sess);
+	uadk_prov_ecc_put_sess(ecc_sess, ret == UADK_P_SUCCESS);
+	return ret;
+}
+
+/* k^-1 then r, each padded to the order */
+size_t uadk_prov_ecdsa_precomp_size(int nid)
+{
+	EC_GROUP *group;
+	size_t size = 0;
+
+	if (!uadk_prov_ec_keypair_size(nid))
+		return 0;
+
+	group = EC_GROUP_new_by_curve_name(nid);
+	if (group)
+		size = ECC_POINT_SIZE(BN_num_bytes(EC_GROUP_get0_order(group)));
+	EC_GROUP_free(group);
+
+	return size;
+}
+
+int uadk_prov_ecdsa_precomp_fill(void *arg, unsigned char *item, size_t size)
+{
+	unsigned char keypair[UADK_ECC_MAX_KEY_BYTES + UADK_ECC_SESS_KEY_BYTES];
+	size_t keypair_len, order_len, field_len;
+	BIGNUM *k, *kinv, *r, *exp;
+	const BIGNUM *order;
+	BN_CTX *bnctx = NULL;
+	int ret = UADK_P_FAIL;
+	EC_GROUP *group;
+
+	keypair_len = uadk_prov_ec_keypair_size((int)(intptr_t)arg);
+	group = EC_GROUP_new_by_curve_name((int)(intptr_t)arg);
+	if (!keypair_len || keypair_len > sizeof(keypair) || !group)
+		goto free_group;
+
+	order = EC_GROUP_get0_order(group);
+	order_len = BN_num_bytes(order);
+	field_len = (keypair_len - order_len - 1) >> 1;
+	if (size != ECC_POINT_SIZE(order_len))
+		goto free_group;
+
+	bnctx = BN_CTX_secure_new();
+	if (!bnctx)
+		goto free_group;
+
+	BN_CTX_start(bnctx);
+	k = BN_CTX_get(bnctx);
+	kinv = BN_CTX_get(bnctx);
+	r = BN_CTX_get(bnctx);
+	exp = BN_CTX_get(bnctx);
+	if (!exp)
+		goto end_ctx;
+
+	/* k and k * G come from the accelerator as an ephemeral key pair */
+	if (uadk_prov_ec_keypair_fill(arg, keypair, keypair_len) != UADK_P_SUCCESS)
+		goto end_ctx;
+
+	/* r = x(k * G) mod n, k^-1 = k^(n - 2) mod n as n is prime */
+	BN_set_flags(k, BN_FLG_CONSTTIME);
+	if (!BN_bin2bn(keypair, order_len, k) ||
+	    !BN_bin2bn(keypair + order_len + 1, field_len, r) ||
+	    !BN_nnmod(r, r, order, bnctx) || BN_is_zero(r) ||
+	    !BN_copy(exp, order) || !BN_sub_word(exp, 2) ||
+	    !BN_mod_exp_mont_consttime(kinv, k, exp, order, bnctx, NULL) ||
+	    BN_bn2binpad(kinv, item, order_len) < 0 ||
+	    BN_bn2binpad(r, item + order_len, order_len) < 0)
+		goto end_ctx;
+
+	ret = UADK_P_SUCCESS;
+
+end_ctx:
+	OPENSSL_cleanse(keypair, sizeof(keypair));
+	/* the secure ctx clears k and k^-1 as it goes */
+	BN_CTX_end(bnctx);
+	BN_CTX_free(bnctx);
+free_group:
+	EC_GROUP_free(group);
 	return ret;
 }
 
+/*
+ * A signature with a nonce made ahead of time, when the curve has a pool:
+ * what is left online is s = k^-1 * (e + r * d) mod n. Each (k^-1, r) is
+ * taken out of the pool once and wiped here, whether it signs or not.
+ */
+static int ecdsa_precomp_sign(struct ecdsa_opdata *opdata)
+{
+	unsigned char item[ECC_POINT_SIZE(UADK_ECC_MAX_KEY_BYTES)];
+	const EC_GROUP *group = EC_KEY_get0_group(opdata->ec);
+	struct uadk_prov_pool *pool;
+	BIGNUM *kinv, *r;
+	size_t order_len;
+
+	pool = uadk_prov_ecdsa_pool_find(EC_GROUP_get_curve_name(group));
+	if (!pool || !uadk_prov_pool_get(pool, item))
+		return UADK_P_FAIL;
+
+	order_len = BN_num_bytes(EC_GROUP_get0_order(group));
+	kinv = BN_secure_new();
+	r = BN_new();
+	if (kinv && r && BN_bin2bn(item, order_len, kinv) &&
+	    BN_bin2bn(item + order_len, order_len, r)) {
+		/* s = 0 needs a new nonce, the accelerator makes one below */
+		ERR_set_mark();
+		opdata->sig = ECDSA_do_sign_ex(opdata->tbs, opdata->tbslen, kinv, r, opdata->ec);
+		if (!opdata->sig)
+			ERR_pop_to_mark();
+		else
+			ERR_clear_last_mark();
+	}
+
+	OPENSSL_cleanse(item, sizeof(item));
+	BN_clear_free(kinv);
+	BN_free(r);
+
+	return opdata->sig ? UADK_P_SUCCESS : UADK_P_FAIL;
+}
+
 static int ecdsa_sign_params_check(struct ecdsa_ctx *ctx,
 				   struct ecdsa_opdata *opdata,
 				   unsigned char *sig, size_t *siglen,
@@ -681,7 +792,9 @@ static int uadk_signature_ecdsa_sign(void *vctx, unsigned char *sig, size_t *sig
 		goto err;
 	}
 
-	ret = ecdsa_hw_sign(&opdata);
+	ret = ecdsa_precomp_sign(&opdata);
+	if (ret != UADK_P_SUCCESS)
+		ret = ecdsa_hw_sign(&opdata);
 	if (unlikely(ret != UADK_P_SUCCESS))
 		goto err;
 	ret = i2d_ECDSA_SIG(opdata.sig, &sig);
@@ -742,34 +855,31 @@ static int ecdsa_verify_init_iot(handle_t sess, struct wd_ecc_req *req,
 
 static int ecdsa_hw_verify(struct ecdsa_opdata *opdata)
 {
+	struct uadk_ecc_sess *ecc_sess;
 	struct wd_ecc_req req = {0};
 	handle_t sess;
 	int ret;
 
-	sess = ecdsa_alloc_sess(opdata->ec);
-	if (unlikely(!sess)) {
+	ecc_sess = ecdsa_get_sess(opdata->ec, UADK_ECC_SESS_PUBKEY);
+	if (unlikely(!ecc_sess)) {
 		UADK_ERR("failed to alloc ecdsa sess!\n");
 		return UADK_DO_SOFT;
 	}
+	sess = ecc_sess->sess;
 
 	ret = ecdsa_verify_init_iot(sess, &req, opdata);
 	if (unlikely(!ret))
 		goto free_sess;
 
-	ret = uadk_prov_ecc_set_public_key(sess, opdata->ec);
-	if (unlikely(!ret))
-		goto free_iot;
-
 	ret = uadk_prov_ecc_crypto(sess, &req, (void *)sess);
 	if (unlikely(ret != UADK_P_SUCCESS || req.status)) {
 		UADK_ERR("failed to hardware verify!\n");
 		ret = UADK_DO_SOFT;
 	}
 
-free_iot:
 	ecdsa_uninit_req_iot(sess, &req);
 free_sess:
-	ecdsa_free_sess(sess);
+	uadk_prov_ecc_put_sess(ecc_sess, ret == UADK_P_SUCCESS);
 	return ret;
 }
 
@@ -858,6 +968,134 @@ err:
 	return ret;
 }
 
+static int ecdsa_batch_sign_prepare(void *vctx, handle_t sess,
+				    struct uadk_prov_batch_item *item,
+				    struct wd_ecc_req *req)
+{
+	struct ecdsa_ctx *ctx = (struct ecdsa_ctx *)vctx;
+	struct ecdsa_opdata opdata = {0};
+
+	opdata.tbs = item->tbs;
+	opdata.tbslen = item->tbslen;
+	if (item->siglen < (size_t)ECDSA_size(ctx->ec) ||
+	    ecdsa_common_params_check(ctx, &opdata) != UADK_P_SUCCESS)
+		return UADK_P_FAIL;
+
+	return ecdsa_sign_init_iot(sess, req, &opdata);
+}
+
+static int ecdsa_batch_sign_finish(void *vctx, struct uadk_prov_batch_item *item,
+				   struct wd_ecc_req *req)
+{
+	unsigned char *sig = item->sig;
+	ECDSA_SIG *s;
+	int ret;
+
+	if (req->status)
+		return UADK_DO_SOFT;
+
+	s = ecdsa_get_sign_data(req);
+	if (!s)
+		return UADK_P_FAIL;
+
+	ret = i2d_ECDSA_SIG(s, &sig);
+	ECDSA_SIG_free(s);
+	if (ret < 0)
+		return UADK_P_FAIL;
+
+	item->siglen = (size_t)ret;
+	item->status = 1;
+
+	return UADK_P_SUCCESS;
+}
+
+static int ecdsa_batch_sign_single(void *vctx, struct uadk_prov_batch_item *item)
+{
+	size_t sigsize = item->siglen;
+
+	return uadk_signature_ecdsa_sign(vctx, item->sig, &item->siglen, sigsize,
+					 item->tbs, item->tbslen) > 0;
+}
+
+static int ecdsa_batch_verify_prepare(void *vctx, handle_t sess,
+				      struct uadk_prov_batch_item *item,
+				      struct wd_ecc_req *req)
+{
+	struct ecdsa_ctx *ctx = (struct ecdsa_ctx *)vctx;
+	struct ecdsa_opdata opdata = {0};
+	int ret;
+
+	opdata.tbs = item->tbs;
+	opdata.tbslen = item->tbslen;
+	if (!item->siglen || ecdsa_common_params_check(ctx, &opdata) != UADK_P_SUCCESS)
+		return UADK_P_FAIL;
+
+	opdata.sig = ecdsa_create_sig(item->sig, item->siglen);
+	if (!opdata.sig)
+		return UADK_P_FAIL;
+
+	ret = ecdsa_verify_init_iot(sess, req, &opdata);
+	ECDSA_SIG_free(opdata.sig);
+
+	return ret;
+}
+
+static int ecdsa_batch_verify_finish(void *vctx, struct uadk_prov_batch_item *item,
+				     struct wd_ecc_req *req)
+{
+	/* as in ecdsa_hw_verify, a mismatch is left to the soft verification */
+	if (req->status)
+		return UADK_DO_SOFT;
+
+	item->status = 1;
+
+	return UADK_P_SUCCESS;
+}
+
+static int ecdsa_batch_verify_single(void *vctx, struct uadk_prov_batch_item *item)
+{
+	return uadk_signature_ecdsa_verify(vctx, item->sig, item->siglen,
+					   item->tbs, item->tbslen) > 0;
+}
+
+static const struct uadk_ecc_batch_ops ecdsa_batch_sign_ops = {
+	.prepare = ecdsa_batch_sign_prepare,
+	.finish = ecdsa_batch_sign_finish,
+	.release = ecdsa_uninit_req_iot,
+	.single = ecdsa_batch_sign_single,
+};
+
+static const struct uadk_ecc_batch_ops ecdsa_batch_verify_ops = {
+	.prepare = ecdsa_batch_verify_prepare,
+	.finish = ecdsa_batch_verify_finish,
+	.release = ecdsa_uninit_req_iot,
+	.single = ecdsa_batch_verify_single,
+};
+
+static int ecdsa_batch(struct ecdsa_ctx *ctx, struct uadk_prov_batch *batch)
+{
+	int sign = batch->op == UADK_PROV_BATCH_SIGN;
+	struct uadk_ecc_sess *ecc_sess;
+	handle_t sess = 0;
+	int ret;
+
+	if (!ctx->ec) {
+		UADK_ERR("invalid: ec is NULL to batch!\n");
+		return UADK_P_FAIL;
+	}
+
+	/* no session sends every item through the single shot path */
+	ecc_sess = ecdsa_get_sess(ctx->ec, sign ? UADK_ECC_SESS_PRIKEY : UADK_ECC_SESS_PUBKEY);
+	if (ecc_sess)
+		sess = ecc_sess->sess;
+
+	ret = uadk_prov_ecc_batch(ctx, sess, batch,
+				  sign ? &ecdsa_batch_sign_ops : &ecdsa_batch_verify_ops);
+	uadk_prov_ecc_put_sess(ecc_sess, ret == UADK_P_SUCCESS);
+
+	return ret;
+}
+
 static int ecdsa_digest_singverify_init(void *vctx, const char *mdname, void *ec,
 					const OSSL_PARAM params[], int operation)
 {
@@ -1015,6 +1253,7 @@ static int ecdsa_get_ctx_digest(struct ecdsa_ctx *ctx, OSSL_PARAM *params)
 static int uadk_signature_ecdsa_get_ctx_params(void *vctx, OSSL_PARAM *params)
 {
 	struct ecdsa_ctx *ctx = (struct ecdsa_ctx *)vctx;
+	struct uadk_prov_batch *batch;
 	int ret;
 
 	if (!ctx) {
@@ -1033,13 +1272,28 @@ static int uadk_signature_ecdsa_get_ctx_params(void *vctx, OSSL_PARAM *params)
 	if (!ret)
 		return ret;
 
-	return ecdsa_get_ctx_aid(ctx, params);
+	ret = ecdsa_get_ctx_aid(ctx, params);
+	if (!ret)
+		return ret;
+
+	batch = uadk_prov_batch_new(params, ctx->operation, &ret);
+	if (!batch)
+		return ret;
+
+	(void)ecdsa_batch(ctx, batch);
+
+	return uadk_prov_batch_free(batch);
 }
 
 static const OSSL_PARAM known_gettable_ctx_params[] = {
 	OSSL_PARAM_octet_string(OSSL_SIGNATURE_PARAM_ALGORITHM_ID, NULL, 0),
 	OSSL_PARAM_size_t(OSSL_SIGNATURE_PARAM_DIGEST_SIZE, NULL),
 	OSSL_PARAM_utf8_string(OSSL_SIGNATURE_PARAM_DIGEST, NULL, 0),
+	OSSL_PARAM_uint(UADK_PROV_PARAM_BATCH_OP, NULL),
+	OSSL_PARAM_octet_string(UADK_PROV_PARAM_BATCH_TBS, NULL, 0),
+	OSSL_PARAM_octet_string(UADK_PROV_PARAM_BATCH_SIG, NULL, 0),
+	OSSL_PARAM_int(UADK_PROV_PARAM_BATCH_STATUS, NULL),
+	OSSL_PARAM_size_t(UADK_PROV_PARAM_BATCH_DONE, NULL),
 	OSSL_PARAM_END
 };
 
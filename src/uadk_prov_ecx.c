@@ -16,6 +16,8 @@
  *
  */
 
+#include <pthread.h>
+#include <unistd.h>
 #include <openssl/core_names.h>
 #include <openssl/err.h>
 #include <openssl/evp.h>
@@ -29,6 +31,7 @@
 #include "uadk_async.h"
 #include "uadk_prov.h"
 #include "uadk_prov_pkey.h"
+#include "uadk_prov_pool.h"
 #include "uadk_utils.h"
 
 #define X448_KEYLEN		56
@@ -40,6 +43,9 @@
 #define X25519_SECURITY_BITS	128
 
 #define ECX_POSSIBLE_SELECTIONS (OSSL_KEYMGMT_SELECT_KEYPAIR)
+#define ECX_KEY_TYPE_NUM	2
+/* idle sessions kept per curve, about the number of threads busy at once */
+#define ECX_SESS_POOL_MAX	16
 
 #define UADK_CRYPTO_UP_REF(val, ret, lock) CRYPTO_atomic_add(val, 1, ret, lock)
 
@@ -154,6 +160,7 @@ typedef struct {
 	size_t keylen;
 	/* uadk sesssion */
 	handle_t sess;
+	unsigned int sess_gen;
 } PROV_ECX_KEYMGMT_CTX;
 
 typedef struct {
@@ -164,6 +171,7 @@ typedef struct {
 	char *propq;
 	/* uadk sesssion */
 	handle_t sess;
+	unsigned int sess_gen;
 } PROV_ECX_KEYEXCH_CTX;
 
 struct x448_res {
@@ -446,6 +454,106 @@ static void uadk_prov_ecx_free_sess(handle_t sess)
 		wd_ecc_free_sess(sess);
 }
 
+/*
+ * x25519 and x448 have fixed curves and the private key is set for every
+ * request, so any idle session of the right curve will do.
+ */
+struct ecx_sess_pool {
+	int pid;
+	/* bumped on every flush, sessions of an older generation are stale */
+	unsigned int gen;
+	unsigned int num;
+	handle_t sess[ECX_SESS_POOL_MAX];
+};
+
+static struct ecx_sess_pool g_ecx_sess_pool[ECX_KEY_TYPE_NUM];
+static pthread_mutex_t ecx_sess_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t ecx_sess_once = PTHREAD_ONCE_INIT;
+
+static void uadk_prov_ecx_mutex_infork(void)
+{
+	/* Release the replication lock of the child process */
+	pthread_mutex_unlock(&ecx_sess_mutex);
+}
+
+static void uadk_prov_ecx_sess_once(void)
+{
+	pthread_atfork(NULL, NULL, uadk_prov_ecx_mutex_infork);
+}
+
+/* called with ecx_sess_mutex held, forgets what a forked child inherited */
+static void ecx_sess_pool_check_pid(struct ecx_sess_pool *pool)
+{
+	if (pool->pid == getpid())
+		return;
+
+	/* the sessions belong to the parent's queues, do not free them here */
+	pool->pid = getpid();
+	pool->num = 0;
+	pool->gen++;
+}
+
+static handle_t uadk_prov_ecx_get_sess(ECX_KEY_TYPE type, unsigned int *gen)
+{
+	struct ecx_sess_pool *pool = &g_ecx_sess_pool[type];
+	handle_t sess = 0;
+
+	pthread_once(&ecx_sess_once, uadk_prov_ecx_sess_once);
+
+	pthread_mutex_lock(&ecx_sess_mutex);
+	ecx_sess_pool_check_pid(pool);
+	if (pool->num)
+		sess = pool->sess[--pool->num];
+	*gen = pool->gen;
+	pthread_mutex_unlock(&ecx_sess_mutex);
+
+	if (sess)
+		return sess;
+
+	return uadk_prov_ecx_alloc_sess(type);
+}
+
+static void uadk_prov_ecx_put_sess(ECX_KEY_TYPE type, handle_t sess, unsigned int gen)
+{
+	struct ecx_sess_pool *pool = &g_ecx_sess_pool[type];
+
+	if (!sess)
+		return;
+
+	pthread_mutex_lock(&ecx_sess_mutex);
+	ecx_sess_pool_check_pid(pool);
+	/* keep it unless the ecc env was re-initialised or the pool is full */
+	if (gen == pool->gen && pool->num < ECX_SESS_POOL_MAX) {
+		pool->sess[pool->num++] = sess;
+		sess = 0;
+	}
+	pthread_mutex_unlock(&ecx_sess_mutex);
+
+	uadk_prov_ecx_free_sess(sess);
+}
+
+void uadk_prov_ecx_sess_pool_flush(void)
+{
+	handle_t sess[ECX_KEY_TYPE_NUM * ECX_SESS_POOL_MAX];
+	struct ecx_sess_pool *pool;
+	unsigned int i, num = 0;
+	int type;
+
+	pthread_mutex_lock(&ecx_sess_mutex);
+	for (type = 0; type < ECX_KEY_TYPE_NUM; type++) {
+		pool = &g_ecx_sess_pool[type];
+		ecx_sess_pool_check_pid(pool);
+		for (i = 0; i < pool->num; i++)
+			sess[num++] = pool->sess[i];
+		pool->num = 0;
+		pool->gen++;
+	}
+	pthread_mutex_unlock(&ecx_sess_mutex);
+
+	for (i = 0; i < num; i++)
+		uadk_prov_ecx_free_sess(sess[i]);
+}
+
 static void *ossl_ecx_gen_init(void *provctx, int selection, const OSSL_PARAM params[],
 			       ECX_KEY_TYPE type)
 {
@@ -813,6 +921,98 @@ free_prikey:
 	return ret;
 }
 
+/* private key, then public key, both little-endian */
+size_t uadk_prov_ecx_keypair_size(int nid)
+{
+	switch (nid) {
+	case NID_X25519:
+		return X25519_KEYLEN << 1;
+	case NID_X448:
+		return X448_KEYLEN << 1;
+	default:
+		return 0;
+	}
+}
+
+int uadk_prov_ecx_keypair_fill(void *arg, unsigned char *item, size_t size)
+{
+	PROV_ECX_KEYMGMT_CTX gctx = {0};
+	ECX_KEY *ecx_key = NULL;
+	int ret;
+
+	gctx.type = (int)(intptr_t)arg == NID_X448 ? ECX_KEY_TYPE_X448 : ECX_KEY_TYPE_X25519;
+	gctx.selection = OSSL_KEYMGMT_SELECT_KEYPAIR;
+
+	ret = uadk_prov_keymgmt_get_support_state(gctx.type == ECX_KEY_TYPE_X448 ?
+						  KEYMGMT_X448 : KEYMGMT_X25519);
+	if (ret == UADK_P_FAIL)
+		return UADK_P_FAIL;
+
+	ret = uadk_prov_ecc_init(gctx.type == ECX_KEY_TYPE_X448 ? "x448" : "x25519");
+	if (ret != UADK_P_SUCCESS)
+		return UADK_P_FAIL;
+
+	gctx.sess = uadk_prov_ecx_get_sess(gctx.type, &gctx.sess_gen);
+	if (gctx.sess == (handle_t)0)
+		return UADK_P_FAIL;
+
+	ret = uadk_prov_ecx_keygen(&gctx, &ecx_key);
+	if (ret != UADK_P_SUCCESS) {
+		uadk_prov_ecx_free_sess(gctx.sess);
+		return UADK_P_FAIL;
+	}
+	uadk_prov_ecx_put_sess(gctx.type, gctx.sess, gctx.sess_gen);
+
+	if (size != ecx_key->keylen << 1) {
+		ret = UADK_P_FAIL;
+	} else {
+		memcpy(item, ecx_key->privkey, ecx_key->keylen);
+		memcpy(item + ecx_key->keylen, ecx_key->pubkey, ecx_key->keylen);
+	}
+	OPENSSL_cleanse(ecx_key->privkey, ecx_key->keylen);
+	uadk_prov_ecx_free_prikey(ecx_key);
+
+	return ret;
+}
+
+/* an ephemeral key pair made ahead of time, when the curve has a pool */
+static ECX_KEY *uadk_prov_ecx_keypool_get(PROV_ECX_KEYMGMT_CTX *gctx)
+{
+	unsigned char item[ECX_MAX_KEYLEN << 1];
+	struct uadk_prov_pool *pool;
+	ECX_KEY *ecx_key;
+
+	if (!(gctx->selection & OSSL_KEYMGMT_SELECT_KEYPAIR))
+		return NULL;
+
+# if OPENSSL_VERSION_NUMBER >= 0x30200000L
+	if (gctx->dhkem_ikm)
+		return NULL;
+# endif
+
+	pool = uadk_prov_keypool_find(gctx->type == ECX_KEY_TYPE_X448 ? NID_X448 : NID_X25519);
+	if (!pool || !uadk_prov_pool_get(pool, item))
+		return NULL;
+
+	ecx_key = uadk_prov_ecx_key_new(gctx->libctx, gctx->type, 1, gctx->propq);
+	if (ecx_key == NULL)
+		goto out;
+
+	ecx_key->privkey = OPENSSL_secure_malloc(ecx_key->keylen);
+	if (ecx_key->privkey == NULL) {
+		uadk_prov_ecx_key_free(ecx_key);
+		ecx_key = NULL;
+		goto out;
+	}
+
+	memcpy(ecx_key->privkey, item, ecx_key->keylen);
+	memcpy(ecx_key->pubkey, item + ecx_key->keylen, ecx_key->keylen);
+
+out:
+	OPENSSL_cleanse(item, sizeof(item));
+	return ecx_key;
+}
+
 static void *uadk_ecx_sw_gen(void *genctx, OSSL_CALLBACK *cb, void *cb_params,
 			     ECX_KEY_TYPE alg_type)
 {
@@ -871,6 +1071,10 @@ static void *uadk_keymgmt_x448_gen(void *genctx, OSSL_CALLBACK *cb, void *cb_par
 		return NULL;
 	}
 
+	ecx_key = uadk_prov_ecx_keypool_get(gctx);
+	if (ecx_key)
+		return ecx_key;
+
 	ret = uadk_prov_keymgmt_get_support_state(KEYMGMT_X448);
 	if (ret == UADK_P_FAIL) {
 		UADK_ERR("failed to get hardware x448 keygen support\n");
@@ -885,7 +1089,7 @@ static void *uadk_keymgmt_x448_gen(void *genctx, OSSL_CALLBACK *cb, void *cb_par
 		goto exe_soft;
 	}
 
-	gctx->sess = uadk_prov_ecx_alloc_sess(ECX_KEY_TYPE_X448);
+	gctx->sess = uadk_prov_ecx_get_sess(ECX_KEY_TYPE_X448, &gctx->sess_gen);
 	if (gctx->sess == (handle_t)0) {
 		UADK_ERR("failed to alloc x448 sess\n");
 		ret = UADK_P_FAIL;
@@ -900,7 +1104,7 @@ static void *uadk_keymgmt_x448_gen(void *genctx, OSSL_CALLBACK *cb, void *cb_par
 		goto exe_soft;
 	}
 
-	uadk_prov_ecx_free_sess(gctx->sess);
+	uadk_prov_ecx_put_sess(ECX_KEY_TYPE_X448, gctx->sess, gctx->sess_gen);
 
 	return ecx_key;
 
@@ -1270,7 +1474,7 @@ static int uadk_keyexch_x448_derive(void *vecxctx, unsigned char *secret, size_t
 		goto exe_soft;
 	}
 
-	ecxctx->sess = uadk_prov_ecx_alloc_sess(ECX_KEY_TYPE_X448);
+	ecxctx->sess = uadk_prov_ecx_get_sess(ECX_KEY_TYPE_X448, &ecxctx->sess_gen);
 	if (ecxctx->sess == (handle_t)0) {
 		UADK_ERR("failed to alloc sess\n");
 		ret = UADK_P_FAIL;
@@ -1286,7 +1490,7 @@ static int uadk_keyexch_x448_derive(void *vecxctx, unsigned char *secret, size_t
 
 	*secretlen = ecxctx->keylen;
 
-	uadk_prov_ecx_free_sess(ecxctx->sess);
+	uadk_prov_ecx_put_sess(ECX_KEY_TYPE_X448, ecxctx->sess, ecxctx->sess_gen);
 
 	return ret;
 
@@ -1515,6 +1719,10 @@ static void *uadk_keymgmt_x25519_gen(void *genctx, OSSL_CALLBACK *cb, void *cb_p
 		return NULL;
 	}
 
+	ecx_key = uadk_prov_ecx_keypool_get(gctx);
+	if (ecx_key)
+		return ecx_key;
+
 	ret = uadk_prov_keymgmt_get_support_state(KEYMGMT_X25519);
 	if (ret == UADK_P_FAIL) {
 		UADK_ERR("failed to get hardware x25519 keygen support\n");
@@ -1529,7 +1737,7 @@ static void *uadk_keymgmt_x25519_gen(void *genctx, OSSL_CALLBACK *cb, void *cb_p
 		goto exe_soft;
 	}
 
-	gctx->sess = uadk_prov_ecx_alloc_sess(ECX_KEY_TYPE_X25519);
+	gctx->sess = uadk_prov_ecx_get_sess(ECX_KEY_TYPE_X25519, &gctx->sess_gen);
 	if (gctx->sess == (handle_t)0) {
 		UADK_ERR("failed to alloc x25519 sess\n");
 		ret = UADK_P_FAIL;
@@ -1544,7 +1752,7 @@ static void *uadk_keymgmt_x25519_gen(void *genctx, OSSL_CALLBACK *cb, void *cb_p
 		goto exe_soft;
 	}
 
-	uadk_prov_ecx_free_sess(gctx->sess);
+	uadk_prov_ecx_put_sess(ECX_KEY_TYPE_X25519, gctx->sess, gctx->sess_gen);
 
 	return ecx_key;
 
@@ -1672,7 +1880,7 @@ static int uadk_keyexch_x25519_derive(void *vecxctx, unsigned char *secret, size
 		goto exe_soft;
 	}
 
-	ecxctx->sess = uadk_prov_ecx_alloc_sess(ECX_KEY_TYPE_X25519);
+	ecxctx->sess = uadk_prov_ecx_get_sess(ECX_KEY_TYPE_X25519, &ecxctx->sess_gen);
 	if (ecxctx->sess == (handle_t)0) {
 		UADK_ERR("failed to alloc sess\n");
 		ret = UADK_P_FAIL;
@@ -1688,7 +1896,7 @@ static int uadk_keyexch_x25519_derive(void *vecxctx, unsigned char *secret, size
 
 	*secretlen = ecxctx->keylen;
 
-	uadk_prov_ecx_free_sess(ecxctx->sess);
+	uadk_prov_ecx_put_sess(ECX_KEY_TYPE_X25519, ecxctx->sess, ecxctx->sess_gen);
 
 	return ret;
 
@@ -51,6 +51,8 @@
 #define UADK_DIGEST_DEF_CTXS	1
 #define UADK_DIGEST_OP_NUM	1
 
+/* digests for hashing long keys, one per libctx and algorithm in use */
+
 enum sec_digest_state {
 	SEC_DIGEST_INIT,
 	SEC_DIGEST_FIRST_UPDATING,
@@ -65,6 +67,16 @@ struct hmac_prov {
 static struct hmac_prov hprov;
 static pthread_mutex_t hmac_mutex = PTHREAD_MUTEX_INITIALIZER;
 
+/* software hmac shared by all ctxs, freed with the last user */
+struct hmac_soft_res {
+	OSSL_LIB_CTX *libctx;
+	EVP_MAC *mac;
+	int refs;
+};
+
+static struct hmac_soft_res *hmac_soft_res;
+static pthread_mutex_t hmac_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+
 struct hmac_priv_ctx {
 	__u32 alg_id;
 	__u32 state;
@@ -75,8 +87,9 @@ struct hmac_priv_ctx {
 	size_t last_update_bufflen;
 	size_t total_data_len;
 	size_t switch_threshold;
+	UADK_PROV_CTX *provctx;
 	OSSL_LIB_CTX *libctx;
-	OSSL_LIB_CTX *soft_libctx;
+	struct hmac_soft_res *soft_res;
 	EVP_MAC_CTX *soft_ctx;
 	EVP_MAC *soft_md;
 	handle_t sess;
@@ -85,8 +98,19 @@ struct hmac_priv_ctx {
 	unsigned char *data;
 	unsigned char key[MAX_KEY_LEN];
 	unsigned char out[MAX_DIGEST_LENGTH];
+	/* the last key longer than a block and its hash, set again by e.g. hkdf */
+	unsigned char *long_key;
+	size_t long_keylen;
+	char long_key_alg[ALG_NAME_SIZE];
+	unsigned char long_key_hash[MAX_DIGEST_LENGTH];
+	size_t long_key_hashlen;
 	char alg_name[ALG_NAME_SIZE];
 	bool is_stream_copy;
+	/* whether the session holds the current key */
+	bool key_prog;
+	/* shared with duplicated ctxs until either side changes them */
+	int *sess_refs;
+	int *data_refs;
 };
 
 struct hmac_info {
@@ -119,17 +143,66 @@ static struct hmac_info hmac_info_table[] = {
 	 32, 128, PROV_NAMES_SHA2_512_256}
 };
 
-static int uadk_create_hmac_soft_ctx(struct hmac_priv_ctx *priv)
+static struct hmac_soft_res *hmac_soft_res_get(void)
 {
-	if (priv->soft_md)
-		return UADK_P_SUCCESS;
+	struct hmac_soft_res *res;
+
+	pthread_mutex_lock(&hmac_cache_mutex);
+	res = hmac_soft_res;
+	if (res)
+		goto up_ref;
+
+	res = OPENSSL_zalloc(sizeof(*res));
+	if (!res)
+		goto unlock;
 
-	priv->soft_libctx = OSSL_LIB_CTX_new();
-	if (!priv->soft_libctx) {
+	/* a libctx of its own, so the fetch cannot come back to this provider */
+	res->libctx = OSSL_LIB_CTX_new();
+	if (!res->libctx) {
 		UADK_ERR("new soft libctx failed.\n");
-		return UADK_P_FAIL;
+		goto free_res;
 	}
 
+	res->mac = EVP_MAC_fetch(res->libctx, "HMAC", NULL);
+	if (unlikely(!res->mac)) {
+		UADK_ERR("hmac soft fetch failed.\n");
+		goto free_libctx;
+	}
+
+	/* the reference held by the cache itself */
+	res->refs = 1;
+	hmac_soft_res = res;
+
+up_ref:
+	__atomic_add_fetch(&res->refs, 1, __ATOMIC_RELAXED);
+	pthread_mutex_unlock(&hmac_cache_mutex);
+	return res;
+
+free_libctx:
+	OSSL_LIB_CTX_free(res->libctx);
+free_res:
+	OPENSSL_free(res);
+	res = NULL;
+unlock:
+	pthread_mutex_unlock(&hmac_cache_mutex);
+	return res;
+}
+
+static void hmac_soft_res_put(struct hmac_soft_res *res)
+{
+	if (!res || __atomic_sub_fetch(&res->refs, 1, __ATOMIC_ACQ_REL))
+		return;
+
+	EVP_MAC_free(res->mac);
+	OSSL_LIB_CTX_free(res->libctx);
+	OPENSSL_free(res);
+}
+
+static int uadk_create_hmac_soft_ctx(struct hmac_priv_ctx *priv)
+{
+	if (priv->soft_md)
+		return UADK_P_SUCCESS;
+
 	switch (priv->alg_id) {
 	case NID_md5:
 	case NID_sm3:
@@ -140,33 +213,25 @@ static int uadk_create_hmac_soft_ctx(struct hmac_priv_ctx *priv)
 	case NID_sha512:
 	case NID_sha512_224:
 	case NID_sha512_256:
-		priv->soft_md = EVP_MAC_fetch(priv->soft_libctx, "HMAC", NULL);
+		priv->soft_res = hmac_soft_res_get();
 		break;
 	default:
 		break;
 	}
 
-	if (unlikely(!priv->soft_md)) {
-		UADK_ERR("hmac soft fetch failed.\n");
-		goto free_libctx;
-	}
+	if (unlikely(!priv->soft_res))
+		return UADK_P_FAIL;
 
-	priv->soft_ctx = EVP_MAC_CTX_new(priv->soft_md);
+	priv->soft_ctx = EVP_MAC_CTX_new(priv->soft_res->mac);
 	if (!priv->soft_ctx) {
 		UADK_ERR("hmac soft new ctx failed.\n");
-		goto free_mac_md;
+		hmac_soft_res_put(priv->soft_res);
+		priv->soft_res = NULL;
+		return UADK_P_FAIL;
 	}
+	priv->soft_md = priv->soft_res->mac;
 
 	return UADK_P_SUCCESS;
-
-free_mac_md:
-	EVP_MAC_free(priv->soft_md);
-	priv->soft_md = NULL;
-free_libctx:
-	OSSL_LIB_CTX_free(priv->soft_libctx);
-	priv->soft_libctx = NULL;
-
-	return UADK_P_FAIL;
 }
 
 static int uadk_hmac_soft_init(struct hmac_priv_ctx *priv)
@@ -231,15 +296,9 @@ static void hmac_soft_cleanup(struct hmac_priv_ctx *priv)
 		priv->soft_ctx = NULL;
 	}
 
-	if (priv->soft_md) {
-		EVP_MAC_free(priv->soft_md);
-		priv->soft_md = NULL;
-	}
-
-	if (priv->soft_libctx) {
-		OSSL_LIB_CTX_free(priv->soft_libctx);
-		priv->soft_libctx = NULL;
-	}
+	hmac_soft_res_put(priv->soft_res);
+	priv->soft_res = NULL;
+	priv->soft_md = NULL;
 
 	priv->switch_flag = 0;
 }
@@ -403,6 +462,7 @@ static void uadk_hmac_mutex_infork(void)
 {
 	/* Release the replication lock of the child process */
 	pthread_mutex_unlock(&hmac_mutex);
+	pthread_mutex_unlock(&hmac_cache_mutex);
 }
 
 static int uadk_prov_hmac_dev_init(struct hmac_priv_ctx *priv)
@@ -454,6 +514,46 @@ free_nodemask:
 	return ret;
 }
 
+/* Returns a reference the caller releases with EVP_MD_free. */
+static EVP_MD *uadk_prov_hmac_get_md(struct hmac_priv_ctx *priv)
+{
+	EVP_MD *md;
+
+	/*
+	 * A key of a few blocks is cheaper in software. Holding a digest of
+	 * this provider would also keep it from teardown.
+	 */
+	md = uadk_prov_soft_md(priv->provctx, priv->alg_name);
+	if (!md)
+		md = EVP_MD_fetch(priv->libctx, priv->alg_name, NULL);
+
+	return md;
+}
+
+static void uadk_prov_hmac_free_long_key(struct hmac_priv_ctx *priv)
+{
+	OPENSSL_clear_free(priv->long_key, priv->long_keylen);
+	priv->long_key = NULL;
+	priv->long_keylen = 0;
+	priv->long_key_hashlen = 0;
+}
+
+static void uadk_prov_hmac_save_long_key(struct hmac_priv_ctx *priv,
+					 const unsigned char *key, size_t keylen)
+{
+	uadk_prov_hmac_free_long_key(priv);
+
+	/* not fatal, the key is only hashed again next time */
+	priv->long_key = OPENSSL_memdup(key, keylen);
+	if (!priv->long_key)
+		return;
+
+	priv->long_keylen = keylen;
+	memcpy(priv->long_key_alg, priv->alg_name, ALG_NAME_SIZE);
+	memcpy(priv->long_key_hash, priv->key, priv->keylen);
+	priv->long_key_hashlen = priv->keylen;
+}
+
 static int uadk_prov_compute_key_hash(struct hmac_priv_ctx *priv,
 				      const unsigned char *key, size_t keylen)
 {
@@ -462,7 +562,14 @@ static int uadk_prov_compute_key_hash(struct hmac_priv_ctx *priv,
 	EVP_MD_CTX *ctx;
 	EVP_MD *key_md;
 
-	key_md = EVP_MD_fetch(priv->libctx, priv->alg_name, NULL);
+	if (priv->long_key && !strcmp(priv->long_key_alg, priv->alg_name) &&
+	    priv->long_keylen == keylen && !CRYPTO_memcmp(priv->long_key, key, keylen)) {
+		memcpy(priv->key, priv->long_key_hash, priv->long_key_hashlen);
+		priv->keylen = priv->long_key_hashlen;
+		return UADK_P_SUCCESS;
+	}
+
+	key_md = uadk_prov_hmac_get_md(priv);
 	if (!key_md)
 		return UADK_P_FAIL;
 
@@ -476,6 +583,7 @@ static int uadk_prov_compute_key_hash(struct hmac_priv_ctx *priv,
 		goto free_ctx;
 
 	priv->keylen = outlen;
+	uadk_prov_hmac_save_long_key(priv, key, keylen);
 	ret = UADK_P_SUCCESS;
 
 free_ctx:
@@ -486,6 +594,39 @@ free_md:
 	return ret;
 }
 
+/* Take a private copy of the buffer before writing to it. */
+static int uadk_hmac_own_data(struct hmac_priv_ctx *priv)
+{
+	unsigned char *data;
+
+	if (!uadk_prov_ref_shared(priv->data_refs)) {
+		uadk_prov_ref_drop(&priv->data_refs);
+		return UADK_P_SUCCESS;
+	}
+
+	data = OPENSSL_malloc(HMAC_BLOCK_SIZE);
+	if (!data) {
+		UADK_ERR("failed to copy shared hmac data.\n");
+		return UADK_P_FAIL;
+	}
+
+	memcpy(data, priv->data, priv->last_update_bufflen);
+	if (uadk_prov_ref_drop(&priv->data_refs))
+		OPENSSL_clear_free(priv->data, HMAC_BLOCK_SIZE);
+	priv->data = data;
+
+	return UADK_P_SUCCESS;
+}
+
+/* A stream or a new key needs a session no other ctx is using. */
+static void uadk_hmac_own_sess(struct hmac_priv_ctx *priv)
+{
+	if (!uadk_prov_ref_drop(&priv->sess_refs)) {
+		priv->sess = 0;
+		priv->key_prog = false;
+	}
+}
+
 static int uadk_hmac_ctx_init(struct hmac_priv_ctx *priv)
 {
 	struct wd_digest_sess_setup setup = {0};
@@ -508,6 +649,9 @@ static int uadk_hmac_ctx_init(struct hmac_priv_ctx *priv)
 	setup.alg = priv->setup.alg;
 	setup.mode = priv->setup.mode;
 
+	if (!priv->key_prog)
+		uadk_hmac_own_sess(priv);
+
 	if (!priv->sess) {
 		priv->sess = wd_digest_alloc_sess(&setup);
 		if (unlikely(!priv->sess)) {
@@ -516,12 +660,17 @@ static int uadk_hmac_ctx_init(struct hmac_priv_ctx *priv)
 			goto soft_init;
 		}
 
+		priv->key_prog = false;
+	}
+
+	if (!priv->key_prog) {
 		ret = wd_digest_set_key(priv->sess, priv->key, priv->keylen);
 		if (ret) {
 			UADK_ERR("uadk failed to set hmac key%s.\n",
 				 SW_SWITCH_PRINT_ENABLE(enable_sw_offload));
 			goto free_sess;
 		}
+		priv->key_prog = true;
 	}
 
 	return UADK_P_SUCCESS;
@@ -623,6 +772,7 @@ static int uadk_hmac_update_inner(struct hmac_priv_ctx *priv, const void *data,
 	size_t processing_len;
 	int ret;
 
+	uadk_hmac_own_sess(priv);
 	ret = uadk_hmac_ctx_init(priv);
 	if (ret != UADK_P_SUCCESS)
 		return UADK_P_FAIL;
@@ -721,6 +871,9 @@ static int uadk_hmac_update(struct hmac_priv_ctx *priv, const void *data, size_t
 	if (unlikely(priv->switch_flag == UADK_DO_SOFT))
 		goto soft_update;
 
+	if (unlikely(priv->data_refs) && !uadk_hmac_own_data(priv))
+		return UADK_P_FAIL;
+
 	priv->total_data_len += data_len;
 
 	if (priv->last_update_bufflen + data_len <= HMAC_BLOCK_SIZE) {
@@ -797,15 +950,24 @@ do_hmac_err:
 static void *uadk_prov_hmac_dupctx(void *hctx)
 {
 	struct hmac_priv_ctx *dst_ctx, *src_ctx;
-	int ret;
+	bool share_sess;
 
 	if (!hctx)
 		return NULL;
 
 	src_ctx = (struct hmac_priv_ctx *)hctx;
+
+	/* the buffer and an idle keyed session are shared rather than copied */
+	if (!uadk_prov_ref_share(&src_ctx->data_refs))
+		return NULL;
+
+	share_sess = src_ctx->sess && src_ctx->key_prog &&
+		     src_ctx->state == SEC_DIGEST_INIT &&
+		     uadk_prov_ref_share(&src_ctx->sess_refs);
+
 	dst_ctx = OPENSSL_memdup(src_ctx, sizeof(struct hmac_priv_ctx));
 	if (!dst_ctx)
-		return NULL;
+		goto drop_refs;
 
 	/*
 	 * When a copy is performed during digest execution,
@@ -821,42 +983,54 @@ static void *uadk_prov_hmac_dupctx(void *hctx)
 					     dst_ctx->last_update_bufflen;
 	}
 
-	dst_ctx->sess = 0;
-	dst_ctx->data = OPENSSL_memdup(src_ctx->data, HMAC_BLOCK_SIZE);
-	if (!dst_ctx->data)
-		goto free_ctx;
+	if (!share_sess) {
+		dst_ctx->sess = 0;
+		dst_ctx->sess_refs = NULL;
+		dst_ctx->key_prog = false;
+	}
+
+	dst_ctx->long_key = NULL;
+	dst_ctx->long_keylen = 0;
+	if (src_ctx->long_key) {
+		dst_ctx->long_key = OPENSSL_memdup(src_ctx->long_key, src_ctx->long_keylen);
+		if (!dst_ctx->long_key)
+			goto free_ctx;
+		dst_ctx->long_keylen = src_ctx->long_keylen;
+	}
 
 	if (dst_ctx->soft_ctx) {
-		dst_ctx->soft_libctx = NULL;
 		dst_ctx->soft_ctx = EVP_MAC_CTX_dup(src_ctx->soft_ctx);
 		if (!dst_ctx->soft_ctx) {
 			UADK_ERR("create soft_ctx failed in ctx copy.\n");
-			goto free_data;
+			goto free_long_key;
 		}
 
-		ret = EVP_MAC_up_ref(dst_ctx->soft_md);
-		if (!ret)
-			goto free_dup;
+		__atomic_add_fetch(&dst_ctx->soft_res->refs, 1, __ATOMIC_RELAXED);
 	}
 
 	return dst_ctx;
 
-free_dup:
-	EVP_MAC_CTX_free(dst_ctx->soft_ctx);
-free_data:
-	OPENSSL_clear_free(dst_ctx->data, HMAC_BLOCK_SIZE);
+free_long_key:
+	uadk_prov_hmac_free_long_key(dst_ctx);
 free_ctx:
 	OPENSSL_clear_free(dst_ctx, sizeof(*dst_ctx));
+drop_refs:
+	/* src keeps the objects, it still holds a reference */
+	if (share_sess)
+		__atomic_sub_fetch(src_ctx->sess_refs, 1, __ATOMIC_RELAXED);
+	__atomic_sub_fetch(src_ctx->data_refs, 1, __ATOMIC_RELAXED);
 	return NULL;
 }
 
 static void uadk_hmac_cleanup(struct hmac_priv_ctx *priv)
 {
-	if (priv->sess)
+	if (uadk_prov_ref_drop(&priv->sess_refs) && priv->sess)
 		wd_digest_free_sess(priv->sess);
 
-	if (priv->data)
+	if (uadk_prov_ref_drop(&priv->data_refs) && priv->data)
 		OPENSSL_clear_free(priv->data, HMAC_BLOCK_SIZE);
+
+	uadk_prov_hmac_free_long_key(priv);
 }
 
 static void uadk_prov_hmac_freectx(void *hctx)
@@ -879,6 +1053,7 @@ static int uadk_prov_hmac_setkey(struct hmac_priv_ctx *priv,
 	size_t padding;
 
 	memset(priv->key, 0, MAX_KEY_LEN);
+	priv->key_prog = false;
 
 	if (keylen > priv->blk_size)
 		return uadk_prov_compute_key_hash(priv, key, keylen);
@@ -980,6 +1155,11 @@ void uadk_prov_destroy_hmac(void)
 		hprov.pid = 0;
 	}
 	pthread_mutex_unlock(&hmac_mutex);
+
+	pthread_mutex_lock(&hmac_cache_mutex);
+	hmac_soft_res_put(hmac_soft_res);
+	hmac_soft_res = NULL;
+	pthread_mutex_unlock(&hmac_cache_mutex);
 }
 
 static const OSSL_PARAM uadk_prov_hmac_known_gettable_ctx_params[] = {
@@ -1087,6 +1267,7 @@ static void *uadk_prov_hmac_newctx(void *hctx)
 	if (!ctx)
 		return NULL;
 
+	ctx->provctx = hctx;
 	ctx->libctx = prov_libctx_of(hctx);
 
 	ctx->data = OPENSSL_zalloc(HMAC_BLOCK_SIZE);
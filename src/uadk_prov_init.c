@@ -16,13 +16,16 @@
  *
  */
 
+#include <pthread.h>
 #include <stdio.h>
 #include <string.h>
+#include <strings.h>
 
 #include <openssl/core_dispatch.h>
 #include <openssl/core_names.h>
 #include <openssl/crypto.h>
 #include <openssl/evp.h>
+#include <openssl/kdf.h>
 #include <openssl/provider.h>
 #include <openssl/rand.h>
 
@@ -30,11 +33,14 @@
 #include "uadk_prov.h"
 #include "uadk_prov_bio.h"
 #include "uadk_prov_pkey.h"
+#include "uadk_prov_pool.h"
+#include "uadk_prov_rand.h"
 #include "uadk_utils.h"
 
 #define ARRAY_SIZE(x)		(sizeof(x) / sizeof((x)[0]))
 static const char UADK_DEFAULT_PROPERTIES[] = "provider=uadk_provider";
 static OSSL_PROVIDER *default_prov;
+static pthread_mutex_t soft_alg_mutex = PTHREAD_MUTEX_INITIALIZER;
 
 /* Functions provided by the core */
 static OSSL_FUNC_core_gettable_params_fn *c_gettable_params;
@@ -51,6 +57,11 @@ static struct uadk_provider_params {
 	char *x25519;
 	char *x448;
 	char *hmac;
+	char *cmac;
+	char *gmac;
+	char *hkdf;
+	char *tls13_kdf;
+	char *tls1_prf;
 	char *aes_ecb;
 	char *aes_cbc;
 	char *aes_xts;
@@ -62,6 +73,7 @@ static struct uadk_provider_params {
 	char *sm4_cfb128;
 	char *sm4_ecb;
 	char *sm4_ctr;
+	char *sm4_xts;
 	char *des_ede3_cbc;
 	char *des_ede3_ecb;
 	char *md5;
@@ -72,6 +84,11 @@ static struct uadk_provider_params {
 	char *sha384;
 	char *sha512;
 	char *aes_gcm;
+	char *aes_ccm;
+	char *sm4_gcm;
+	char *sm4_ccm;
+	char *keypair_pool;
+	char *ecdsa_precomp;
 } uadk_params;
 
 static struct uadk_prov_alg_en_info {
@@ -83,6 +100,11 @@ static struct uadk_prov_alg_en_info {
 	int x25519_en;
 	int x448_en;
 	int hmac_en;
+	int cmac_en;
+	int gmac_en;
+	int hkdf_en;
+	int tls13_kdf_en;
+	int tls1_prf_en;
 	int aes_ecb_en;
 	int aes_cbc_en;
 	int aes_xts_en;
@@ -94,6 +116,7 @@ static struct uadk_prov_alg_en_info {
 	int sm4_cfb128_en;
 	int sm4_ecb_en;
 	int sm4_ctr_en;
+	int sm4_xts_en;
 	int des_ede3_cbc_en;
 	int des_ede3_ecb_en;
 	int md5_en;
@@ -104,6 +127,9 @@ static struct uadk_prov_alg_en_info {
 	int sha384_en;
 	int sha512_en;
 	int aes_gcm_en;
+	int aes_ccm_en;
+	int sm4_gcm_en;
+	int sm4_ccm_en;
 } uadk_prov_alg_en;
 
 /* offload small packets to sw */
@@ -124,6 +150,11 @@ static struct uadk_prov_alg_cfg uadk_prov_alg_cfg_info[] = {
 	{"x25519", &uadk_params.x25519, &uadk_prov_alg_en.x25519_en},
 	{"x448", &uadk_params.x448, &uadk_prov_alg_en.x448_en},
 	{"hmac", &uadk_params.hmac, &uadk_prov_alg_en.hmac_en},
+	{"cmac", &uadk_params.cmac, &uadk_prov_alg_en.cmac_en},
+	{"gmac", &uadk_params.gmac, &uadk_prov_alg_en.gmac_en},
+	{"hkdf", &uadk_params.hkdf, &uadk_prov_alg_en.hkdf_en},
+	{"tls13_kdf", &uadk_params.tls13_kdf, &uadk_prov_alg_en.tls13_kdf_en},
+	{"tls1_prf", &uadk_params.tls1_prf, &uadk_prov_alg_en.tls1_prf_en},
 	{"aes_ecb", &uadk_params.aes_ecb, &uadk_prov_alg_en.aes_ecb_en},
 	{"aes_cbc", &uadk_params.aes_cbc, &uadk_prov_alg_en.aes_cbc_en},
 	{"aes_xts", &uadk_params.aes_xts, &uadk_prov_alg_en.aes_xts_en},
@@ -135,6 +166,7 @@ static struct uadk_prov_alg_cfg uadk_prov_alg_cfg_info[] = {
 	{"sm4_cfb128", &uadk_params.sm4_cfb128, &uadk_prov_alg_en.sm4_cfb128_en},
 	{"sm4_ecb", &uadk_params.sm4_ecb, &uadk_prov_alg_en.sm4_ecb_en},
 	{"sm4_ctr", &uadk_params.sm4_ctr, &uadk_prov_alg_en.sm4_ctr_en},
+	{"sm4_xts", &uadk_params.sm4_xts, &uadk_prov_alg_en.sm4_xts_en},
 	{"des_ede3_cbc", &uadk_params.des_ede3_cbc,
 	 &uadk_prov_alg_en.des_ede3_cbc_en},
 	{"des_ede3_ecb", &uadk_params.des_ede3_ecb,
@@ -146,7 +178,10 @@ static struct uadk_prov_alg_cfg uadk_prov_alg_cfg_info[] = {
 	{"sha256", &uadk_params.sha256, &uadk_prov_alg_en.sha256_en},
 	{"sha384", &uadk_params.sha384, &uadk_prov_alg_en.sha384_en},
 	{"sha512", &uadk_params.sha512, &uadk_prov_alg_en.sha512_en},
-	{"aes_gcm", &uadk_params.aes_gcm, &uadk_prov_alg_en.aes_gcm_en}
+	{"aes_gcm", &uadk_params.aes_gcm, &uadk_prov_alg_en.aes_gcm_en},
+	{"aes_ccm", &uadk_params.aes_ccm, &uadk_prov_alg_en.aes_ccm_en},
+	{"sm4_gcm", &uadk_params.sm4_gcm, &uadk_prov_alg_en.sm4_gcm_en},
+	{"sm4_ccm", &uadk_params.sm4_ccm, &uadk_prov_alg_en.sm4_ccm_en}
 };
 
 const OSSL_ALGORITHM uadk_prov_digests[] = {
@@ -171,9 +206,24 @@ const OSSL_ALGORITHM uadk_prov_digests[] = {
 	{ NULL, NULL, NULL, NULL }
 };
 
-const OSSL_ALGORITHM uadk_prov_hmac[] = {
+const OSSL_ALGORITHM uadk_prov_macs[] = {
 	{ "HMAC", UADK_DEFAULT_PROPERTIES,
 	  uadk_hmac_functions, "uadk_provider hmac" },
+	{ "CMAC", UADK_DEFAULT_PROPERTIES,
+	  uadk_cmac_functions, "uadk_provider cmac" },
+	{ "GMAC", UADK_DEFAULT_PROPERTIES,
+	  uadk_gmac_functions, "uadk_provider gmac" },
+	{ NULL, NULL, NULL, NULL }
+};
+
+/* the names of the default provider, aliases too, so it exports none of them twice */
+const OSSL_ALGORITHM uadk_prov_kdfs[] = {
+	{ "HKDF", UADK_DEFAULT_PROPERTIES,
+	  uadk_hkdf_functions, "uadk_provider hkdf" },
+	{ "TLS13-KDF", UADK_DEFAULT_PROPERTIES,
+	  uadk_tls13_kdf_functions, "uadk_provider tls13-kdf" },
+	{ "TLS1-PRF", UADK_DEFAULT_PROPERTIES,
+	  uadk_tls1_prf_functions, "uadk_provider tls1-prf" },
 	{ NULL, NULL, NULL, NULL }
 };
 
@@ -184,6 +234,14 @@ const OSSL_ALGORITHM uadk_prov_ciphers_v2[] = {
 	  uadk_aes_192_cbc_functions, "uadk_provider aes-192-cbc" },
 	{ "AES-256-CBC", UADK_DEFAULT_PROPERTIES,
 	  uadk_aes_256_cbc_functions, "uadk_provider aes-256-cbc" },
+	{ "AES-128-CBC-HMAC-SHA1", UADK_DEFAULT_PROPERTIES,
+	  uadk_aes_128_cbc_hmac_sha1_functions, "uadk_provider aes-128-cbc-hmac-sha1" },
+	{ "AES-256-CBC-HMAC-SHA1", UADK_DEFAULT_PROPERTIES,
+	  uadk_aes_256_cbc_hmac_sha1_functions, "uadk_provider aes-256-cbc-hmac-sha1" },
+	{ "AES-128-CBC-HMAC-SHA256", UADK_DEFAULT_PROPERTIES,
+	  uadk_aes_128_cbc_hmac_sha256_functions, "uadk_provider aes-128-cbc-hmac-sha256" },
+	{ "AES-256-CBC-HMAC-SHA256", UADK_DEFAULT_PROPERTIES,
+	  uadk_aes_256_cbc_hmac_sha256_functions, "uadk_provider aes-256-cbc-hmac-sha256" },
 	{ "AES-128-ECB", UADK_DEFAULT_PROPERTIES,
 	  uadk_aes_128_ecb_functions, "uadk_provider aes-128-ecb" },
 	{ "AES-192-ECB", UADK_DEFAULT_PROPERTIES,
@@ -212,6 +270,14 @@ const OSSL_ALGORITHM uadk_prov_ciphers_v3[] = {
 	  uadk_aes_192_cbc_functions, "uadk_provider aes-192-cbc" },
 	{ "AES-256-CBC", UADK_DEFAULT_PROPERTIES,
 	  uadk_aes_256_cbc_functions, "uadk_provider aes-256-cbc" },
+	{ "AES-128-CBC-HMAC-SHA1", UADK_DEFAULT_PROPERTIES,
+	  uadk_aes_128_cbc_hmac_sha1_functions, "uadk_provider aes-128-cbc-hmac-sha1" },
+	{ "AES-256-CBC-HMAC-SHA1", UADK_DEFAULT_PROPERTIES,
+	  uadk_aes_256_cbc_hmac_sha1_functions, "uadk_provider aes-256-cbc-hmac-sha1" },
+	{ "AES-128-CBC-HMAC-SHA256", UADK_DEFAULT_PROPERTIES,
+	  uadk_aes_128_cbc_hmac_sha256_functions, "uadk_provider aes-128-cbc-hmac-sha256" },
+	{ "AES-256-CBC-HMAC-SHA256", UADK_DEFAULT_PROPERTIES,
+	  uadk_aes_256_cbc_hmac_sha256_functions, "uadk_provider aes-256-cbc-hmac-sha256" },
 	{ "AES-128-CBC-CTS", UADK_DEFAULT_PROPERTIES,
 	  uadk_aes_128_cts_functions, "uadk_provider aes-128-cbc-cts" },
 	{ "AES-192-CBC-CTS", UADK_DEFAULT_PROPERTIES,
@@ -252,6 +318,16 @@ const OSSL_ALGORITHM uadk_prov_ciphers_v3[] = {
 	  uadk_aes_192_gcm_functions, "uadk_provider aes-192-gcm" },
 	{ "AES-256-GCM", UADK_DEFAULT_PROPERTIES,
 	  uadk_aes_256_gcm_functions, "uadk_provider aes-256-gcm" },
+	{ "AES-128-CCM", UADK_DEFAULT_PROPERTIES,
+	  uadk_aes_128_ccm_functions, "uadk_provider aes-128-ccm" },
+	{ "AES-192-CCM", UADK_DEFAULT_PROPERTIES,
+	  uadk_aes_192_ccm_functions, "uadk_provider aes-192-ccm" },
+	{ "AES-256-CCM", UADK_DEFAULT_PROPERTIES,
+	  uadk_aes_256_ccm_functions, "uadk_provider aes-256-ccm" },
+	{ "SM4-GCM", UADK_DEFAULT_PROPERTIES,
+	  uadk_sm4_gcm_functions, "uadk_provider sm4-gcm" },
+	{ "SM4-CCM", UADK_DEFAULT_PROPERTIES,
+	  uadk_sm4_ccm_functions, "uadk_provider sm4-ccm" },
 	{ "SM4-CBC", UADK_DEFAULT_PROPERTIES,
 	  uadk_sm4_cbc_functions, "uadk_provider sm4-cbc" },
 	{ "SM4-ECB", UADK_DEFAULT_PROPERTIES,
@@ -262,6 +338,8 @@ const OSSL_ALGORITHM uadk_prov_ciphers_v3[] = {
 	  uadk_sm4_cfb128_functions, "uadk_provider sm4-cfb" },
 	{ "SM4-CTR", UADK_DEFAULT_PROPERTIES,
 	  uadk_sm4_ctr_functions, "uadk_provider sm4-ctr" },
+	{ "SM4-XTS", UADK_DEFAULT_PROPERTIES,
+	  uadk_sm4_xts_functions, "uadk_provider sm4-xts" },
 	{ "DES-EDE3-CBC", UADK_DEFAULT_PROPERTIES,
 	  uadk_des_ede3_cbc_functions, "uadk_provider des-ede3-cbc" },
 	{ "DES-EDE3-ECB", UADK_DEFAULT_PROPERTIES,
@@ -375,27 +453,91 @@ static OSSL_ALGORITHM *uadk_generate_digests_array(void)
 	return digests_array;
 }
 
-static OSSL_ALGORITHM *uadk_generate_hmac_array(void)
+static OSSL_ALGORITHM *uadk_generate_mac_array(void)
 {
-	OSSL_ALGORITHM *hmac_array;
+	OSSL_ALGORITHM *mac_array;
 	const char *name;
 	int index = 0;
 	int i, size;
 
 	/* The algorithm will not exceed the size of a static array */
-	size = ARRAY_SIZE(uadk_prov_hmac);
-	hmac_array = OPENSSL_zalloc(size * sizeof(OSSL_ALGORITHM));
-	if (!hmac_array)
+	size = ARRAY_SIZE(uadk_prov_macs);
+	mac_array = OPENSSL_zalloc(size * sizeof(OSSL_ALGORITHM));
+	if (!mac_array)
 		return NULL;
 	for (i = 0; i < size; i++) {
-		name = uadk_prov_hmac[i].algorithm_names;
+		name = uadk_prov_macs[i].algorithm_names;
 		if (name == NULL ||
-		    (uadk_prov_alg_en.hmac_en && strstr(name, "HMAC")))
-			memcpy(&hmac_array[index++],
-			       &uadk_prov_hmac[i], sizeof(OSSL_ALGORITHM));
+		    (uadk_prov_alg_en.hmac_en && strstr(name, "HMAC")) ||
+		    (uadk_prov_alg_en.cmac_en && strstr(name, "CMAC")) ||
+		    (uadk_prov_alg_en.gmac_en && strstr(name, "GMAC")))
+			memcpy(&mac_array[index++],
+			       &uadk_prov_macs[i], sizeof(OSSL_ALGORITHM));
 	}
 
-	return hmac_array;
+	return mac_array;
+}
+
+static bool uadk_kdf_name_enabled(const char *name, size_t len)
+{
+	return (uadk_prov_alg_en.hkdf_en && len == strlen("HKDF") &&
+		!strncasecmp(name, "HKDF", len)) ||
+	       (uadk_prov_alg_en.tls13_kdf_en && len == strlen("TLS13-KDF") &&
+		!strncasecmp(name, "TLS13-KDF", len)) ||
+	       (uadk_prov_alg_en.tls1_prf_en && len == strlen("TLS1-PRF") &&
+		!strncasecmp(name, "TLS1-PRF", len));
+}
+
+/* names is a colon separated list, e.g. "PBKDF2:1.2.840.113549.1.5.12" */
+static bool uadk_kdf_enabled(const char *names)
+{
+	const char *end;
+	size_t len;
+
+	for (;;) {
+		end = strchr(names, ':');
+		len = end ? (size_t)(end - names) : strlen(names);
+		if (uadk_kdf_name_enabled(names, len))
+			return true;
+		if (!end)
+			return false;
+		names = end + 1;
+	}
+}
+
+/* the kdfs without a uadk one, PBKDF2 and the others, still come from default */
+static OSSL_ALGORITHM *uadk_generate_kdf_array(void)
+{
+	const OSSL_ALGORITHM *soft_kdfs;
+	OSSL_ALGORITHM *kdf_array;
+	int no_cache = 0;
+	int index = 0;
+	int i, size;
+
+	soft_kdfs = OSSL_PROVIDER_query_operation(default_prov, OSSL_OP_KDF, &no_cache);
+	size = ARRAY_SIZE(uadk_prov_kdfs);
+	for (i = 0; soft_kdfs && soft_kdfs[i].algorithm_names; i++)
+		size++;
+
+	kdf_array = OPENSSL_zalloc(size * sizeof(OSSL_ALGORITHM));
+	if (!kdf_array)
+		goto out;
+
+	for (i = 0; uadk_prov_kdfs[i].algorithm_names; i++) {
+		if (uadk_kdf_enabled(uadk_prov_kdfs[i].algorithm_names))
+			memcpy(&kdf_array[index++],
+			       &uadk_prov_kdfs[i], sizeof(OSSL_ALGORITHM));
+	}
+
+	for (i = 0; soft_kdfs && soft_kdfs[i].algorithm_names; i++) {
+		if (!uadk_kdf_enabled(soft_kdfs[i].algorithm_names))
+			memcpy(&kdf_array[index++],
+			       &soft_kdfs[i], sizeof(OSSL_ALGORITHM));
+	}
+
+out:
+	OSSL_PROVIDER_unquery_operation(default_prov, OSSL_OP_KDF, soft_kdfs);
+	return kdf_array;
 }
 
 static OSSL_ALGORITHM *uadk_generate_cipher_array_v2(void)
@@ -418,7 +560,8 @@ static OSSL_ALGORITHM *uadk_generate_cipher_array_v2(void)
 		     strstr(name, "AES") && strstr(name, "CBC")) ||
 		    (uadk_prov_alg_en.aes_ecb_en &&
 		     strstr(name, "AES") && strstr(name, "ECB")) ||
-		    (uadk_prov_alg_en.aes_xts_en && strstr(name, "XTS")) ||
+		    (uadk_prov_alg_en.aes_xts_en &&
+		     strstr(name, "AES") && strstr(name, "XTS")) ||
 		    (uadk_prov_alg_en.sm4_cbc_en && strstr(name, "SM4-CBC")) ||
 		    (uadk_prov_alg_en.sm4_ecb_en && strstr(name, "SM4-ECB")) ||
 		    (uadk_prov_alg_en.des_ede3_cbc_en && strstr(name, "EDE3-CBC")) ||
@@ -452,17 +595,22 @@ static OSSL_ALGORITHM *uadk_generate_cipher_array_v3(void)
 		     strstr(name, "AES") && strstr(name, "ECB")) ||
 		    (uadk_prov_alg_en.aes_ctr_en &&
 		     strstr(name, "AES") && strstr(name, "CTR")) ||
-		    (uadk_prov_alg_en.aes_xts_en && strstr(name, "XTS")) ||
+		    (uadk_prov_alg_en.aes_xts_en &&
+		     strstr(name, "AES") && strstr(name, "XTS")) ||
 		    (uadk_prov_alg_en.aes_ofb128_en &&
 		     strstr(name, "AES") && strstr(name, "OFB")) ||
 		    (uadk_prov_alg_en.aes_cfb128_en &&
 		     strstr(name, "AES") && strstr(name, "CFB")) ||
-		    (uadk_prov_alg_en.aes_gcm_en && strstr(name, "GCM")) ||
+		    (uadk_prov_alg_en.aes_gcm_en && strstr(name, "AES") && strstr(name, "GCM")) ||
+		    (uadk_prov_alg_en.aes_ccm_en && strstr(name, "AES") && strstr(name, "CCM")) ||
+		    (uadk_prov_alg_en.sm4_gcm_en && strstr(name, "SM4-GCM")) ||
+		    (uadk_prov_alg_en.sm4_ccm_en && strstr(name, "SM4-CCM")) ||
 		    (uadk_prov_alg_en.sm4_cbc_en && strstr(name, "SM4-CBC")) ||
 		    (uadk_prov_alg_en.sm4_ecb_en && strstr(name, "SM4-ECB")) ||
 		    (uadk_prov_alg_en.sm4_ofb128_en && strstr(name, "SM4-OFB")) ||
 		    (uadk_prov_alg_en.sm4_cfb128_en && strstr(name, "SM4-CFB")) ||
 		    (uadk_prov_alg_en.sm4_ctr_en && strstr(name, "SM4-CTR")) ||
+		    (uadk_prov_alg_en.sm4_xts_en && strstr(name, "SM4-XTS")) ||
 		    (uadk_prov_alg_en.des_ede3_cbc_en && strstr(name, "EDE3-CBC")) ||
 		    (uadk_prov_alg_en.des_ede3_ecb_en && strstr(name, "EDE3-ECB")))
 			memcpy(&ciphers_array_v3[index++],
@@ -731,7 +879,9 @@ static const OSSL_ALGORITHM *uadk_query(void *provctx, int operation_id,
 			break;
 		return uadk_generate_digests_array();
 	case OSSL_OP_MAC:
-		return uadk_generate_hmac_array();
+		return uadk_generate_mac_array();
+	case OSSL_OP_KDF:
+		return uadk_generate_kdf_array();
 	case OSSL_OP_CIPHER:
 		ver = uadk_prov_cipher_version();
 		if (!ver && uadk_get_sw_offload_state())
@@ -778,18 +928,153 @@ static const OSSL_ALGORITHM *uadk_query(void *provctx, int operation_id,
 	return OSSL_PROVIDER_query_operation(default_prov, operation_id, no_cache);
 }
 
+static void *uadk_prov_soft_find(UADK_PROV_CTX *ctx, enum uadk_prov_soft_type type,
+				 const char *name)
+{
+	int num = __atomic_load_n(&ctx->soft_num, __ATOMIC_ACQUIRE);
+	int i;
+
+	for (i = 0; i < num; i++) {
+		if (ctx->soft_algs[i].type == type && !strcmp(ctx->soft_algs[i].name, name))
+			return ctx->soft_algs[i].alg;
+	}
+
+	return NULL;
+}
+
+static void *uadk_prov_soft_fetch_alg(OSSL_LIB_CTX *libctx, enum uadk_prov_soft_type type,
+				      const char *name)
+{
+	if (type == UADK_PROV_SOFT_CIPHER)
+		return EVP_CIPHER_fetch(libctx, name, "provider=default");
+	if (type == UADK_PROV_SOFT_MAC)
+		return EVP_MAC_fetch(libctx, name, "provider=default");
+	if (type == UADK_PROV_SOFT_KDF)
+		return EVP_KDF_fetch(libctx, name, "provider=default");
+
+	return EVP_MD_fetch(libctx, name, "provider=default");
+}
+
+static int uadk_prov_soft_up_ref(enum uadk_prov_soft_type type, void *alg)
+{
+	if (type == UADK_PROV_SOFT_CIPHER)
+		return EVP_CIPHER_up_ref(alg);
+	if (type == UADK_PROV_SOFT_MAC)
+		return EVP_MAC_up_ref(alg);
+	if (type == UADK_PROV_SOFT_KDF)
+		return EVP_KDF_up_ref(alg);
+
+	return EVP_MD_up_ref(alg);
+}
+
+static void uadk_prov_soft_free_alg(enum uadk_prov_soft_type type, void *alg)
+{
+	if (type == UADK_PROV_SOFT_CIPHER)
+		EVP_CIPHER_free(alg);
+	else if (type == UADK_PROV_SOFT_MAC)
+		EVP_MAC_free(alg);
+	else if (type == UADK_PROV_SOFT_KDF)
+		EVP_KDF_free(alg);
+	else
+		EVP_MD_free(alg);
+}
+
+/*
+ * Fetching takes the method store locks of libcrypto, so each fallback is
+ * fetched once for the libctx of the provider and kept until teardown.
+ * Lookups are lock free, the mutex only serialises adding entries.
+ */
+static void *uadk_prov_soft_get(UADK_PROV_CTX *ctx, enum uadk_prov_soft_type type,
+				const char *name)
+{
+	struct uadk_prov_soft_alg *soft;
+	void *alg;
+	int num;
+
+	if (!ctx)
+		return uadk_prov_soft_fetch_alg(NULL, type, name);
+
+	alg = uadk_prov_soft_find(ctx, type, name);
+	if (alg)
+		goto up_ref;
+
+	pthread_mutex_lock(&soft_alg_mutex);
+	num = ctx->soft_num;
+	/* another thread may have added it before we got the lock */
+	alg = uadk_prov_soft_find(ctx, type, name);
+	if (alg) {
+		pthread_mutex_unlock(&soft_alg_mutex);
+		goto up_ref;
+	}
+
+	alg = uadk_prov_soft_fetch_alg(ctx->libctx, type, name);
+	if (!alg || num >= UADK_PROV_SOFT_ALG_MAX ||
+	    strlen(name) >= UADK_PROV_SOFT_NAME_SIZE) {
+		/* not cached, the caller gets the only reference */
+		pthread_mutex_unlock(&soft_alg_mutex);
+		return alg;
+	}
+
+	soft = &ctx->soft_algs[num];
+	soft->type = type;
+	strcpy(soft->name, name);
+	soft->alg = alg;
+	__atomic_store_n(&ctx->soft_num, num + 1, __ATOMIC_RELEASE);
+	pthread_mutex_unlock(&soft_alg_mutex);
+
+up_ref:
+	if (!uadk_prov_soft_up_ref(type, alg))
+		return NULL;
+
+	return alg;
+}
+
+EVP_CIPHER *uadk_prov_soft_cipher(UADK_PROV_CTX *ctx, const char *name)
+{
+	return uadk_prov_soft_get(ctx, UADK_PROV_SOFT_CIPHER, name);
+}
+
+EVP_MD *uadk_prov_soft_md(UADK_PROV_CTX *ctx, const char *name)
+{
+	return uadk_prov_soft_get(ctx, UADK_PROV_SOFT_MD, name);
+}
+
+EVP_MAC *uadk_prov_soft_mac(UADK_PROV_CTX *ctx, const char *name)
+{
+	return uadk_prov_soft_get(ctx, UADK_PROV_SOFT_MAC, name);
+}
+
+EVP_KDF *uadk_prov_soft_kdf(UADK_PROV_CTX *ctx, const char *name)
+{
+	return uadk_prov_soft_get(ctx, UADK_PROV_SOFT_KDF, name);
+}
+
+static void uadk_prov_soft_cache_free(UADK_PROV_CTX *ctx)
+{
+	int i;
+
+	for (i = 0; i < ctx->soft_num; i++)
+		uadk_prov_soft_free_alg(ctx->soft_algs[i].type, ctx->soft_algs[i].alg);
+	ctx->soft_num = 0;
+}
+
 static void uadk_teardown(void *provctx)
 {
 	struct uadk_prov_ctx *ctx = (struct uadk_prov_ctx *)provctx;
 
 	if (ctx) {
+		uadk_prov_soft_cache_free(ctx);
 		BIO_meth_free(ctx->corebiometh);
 		OPENSSL_free(ctx);
 	}
 
+	/* the pool thread works on the accelerator until it is stopped here */
+	uadk_prov_pool_uninit();
+	uadk_prov_rand_uninit();
 	async_module_uninit();
 	uadk_prov_destroy_digest();
 	uadk_prov_destroy_hmac();
+	uadk_prov_destroy_mac();
 	uadk_prov_destroy_cipher();
 	uadk_prov_destroy_aead();
 	uadk_prov_destroy_rsa();
@@ -829,6 +1114,7 @@ static void uadk_unquery(void *provctx, int operation_id,
 		needs_version_check = 1;
 		break;
 	case OSSL_OP_MAC:
+	case OSSL_OP_KDF:
 		if (algs)
 			OPENSSL_free((void *)algs);
 		return;
@@ -895,7 +1181,7 @@ void uadk_set_sw_offload_state(int enable)
 
 static int uadk_get_params_from_core(const OSSL_CORE_HANDLE *handle)
 {
-	OSSL_PARAM core_params[31], *p = core_params;
+	OSSL_PARAM core_params[42], *p = core_params;
 
 	if (handle == NULL) {
 		UADK_ERR("invalid: OSSL_CORE_HANDLE is NULL\n");
@@ -912,6 +1198,11 @@ static int uadk_get_params_from_core(const OSSL_CORE_HANDLE *handle)
 	*p++ = OSSL_PARAM_construct_utf8_ptr("X25519", (char **)&uadk_params.x25519, 0);
 	*p++ = OSSL_PARAM_construct_utf8_ptr("X448", (char **)&uadk_params.x448, 0);
 	*p++ = OSSL_PARAM_construct_utf8_ptr("HMAC", (char **)&uadk_params.hmac, 0);
+	*p++ = OSSL_PARAM_construct_utf8_ptr("CMAC", (char **)&uadk_params.cmac, 0);
+	*p++ = OSSL_PARAM_construct_utf8_ptr("GMAC", (char **)&uadk_params.gmac, 0);
+	*p++ = OSSL_PARAM_construct_utf8_ptr("HKDF", (char **)&uadk_params.hkdf, 0);
+	*p++ = OSSL_PARAM_construct_utf8_ptr("TLS13_KDF", (char **)&uadk_params.tls13_kdf, 0);
+	*p++ = OSSL_PARAM_construct_utf8_ptr("TLS1_PRF", (char **)&uadk_params.tls1_prf, 0);
 	*p++ = OSSL_PARAM_construct_utf8_ptr("AES_ECB", (char **)&uadk_params.aes_ecb, 0);
 	*p++ = OSSL_PARAM_construct_utf8_ptr("AES_CBC", (char **)&uadk_params.aes_cbc, 0);
 	*p++ = OSSL_PARAM_construct_utf8_ptr("AES_XTS", (char **)&uadk_params.aes_xts, 0);
@@ -923,6 +1214,7 @@ static int uadk_get_params_from_core(const OSSL_CORE_HANDLE *handle)
 	*p++ = OSSL_PARAM_construct_utf8_ptr("SM4_CFB128", (char **)&uadk_params.sm4_cfb128, 0);
 	*p++ = OSSL_PARAM_construct_utf8_ptr("SM4_ECB", (char **)&uadk_params.sm4_ecb, 0);
 	*p++ = OSSL_PARAM_construct_utf8_ptr("SM4_CTR", (char **)&uadk_params.sm4_ctr, 0);
+	*p++ = OSSL_PARAM_construct_utf8_ptr("SM4_XTS", (char **)&uadk_params.sm4_xts, 0);
 	*p++ = OSSL_PARAM_construct_utf8_ptr("MD5", (char **)&uadk_params.md5, 0);
 	*p++ = OSSL_PARAM_construct_utf8_ptr("SM3", (char **)&uadk_params.sm3, 0);
 	*p++ = OSSL_PARAM_construct_utf8_ptr("SHA1", (char **)&uadk_params.sha1, 0);
@@ -931,10 +1223,17 @@ static int uadk_get_params_from_core(const OSSL_CORE_HANDLE *handle)
 	*p++ = OSSL_PARAM_construct_utf8_ptr("SHA384", (char **)&uadk_params.sha384, 0);
 	*p++ = OSSL_PARAM_construct_utf8_ptr("SHA512", (char **)&uadk_params.sha512, 0);
 	*p++ = OSSL_PARAM_construct_utf8_ptr("AES_GCM", (char **)&uadk_params.aes_gcm, 0);
+	*p++ = OSSL_PARAM_construct_utf8_ptr("AES_CCM", (char **)&uadk_params.aes_ccm, 0);
+	*p++ = OSSL_PARAM_construct_utf8_ptr("SM4_GCM", (char **)&uadk_params.sm4_gcm, 0);
+	*p++ = OSSL_PARAM_construct_utf8_ptr("SM4_CCM", (char **)&uadk_params.sm4_ccm, 0);
 	*p++ = OSSL_PARAM_construct_utf8_ptr("DES_EDE3_CBC",
 					     (char **)&uadk_params.des_ede3_cbc, 0);
 	*p++ = OSSL_PARAM_construct_utf8_ptr("DES_EDE3_ECB",
 					     (char **)&uadk_params.des_ede3_ecb, 0);
+	*p++ = OSSL_PARAM_construct_utf8_ptr("KEYPAIR_POOL",
+					     (char **)&uadk_params.keypair_pool, 0);
+	*p++ = OSSL_PARAM_construct_utf8_ptr("ECDSA_PRECOMP",
+					     (char **)&uadk_params.ecdsa_precomp, 0);
 	*p = OSSL_PARAM_construct_end();
 
 	if (!c_get_params(handle, core_params)) {
@@ -944,6 +1243,12 @@ static int uadk_get_params_from_core(const OSSL_CORE_HANDLE *handle)
 
 	uadk_set_alg_sel_state();
 
+	/* opt-in, no pool is made unless KEYPAIR_POOL or ECDSA_PRECOMP names curves */
+	if (uadk_params.keypair_pool)
+		uadk_prov_keypool_config(uadk_params.keypair_pool);
+	if (uadk_params.ecdsa_precomp)
+		uadk_prov_ecdsa_pool_config(uadk_params.ecdsa_precomp);
+
 	return UADK_P_SUCCESS;
 }
 
@@ -951,6 +1256,13 @@ static void provider_init_child_at_fork_handler(void)
 {
 	int ret;
 
+	/*
+	 * Another thread may have held the lock at fork, the child never owns
+	 * it. An entry being added then is not counted in soft_num yet, so
+	 * the cache is consistent without it.
+	 */
+	pthread_mutex_init(&soft_alg_mutex, NULL);
+
 	ret = async_module_init();
 	if (!ret)
 		UADK_ERR("async_module_init fail!\n");
@@ -0,0 +1,859 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+ * Copyright 2023-2024 Huawei Technologies Co.,Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <strings.h>
+#include <openssl/core_dispatch.h>
+#include <openssl/core_names.h>
+#include <openssl/evp.h>
+#include <openssl/kdf.h>
+#include <openssl/params.h>
+#include "uadk.h"
+#include "uadk_prov.h"
+#include "uadk_utils.h"
+
+#define ALG_NAME_SIZE		64
+#define KDF_MAXBUF		2048
+#define KDF_MAX_LABEL_LEN	255
+#define KDF_PARAMS_SIZE		9
+#define TLS13_LABEL_PREFIX_LEN	6
+
+/* every hmac of a shorter chain would be left to software by uadk_hmac */
+#define KDF_SMALL_PACKET_OFFLOAD_THRESHOLD_DEFAULT	(512)
+
+enum uadk_kdf_type {
+	UADK_KDF_HKDF,
+	UADK_KDF_TLS13,
+	UADK_KDF_TLS1_PRF,
+};
+
+/* the hmac of this provider, called directly rather than fetched */
+static struct kdf_hmac_fns {
+	OSSL_FUNC_mac_newctx_fn *newctx;
+	OSSL_FUNC_mac_freectx_fn *freectx;
+	OSSL_FUNC_mac_init_fn *init;
+	OSSL_FUNC_mac_update_fn *update;
+	OSSL_FUNC_mac_final_fn *final;
+} kdf_hmac;
+
+static pthread_once_t kdf_hmac_once = PTHREAD_ONCE_INIT;
+
+struct kdf_priv_ctx {
+	enum uadk_kdf_type type;
+	int mode;
+	UADK_PROV_CTX *provctx;
+	char digest[ALG_NAME_SIZE];
+	/* the hkdf and tls13 key, or the tls1-prf secret */
+	unsigned char *key;
+	size_t key_len;
+	unsigned char *salt;
+	size_t salt_len;
+	unsigned char *prefix;
+	size_t prefix_len;
+	unsigned char *label;
+	size_t label_len;
+	unsigned char *data;
+	size_t data_len;
+	/* the hkdf info or the tls1-prf seed, both concatenate */
+	unsigned char info[KDF_MAXBUF];
+	size_t info_len;
+};
+
+static void uadk_kdf_hmac_fns_init(void)
+{
+	const OSSL_DISPATCH *fn;
+
+	for (fn = uadk_hmac_functions; fn->function_id; fn++) {
+		switch (fn->function_id) {
+		case OSSL_FUNC_MAC_NEWCTX:
+			kdf_hmac.newctx = OSSL_FUNC_mac_newctx(fn);
+			break;
+		case OSSL_FUNC_MAC_FREECTX:
+			kdf_hmac.freectx = OSSL_FUNC_mac_freectx(fn);
+			break;
+		case OSSL_FUNC_MAC_INIT:
+			kdf_hmac.init = OSSL_FUNC_mac_init(fn);
+			break;
+		case OSSL_FUNC_MAC_UPDATE:
+			kdf_hmac.update = OSSL_FUNC_mac_update(fn);
+			break;
+		case OSSL_FUNC_MAC_FINAL:
+			kdf_hmac.final = OSSL_FUNC_mac_final(fn);
+			break;
+		default:
+			break;
+		}
+	}
+}
+
+/*
+ * One hmac ctx is keyed once for a whole chain. After a final it keeps its
+ * session and the key programmed in it, so the next init without a key
+ * only restarts the message.
+ */
+static void *uadk_kdf_hmac_new(struct kdf_priv_ctx *priv, const char *digest,
+			       const unsigned char *key, size_t keylen)
+{
+	OSSL_PARAM params[2];
+	void *hctx;
+
+	hctx = kdf_hmac.newctx(priv->provctx);
+	if (!hctx)
+		return NULL;
+
+	params[0] = OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_DIGEST, (char *)digest, 0);
+	params[1] = OSSL_PARAM_construct_end();
+	if (!kdf_hmac.init(hctx, key, keylen, params)) {
+		kdf_hmac.freectx(hctx);
+		return NULL;
+	}
+
+	return hctx;
+}
+
+static int uadk_kdf_hmac(void *hctx, const unsigned char *in1, size_t in1_len,
+			 const unsigned char *in2, size_t in2_len,
+			 const unsigned char *in3, size_t in3_len, unsigned char *out)
+{
+	size_t outl;
+
+	if (!kdf_hmac.init(hctx, NULL, 0, NULL) ||
+	    (in1_len && !kdf_hmac.update(hctx, in1, in1_len)) ||
+	    (in2_len && !kdf_hmac.update(hctx, in2, in2_len)) ||
+	    (in3_len && !kdf_hmac.update(hctx, in3, in3_len)))
+		return UADK_P_FAIL;
+
+	return kdf_hmac.final(hctx, out, &outl, EVP_MAX_MD_SIZE);
+}
+
+static size_t uadk_kdf_md_size(struct kdf_priv_ctx *priv, const char *digest)
+{
+	EVP_MD *md;
+	int size;
+
+	md = uadk_prov_soft_md(priv->provctx, digest);
+	if (!md)
+		return 0;
+
+	size = EVP_MD_get_size(md);
+	EVP_MD_free(md);
+
+	return size > 0 ? size : 0;
+}
+
+static int uadk_kdf_hkdf_extract(struct kdf_priv_ctx *priv, size_t mdlen,
+				 const unsigned char *salt, size_t salt_len,
+				 const unsigned char *ikm, size_t ikm_len, unsigned char *prk)
+{
+	static const unsigned char zeros[EVP_MAX_MD_SIZE];
+	void *hctx;
+	int ret;
+
+	/* no salt is a string of hash length zeros, RFC 5869 section 2.2 */
+	if (!salt || !salt_len) {
+		salt = zeros;
+		salt_len = mdlen;
+	}
+
+	hctx = uadk_kdf_hmac_new(priv, priv->digest, salt, salt_len);
+	if (!hctx)
+		return UADK_P_FAIL;
+
+	ret = uadk_kdf_hmac(hctx, ikm, ikm_len, NULL, 0, NULL, 0, prk);
+	kdf_hmac.freectx(hctx);
+
+	return ret;
+}
+
+static int uadk_kdf_hkdf_expand(struct kdf_priv_ctx *priv, size_t mdlen,
+				const unsigned char *prk, size_t prk_len,
+				const unsigned char *info, size_t info_len,
+				unsigned char *out, size_t outlen)
+{
+	unsigned char prev[EVP_MAX_MD_SIZE];
+	unsigned char ctr;
+	size_t done, n;
+	void *hctx;
+	int ret = UADK_P_FAIL;
+
+	if (!outlen || outlen > mdlen * 255)
+		return UADK_P_FAIL;
+
+	hctx = uadk_kdf_hmac_new(priv, priv->digest, prk, prk_len);
+	if (!hctx)
+		return UADK_P_FAIL;
+
+	/* T(i) = HMAC(PRK, T(i - 1) | info | i) */
+	for (ctr = 1, done = 0; done < outlen; ctr++, done += n) {
+		if (!uadk_kdf_hmac(hctx, prev, ctr == 1 ? 0 : mdlen, info, info_len,
+				   &ctr, 1, prev))
+			goto out;
+
+		n = outlen - done < mdlen ? outlen - done : mdlen;
+		memcpy(out + done, prev, n);
+	}
+	ret = UADK_P_SUCCESS;
+
+out:
+	OPENSSL_cleanse(prev, sizeof(prev));
+	kdf_hmac.freectx(hctx);
+	return ret;
+}
+
+/* HKDF-Expand-Label of RFC 8446 section 7.1, with the prefix given by the caller */
+static int uadk_kdf_tls13_expand(struct kdf_priv_ctx *priv, size_t mdlen,
+				 const unsigned char *secret, size_t secret_len,
+				 const unsigned char *label, size_t label_len,
+				 const unsigned char *data, size_t data_len,
+				 unsigned char *out, size_t outlen)
+{
+	unsigned char hkdflabel[KDF_MAXBUF];
+	size_t len = 0;
+
+	if (outlen > UINT16_MAX || priv->prefix_len + label_len > KDF_MAX_LABEL_LEN ||
+	    data_len > KDF_MAX_LABEL_LEN)
+		return UADK_P_FAIL;
+
+	hkdflabel[len++] = (unsigned char)(outlen >> 8);
+	hkdflabel[len++] = (unsigned char)outlen;
+	hkdflabel[len++] = (unsigned char)(priv->prefix_len + label_len);
+	if (priv->prefix_len)
+		memcpy(hkdflabel + len, priv->prefix, priv->prefix_len);
+	len += priv->prefix_len;
+	if (label_len)
+		memcpy(hkdflabel + len, label, label_len);
+	len += label_len;
+	hkdflabel[len++] = (unsigned char)data_len;
+	if (data_len)
+		memcpy(hkdflabel + len, data, data_len);
+	len += data_len;
+
+	return uadk_kdf_hkdf_expand(priv, mdlen, secret, secret_len, hkdflabel, len,
+				    out, outlen);
+}
+
+/* the early, handshake or master secret from the previous one, as libssl asks */
+static int uadk_kdf_tls13_extract(struct kdf_priv_ctx *priv, size_t mdlen,
+				  unsigned char *out, size_t outlen)
+{
+	static const unsigned char zeros[EVP_MAX_MD_SIZE];
+	unsigned char preextract[EVP_MAX_MD_SIZE];
+	unsigned char hash[EVP_MAX_MD_SIZE];
+	const unsigned char *prev = NULL;
+	const unsigned char *insecret = priv->key;
+	size_t insecret_len = priv->key_len;
+	size_t prev_len = 0;
+	EVP_MD *md;
+	int ret;
+
+	if (outlen != mdlen)
+		return UADK_P_FAIL;
+
+	if (!insecret) {
+		insecret = zeros;
+		insecret_len = mdlen;
+	}
+
+	if (priv->salt) {
+		/* Derive-Secret(prev, "derived", "") keys the next extract */
+		md = uadk_prov_soft_md(priv->provctx, priv->digest);
+		if (!md)
+			return UADK_P_FAIL;
+		ret = EVP_Digest(NULL, 0, hash, NULL, md, NULL);
+		EVP_MD_free(md);
+		if (!ret ||
+		    !uadk_kdf_tls13_expand(priv, mdlen, priv->salt, priv->salt_len, priv->label,
+					   priv->label_len, hash, mdlen, preextract, mdlen))
+			return UADK_P_FAIL;
+		prev = preextract;
+		prev_len = mdlen;
+	}
+
+	ret = uadk_kdf_hkdf_extract(priv, mdlen, prev, prev_len, insecret, insecret_len, out);
+	OPENSSL_cleanse(preextract, sizeof(preextract));
+
+	return ret;
+}
+
+/* P_hash of RFC 5246 section 5, xored into out when asked */
+static int uadk_kdf_p_hash(struct kdf_priv_ctx *priv, const char *digest,
+			   const unsigned char *sec, size_t sec_len,
+			   unsigned char *out, size_t outlen, bool xor)
+{
+	unsigned char a[EVP_MAX_MD_SIZE];
+	unsigned char blk[EVP_MAX_MD_SIZE];
+	size_t mdlen, done, n, i;
+	void *hctx;
+	int ret = UADK_P_FAIL;
+
+	mdlen = uadk_kdf_md_size(priv, digest);
+	if (!mdlen)
+		return UADK_P_FAIL;
+
+	hctx = uadk_kdf_hmac_new(priv, digest, sec, sec_len);
+	if (!hctx)
+		return UADK_P_FAIL;
+
+	/* A(1) = HMAC(secret, seed) */
+	if (!uadk_kdf_hmac(hctx, priv->info, priv->info_len, NULL, 0, NULL, 0, a))
+		goto out;
+
+	for (done = 0; done < outlen; done += n) {
+		if (!uadk_kdf_hmac(hctx, a, mdlen, priv->info, priv->info_len, NULL, 0, blk))
+			goto out;
+
+		n = outlen - done < mdlen ? outlen - done : mdlen;
+		if (xor) {
+			for (i = 0; i < n; i++)
+				out[done + i] ^= blk[i];
+		} else {
+			memcpy(out + done, blk, n);
+		}
+
+		/* A(i + 1) = HMAC(secret, A(i)) */
+		if (done + n < outlen && !uadk_kdf_hmac(hctx, a, mdlen, NULL, 0, NULL, 0, a))
+			goto out;
+	}
+	ret = UADK_P_SUCCESS;
+
+out:
+	OPENSSL_cleanse(a, sizeof(a));
+	OPENSSL_cleanse(blk, sizeof(blk));
+	kdf_hmac.freectx(hctx);
+	return ret;
+}
+
+static int uadk_kdf_tls1_prf(struct kdf_priv_ctx *priv, unsigned char *out, size_t outlen)
+{
+	size_t half;
+
+	if (strcasecmp(priv->digest, SN_md5_sha1))
+		return uadk_kdf_p_hash(priv, priv->digest, priv->key, priv->key_len,
+				       out, outlen, false);
+
+	/* TLS 1.0 and 1.1 xor MD5 over one half of the secret with SHA1 over the other */
+	half = priv->key_len / 2 + (priv->key_len & 1);
+	if (!uadk_kdf_p_hash(priv, SN_md5, priv->key, half, out, outlen, false) ||
+	    !uadk_kdf_p_hash(priv, SN_sha1, priv->key + priv->key_len - half, half,
+			     out, outlen, true)) {
+		OPENSSL_cleanse(out, outlen);
+		return UADK_P_FAIL;
+	}
+
+	return UADK_P_SUCCESS;
+}
+
+/* The largest single hmac input of the derivation. */
+static size_t uadk_kdf_max_input(struct kdf_priv_ctx *priv, size_t mdlen)
+{
+	size_t len;
+
+	switch (priv->type) {
+	case UADK_KDF_HKDF:
+		len = mdlen + priv->info_len + 1;
+		if (priv->mode != EVP_KDF_HKDF_MODE_EXPAND_ONLY && priv->key_len > len)
+			len = priv->key_len;
+		return len;
+	case UADK_KDF_TLS13:
+		len = mdlen + priv->prefix_len + priv->label_len + priv->data_len + 5;
+		return priv->key_len > len ? priv->key_len : len;
+	default:
+		return mdlen + priv->info_len;
+	}
+}
+
+static int uadk_kdf_soft_derive(struct kdf_priv_ctx *priv, unsigned char *out, size_t outlen)
+{
+	static const char * const names[] = {
+		[UADK_KDF_HKDF] = OSSL_KDF_NAME_HKDF,
+		[UADK_KDF_TLS13] = OSSL_KDF_NAME_TLS1_3_KDF,
+		[UADK_KDF_TLS1_PRF] = OSSL_KDF_NAME_TLS1_PRF,
+	};
+	OSSL_PARAM params[KDF_PARAMS_SIZE];
+	OSSL_PARAM *p = params;
+	EVP_KDF_CTX *kctx;
+	EVP_KDF *kdf;
+	int ret;
+
+	kdf = uadk_prov_soft_kdf(priv->provctx, names[priv->type]);
+	if (!kdf) {
+		UADK_ERR("kdf soft fetch failed.\n");
+		return UADK_P_FAIL;
+	}
+
+	kctx = EVP_KDF_CTX_new(kdf);
+	EVP_KDF_free(kdf);
+	if (!kctx)
+		return UADK_P_FAIL;
+
+	/* the hmac must not be fetched back from this provider */
+	*p++ = OSSL_PARAM_construct_utf8_string(OSSL_KDF_PARAM_DIGEST, priv->digest, 0);
+	*p++ = OSSL_PARAM_construct_utf8_string(OSSL_KDF_PARAM_PROPERTIES,
+						"provider=default", 0);
+	if (priv->type == UADK_KDF_TLS1_PRF) {
+		*p++ = OSSL_PARAM_construct_octet_string(OSSL_KDF_PARAM_SECRET, priv->key,
+							 priv->key_len);
+		*p++ = OSSL_PARAM_construct_octet_string(OSSL_KDF_PARAM_SEED, priv->info,
+							 priv->info_len);
+		goto derive;
+	}
+
+	*p++ = OSSL_PARAM_construct_int(OSSL_KDF_PARAM_MODE, &priv->mode);
+	if (priv->key)
+		*p++ = OSSL_PARAM_construct_octet_string(OSSL_KDF_PARAM_KEY, priv->key,
+							 priv->key_len);
+	if (priv->salt)
+		*p++ = OSSL_PARAM_construct_octet_string(OSSL_KDF_PARAM_SALT, priv->salt,
+							 priv->salt_len);
+	if (priv->type == UADK_KDF_HKDF) {
+		if (priv->info_len)
+			*p++ = OSSL_PARAM_construct_octet_string(OSSL_KDF_PARAM_INFO, priv->info,
+								 priv->info_len);
+		goto derive;
+	}
+
+	if (priv->prefix)
+		*p++ = OSSL_PARAM_construct_octet_string(OSSL_KDF_PARAM_PREFIX, priv->prefix,
+							 priv->prefix_len);
+	if (priv->label)
+		*p++ = OSSL_PARAM_construct_octet_string(OSSL_KDF_PARAM_LABEL, priv->label,
+							 priv->label_len);
+	if (priv->data)
+		*p++ = OSSL_PARAM_construct_octet_string(OSSL_KDF_PARAM_DATA, priv->data,
+							 priv->data_len);
+
+derive:
+	*p = OSSL_PARAM_construct_end();
+	ret = EVP_KDF_derive(kctx, out, outlen, params);
+	EVP_KDF_CTX_free(kctx);
+
+	return ret;
+}
+
+static int uadk_kdf_hw_derive(struct kdf_priv_ctx *priv, size_t mdlen,
+			      unsigned char *out, size_t outlen)
+{
+	unsigned char prk[EVP_MAX_MD_SIZE];
+	int ret;
+
+	switch (priv->type) {
+	case UADK_KDF_TLS1_PRF:
+		return uadk_kdf_tls1_prf(priv, out, outlen);
+	case UADK_KDF_TLS13:
+		if (priv->mode == EVP_KDF_HKDF_MODE_EXTRACT_ONLY)
+			return uadk_kdf_tls13_extract(priv, mdlen, out, outlen);
+		return uadk_kdf_tls13_expand(priv, mdlen, priv->key, priv->key_len,
+					     priv->label, priv->label_len, priv->data,
+					     priv->data_len, out, outlen);
+	default:
+		break;
+	}
+
+	switch (priv->mode) {
+	case EVP_KDF_HKDF_MODE_EXTRACT_ONLY:
+		if (outlen != mdlen)
+			return UADK_P_FAIL;
+		return uadk_kdf_hkdf_extract(priv, mdlen, priv->salt, priv->salt_len,
+					     priv->key, priv->key_len, out);
+	case EVP_KDF_HKDF_MODE_EXPAND_ONLY:
+		return uadk_kdf_hkdf_expand(priv, mdlen, priv->key, priv->key_len,
+					    priv->info, priv->info_len, out, outlen);
+	default:
+		ret = uadk_kdf_hkdf_extract(priv, mdlen, priv->salt, priv->salt_len,
+					    priv->key, priv->key_len, prk) &&
+		      uadk_kdf_hkdf_expand(priv, mdlen, prk, mdlen, priv->info,
+					   priv->info_len, out, outlen);
+		OPENSSL_cleanse(prk, sizeof(prk));
+		return ret;
+	}
+}
+
+static int uadk_kdf_check(struct kdf_priv_ctx *priv, size_t outlen)
+{
+	if (!priv->digest[0]) {
+		UADK_ERR("kdf digest is not set.\n");
+		return UADK_P_FAIL;
+	}
+
+	if (!outlen)
+		return UADK_P_FAIL;
+
+	switch (priv->type) {
+	case UADK_KDF_TLS1_PRF:
+		return priv->key_len ? UADK_P_SUCCESS : UADK_P_FAIL;
+	case UADK_KDF_TLS13:
+		/* libssl only asks a tls13 kdf for an extract or an expand */
+		if (priv->mode == EVP_KDF_HKDF_MODE_EXTRACT_AND_EXPAND)
+			return UADK_P_FAIL;
+		return priv->mode == EVP_KDF_HKDF_MODE_EXTRACT_ONLY || priv->key ?
+		       UADK_P_SUCCESS : UADK_P_FAIL;
+	default:
+		return priv->key ? UADK_P_SUCCESS : UADK_P_FAIL;
+	}
+}
+
+static void uadk_kdf_free_buf(unsigned char **buf, size_t *len)
+{
+	OPENSSL_clear_free(*buf, *len);
+	*buf = NULL;
+	*len = 0;
+}
+
+static int uadk_kdf_set_buf(unsigned char **buf, size_t *len, const OSSL_PARAM *p)
+{
+	uadk_kdf_free_buf(buf, len);
+
+	/* an empty value is set too, so a zero length buffer is still allocated */
+	if (!OSSL_PARAM_get_octet_string(p, (void **)buf, 0, len))
+		return UADK_P_FAIL;
+
+	return UADK_P_SUCCESS;
+}
+
+/* hkdf info and tls1-prf seed params concatenate, as in the default provider */
+static int uadk_kdf_add_info(struct kdf_priv_ctx *priv, const OSSL_PARAM params[],
+			     const char *name)
+{
+	const OSSL_PARAM *p;
+	size_t len;
+	void *q;
+
+	p = OSSL_PARAM_locate_const(params, name);
+	if (!p)
+		return UADK_P_SUCCESS;
+
+	priv->info_len = 0;
+	for (; p; p = OSSL_PARAM_locate_const(p + 1, name)) {
+		if (p->data_size > KDF_MAXBUF - priv->info_len)
+			return UADK_P_FAIL;
+
+		q = priv->info + priv->info_len;
+		if (p->data_size &&
+		    !OSSL_PARAM_get_octet_string(p, &q, KDF_MAXBUF - priv->info_len, &len))
+			return UADK_P_FAIL;
+		if (p->data_size)
+			priv->info_len += len;
+	}
+
+	return UADK_P_SUCCESS;
+}
+
+static int uadk_kdf_set_mode(struct kdf_priv_ctx *priv, const OSSL_PARAM *p)
+{
+	int mode;
+
+	if (p->data_type == OSSL_PARAM_UTF8_STRING) {
+		if (!strcasecmp(p->data, "EXTRACT_AND_EXPAND"))
+			mode = EVP_KDF_HKDF_MODE_EXTRACT_AND_EXPAND;
+		else if (!strcasecmp(p->data, "EXTRACT_ONLY"))
+			mode = EVP_KDF_HKDF_MODE_EXTRACT_ONLY;
+		else if (!strcasecmp(p->data, "EXPAND_ONLY"))
+			mode = EVP_KDF_HKDF_MODE_EXPAND_ONLY;
+		else
+			return UADK_P_FAIL;
+	} else if (!OSSL_PARAM_get_int(p, &mode)) {
+		return UADK_P_FAIL;
+	}
+
+	if (mode < EVP_KDF_HKDF_MODE_EXTRACT_AND_EXPAND || mode > EVP_KDF_HKDF_MODE_EXPAND_ONLY)
+		return UADK_P_FAIL;
+
+	priv->mode = mode;
+
+	return UADK_P_SUCCESS;
+}
+
+static int uadk_prov_kdf_set_ctx_params(void *kctx, const OSSL_PARAM params[])
+{
+	struct kdf_priv_ctx *priv = (struct kdf_priv_ctx *)kctx;
+	const OSSL_PARAM *p;
+
+	if (!params || !params->key)
+		return UADK_P_SUCCESS;
+
+	if (!kctx)
+		return UADK_P_FAIL;
+
+	p = OSSL_PARAM_locate_const(params, OSSL_KDF_PARAM_DIGEST);
+	if (p) {
+		if (p->data_type != OSSL_PARAM_UTF8_STRING ||
+		    strlen(p->data) > ALG_NAME_SIZE - 1)
+			return UADK_P_FAIL;
+		strcpy(priv->digest, p->data);
+	}
+
+	/* the fallback always comes from the default provider, see uadk_kdf_soft_derive */
+	p = OSSL_PARAM_locate_const(params, OSSL_KDF_PARAM_PROPERTIES);
+	if (p && p->data_type != OSSL_PARAM_UTF8_STRING)
+		return UADK_P_FAIL;
+
+	if (priv->type == UADK_KDF_TLS1_PRF) {
+		p = OSSL_PARAM_locate_const(params, OSSL_KDF_PARAM_SECRET);
+		if (p && !uadk_kdf_set_buf(&priv->key, &priv->key_len, p))
+			return UADK_P_FAIL;
+
+		return uadk_kdf_add_info(priv, params, OSSL_KDF_PARAM_SEED);
+	}
+
+	p = OSSL_PARAM_locate_const(params, OSSL_KDF_PARAM_MODE);
+	if (p && !uadk_kdf_set_mode(priv, p))
+		return UADK_P_FAIL;
+
+	p = OSSL_PARAM_locate_const(params, OSSL_KDF_PARAM_KEY);
+	if (p && !uadk_kdf_set_buf(&priv->key, &priv->key_len, p))
+		return UADK_P_FAIL;
+
+	p = OSSL_PARAM_locate_const(params, OSSL_KDF_PARAM_SALT);
+	if (p && !uadk_kdf_set_buf(&priv->salt, &priv->salt_len, p))
+		return UADK_P_FAIL;
+
+	if (priv->type == UADK_KDF_HKDF)
+		return uadk_kdf_add_info(priv, params, OSSL_KDF_PARAM_INFO);
+
+	p = OSSL_PARAM_locate_const(params, OSSL_KDF_PARAM_PREFIX);
+	if (p && !uadk_kdf_set_buf(&priv->prefix, &priv->prefix_len, p))
+		return UADK_P_FAIL;
+
+	p = OSSL_PARAM_locate_const(params, OSSL_KDF_PARAM_LABEL);
+	if (p && !uadk_kdf_set_buf(&priv->label, &priv->label_len, p))
+		return UADK_P_FAIL;
+
+	p = OSSL_PARAM_locate_const(params, OSSL_KDF_PARAM_DATA);
+	if (p && !uadk_kdf_set_buf(&priv->data, &priv->data_len, p))
+		return UADK_P_FAIL;
+
+	return UADK_P_SUCCESS;
+}
+
+static int uadk_prov_kdf_derive(void *kctx, unsigned char *key, size_t keylen,
+				const OSSL_PARAM params[])
+{
+	struct kdf_priv_ctx *priv = (struct kdf_priv_ctx *)kctx;
+	size_t mdlen;
+
+	if (!kctx || !key)
+		return UADK_P_FAIL;
+
+	if (!uadk_prov_kdf_set_ctx_params(kctx, params) || !uadk_kdf_check(priv, keylen))
+		return UADK_P_FAIL;
+
+	mdlen = uadk_kdf_md_size(priv, priv->digest);
+
+	if (!mdlen || !uadk_prov_digest_version() ||
+	    (enable_sw_offload &&
+	     uadk_kdf_max_input(priv, mdlen) <= KDF_SMALL_PACKET_OFFLOAD_THRESHOLD_DEFAULT))
+		return uadk_kdf_soft_derive(priv, key, keylen);
+
+	pthread_once(&kdf_hmac_once, uadk_kdf_hmac_fns_init);
+	if (uadk_kdf_hw_derive(priv, mdlen, key, keylen))
+		return UADK_P_SUCCESS;
+
+	UADK_ERR("uadk kdf derive failed, switch to soft kdf.\n");
+	return uadk_kdf_soft_derive(priv, key, keylen);
+}
+
+static void uadk_prov_kdf_reset(void *kctx)
+{
+	struct kdf_priv_ctx *priv = (struct kdf_priv_ctx *)kctx;
+
+	if (!kctx)
+		return;
+
+	uadk_kdf_free_buf(&priv->key, &priv->key_len);
+	uadk_kdf_free_buf(&priv->salt, &priv->salt_len);
+	uadk_kdf_free_buf(&priv->prefix, &priv->prefix_len);
+	uadk_kdf_free_buf(&priv->label, &priv->label_len);
+	uadk_kdf_free_buf(&priv->data, &priv->data_len);
+	OPENSSL_cleanse(priv->info, sizeof(priv->info));
+	priv->info_len = 0;
+	priv->digest[0] = '\0';
+	priv->mode = EVP_KDF_HKDF_MODE_EXTRACT_AND_EXPAND;
+}
+
+static void *uadk_prov_kdf_newctx(void *provctx, enum uadk_kdf_type type)
+{
+	struct kdf_priv_ctx *ctx;
+
+	ctx = OPENSSL_zalloc(sizeof(*ctx));
+	if (!ctx)
+		return NULL;
+
+	ctx->provctx = provctx;
+	ctx->type = type;
+
+	return ctx;
+}
+
+static void uadk_prov_kdf_freectx(void *kctx)
+{
+	if (!kctx)
+		return;
+
+	uadk_prov_kdf_reset(kctx);
+	OPENSSL_clear_free(kctx, sizeof(struct kdf_priv_ctx));
+}
+
+static int uadk_kdf_dup_buf(unsigned char **dst, const unsigned char *src, size_t len)
+{
+	if (!src)
+		return UADK_P_SUCCESS;
+
+	/* keep an empty value set, as uadk_kdf_set_buf does */
+	*dst = len ? OPENSSL_memdup(src, len) : OPENSSL_zalloc(1);
+
+	return *dst ? UADK_P_SUCCESS : UADK_P_FAIL;
+}
+
+static void *uadk_prov_kdf_dupctx(void *kctx)
+{
+	struct kdf_priv_ctx *src = (struct kdf_priv_ctx *)kctx;
+	struct kdf_priv_ctx *dst;
+
+	if (!kctx)
+		return NULL;
+
+	dst = OPENSSL_memdup(src, sizeof(*src));
+	if (!dst)
+		return NULL;
+
+	dst->key = dst->salt = dst->prefix = dst->label = dst->data = NULL;
+	if (!uadk_kdf_dup_buf(&dst->key, src->key, src->key_len) ||
+	    !uadk_kdf_dup_buf(&dst->salt, src->salt, src->salt_len) ||
+	    !uadk_kdf_dup_buf(&dst->prefix, src->prefix, src->prefix_len) ||
+	    !uadk_kdf_dup_buf(&dst->label, src->label, src->label_len) ||
+	    !uadk_kdf_dup_buf(&dst->data, src->data, src->data_len)) {
+		uadk_prov_kdf_freectx(dst);
+		return NULL;
+	}
+
+	return dst;
+}
+
+static int uadk_prov_kdf_get_ctx_params(void *kctx, OSSL_PARAM params[])
+{
+	struct kdf_priv_ctx *priv = (struct kdf_priv_ctx *)kctx;
+	size_t size = SIZE_MAX;
+	OSSL_PARAM *p;
+
+	if (!kctx)
+		return UADK_P_FAIL;
+
+	p = OSSL_PARAM_locate(params, OSSL_KDF_PARAM_SIZE);
+	if (!p)
+		return UADK_P_FAIL;
+
+	/* an extract gives exactly one hash */
+	if (priv->type != UADK_KDF_TLS1_PRF && priv->mode == EVP_KDF_HKDF_MODE_EXTRACT_ONLY) {
+		size = priv->digest[0] ? uadk_kdf_md_size(priv, priv->digest) : 0;
+		if (!size)
+			return UADK_P_FAIL;
+	}
+
+	return OSSL_PARAM_set_size_t(p, size);
+}
+
+static const OSSL_PARAM uadk_prov_kdf_known_gettable_ctx_params[] = {
+	OSSL_PARAM_size_t(OSSL_KDF_PARAM_SIZE, NULL),
+	OSSL_PARAM_END
+};
+
+static const OSSL_PARAM *uadk_prov_kdf_gettable_ctx_params(ossl_unused void *ctx,
+							   ossl_unused void *provctx)
+{
+	return uadk_prov_kdf_known_gettable_ctx_params;
+}
+
+static const OSSL_PARAM uadk_prov_hkdf_known_settable_ctx_params[] = {
+	OSSL_PARAM_utf8_string(OSSL_KDF_PARAM_MODE, NULL, 0),
+	OSSL_PARAM_int(OSSL_KDF_PARAM_MODE, NULL),
+	OSSL_PARAM_utf8_string(OSSL_KDF_PARAM_PROPERTIES, NULL, 0),
+	OSSL_PARAM_utf8_string(OSSL_KDF_PARAM_DIGEST, NULL, 0),
+	OSSL_PARAM_octet_string(OSSL_KDF_PARAM_KEY, NULL, 0),
+	OSSL_PARAM_octet_string(OSSL_KDF_PARAM_SALT, NULL, 0),
+	OSSL_PARAM_octet_string(OSSL_KDF_PARAM_INFO, NULL, 0),
+	OSSL_PARAM_END
+};
+
+static const OSSL_PARAM *uadk_prov_hkdf_settable_ctx_params(ossl_unused void *ctx,
+							    ossl_unused void *provctx)
+{
+	return uadk_prov_hkdf_known_settable_ctx_params;
+}
+
+static const OSSL_PARAM uadk_prov_tls13_kdf_known_settable_ctx_params[] = {
+	OSSL_PARAM_utf8_string(OSSL_KDF_PARAM_MODE, NULL, 0),
+	OSSL_PARAM_int(OSSL_KDF_PARAM_MODE, NULL),
+	OSSL_PARAM_utf8_string(OSSL_KDF_PARAM_PROPERTIES, NULL, 0),
+	OSSL_PARAM_utf8_string(OSSL_KDF_PARAM_DIGEST, NULL, 0),
+	OSSL_PARAM_octet_string(OSSL_KDF_PARAM_KEY, NULL, 0),
+	OSSL_PARAM_octet_string(OSSL_KDF_PARAM_SALT, NULL, 0),
+	OSSL_PARAM_octet_string(OSSL_KDF_PARAM_PREFIX, NULL, 0),
+	OSSL_PARAM_octet_string(OSSL_KDF_PARAM_LABEL, NULL, 0),
+	OSSL_PARAM_octet_string(OSSL_KDF_PARAM_DATA, NULL, 0),
+	OSSL_PARAM_END
+};
+
+static const OSSL_PARAM *uadk_prov_tls13_kdf_settable_ctx_params(ossl_unused void *ctx,
+								 ossl_unused void *provctx)
+{
+	return uadk_prov_tls13_kdf_known_settable_ctx_params;
+}
+
+static const OSSL_PARAM uadk_prov_tls1_prf_known_settable_ctx_params[] = {
+	OSSL_PARAM_utf8_string(OSSL_KDF_PARAM_PROPERTIES, NULL, 0),
+	OSSL_PARAM_utf8_string(OSSL_KDF_PARAM_DIGEST, NULL, 0),
+	OSSL_PARAM_octet_string(OSSL_KDF_PARAM_SECRET, NULL, 0),
+	OSSL_PARAM_octet_string(OSSL_KDF_PARAM_SEED, NULL, 0),
+	OSSL_PARAM_END
+};
+
+static const OSSL_PARAM *uadk_prov_tls1_prf_settable_ctx_params(ossl_unused void *ctx,
+								ossl_unused void *provctx)
+{
+	return uadk_prov_tls1_prf_known_settable_ctx_params;
+}
+
+#define UADK_KDF_DESCR(nm, typ)							\
+static OSSL_FUNC_kdf_newctx_fn uadk_prov_##nm##_newctx;				\
+static void *uadk_prov_##nm##_newctx(void *provctx)				\
+{										\
+	return uadk_prov_kdf_newctx(provctx, typ);				\
+}										\
+const OSSL_DISPATCH uadk_##nm##_functions[] = {					\
+	{ OSSL_FUNC_KDF_NEWCTX, (void (*)(void))uadk_prov_##nm##_newctx },	\
+	{ OSSL_FUNC_KDF_DUPCTX, (void (*)(void))uadk_prov_kdf_dupctx },		\
+	{ OSSL_FUNC_KDF_FREECTX, (void (*)(void))uadk_prov_kdf_freectx },	\
+	{ OSSL_FUNC_KDF_RESET, (void (*)(void))uadk_prov_kdf_reset },		\
+	{ OSSL_FUNC_KDF_DERIVE, (void (*)(void))uadk_prov_kdf_derive },		\
+	{ OSSL_FUNC_KDF_SETTABLE_CTX_PARAMS,					\
+		(void (*)(void))uadk_prov_##nm##_settable_ctx_params },		\
+	{ OSSL_FUNC_KDF_SET_CTX_PARAMS,						\
+		(void (*)(void))uadk_prov_kdf_set_ctx_params },			\
+	{ OSSL_FUNC_KDF_GETTABLE_CTX_PARAMS,					\
+		(void (*)(void))uadk_prov_kdf_gettable_ctx_params },		\
+	{ OSSL_FUNC_KDF_GET_CTX_PARAMS,						\
+		(void (*)(void))uadk_prov_kdf_get_ctx_params },			\
+	{ 0, NULL }								\
+}
+
+UADK_KDF_DESCR(hkdf, UADK_KDF_HKDF);
+UADK_KDF_DESCR(tls13_kdf, UADK_KDF_TLS13);
+UADK_KDF_DESCR(tls1_prf, UADK_KDF_TLS1_PRF);
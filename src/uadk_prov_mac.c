@@ -0,0 +1,806 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+ * Copyright 2023-2024 Huawei Technologies Co.,Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include <strings.h>
+#include <openssl/evp.h>
+#include <openssl/core_names.h>
+#include <openssl/params.h>
+#include <openssl/proverr.h>
+#include <uadk/wd_digest.h>
+#include <uadk/wd_sched.h>
+#include "uadk.h"
+#include "uadk_async.h"
+#include "uadk_prov.h"
+#include "uadk_utils.h"
+
+#define MAC_OUT_LEN		16
+#define MAC_GMAC_IV_LEN		12
+#define MAC_MAX_IV_LEN		64
+#define ALG_NAME_SIZE		64
+#define PARAMS_SIZE		5
+
+/* the message is sent in one request, longer streams go on in software */
+#define MAC_BUF_MIN		4096
+#define MAC_HW_MAX_LEN		0x100000
+
+#define MAC_SMALL_PACKET_OFFLOAD_THRESHOLD_DEFAULT	(512)
+
+#define UADK_MAC_DEF_CTXS	1
+#define UADK_MAC_OP_NUM		1
+
+enum uadk_mac_type {
+	UADK_MAC_CMAC,
+	UADK_MAC_GMAC,
+};
+
+struct mac_prov {
+	int pid;
+};
+
+static struct mac_prov mprov;
+static pthread_mutex_t mac_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/* the ciphers the engine computes the mac with */
+struct mac_info {
+	const char *cipher;
+	enum wd_digest_type alg;
+	size_t keylen;
+};
+
+static const struct mac_info cmac_info_table[] = {
+	{ "AES-128-CBC", WD_DIGEST_AES_CMAC, 16 },
+	{ "AES-192-CBC", WD_DIGEST_AES_CMAC, 24 },
+	{ "AES-256-CBC", WD_DIGEST_AES_CMAC, 32 },
+};
+
+static const struct mac_info gmac_info_table[] = {
+	{ "AES-128-GCM", WD_DIGEST_AES_GMAC, 16 },
+	{ "AES-192-GCM", WD_DIGEST_AES_GMAC, 24 },
+	{ "AES-256-GCM", WD_DIGEST_AES_GMAC, 32 },
+};
+
+struct mac_priv_ctx {
+	enum uadk_mac_type type;
+	int switch_flag;
+	UADK_PROV_CTX *provctx;
+	const struct mac_info *info;
+	EVP_MAC *soft_mac;
+	EVP_MAC_CTX *soft_ctx;
+	handle_t sess;
+	struct wd_digest_req req;
+	/* the message so far, sent to the engine at final */
+	unsigned char *data;
+	size_t data_len;
+	size_t data_size;
+	size_t keylen;
+	size_t ivlen;
+	unsigned char key[EVP_MAX_KEY_LENGTH];
+	unsigned char iv[MAC_MAX_IV_LEN];
+	char cipher[ALG_NAME_SIZE];
+	/* whether the session holds the current key */
+	bool key_prog;
+};
+
+static OSSL_FUNC_mac_dupctx_fn		uadk_prov_mac_dupctx;
+static OSSL_FUNC_mac_freectx_fn		uadk_prov_mac_freectx;
+static OSSL_FUNC_mac_init_fn		uadk_prov_mac_init;
+static OSSL_FUNC_mac_update_fn		uadk_prov_mac_update;
+static OSSL_FUNC_mac_final_fn		uadk_prov_mac_final;
+static OSSL_FUNC_mac_get_ctx_params_fn	uadk_prov_mac_get_ctx_params;
+static OSSL_FUNC_mac_set_ctx_params_fn	uadk_prov_mac_set_ctx_params;
+
+static int uadk_mac_poll(void *ctx)
+{
+	__u64 rx_cnt = 0;
+	__u32 recv = 0;
+	/* Poll one packet currently */
+	__u32 expt = 1;
+	int ret;
+
+	do {
+		ret = wd_digest_poll(expt, &recv);
+		if (ret < 0 || recv == expt)
+			return ret;
+		rx_cnt++;
+	} while (rx_cnt < PROV_SCH_RECV_MAX_CNT);
+
+	UADK_ERR("failed to poll msg: timeout!\n");
+
+	return -ETIMEDOUT;
+}
+
+static void uadk_mac_mutex_infork(void)
+{
+	/* Release the replication lock of the child process */
+	pthread_mutex_unlock(&mac_mutex);
+}
+
+static int uadk_prov_mac_dev_init(struct mac_priv_ctx *priv)
+{
+	struct wd_ctx_params cparams = {0};
+	struct wd_ctx_nums ctx_set_num;
+	int ret = UADK_P_SUCCESS;
+
+	if (mprov.pid == getpid())
+		return ret;
+
+	cparams.op_type_num = UADK_MAC_OP_NUM;
+	cparams.ctx_set_num = &ctx_set_num;
+	cparams.bmp = numa_allocate_nodemask();
+	if (!cparams.bmp) {
+		UADK_ERR("failed to create nodemask!\n");
+		return UADK_P_FAIL;
+	}
+
+	numa_bitmask_setall(cparams.bmp);
+
+	ctx_set_num.sync_ctx_num = UADK_MAC_DEF_CTXS;
+	ctx_set_num.async_ctx_num = UADK_MAC_DEF_CTXS;
+
+	pthread_atfork(NULL, NULL, uadk_mac_mutex_infork);
+	pthread_mutex_lock(&mac_mutex);
+	if (mprov.pid == getpid())
+		goto free_nodemask;
+
+	ret = wd_digest_init2_(priv->type == UADK_MAC_CMAC ? "cmac(aes)" : "gmac(aes)",
+			       TASK_MIX, SCHED_POLICY_RR, &cparams);
+	if (unlikely(ret && ret != -WD_EEXIST)) {
+		UADK_ERR("uadk failed to initialize mac, ret = %d\n", ret);
+		ret = UADK_P_FAIL;
+		goto free_nodemask;
+	}
+	ret = UADK_P_SUCCESS;
+
+	async_register_poll_fn(ASYNC_TASK_MAC, uadk_mac_poll);
+	mb();
+	mprov.pid = getpid();
+
+free_nodemask:
+	pthread_mutex_unlock(&mac_mutex);
+	numa_free_nodemask(cparams.bmp);
+	return ret;
+}
+
+void uadk_prov_destroy_mac(void)
+{
+	pthread_mutex_lock(&mac_mutex);
+	if (mprov.pid == getpid()) {
+		wd_digest_uninit2();
+		mprov.pid = 0;
+	}
+	pthread_mutex_unlock(&mac_mutex);
+}
+
+/* The engine only has AES-CMAC and AES-GMAC with a 96 bit iv, and only from v3. */
+static const struct mac_info *uadk_mac_get_info(struct mac_priv_ctx *priv)
+{
+	const struct mac_info *table;
+	size_t i, num;
+
+	if (uadk_prov_cipher_version() != HW_SYMM_ENC_V3)
+		return NULL;
+
+	if (priv->type == UADK_MAC_CMAC) {
+		table = cmac_info_table;
+		num = ARRAY_SIZE(cmac_info_table);
+	} else {
+		if (priv->ivlen != MAC_GMAC_IV_LEN)
+			return NULL;
+		table = gmac_info_table;
+		num = ARRAY_SIZE(gmac_info_table);
+	}
+
+	for (i = 0; i < num; i++) {
+		if (!strcasecmp(table[i].cipher, priv->cipher))
+			return table[i].keylen == priv->keylen ? &table[i] : NULL;
+	}
+
+	return NULL;
+}
+
+static void uadk_mac_soft_cleanup(struct mac_priv_ctx *priv)
+{
+	EVP_MAC_CTX_free(priv->soft_ctx);
+	priv->soft_ctx = NULL;
+	EVP_MAC_free(priv->soft_mac);
+	priv->soft_mac = NULL;
+	priv->switch_flag = 0;
+}
+
+/* Key the default provider mac and hand it what was buffered so far. */
+static int uadk_mac_soft_init(struct mac_priv_ctx *priv)
+{
+	OSSL_PARAM params[PARAMS_SIZE];
+	OSSL_PARAM *p = params;
+
+	if (!priv->soft_mac) {
+		priv->soft_mac = uadk_prov_soft_mac(priv->provctx,
+						    priv->type == UADK_MAC_CMAC ? "CMAC" : "GMAC");
+		if (!priv->soft_mac) {
+			UADK_ERR("mac soft fetch failed.\n");
+			return UADK_P_FAIL;
+		}
+	}
+
+	if (!priv->soft_ctx) {
+		priv->soft_ctx = EVP_MAC_CTX_new(priv->soft_mac);
+		if (!priv->soft_ctx) {
+			UADK_ERR("mac soft new ctx failed.\n");
+			return UADK_P_FAIL;
+		}
+	}
+
+	/* the cipher must not be fetched back from this provider */
+	*p++ = OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_CIPHER, priv->cipher, 0);
+	*p++ = OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_PROPERTIES,
+						"provider=default", 0);
+	if (priv->type == UADK_MAC_GMAC && priv->ivlen)
+		*p++ = OSSL_PARAM_construct_octet_string(OSSL_MAC_PARAM_IV, priv->iv,
+							 priv->ivlen);
+	*p = OSSL_PARAM_construct_end();
+
+	if (!EVP_MAC_init(priv->soft_ctx, priv->key, priv->keylen, params)) {
+		UADK_ERR("do soft mac init failed!\n");
+		return UADK_P_FAIL;
+	}
+
+	if (priv->data_len && !EVP_MAC_update(priv->soft_ctx, priv->data, priv->data_len)) {
+		UADK_ERR("do soft mac update failed!\n");
+		return UADK_P_FAIL;
+	}
+
+	priv->data_len = 0;
+	priv->switch_flag = UADK_DO_SOFT;
+
+	return UADK_P_SUCCESS;
+}
+
+/* Called whenever the cipher, key or iv change, as a new message starts. */
+static int uadk_mac_start(struct mac_priv_ctx *priv)
+{
+	priv->data_len = 0;
+	priv->switch_flag = 0;
+
+	if (!priv->cipher[0] || !priv->keylen)
+		return UADK_P_SUCCESS;
+
+	priv->info = uadk_mac_get_info(priv);
+	if (priv->info && uadk_prov_mac_dev_init(priv))
+		return UADK_P_SUCCESS;
+
+	return uadk_mac_soft_init(priv);
+}
+
+static int uadk_mac_reserve(struct mac_priv_ctx *priv, size_t len)
+{
+	size_t size = priv->data_size ? priv->data_size : MAC_BUF_MIN;
+	unsigned char *data;
+
+	if (len <= priv->data_size)
+		return UADK_P_SUCCESS;
+
+	while (size < len)
+		size <<= 1;
+
+	data = OPENSSL_realloc(priv->data, size);
+	if (!data) {
+		UADK_ERR("failed to grow mac buffer.\n");
+		return UADK_P_FAIL;
+	}
+
+	priv->data = data;
+	priv->data_size = size;
+
+	return UADK_P_SUCCESS;
+}
+
+static void uadk_mac_async_cb(struct wd_digest_req *req)
+{
+	struct uadk_e_cb_info *mac_cb_param;
+	struct wd_digest_req *req_origin;
+	struct async_op *op;
+
+	if (!req || !req->cb_param)
+		return;
+
+	mac_cb_param = req->cb_param;
+	req_origin = mac_cb_param->priv;
+	req_origin->state = req->state;
+	op = mac_cb_param->op;
+	if (op && op->job && !op->done) {
+		op->done = 1;
+		async_free_poll_task(op->idx, 1);
+		(void) async_wake_job(op->job);
+	}
+}
+
+static int uadk_do_mac_async(struct mac_priv_ctx *priv, struct async_op *op)
+{
+	struct uadk_e_cb_info cb_param;
+	int idx, ret;
+	int cnt = 0;
+
+	cb_param.op = op;
+	cb_param.priv = &priv->req;
+	priv->req.cb = (void *)uadk_mac_async_cb;
+	priv->req.cb_param = &cb_param;
+	priv->req.state = POLL_ERROR;
+
+	ret = async_get_free_task(&idx);
+	if (!ret)
+		return UADK_P_FAIL;
+
+	op->idx = idx;
+	do {
+		ret = wd_do_digest_async(priv->sess, &priv->req);
+		if (likely(!ret))
+			break;
+
+		if (ret != -EBUSY) {
+			UADK_ERR("do mac async failed.\n");
+			goto free_poll_task;
+		}
+
+		if (unlikely(++cnt > ENGINE_SEND_MAX_CNT)) {
+			UADK_ERR("do mac async operation timeout.\n");
+			goto free_poll_task;
+		}
+	} while (true);
+
+	ret = async_pause_job(priv, op, ASYNC_TASK_MAC);
+	if (!ret || priv->req.state)
+		return UADK_P_FAIL;
+
+	return UADK_P_SUCCESS;
+
+free_poll_task:
+	async_free_poll_task(op->idx, 0);
+	return UADK_P_FAIL;
+}
+
+static int uadk_mac_hw_final(struct mac_priv_ctx *priv, unsigned char *out)
+{
+	struct wd_digest_sess_setup setup = {0};
+	struct sched_params params = {0};
+	struct async_op op;
+	int ret;
+
+	if (!priv->sess) {
+		/* Use the default numa parameters */
+		params.numa_id = -1;
+		setup.sched_param = &params;
+		setup.alg = priv->info->alg;
+		setup.mode = WD_DIGEST_HMAC;
+		priv->sess = wd_digest_alloc_sess(&setup);
+		if (unlikely(!priv->sess)) {
+			UADK_ERR("uadk failed to alloc mac sess.\n");
+			return UADK_P_FAIL;
+		}
+		priv->key_prog = false;
+	}
+
+	if (!priv->key_prog) {
+		if (wd_digest_set_key(priv->sess, priv->key, priv->keylen)) {
+			UADK_ERR("uadk failed to set mac key.\n");
+			return UADK_P_FAIL;
+		}
+		priv->key_prog = true;
+	}
+
+	priv->req.in = priv->data;
+	priv->req.in_bytes = priv->data_len;
+	priv->req.out = out;
+	priv->req.out_bytes = MAC_OUT_LEN;
+	priv->req.out_buf_bytes = MAC_OUT_LEN;
+	priv->req.has_next = WD_DIGEST_END;
+	if (priv->type == UADK_MAC_GMAC) {
+		priv->req.iv = priv->iv;
+		priv->req.iv_bytes = MAC_GMAC_IV_LEN;
+	}
+
+	ret = async_setup_async_event_notification(&op);
+	if (unlikely(!ret)) {
+		UADK_ERR("failed to setup async event notification.\n");
+		return UADK_P_FAIL;
+	}
+
+	if (!op.job) {
+		ret = !wd_do_digest_sync(priv->sess, &priv->req);
+		if (!ret)
+			UADK_ERR("do sec mac sync failed.\n");
+		return ret;
+	}
+
+	ret = uadk_do_mac_async(priv, &op);
+	if (!ret)
+		async_clear_async_event_notification();
+
+	return ret;
+}
+
+static int uadk_mac_update(struct mac_priv_ctx *priv, const unsigned char *data, size_t len)
+{
+	if (!priv->keylen) {
+		UADK_ERR("mac key is not set.\n");
+		return UADK_P_FAIL;
+	}
+
+	if (priv->switch_flag == UADK_DO_SOFT)
+		goto soft_update;
+
+	if (priv->data_len + len > MAC_HW_MAX_LEN) {
+		if (!uadk_mac_soft_init(priv))
+			return UADK_P_FAIL;
+		goto soft_update;
+	}
+
+	if (!uadk_mac_reserve(priv, priv->data_len + len))
+		return UADK_P_FAIL;
+
+	uadk_memcpy(priv->data + priv->data_len, data, len);
+	priv->data_len += len;
+
+	return UADK_P_SUCCESS;
+
+soft_update:
+	return EVP_MAC_update(priv->soft_ctx, data, len);
+}
+
+static int uadk_mac_final(struct mac_priv_ctx *priv, unsigned char *out, size_t *outl,
+			  size_t outsize)
+{
+	if (!priv->keylen) {
+		UADK_ERR("mac key is not set.\n");
+		return UADK_P_FAIL;
+	}
+
+	if (priv->switch_flag == UADK_DO_SOFT)
+		goto soft_final;
+
+	/* the engine takes no empty message, a short one is cheaper on the cpu */
+	if (!priv->data_len ||
+	    (enable_sw_offload && priv->data_len <= MAC_SMALL_PACKET_OFFLOAD_THRESHOLD_DEFAULT))
+		goto soft_init;
+
+	if (outsize < MAC_OUT_LEN)
+		return UADK_P_FAIL;
+
+	if (uadk_mac_hw_final(priv, out)) {
+		*outl = MAC_OUT_LEN;
+		priv->data_len = 0;
+		return UADK_P_SUCCESS;
+	}
+
+	UADK_ERR("do sec mac final failed, switch to soft mac.\n");
+
+soft_init:
+	if (!uadk_mac_soft_init(priv))
+		return UADK_P_FAIL;
+
+soft_final:
+	return EVP_MAC_final(priv->soft_ctx, out, outl, outsize);
+}
+
+static void *uadk_prov_mac_newctx(void *provctx, enum uadk_mac_type type)
+{
+	struct mac_priv_ctx *ctx;
+
+	ctx = OPENSSL_zalloc(sizeof(*ctx));
+	if (!ctx)
+		return NULL;
+
+	ctx->provctx = provctx;
+	ctx->type = type;
+
+	return ctx;
+}
+
+static void *uadk_prov_mac_dupctx(void *mctx)
+{
+	struct mac_priv_ctx *src_ctx = (struct mac_priv_ctx *)mctx;
+	struct mac_priv_ctx *dst_ctx;
+
+	if (!mctx)
+		return NULL;
+
+	dst_ctx = OPENSSL_memdup(src_ctx, sizeof(*src_ctx));
+	if (!dst_ctx)
+		return NULL;
+
+	/* the copy gets a session of its own when it reaches the engine */
+	dst_ctx->sess = 0;
+	dst_ctx->key_prog = false;
+	dst_ctx->data = NULL;
+	dst_ctx->data_size = 0;
+	dst_ctx->soft_mac = NULL;
+	dst_ctx->soft_ctx = NULL;
+
+	if (src_ctx->data_len && !uadk_mac_reserve(dst_ctx, src_ctx->data_len))
+		goto free_ctx;
+	if (src_ctx->data_len)
+		memcpy(dst_ctx->data, src_ctx->data, src_ctx->data_len);
+
+	if (src_ctx->soft_ctx) {
+		dst_ctx->soft_ctx = EVP_MAC_CTX_dup(src_ctx->soft_ctx);
+		if (!dst_ctx->soft_ctx) {
+			UADK_ERR("create soft_ctx failed in ctx copy.\n");
+			goto free_ctx;
+		}
+	}
+
+	if (src_ctx->soft_mac) {
+		if (!EVP_MAC_up_ref(src_ctx->soft_mac))
+			goto free_ctx;
+		dst_ctx->soft_mac = src_ctx->soft_mac;
+	}
+
+	return dst_ctx;
+
+free_ctx:
+	uadk_prov_mac_freectx(dst_ctx);
+	return NULL;
+}
+
+static void uadk_prov_mac_freectx(void *mctx)
+{
+	struct mac_priv_ctx *priv = (struct mac_priv_ctx *)mctx;
+
+	if (!mctx)
+		return;
+
+	if (priv->sess)
+		wd_digest_free_sess(priv->sess);
+
+	uadk_mac_soft_cleanup(priv);
+	OPENSSL_clear_free(priv->data, priv->data_size);
+	OPENSSL_clear_free(priv, sizeof(*priv));
+}
+
+static int uadk_mac_set_key(struct mac_priv_ctx *priv, const unsigned char *key,
+			    size_t keylen)
+{
+	if (keylen > sizeof(priv->key)) {
+		UADK_ERR("invalid mac key length %zu.\n", keylen);
+		return UADK_P_FAIL;
+	}
+
+	OPENSSL_cleanse(priv->key, sizeof(priv->key));
+	memcpy(priv->key, key, keylen);
+	priv->keylen = keylen;
+	priv->key_prog = false;
+
+	return UADK_P_SUCCESS;
+}
+
+/* Returns whether the cipher, key or iv was set, as those restart the mac. */
+static int uadk_mac_set_params(struct mac_priv_ctx *priv, const OSSL_PARAM params[],
+			       bool *restart)
+{
+	const OSSL_PARAM *p;
+
+	*restart = false;
+	if (!params)
+		return UADK_P_SUCCESS;
+
+	p = OSSL_PARAM_locate_const(params, OSSL_MAC_PARAM_CIPHER);
+	if (p) {
+		if (p->data_type != OSSL_PARAM_UTF8_STRING ||
+		    strlen((char *)p->data) > ALG_NAME_SIZE - 1)
+			return UADK_P_FAIL;
+
+		/* a new cipher may need a session of another algorithm */
+		if (strcasecmp(priv->cipher, p->data) && priv->sess) {
+			wd_digest_free_sess(priv->sess);
+			priv->sess = 0;
+		}
+		strcpy(priv->cipher, p->data);
+		*restart = true;
+	}
+
+	/* the fallback always comes from the default provider, see uadk_mac_soft_init */
+	p = OSSL_PARAM_locate_const(params, OSSL_MAC_PARAM_PROPERTIES);
+	if (p && p->data_type != OSSL_PARAM_UTF8_STRING)
+		return UADK_P_FAIL;
+
+	p = OSSL_PARAM_locate_const(params, OSSL_MAC_PARAM_KEY);
+	if (p) {
+		if (p->data_type != OSSL_PARAM_OCTET_STRING ||
+		    !uadk_mac_set_key(priv, p->data, p->data_size))
+			return UADK_P_FAIL;
+		*restart = true;
+	}
+
+	if (priv->type != UADK_MAC_GMAC)
+		return UADK_P_SUCCESS;
+
+	p = OSSL_PARAM_locate_const(params, OSSL_MAC_PARAM_IV);
+	if (p) {
+		if (p->data_type != OSSL_PARAM_OCTET_STRING || !p->data_size ||
+		    p->data_size > MAC_MAX_IV_LEN)
+			return UADK_P_FAIL;
+
+		memcpy(priv->iv, p->data, p->data_size);
+		priv->ivlen = p->data_size;
+		*restart = true;
+	}
+
+	return UADK_P_SUCCESS;
+}
+
+static int uadk_prov_mac_set_ctx_params(void *mctx, const OSSL_PARAM params[])
+{
+	struct mac_priv_ctx *priv = (struct mac_priv_ctx *)mctx;
+	bool restart;
+
+	if (!mctx)
+		return UADK_P_FAIL;
+
+	if (!uadk_mac_set_params(priv, params, &restart))
+		return UADK_P_FAIL;
+
+	return restart ? uadk_mac_start(priv) : UADK_P_SUCCESS;
+}
+
+static int uadk_prov_mac_init(void *mctx, const unsigned char *key, size_t keylen,
+			      const OSSL_PARAM params[])
+{
+	struct mac_priv_ctx *priv = (struct mac_priv_ctx *)mctx;
+	bool restart;
+
+	if (!mctx) {
+		UADK_ERR("CTX is NULL.\n");
+		return UADK_P_FAIL;
+	}
+
+	if (!uadk_mac_set_params(priv, params, &restart))
+		return UADK_P_FAIL;
+
+	if (key && !uadk_mac_set_key(priv, key, keylen))
+		return UADK_P_FAIL;
+
+	return uadk_mac_start(priv);
+}
+
+static int uadk_prov_mac_update(void *mctx, const unsigned char *data, size_t datalen)
+{
+	if (!mctx || (!data && datalen)) {
+		UADK_ERR("CTX or input data is NULL.\n");
+		return UADK_P_FAIL;
+	}
+
+	if (!datalen)
+		return UADK_P_SUCCESS;
+
+	return uadk_mac_update((struct mac_priv_ctx *)mctx, data, datalen);
+}
+
+static int uadk_prov_mac_final(void *mctx, unsigned char *out, size_t *outl,
+			       size_t outsize)
+{
+	struct mac_priv_ctx *priv = (struct mac_priv_ctx *)mctx;
+
+	if (!mctx || !out || !outl) {
+		UADK_ERR("mac CTX or output data is NULL.\n");
+		return UADK_P_FAIL;
+	}
+
+	return uadk_mac_final(priv, out, outl, outsize);
+}
+
+static int uadk_prov_mac_get_ctx_params(void *mctx, OSSL_PARAM params[])
+{
+	struct mac_priv_ctx *priv = (struct mac_priv_ctx *)mctx;
+	OSSL_PARAM *p;
+
+	if (!mctx)
+		return UADK_P_FAIL;
+
+	/* a cipher the engine lacks may have another block size */
+	if (!priv->info && priv->soft_ctx)
+		return EVP_MAC_CTX_get_params(priv->soft_ctx, params);
+
+	p = OSSL_PARAM_locate(params, OSSL_MAC_PARAM_SIZE);
+	if (p && !OSSL_PARAM_set_size_t(p, MAC_OUT_LEN))
+		return UADK_P_FAIL;
+
+	p = OSSL_PARAM_locate(params, OSSL_MAC_PARAM_BLOCK_SIZE);
+	if (p && !OSSL_PARAM_set_size_t(p, MAC_OUT_LEN))
+		return UADK_P_FAIL;
+
+	return UADK_P_SUCCESS;
+}
+
+static const OSSL_PARAM uadk_prov_cmac_known_gettable_ctx_params[] = {
+	OSSL_PARAM_size_t(OSSL_MAC_PARAM_SIZE, NULL),
+	OSSL_PARAM_size_t(OSSL_MAC_PARAM_BLOCK_SIZE, NULL),
+	OSSL_PARAM_END
+};
+
+static const OSSL_PARAM *uadk_prov_cmac_gettable_ctx_params(ossl_unused void *ctx,
+							    ossl_unused void *provctx)
+{
+	return uadk_prov_cmac_known_gettable_ctx_params;
+}
+
+static const OSSL_PARAM uadk_prov_cmac_settable_ctx_params[] = {
+	OSSL_PARAM_utf8_string(OSSL_MAC_PARAM_CIPHER, NULL, 0),
+	OSSL_PARAM_utf8_string(OSSL_MAC_PARAM_PROPERTIES, NULL, 0),
+	OSSL_PARAM_octet_string(OSSL_MAC_PARAM_KEY, NULL, 0),
+	OSSL_PARAM_END
+};
+
+static const OSSL_PARAM *uadk_prov_cmac_settable_ctx_params_fn(ossl_unused void *ctx,
+							       ossl_unused void *provctx)
+{
+	return uadk_prov_cmac_settable_ctx_params;
+}
+
+static const OSSL_PARAM uadk_prov_gmac_known_gettable_ctx_params[] = {
+	OSSL_PARAM_size_t(OSSL_MAC_PARAM_SIZE, NULL),
+	OSSL_PARAM_END
+};
+
+static const OSSL_PARAM *uadk_prov_gmac_gettable_ctx_params(ossl_unused void *ctx,
+							    ossl_unused void *provctx)
+{
+	return uadk_prov_gmac_known_gettable_ctx_params;
+}
+
+static const OSSL_PARAM uadk_prov_gmac_settable_ctx_params[] = {
+	OSSL_PARAM_utf8_string(OSSL_MAC_PARAM_CIPHER, NULL, 0),
+	OSSL_PARAM_utf8_string(OSSL_MAC_PARAM_PROPERTIES, NULL, 0),
+	OSSL_PARAM_octet_string(OSSL_MAC_PARAM_KEY, NULL, 0),
+	OSSL_PARAM_octet_string(OSSL_MAC_PARAM_IV, NULL, 0),
+	OSSL_PARAM_END
+};
+
+static const OSSL_PARAM *uadk_prov_gmac_settable_ctx_params_fn(ossl_unused void *ctx,
+							       ossl_unused void *provctx)
+{
+	return uadk_prov_gmac_settable_ctx_params;
+}
+
+#define UADK_MAC_DESCR(nm, typ)							\
+static OSSL_FUNC_mac_newctx_fn uadk_prov_##nm##_newctx;				\
+static void *uadk_prov_##nm##_newctx(void *provctx)				\
+{										\
+	return uadk_prov_mac_newctx(provctx, typ);				\
+}										\
+const OSSL_DISPATCH uadk_##nm##_functions[] = {					\
+	{ OSSL_FUNC_MAC_NEWCTX, (void (*)(void))uadk_prov_##nm##_newctx },	\
+	{ OSSL_FUNC_MAC_DUPCTX, (void (*)(void))uadk_prov_mac_dupctx },		\
+	{ OSSL_FUNC_MAC_FREECTX, (void (*)(void))uadk_prov_mac_freectx },	\
+	{ OSSL_FUNC_MAC_INIT, (void (*)(void))uadk_prov_mac_init },		\
+	{ OSSL_FUNC_MAC_UPDATE, (void (*)(void))uadk_prov_mac_update },		\
+	{ OSSL_FUNC_MAC_FINAL, (void (*)(void))uadk_prov_mac_final },		\
+	{ OSSL_FUNC_MAC_GETTABLE_CTX_PARAMS,					\
+		(void (*)(void))uadk_prov_##nm##_gettable_ctx_params },		\
+	{ OSSL_FUNC_MAC_GET_CTX_PARAMS,						\
+		(void (*)(void))uadk_prov_mac_get_ctx_params },			\
+	{ OSSL_FUNC_MAC_SETTABLE_CTX_PARAMS,					\
+		(void (*)(void))uadk_prov_##nm##_settable_ctx_params_fn },	\
+	{ OSSL_FUNC_MAC_SET_CTX_PARAMS,						\
+		(void (*)(void))uadk_prov_mac_set_ctx_params },			\
+	{ 0, NULL }								\
+}
+
+UADK_MAC_DESCR(cmac, UADK_MAC_CMAC);
+UADK_MAC_DESCR(gmac, UADK_MAC_GMAC);
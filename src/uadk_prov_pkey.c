@@ -17,6 +17,8 @@
  *
  */
 #include "uadk_prov_pkey.h"
+#include "uadk_prov_rand.h"
+#include "uadk_ecc_curve.h"
 #include "uadk_utils.h"
 
 #define ECC_TYPE		5
@@ -45,8 +47,20 @@ struct ecc_prov {
 	int pid;
 };
 
+struct ecc_sess_cache {
+	int pid;
+	/* bumped on every flush, sessions of an older generation are stale */
+	unsigned int gen;
+	unsigned int num;
+	/* most recently used first */
+	struct uadk_ecc_sess *head;
+	struct uadk_ecc_sess *tail;
+};
+
 static struct ecc_prov g_ecc_prov;
 static pthread_mutex_t ecc_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct ecc_sess_cache g_ecc_sess_cache;
+static pthread_mutex_t ecc_sess_mutex = PTHREAD_MUTEX_INITIALIZER;
 
 /* Mapping between a flag and a name */
 static const OSSL_ITEM encoding_nameid_map[] = {
@@ -123,60 +137,35 @@ void uadk_prov_ecc_fill_req(struct wd_ecc_req *req, unsigned int op,
 	req->dst = out;
 }
 
+static bool ecc_rand_is_zero(const char *k, size_t len)
+{
+	char acc = 0;
+	size_t i;
+
+	for (i = 0; i < len; i++)
+		acc |= k[i];
+
+	return !acc;
+}
+
 int uadk_prov_ecc_get_rand(char *out, size_t out_len, void *usr)
 {
 	int count = GET_RAND_MAX_CNT;
-	BIGNUM *k;
-	int ret;
 
 	if (out == NULL) {
 		UADK_ERR("out is NULL\n");
 		return UADK_P_INVALID;
 	}
 
-	k = BN_new();
-	if (k == NULL)
-		return -ENOMEM;
-
+	/* carved out of a block of the thread, no DRBG call for most scalars */
 	do {
-		ret = BN_priv_rand_range(k, usr);
-		if (ret == 0) {
-			UADK_ERR("failed to BN_priv_rand_range\n");
-			ret = -EINVAL;
-			goto err;
+		if (!uadk_prov_rand_range((void *)out, out_len, usr)) {
+			UADK_ERR("failed to get random k\n");
+			return -EINVAL;
 		}
+	} while (--count >= 0 && ecc_rand_is_zero(out, out_len));
 
-		ret = BN_bn2binpad(k, (void *)out, (int)out_len);
-		if (ret < 0) {
-			ret = -EINVAL;
-			UADK_ERR("failed to BN_bn2binpad\n");
-			goto err;
-		}
-	} while (--count >= 0 && BN_is_zero(k));
-
-	ret = 0;
-	if (count < 0)
-		ret = UADK_P_INVALID;
-err:
-	BN_free(k);
-
-	return ret;
-}
-
-static void uadk_prov_init_dtb_param(void *dtb, char *start,
-				     __u32 dsz, __u32 bsz, __u32 num)
-{
-	struct wd_dtb *tmp = dtb;
-	char *buff = start;
-	__u32 i = 0;
-
-	while (i++ < num) {
-		tmp->data = buff;
-		tmp->dsize = dsz;
-		tmp->bsize = bsz;
-		tmp += 1;
-		buff += bsz;
-	}
+	return count < 0 ? UADK_P_INVALID : 0;
 }
 
 int uadk_prov_get_affine_coordinates(const EC_GROUP *group, const EC_POINT *p,
@@ -192,156 +181,369 @@ int uadk_prov_get_affine_coordinates(const EC_GROUP *group, const EC_POINT *p,
 	return UADK_P_SUCCESS;
 }
 
-static int uadk_prov_get_curve(const EC_GROUP *group, BIGNUM *p, BIGNUM *a,
-			       BIGNUM *b, BN_CTX *ctx)
+static handle_t ecc_alloc_sess(const EC_KEY *eckey, const char *alg,
+			       const BIGNUM *order, const struct wd_hash_mt *hash)
 {
-# if OPENSSL_VERSION_NUMBER > 0x10101000L
-	if (!EC_GROUP_get_curve(group, p, a, b, ctx))
-		return UADK_P_FAIL;
-# else
-	if (!EC_GROUP_get_curve_GFp(group, p, a, b, ctx))
-		return UADK_P_FAIL;
-# endif
-	return UADK_P_SUCCESS;
+	struct sched_params sch_p = {0};
+	struct uadk_ecc_curve_buf cv_buf;
+	struct wd_ecc_sess_setup sp;
+	handle_t sess;
+	int ret;
+
+	memset(&sp, 0, sizeof(sp));
+	/* sm2 runs on its standard curve, the others take it from the key */
+	if (strcmp(alg, "sm2")) {
+		ret = uadk_ecc_curve_set_cfg(EC_KEY_get0_group(eckey), &sp.cv, &cv_buf);
+		if (ret) {
+			UADK_ERR("failed to set ecc curve cfg\n");
+			return (handle_t)0;
+		}
+		sp.key_bits = uadk_prov_ecc_get_hw_keybits(BN_num_bits(order));
+	}
+
+	if (hash)
+		sp.hash = *hash;
+	sp.alg = alg;
+	sp.rand.cb = uadk_prov_ecc_get_rand;
+	sp.rand.usr = (void *)order;
+	/* Use the default numa parameters */
+	sch_p.numa_id = -1;
+	sp.sched_param = &sch_p;
+	sess = wd_ecc_alloc_sess(&sp);
+	if (sess == (handle_t)0)
+		UADK_ERR("failed to alloc ecc sess\n");
+
+	return sess;
 }
 
-static void uadk_prov_fill_ecc_cv_param(struct wd_ecc_curve *ecc_param,
-					struct curve_param *cv_param,
-					BIGNUM *g_x, BIGNUM *g_y)
+handle_t uadk_prov_ecc_alloc_sess(const EC_KEY *eckey, const char *alg)
 {
-	ecc_param->p.dsize = BN_bn2bin(cv_param->p, (void *)ecc_param->p.data);
-	ecc_param->a.dsize = BN_bn2bin(cv_param->a, (void *)ecc_param->a.data);
-	if (ecc_param->a.dsize == 0) {
-		ecc_param->a.dsize = 1;
-		ecc_param->a.data[0] = 0;
+	const BIGNUM *order;
+
+	if (!eckey) {
+		UADK_ERR("input eckey is NULL\n");
+		return (handle_t)0;
 	}
 
-	ecc_param->b.dsize = BN_bn2bin(cv_param->b, (void *)ecc_param->b.data);
-	if (ecc_param->b.dsize == 0) {
-		ecc_param->b.dsize = 1;
-		ecc_param->b.data[0] = 0;
+	order = EC_GROUP_get0_order(EC_KEY_get0_group(eckey));
+	if (order == NULL) {
+		UADK_ERR("failed to get ecc order\n");
+		return (handle_t)0;
 	}
 
-	ecc_param->g.x.dsize = BN_bn2bin(g_x, (void *)ecc_param->g.x.data);
-	ecc_param->g.y.dsize = BN_bn2bin(g_y, (void *)ecc_param->g.y.data);
-	ecc_param->n.dsize = BN_bn2bin(cv_param->order, (void *)ecc_param->n.data);
+	return ecc_alloc_sess(eckey, alg, order, NULL);
 }
 
-static int uadk_prov_set_sess_setup_cv(const EC_GROUP *group,
-				       struct wd_ecc_curve_cfg *cv)
+static int ecc_sess_fill_key(struct uadk_ecc_sess *ecc_sess, const EC_KEY *eckey,
+			     const EC_GROUP *group)
 {
-	struct wd_ecc_curve *ecc_param = cv->cfg.pparam;
-	struct curve_param *cv_param;
-	int ret = UADK_P_FAIL;
-	BIGNUM *g_x, *g_y;
-	BN_CTX *bn_ctx;
+	const EC_POINT *point;
+	const BIGNUM *d;
+	size_t len;
 
-	bn_ctx = BN_CTX_new();
-	if (bn_ctx == NULL)
-		return ret;
+	if (ecc_sess->key_type == UADK_ECC_SESS_PRIKEY) {
+		d = EC_KEY_get0_private_key(eckey);
+		if (d == NULL) {
+			UADK_ERR("private key not set\n");
+			return UADK_P_FAIL;
+		}
+
+		len = BITS_TO_BYTES(EC_GROUP_get_degree(group));
+		if (len > UADK_ECC_MAX_KEY_BYTES ||
+		    BN_bn2binpad(d, ecc_sess->key, len) < 0) {
+			UADK_ERR("invalid ecc prikey\n");
+			return UADK_P_FAIL;
+		}
+	} else {
+		point = EC_KEY_get0_public_key(eckey);
+		if (point == NULL) {
+			UADK_ERR("pubkey not set!\n");
+			return UADK_P_FAIL;
+		}
 
-	BN_CTX_start(bn_ctx);
+		len = EC_POINT_point2oct(group, point, POINT_CONVERSION_UNCOMPRESSED,
+					 ecc_sess->key, sizeof(ecc_sess->key), NULL);
+		if (len == 0 || ecc_sess->key[0] != UADK_OCTET_STRING) {
+			UADK_ERR("EC_POINT_point2oct error.\n");
+			return UADK_P_FAIL;
+		}
+	}
 
-	cv_param = OPENSSL_malloc(sizeof(struct curve_param));
-	if (cv_param == NULL)
-		goto free_ctx;
+	ecc_sess->key_len = len;
 
-	cv_param->p = BN_CTX_get(bn_ctx);
-	if (cv_param->p == NULL)
-		goto free_cv;
+	return UADK_P_SUCCESS;
+}
 
-	cv_param->a = BN_CTX_get(bn_ctx);
-	if (cv_param->a == NULL)
-		goto free_cv;
+static int ecc_sess_load_key(struct uadk_ecc_sess *ecc_sess)
+{
+	struct wd_ecc_key *ecc_key = wd_ecc_get_key(ecc_sess->sess);
+	struct wd_ecc_point pubkey;
+	struct wd_dtb prikey;
+	unsigned int len;
+	int ret;
 
-	cv_param->b = BN_CTX_get(bn_ctx);
-	if (cv_param->b == NULL)
-		goto free_cv;
+	if (ecc_sess->key_type == UADK_ECC_SESS_PRIKEY) {
+		prikey.data = (void *)ecc_sess->key;
+		prikey.dsize = ecc_sess->key_len;
+		ret = wd_ecc_set_prikey(ecc_key, &prikey);
+		if (ret) {
+			UADK_ERR("failed to set ecc prikey, ret = %d\n", ret);
+			return UADK_P_FAIL;
+		}
+	} else {
+		len = ecc_sess->key_len / UADK_ECC_PUBKEY_PARAM_NUM;
+		pubkey.x.data = (char *)ecc_sess->key + 1;
+		pubkey.x.dsize = len;
+		pubkey.y.data = pubkey.x.data + len;
+		pubkey.y.dsize = len;
+		ret = wd_ecc_set_pubkey(ecc_key, &pubkey);
+		if (ret) {
+			UADK_ERR("failed to set ecc pubkey\n");
+			return UADK_P_FAIL;
+		}
+	}
 
-	g_x = BN_CTX_get(bn_ctx);
-	if (g_x == NULL)
-		goto free_cv;
+	return UADK_P_SUCCESS;
+}
 
-	g_y = BN_CTX_get(bn_ctx);
-	if (g_y == NULL)
-		goto free_cv;
+static void ecc_sess_free(struct uadk_ecc_sess *ecc_sess)
+{
+	/* sessions inherited over fork belong to the parent's queues */
+	if (ecc_sess->sess && ecc_sess->pid == getpid())
+		wd_ecc_free_sess(ecc_sess->sess);
+	BN_free(ecc_sess->order);
+	EVP_MD_free(ecc_sess->md);
+	OPENSSL_clear_free(ecc_sess, sizeof(struct uadk_ecc_sess));
+}
 
-	ret = uadk_prov_get_curve(group, cv_param->p, cv_param->a, cv_param->b, bn_ctx);
-	if (ret == 0)
-		goto free_cv;
+/* the key is loaded for each operation, it takes no part in the match */
+static bool ecc_sess_match(const struct uadk_ecc_sess *a, const struct uadk_ecc_sess *b)
+{
+	return a->nid == b->nid && a->key_type == b->key_type &&
+	       a->hash_type == b->hash_type && !strcmp(a->alg, b->alg);
+}
 
-	cv_param->g = EC_GROUP_get0_generator(group);
-	if (cv_param->g == NULL)
-		goto free_cv;
+static void ecc_sess_unlink(struct ecc_sess_cache *cache, struct uadk_ecc_sess *ecc_sess)
+{
+	if (ecc_sess->prev)
+		ecc_sess->prev->next = ecc_sess->next;
+	else
+		cache->head = ecc_sess->next;
 
-	ret = uadk_prov_get_affine_coordinates(group, cv_param->g, g_x, g_y, bn_ctx);
-	if (ret == 0)
-		goto free_cv;
+	if (ecc_sess->next)
+		ecc_sess->next->prev = ecc_sess->prev;
+	else
+		cache->tail = ecc_sess->prev;
 
-	cv_param->order = EC_GROUP_get0_order(group);
-	if (cv_param->order == NULL)
-		goto free_cv;
+	ecc_sess->prev = NULL;
+	ecc_sess->next = NULL;
+	cache->num--;
+}
 
-	uadk_prov_fill_ecc_cv_param(ecc_param, cv_param, g_x, g_y);
-	cv->type = WD_CV_CFG_PARAM;
-	ret = UADK_P_SUCCESS;
+/* called with ecc_sess_mutex held, returns the list for the caller to free */
+static struct uadk_ecc_sess *ecc_sess_cache_detach(struct ecc_sess_cache *cache)
+{
+	struct uadk_ecc_sess *list = cache->head;
 
-free_cv:
-	OPENSSL_free(cv_param);
-free_ctx:
-	BN_CTX_end(bn_ctx);
-	BN_CTX_free(bn_ctx);
+	cache->head = NULL;
+	cache->tail = NULL;
+	cache->num = 0;
+	__atomic_add_fetch(&cache->gen, 1, __ATOMIC_RELEASE);
 
-	return ret;
+	return list;
 }
 
-handle_t uadk_prov_ecc_alloc_sess(const EC_KEY *eckey, const char *alg)
+static void ecc_sess_free_list(struct uadk_ecc_sess *list)
 {
-	char buff[UADK_ECC_MAX_KEY_BYTES * UADK_ECC_CV_PARAM_NUM];
-	struct sched_params sch_p = {0};
-	struct wd_ecc_sess_setup sp;
-	struct wd_ecc_curve param;
-	const EC_GROUP *group;
-	const BIGNUM *order;
-	int ret, key_bits;
-	handle_t sess;
+	struct uadk_ecc_sess *next;
 
-	if (!eckey) {
-		UADK_ERR("input eckey is NULL\n");
-		return (handle_t)0;
+	while (list) {
+		next = list->next;
+		ecc_sess_free(list);
+		list = next;
 	}
+}
 
-	uadk_prov_init_dtb_param(&param, buff, 0, UADK_ECC_MAX_KEY_BYTES,
-				 UADK_ECC_CV_PARAM_NUM);
+/* called with ecc_sess_mutex held, drops what a forked child inherited */
+static struct uadk_ecc_sess *ecc_sess_cache_check_pid(struct ecc_sess_cache *cache)
+{
+	if (cache->pid == getpid())
+		return NULL;
 
-	memset(&sp, 0, sizeof(sp));
-	sp.cv.cfg.pparam = &param;
-	group = EC_KEY_get0_group(eckey);
-	ret = uadk_prov_set_sess_setup_cv(group, &sp.cv);
-	if (ret == 0) {
-		UADK_ERR("failed to set_sess_setup_cv\n");
-		return (handle_t)0;
+	cache->pid = getpid();
+
+	return ecc_sess_cache_detach(cache);
+}
+
+static struct uadk_ecc_sess *ecc_sess_cache_take(const struct uadk_ecc_sess *want)
+{
+	struct ecc_sess_cache *cache = &g_ecc_sess_cache;
+	struct uadk_ecc_sess *ecc_sess, *stale;
+
+	pthread_mutex_lock(&ecc_sess_mutex);
+	stale = ecc_sess_cache_check_pid(cache);
+	for (ecc_sess = cache->head; ecc_sess; ecc_sess = ecc_sess->next) {
+		if (ecc_sess_match(ecc_sess, want)) {
+			ecc_sess_unlink(cache, ecc_sess);
+			break;
+		}
 	}
+	pthread_mutex_unlock(&ecc_sess_mutex);
+
+	ecc_sess_free_list(stale);
+
+	return ecc_sess;
+}
 
+/*
+ * Return a session for the key, either one of the same curve cached by an
+ * earlier operation or a new one, with the key loaded. The session is owned
+ * by the caller until uadk_prov_ecc_put_sess, so concurrent users of one
+ * key work on separate sessions.
+ */
+struct uadk_ecc_sess *uadk_prov_ecc_get_sess(const EC_KEY *eckey,
+					     const struct uadk_ecc_sess_cfg *cfg)
+{
+	struct uadk_ecc_sess *ecc_sess, *cached;
+	struct wd_hash_mt hash = {0};
+	const EC_GROUP *group;
+	const BIGNUM *order;
+
+	if (!eckey || !cfg || !cfg->alg) {
+		UADK_ERR("invalid: eckey or cfg is NULL\n");
+		return NULL;
+	}
+
+	group = EC_KEY_get0_group(eckey);
 	order = EC_GROUP_get0_order(group);
 	if (order == NULL) {
 		UADK_ERR("failed to get ecc order\n");
-		return (handle_t)0;
+		return NULL;
 	}
 
-	key_bits = BN_num_bits(order);
-	sp.alg = alg;
-	sp.key_bits = uadk_prov_ecc_get_hw_keybits(key_bits);
-	sp.rand.cb = uadk_prov_ecc_get_rand;
-	sp.rand.usr = (void *)order;
-	/* Use the default numa parameters */
-	sch_p.numa_id = -1;
-	sp.sched_param = &sch_p;
-	sess = wd_ecc_alloc_sess(&sp);
-	if (sess == (handle_t)0)
-		UADK_ERR("failed to alloc ecc sess\n");
+	ecc_sess = OPENSSL_zalloc(sizeof(struct uadk_ecc_sess));
+	if (!ecc_sess)
+		return NULL;
+
+	ecc_sess->alg = cfg->alg;
+	ecc_sess->key_type = cfg->key_type;
+	ecc_sess->hash_type = cfg->md ? cfg->hash_type : -1;
+	/* explicit curve parameters are not worth a lookup key, no caching */
+	ecc_sess->nid = EC_GROUP_get_curve_name(group);
+	ecc_sess->pid = getpid();
+	if (!ecc_sess_fill_key(ecc_sess, eckey, group))
+		goto free_sess;
+
+	if (ecc_sess->nid != NID_undef) {
+		cached = ecc_sess_cache_take(ecc_sess);
+		if (cached) {
+			memcpy(cached->key, ecc_sess->key, ecc_sess->key_len);
+			cached->key_len = ecc_sess->key_len;
+			OPENSSL_clear_free(ecc_sess, sizeof(struct uadk_ecc_sess));
+			ecc_sess = cached;
+			goto load_key;
+		}
+	}
 
-	return sess;
+	ecc_sess->gen = __atomic_load_n(&g_ecc_sess_cache.gen, __ATOMIC_ACQUIRE);
+	ecc_sess->order = BN_dup(order);
+	if (!ecc_sess->order)
+		goto free_sess;
+
+	if (cfg->md) {
+		if (!EVP_MD_up_ref((EVP_MD *)cfg->md))
+			goto free_sess;
+		ecc_sess->md = (EVP_MD *)cfg->md;
+		hash.type = cfg->hash_type;
+		hash.cb = cfg->hash_cb;
+		hash.usr = ecc_sess->md;
+	}
+
+	ecc_sess->sess = ecc_alloc_sess(eckey, cfg->alg, ecc_sess->order,
+					cfg->md ? &hash : NULL);
+	if (ecc_sess->sess == (handle_t)0)
+		goto free_sess;
+
+load_key:
+	if (!ecc_sess_load_key(ecc_sess))
+		goto free_sess;
+	OPENSSL_cleanse(ecc_sess->key, ecc_sess->key_len);
+
+	return ecc_sess;
+
+free_sess:
+	ecc_sess_free(ecc_sess);
+	return NULL;
+}
+
+/* a private key must not stay in a cached session after its EC_KEY is gone */
+static int ecc_sess_wipe_key(struct uadk_ecc_sess *ecc_sess)
+{
+	if (ecc_sess->key_type != UADK_ECC_SESS_PRIKEY)
+		return UADK_P_SUCCESS;
+
+	OPENSSL_cleanse(ecc_sess->key, ecc_sess->key_len);
+
+	return ecc_sess_load_key(ecc_sess);
+}
+
+/*
+ * Give back a session of uadk_prov_ecc_get_sess. Only one whose operation
+ * went through is cached, after an error it may still be in a bad state.
+ */
+void uadk_prov_ecc_put_sess(struct uadk_ecc_sess *ecc_sess, bool reuse)
+{
+	struct ecc_sess_cache *cache = &g_ecc_sess_cache;
+	struct uadk_ecc_sess *victim = NULL;
+	struct uadk_ecc_sess *stale;
+
+	if (!ecc_sess)
+		return;
+
+	if (!reuse || ecc_sess->nid == NID_undef || ecc_sess->pid != getpid() ||
+	    !ecc_sess_wipe_key(ecc_sess)) {
+		ecc_sess_free(ecc_sess);
+		return;
+	}
+
+	pthread_mutex_lock(&ecc_sess_mutex);
+	stale = ecc_sess_cache_check_pid(cache);
+	/* the ecc env was re-initialised while the session was out */
+	if (ecc_sess->gen != cache->gen) {
+		pthread_mutex_unlock(&ecc_sess_mutex);
+		ecc_sess_free_list(stale);
+		ecc_sess_free(ecc_sess);
+		return;
+	}
+
+	ecc_sess->next = cache->head;
+	if (cache->head)
+		cache->head->prev = ecc_sess;
+	else
+		cache->tail = ecc_sess;
+	cache->head = ecc_sess;
+	cache->num++;
+
+	if (cache->num > UADK_ECC_SESS_CACHE_MAX) {
+		victim = cache->tail;
+		ecc_sess_unlink(cache, victim);
+	}
+	pthread_mutex_unlock(&ecc_sess_mutex);
+
+	ecc_sess_free_list(stale);
+	if (victim)
+		ecc_sess_free(victim);
+}
+
+static void ecc_sess_cache_flush(void)
+{
+	struct uadk_ecc_sess *list;
+
+	pthread_mutex_lock(&ecc_sess_mutex);
+	list = ecc_sess_cache_detach(&g_ecc_sess_cache);
+	pthread_mutex_unlock(&ecc_sess_mutex);
+
+	ecc_sess_free_list(list);
 }
 
 void uadk_prov_ecc_cb(void *req_t)
@@ -456,6 +658,269 @@ int uadk_prov_ecc_poll(void *ctx)
 	return -ETIMEDOUT;
 }
 
+/*
+ * Batch requests complete in any order, each one bumps the shared counter
+ * once its status is in place.
+ */
+struct ecc_batch_cb {
+	struct wd_ecc_req *req;
+	size_t *done;
+};
+
+/*
+ * The requests of a chunk in flight, with the counter their callbacks bump.
+ * It belongs to the hardware until every request sent is back.
+ */
+struct ecc_batch {
+	struct wd_ecc_req reqs[UADK_ECC_BATCH_CHUNK];
+	struct ecc_batch_cb cbs[UADK_ECC_BATCH_CHUNK];
+	size_t done;
+};
+
+static void ecc_batch_cb(void *req_t)
+{
+	struct wd_ecc_req *req_new = (struct wd_ecc_req *)req_t;
+	struct ecc_batch_cb *cb;
+
+	if (!req_new || !req_new->cb_param)
+		return;
+
+	cb = req_new->cb_param;
+	cb->req->status = req_new->status;
+	__atomic_add_fetch(cb->done, 1, __ATOMIC_RELEASE);
+}
+
+/*
+ * Send all the requests before waiting for any, polling whenever the queue
+ * is full, then poll until every sent one has come back. A request that
+ * could not be sent keeps POLL_ERROR as its status. -ETIMEDOUT means some
+ * are still out, and the batch must be neither reused nor freed.
+ */
+static int ecc_crypto_batch(handle_t sess, struct ecc_batch *b, size_t num)
+{
+	size_t sent = 0, done;
+	unsigned int recv;
+	__u64 cnt = 0;
+	size_t i;
+	int ret;
+
+	b->done = 0;
+	for (i = 0; i < num; i++) {
+		b->cbs[i].req = &b->reqs[i];
+		b->cbs[i].done = &b->done;
+		b->reqs[i].cb = ecc_batch_cb;
+		b->reqs[i].cb_param = &b->cbs[i];
+		b->reqs[i].status = POLL_ERROR;
+	}
+
+	while (sent < num) {
+		ret = wd_do_ecc_async(sess, &b->reqs[sent]);
+		if (likely(!ret)) {
+			sent++;
+			cnt = 0;
+			continue;
+		}
+
+		if (ret != -EBUSY) {
+			UADK_ERR("failed to do ecc batch async, ret = %d\n", ret);
+			break;
+		}
+
+		/* make room by taking back what is done so far */
+		ret = wd_ecc_poll(1, &recv);
+		if (ret < 0 || unlikely(++cnt > PROV_SEND_MAX_CNT)) {
+			UADK_ERR("do ecc batch async operation timeout\n");
+			break;
+		}
+	}
+
+	/* a poll error does not give the requests back, keep on until timeout */
+	cnt = 0;
+	while ((done = __atomic_load_n(&b->done, __ATOMIC_ACQUIRE)) < sent) {
+		recv = 0;
+		ret = wd_ecc_poll(sent - done, &recv);
+		if (ret >= 0 && recv)
+			cnt = 0;
+		else if (unlikely(++cnt > PROV_SCH_RECV_MAX_CNT)) {
+			UADK_ERR("failed to recv ecc batch, ret = %d: timeout!\n", ret);
+			return -ETIMEDOUT;
+		}
+	}
+
+	return sent == num ? UADK_P_SUCCESS : UADK_P_FAIL;
+}
+
+static int uadk_prov_batch_item_params(const OSSL_PARAM *p)
+{
+	return p[0].key && !strcmp(p[0].key, UADK_PROV_PARAM_BATCH_TBS) &&
+	       p[0].data_type == OSSL_PARAM_OCTET_STRING && p[0].data &&
+	       p[1].key && !strcmp(p[1].key, UADK_PROV_PARAM_BATCH_SIG) &&
+	       p[1].data_type == OSSL_PARAM_OCTET_STRING && p[1].data &&
+	       p[2].key && !strcmp(p[2].key, UADK_PROV_PARAM_BATCH_STATUS) &&
+	       p[2].data_type == OSSL_PARAM_INTEGER;
+}
+
+/*
+ * The batch of a signature get_ctx_params call, or NULL if there is none
+ * or it does not fit the operation the ctx was set up for. The items have
+ * to follow the op, and done has to follow the items.
+ */
+struct uadk_prov_batch *uadk_prov_batch_new(OSSL_PARAM params[], int operation, int *ret)
+{
+	struct uadk_prov_batch *batch;
+	OSSL_PARAM *p, *op;
+	unsigned int op_id;
+	size_t num, i;
+
+	*ret = UADK_P_SUCCESS;
+	op = OSSL_PARAM_locate(params, UADK_PROV_PARAM_BATCH_OP);
+	if (!op)
+		return NULL;
+
+	*ret = UADK_P_FAIL;
+	if (!OSSL_PARAM_get_uint(op, &op_id) ||
+	    (op_id == UADK_PROV_BATCH_SIGN && operation != EVP_PKEY_OP_SIGN) ||
+	    (op_id == UADK_PROV_BATCH_VERIFY && operation != EVP_PKEY_OP_VERIFY) ||
+	    (op_id != UADK_PROV_BATCH_SIGN && op_id != UADK_PROV_BATCH_VERIFY)) {
+		UADK_ERR("invalid: batch op does not match the ctx!\n");
+		return NULL;
+	}
+
+	for (p = op + 1, num = 0; uadk_prov_batch_item_params(p); num++)
+		p += UADK_PROV_BATCH_ITEM_PARAMS;
+
+	if (!p->key || strcmp(p->key, UADK_PROV_PARAM_BATCH_DONE) ||
+	    p->data_type != OSSL_PARAM_UNSIGNED_INTEGER) {
+		UADK_ERR("invalid: batch item %zu or done is malformed!\n", num);
+		return NULL;
+	}
+
+	batch = OPENSSL_zalloc(sizeof(*batch));
+	if (!batch)
+		return NULL;
+
+	if (num) {
+		batch->items = OPENSSL_zalloc(num * sizeof(*batch->items));
+		if (!batch->items) {
+			OPENSSL_free(batch);
+			return NULL;
+		}
+	}
+
+	batch->op = op_id;
+	batch->num = num;
+	batch->item_params = op + 1;
+	batch->done_param = p;
+	for (i = 0, p = op + 1; i < num; i++, p += UADK_PROV_BATCH_ITEM_PARAMS) {
+		batch->items[i].tbs = p[0].data;
+		batch->items[i].tbslen = p[0].data_size;
+		batch->items[i].sig = p[1].data;
+		batch->items[i].siglen = p[1].data_size;
+	}
+
+	*ret = UADK_P_SUCCESS;
+
+	return batch;
+}
+
+/*
+ * Write the results of the items done back to the params, then free the
+ * batch. A batch that stopped part way is no error, the caller takes the
+ * items after done one by one.
+ */
+int uadk_prov_batch_free(struct uadk_prov_batch *batch)
+{
+	struct uadk_prov_batch_item *item;
+	int ret = UADK_P_SUCCESS;
+	OSSL_PARAM *p;
+	size_t i;
+
+	if (batch->done > batch->num)
+		batch->done = 0;
+
+	for (i = 0; i < batch->done; i++) {
+		item = &batch->items[i];
+		p = batch->item_params + i * UADK_PROV_BATCH_ITEM_PARAMS;
+		if (batch->op == UADK_PROV_BATCH_SIGN && item->status)
+			p[1].return_size = item->siglen;
+		if (!OSSL_PARAM_set_int(&p[2], item->status))
+			batch->done = i;
+	}
+
+	if (!OSSL_PARAM_set_size_t(batch->done_param, batch->done))
+		ret = UADK_P_FAIL;
+
+	OPENSSL_free(batch->items);
+	OPENSSL_free(batch);
+
+	return ret;
+}
+
+/*
+ * Run a signature batch on one session, UADK_ECC_BATCH_CHUNK requests in
+ * flight at most. Items the hardware could not take, or that came back
+ * with an error, go through the single shot path with its soft fallback.
+ * When a chunk does not come back the batch fails, with the items before
+ * it done, and the caller takes the rest one by one.
+ */
+int uadk_prov_ecc_batch(void *ctx, handle_t sess, struct uadk_prov_batch *batch,
+			const struct uadk_ecc_batch_ops *ops)
+{
+	struct uadk_prov_batch_item *item;
+	struct ecc_batch *b = NULL;
+	size_t idx[UADK_ECC_BATCH_CHUNK];
+	size_t base, n, m, i;
+	int ret;
+
+	if (sess) {
+		b = OPENSSL_malloc(sizeof(*b));
+		if (!b)
+			sess = 0;
+	}
+
+	for (base = 0; base < batch->num; base += n) {
+		n = batch->num - base;
+		if (n > UADK_ECC_BATCH_CHUNK)
+			n = UADK_ECC_BATCH_CHUNK;
+
+		for (i = 0, m = 0; i < n; i++) {
+			item = &batch->items[base + i];
+			item->status = 0;
+			if (sess) {
+				memset(&b->reqs[m], 0, sizeof(b->reqs[m]));
+				if (ops->prepare(ctx, sess, item, &b->reqs[m]) == UADK_P_SUCCESS) {
+					idx[m++] = base + i;
+					continue;
+				}
+			}
+			item->status = ops->single(ctx, item);
+		}
+
+		if (!m)
+			continue;
+
+		ret = ecc_crypto_batch(sess, b, m);
+		if (ret == -ETIMEDOUT) {
+			/* a late request still writes to it, so it is not freed */
+			batch->done = base;
+			return UADK_P_FAIL;
+		}
+
+		for (i = 0; i < m; i++) {
+			item = &batch->items[idx[i]];
+			ret = ops->finish(ctx, item, &b->reqs[i]);
+			ops->release(sess, &b->reqs[i]);
+			if (ret != UADK_P_SUCCESS)
+				item->status = ops->single(ctx, item);
+		}
+	}
+
+	OPENSSL_free(b);
+	batch->done = batch->num;
+
+	return UADK_P_SUCCESS;
+}
+
 static int set_group(OSSL_PARAM_BLD *bld, struct ec_gen_ctx *gctx)
 {
 	OSSL_PARAM *params = NULL;
@@ -812,6 +1277,7 @@ static void uadk_prov_ecc_mutex_infork(void)
 {
 	/* Release the replication lock of the child process */
 	pthread_mutex_unlock(&ecc_mutex);
+	pthread_mutex_unlock(&ecc_sess_mutex);
 }
 
 int uadk_prov_ecc_init(const char *alg_name)
@@ -845,6 +1311,9 @@ void uadk_prov_ecc_uninit(void)
 {
 	pthread_mutex_lock(&ecc_mutex);
 	if (g_ecc_prov.pid == getpid()) {
+		/* cached sessions hold ctxs released by wd_ecc_uninit2 */
+		ecc_sess_cache_flush();
+		uadk_prov_ecx_sess_pool_flush();
 		wd_ecc_uninit2();
 		g_ecc_prov.pid = 0;
 	}
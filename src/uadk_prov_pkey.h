@@ -37,6 +37,7 @@
 #include <uadk/wd_sched.h>
 #include "uadk_async.h"
 #include "uadk_prov.h"
+#include "uadk_prov_batch.h"
 
 #define UADK_ECC_MAX_KEY_BITS		521
 #define UADK_ECC_MAX_KEY_BYTES		66
@@ -62,6 +63,9 @@
 #define GET_LS_BYTE(n)			((n) & 0xFF)
 
 #define SM2_KEY_BYTES			32
+/* idle ecc sessions kept for reuse, the least recently used goes first */
+#define UADK_ECC_SESS_CACHE_MAX		64
+#define UADK_ECC_SESS_KEY_BYTES		(1 + ECC_POINT_SIZE(UADK_ECC_MAX_KEY_BYTES))
 
 enum HW_ASYM_ENC_DEV {
 	HW_ASYM_ENC_INVALID = 0x0,
@@ -95,17 +99,73 @@ enum {
 	KEYEXCH_X25519 = 0x2,
 };
 
-struct curve_param {
-	/* Prime */
-	BIGNUM *p;
-	/* ECC coefficient 'a' */
-	BIGNUM *a;
-	/* ECC coefficient 'b' */
-	BIGNUM *b;
-	/* Base point */
-	const EC_POINT *g;
-	/* Order of base point */
-	const BIGNUM *order;
+enum {
+	UADK_ECC_SESS_PUBKEY,
+	UADK_ECC_SESS_PRIKEY,
+};
+
+/* what a cached ecc session is set up with, besides the curve */
+struct uadk_ecc_sess_cfg {
+	const char *alg;
+	/* UADK_ECC_SESS_PUBKEY or UADK_ECC_SESS_PRIKEY */
+	int key_type;
+	/* sm2 encrypt and decrypt only, NULL otherwise */
+	const EVP_MD *md;
+	__u8 hash_type;
+	wd_hash hash_cb;
+};
+
+/*
+ * A hardware session with the key already loaded. Sessions of named curves
+ * go back to an LRU cache on put, with the private key wiped, and are picked
+ * up again by the next operation with the same algorithm and curve, which
+ * loads its own key.
+ */
+struct uadk_ecc_sess {
+	handle_t sess;
+	struct uadk_ecc_sess *prev;
+	struct uadk_ecc_sess *next;
+	const char *alg;
+	int nid;
+	int key_type;
+	int hash_type;
+	int pid;
+	unsigned int gen;
+	/* only between taking the key and loading it into the session */
+	unsigned int key_len;
+	unsigned char key[UADK_ECC_SESS_KEY_BYTES];
+	/* own copies, the session callbacks outlive the caller's key and ctx */
+	BIGNUM *order;
+	EVP_MD *md;
+};
+
+/* requests of a signature batch in flight at a time */
+#define UADK_ECC_BATCH_CHUNK		64
+
+/* a batch of a signature get_ctx_params call, see uadk_prov_batch.h */
+struct uadk_prov_batch {
+	unsigned int op;
+	size_t num;
+	struct uadk_prov_batch_item *items;
+	/* the tbs param of the first item, its sig and status follow */
+	OSSL_PARAM *item_params;
+	OSSL_PARAM *done_param;
+	/* the first items, the ones with a result */
+	size_t done;
+};
+
+/*
+ * How a signature turns a batch item into a hardware request and back.
+ * prepare and finish return UADK_P_SUCCESS when the item is taken care of,
+ * anything else sends it to single, the usual one item operation.
+ */
+struct uadk_ecc_batch_ops {
+	int (*prepare)(void *ctx, handle_t sess, struct uadk_prov_batch_item *item,
+		       struct wd_ecc_req *req);
+	int (*finish)(void *ctx, struct uadk_prov_batch_item *item,
+		      struct wd_ecc_req *req);
+	void (*release)(handle_t sess, struct wd_ecc_req *req);
+	int (*single)(void *ctx, struct uadk_prov_batch_item *item);
 };
 
 struct ec_gen_ctx {
@@ -459,12 +519,20 @@ const OSSL_DISPATCH uadk_##nm##_keyexch_functions[] = {	\
 }	\
 
 handle_t uadk_prov_ecc_alloc_sess(const EC_KEY *eckey, const char *alg);
+struct uadk_ecc_sess *uadk_prov_ecc_get_sess(const EC_KEY *eckey,
+					     const struct uadk_ecc_sess_cfg *cfg);
+void uadk_prov_ecc_put_sess(struct uadk_ecc_sess *ecc_sess, bool reuse);
+void uadk_prov_ecx_sess_pool_flush(void);
 int uadk_prov_ecc_crypto(handle_t sess, struct wd_ecc_req *req, void *usr);
 int uadk_prov_keymgmt_get_support_state(int alg_tag);
 int uadk_prov_ecc_get_numa_id(void);
 void uadk_prov_ecc_cb(void *req_t);
 int uadk_prov_ecc_get_rand(char *out, size_t out_len, void *usr);
 int uadk_prov_ecc_poll(void *ctx);
+struct uadk_prov_batch *uadk_prov_batch_new(OSSL_PARAM params[], int operation, int *ret);
+int uadk_prov_batch_free(struct uadk_prov_batch *batch);
+int uadk_prov_ecc_batch(void *ctx, handle_t sess, struct uadk_prov_batch *batch,
+			const struct uadk_ecc_batch_ops *ops);
 int uadk_prov_ecc_genctx_check(struct ec_gen_ctx *gctx, EC_KEY *ec);
 void uadk_prov_keymgmt_alg(void);
 void uadk_prov_ecc_fill_req(struct wd_ecc_req *req, unsigned int op, void *in, void *out);
@@ -484,5 +552,11 @@ int uadk_prov_get_affine_coordinates(const EC_GROUP *group, const EC_POINT *p,
 int uadk_prov_securitycheck_enabled(OSSL_LIB_CTX *ctx);
 int uadk_prov_ecc_check_key(OSSL_LIB_CTX *ctx, const EC_KEY *ec, int protect);
 int uadk_prov_pkey_version(void);
+size_t uadk_prov_ec_keypair_size(int nid);
+int uadk_prov_ec_keypair_fill(void *arg, unsigned char *item, size_t size);
+size_t uadk_prov_ecx_keypair_size(int nid);
+int uadk_prov_ecx_keypair_fill(void *arg, unsigned char *item, size_t size);
+size_t uadk_prov_ecdsa_precomp_size(int nid);
+int uadk_prov_ecdsa_precomp_fill(void *arg, unsigned char *item, size_t size);
 
 #endif
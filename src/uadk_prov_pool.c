@@ -0,0 +1,511 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+ * Copyright 2024 Huawei Technologies Co.,Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <openssl/crypto.h>
+#include <openssl/ec.h>
+#include <openssl/objects.h>
+#include "uadk_prov.h"
+#include "uadk_prov_pkey.h"
+#include "uadk_prov_pool.h"
+#include "uadk_utils.h"
+
+/* a pool is refilled once it is down to half, up to full */
+#define UADK_POOL_LOW(num)		((num) >> 1)
+/* items made for a pool before the thread turns to the next one */
+#define UADK_POOL_FILL_BATCH		16
+#define UADK_POOL_IDLE_SEC		1
+/* a pool whose fill failed is left alone for a while */
+#define UADK_POOL_BACKOFF_SEC		5
+#define UADK_POOL_TAG_SHIFT		32
+#define UADK_POOL_IDX_MASK		0xffffffffULL
+#define UADK_KEYPOOL_MAX		16
+#define UADK_KEYPOOL_NAME_LEN		32
+#define DECIMAL				10
+
+struct uadk_prov_pool {
+	char name[UADK_KEYPOOL_NAME_LEN];
+	size_t item_size;
+	__u32 num;
+	uadk_prov_pool_fill_fn fill;
+	void *arg;
+	/* on the secure heap, wiped as each item is taken */
+	unsigned char *items;
+	__u32 *next;
+	/*
+	 * Lock-free stacks of filled and free slots. The head holds the slot
+	 * index plus one in the low half, 0 for an empty stack, and a tag in
+	 * the high half bumped on every change against ABA.
+	 */
+	__u64 full;
+	__u64 free;
+	__u32 avail;
+	/* set from the low watermark until the pool is full again */
+	int refill;
+	time_t retry_at;
+	__u64 hits;
+	__u64 misses;
+	struct uadk_prov_pool *link;
+};
+
+static struct {
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	pthread_t thread;
+	/* process the thread runs in, 0 when there is none */
+	int pid;
+	int stop;
+	int wake;
+	struct uadk_prov_pool *head;
+} g_pool = {
+	.mutex = PTHREAD_MUTEX_INITIALIZER,
+	.cond = PTHREAD_COND_INITIALIZER,
+};
+
+static pthread_once_t pool_once = PTHREAD_ONCE_INIT;
+
+enum uadk_keypool_type {
+	UADK_KEYPOOL_KEYPAIR,
+	UADK_KEYPOOL_ECDSA,
+};
+
+static struct uadk_keypool {
+	int nid;
+	enum uadk_keypool_type type;
+	struct uadk_prov_pool *pool;
+} g_keypool[UADK_KEYPOOL_MAX];
+static int g_keypool_num;
+
+static unsigned char *pool_slot(struct uadk_prov_pool *pool, __u32 idx)
+{
+	return pool->items + (size_t)(idx - 1) * pool->item_size;
+}
+
+static __u32 pool_pop(struct uadk_prov_pool *pool, __u64 *head)
+{
+	__u64 old, new;
+	__u32 idx;
+
+	old = __atomic_load_n(head, __ATOMIC_ACQUIRE);
+	do {
+		idx = old & UADK_POOL_IDX_MASK;
+		if (!idx)
+			return 0;
+
+		/* a stale next is harmless, the tag makes the exchange fail */
+		new = (((old >> UADK_POOL_TAG_SHIFT) + 1) << UADK_POOL_TAG_SHIFT) |
+		      __atomic_load_n(&pool->next[idx - 1], __ATOMIC_RELAXED);
+	} while (!__atomic_compare_exchange_n(head, &old, new, true,
+					      __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
+
+	return idx;
+}
+
+static void pool_push(struct uadk_prov_pool *pool, __u64 *head, __u32 idx)
+{
+	__u64 old, new;
+
+	old = __atomic_load_n(head, __ATOMIC_RELAXED);
+	do {
+		__atomic_store_n(&pool->next[idx - 1], (__u32)(old & UADK_POOL_IDX_MASK),
+				 __ATOMIC_RELAXED);
+		new = (((old >> UADK_POOL_TAG_SHIFT) + 1) << UADK_POOL_TAG_SHIFT) | idx;
+	} while (!__atomic_compare_exchange_n(head, &old, new, true,
+					      __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+/* with no other user of the pool: wipes it and puts every slot on the free stack */
+static void pool_reset(struct uadk_prov_pool *pool)
+{
+	__u32 i;
+
+	OPENSSL_cleanse(pool->items, pool->item_size * pool->num);
+	for (i = 0; i < pool->num; i++)
+		pool->next[i] = i;
+	pool->free = pool->num;
+	pool->full = 0;
+	pool->avail = 0;
+	pool->refill = 1;
+	pool->retry_at = 0;
+}
+
+static void pool_free_items(struct uadk_prov_pool *pool)
+{
+	if (!pool->items)
+		return;
+
+	if (CRYPTO_secure_allocated(pool->items))
+		OPENSSL_secure_clear_free(pool->items, pool->item_size * pool->num);
+	else
+		OPENSSL_clear_free(pool->items, pool->item_size * pool->num);
+}
+
+static time_t pool_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec;
+}
+
+/* returns 1 while the pool wants more */
+static int pool_refill(struct uadk_prov_pool *pool)
+{
+	unsigned int cnt;
+	__u32 idx;
+
+	if (!__atomic_load_n(&pool->refill, __ATOMIC_ACQUIRE) || pool_now() < pool->retry_at)
+		return 0;
+
+	for (cnt = 0; cnt < UADK_POOL_FILL_BATCH; cnt++) {
+		idx = pool_pop(pool, &pool->free);
+		if (!idx)
+			break;
+
+		if (pool->fill(pool->arg, pool_slot(pool, idx), pool->item_size) != UADK_P_SUCCESS) {
+			OPENSSL_cleanse(pool_slot(pool, idx), pool->item_size);
+			pool_push(pool, &pool->free, idx);
+			UADK_INFO("%s pool: failed to fill, retry in %d s\n",
+				  pool->name, UADK_POOL_BACKOFF_SEC);
+			pool->retry_at = pool_now() + UADK_POOL_BACKOFF_SEC;
+			return 0;
+		}
+
+		pool_push(pool, &pool->full, idx);
+		__atomic_add_fetch(&pool->avail, 1, __ATOMIC_RELEASE);
+	}
+
+	if (__atomic_load_n(&pool->avail, __ATOMIC_ACQUIRE) < pool->num)
+		return 1;
+
+	__atomic_store_n(&pool->refill, 0, __ATOMIC_RELEASE);
+	/* a get may have crossed the watermark before the flag went down */
+	if (__atomic_load_n(&pool->avail, __ATOMIC_ACQUIRE) <= UADK_POOL_LOW(pool->num)) {
+		__atomic_store_n(&pool->refill, 1, __ATOMIC_RELEASE);
+		return 1;
+	}
+
+	return 0;
+}
+
+static void *pool_thread(void *arg)
+{
+	struct uadk_prov_pool *pool, *head;
+	struct timespec ts;
+	int busy;
+
+	while (true) {
+		pthread_mutex_lock(&g_pool.mutex);
+		head = g_pool.head;
+		pthread_mutex_unlock(&g_pool.mutex);
+
+		busy = 0;
+		for (pool = head; pool; pool = pool->link)
+			busy |= pool_refill(pool);
+
+		pthread_mutex_lock(&g_pool.mutex);
+		if (!busy && !g_pool.wake && !g_pool.stop) {
+			clock_gettime(CLOCK_REALTIME, &ts);
+			ts.tv_sec += UADK_POOL_IDLE_SEC;
+			pthread_cond_timedwait(&g_pool.cond, &g_pool.mutex, &ts);
+		}
+		g_pool.wake = 0;
+		if (g_pool.stop) {
+			pthread_mutex_unlock(&g_pool.mutex);
+			break;
+		}
+		pthread_mutex_unlock(&g_pool.mutex);
+	}
+
+	return NULL;
+}
+
+static void pool_wake(void)
+{
+	pthread_mutex_lock(&g_pool.mutex);
+	g_pool.wake = 1;
+	pthread_cond_signal(&g_pool.cond);
+	pthread_mutex_unlock(&g_pool.mutex);
+}
+
+/* the thread is started by the first get, a process that only forks has none */
+static void pool_start(void)
+{
+	pthread_mutex_lock(&g_pool.mutex);
+	if (g_pool.pid != getpid() && !g_pool.stop) {
+		if (!pthread_create(&g_pool.thread, NULL, pool_thread, NULL))
+			g_pool.pid = getpid();
+		else
+			UADK_ERR("failed to create pool thread\n");
+	}
+	pthread_mutex_unlock(&g_pool.mutex);
+}
+
+static void pool_child_atfork(void)
+{
+	struct uadk_prov_pool *pool;
+
+	/* the thread is gone, and the child must not hand out the parent's items */
+	pthread_mutex_init(&g_pool.mutex, NULL);
+	pthread_cond_init(&g_pool.cond, NULL);
+	g_pool.pid = 0;
+	g_pool.wake = 0;
+	for (pool = g_pool.head; pool; pool = pool->link)
+		pool_reset(pool);
+}
+
+static void pool_init_once(void)
+{
+	pthread_atfork(NULL, NULL, pool_child_atfork);
+}
+
+struct uadk_prov_pool *uadk_prov_pool_new(const char *name, size_t item_size,
+					  unsigned int num, uadk_prov_pool_fill_fn fill,
+					  void *arg)
+{
+	struct uadk_prov_pool *pool;
+
+	if (!item_size || !num || num > UADK_POOL_MAX_NUM || !fill)
+		return NULL;
+
+	pthread_once(&pool_once, pool_init_once);
+
+	pool = OPENSSL_zalloc(sizeof(*pool));
+	if (!pool)
+		return NULL;
+
+	pool->item_size = item_size;
+	pool->num = num;
+	/* the secure heap is only there when the application set one up */
+	pool->items = OPENSSL_secure_zalloc(item_size * num);
+	if (!pool->items)
+		pool->items = OPENSSL_zalloc(item_size * num);
+	pool->next = OPENSSL_zalloc(sizeof(*pool->next) * num);
+	if (!pool->items || !pool->next) {
+		UADK_ERR("failed to alloc %s pool of %u\n", name, num);
+		pool_free_items(pool);
+		OPENSSL_free(pool->next);
+		OPENSSL_free(pool);
+		return NULL;
+	}
+
+	snprintf(pool->name, sizeof(pool->name), "%s", name);
+	pool->fill = fill;
+	pool->arg = arg;
+	pool_reset(pool);
+
+	pthread_mutex_lock(&g_pool.mutex);
+	pool->link = g_pool.head;
+	g_pool.head = pool;
+	pthread_mutex_unlock(&g_pool.mutex);
+
+	return pool;
+}
+
+int uadk_prov_pool_get(struct uadk_prov_pool *pool, unsigned char *item)
+{
+	unsigned char *slot;
+	__u32 idx, avail;
+
+	if (__atomic_load_n(&g_pool.pid, __ATOMIC_ACQUIRE) != getpid())
+		pool_start();
+
+	idx = pool_pop(pool, &pool->full);
+	if (!idx) {
+		__atomic_add_fetch(&pool->misses, 1, __ATOMIC_RELAXED);
+		return UADK_P_FAIL;
+	}
+
+	slot = pool_slot(pool, idx);
+	memcpy(item, slot, pool->item_size);
+	OPENSSL_cleanse(slot, pool->item_size);
+	pool_push(pool, &pool->free, idx);
+
+	__atomic_add_fetch(&pool->hits, 1, __ATOMIC_RELAXED);
+	avail = __atomic_sub_fetch(&pool->avail, 1, __ATOMIC_ACQ_REL);
+	if (avail <= UADK_POOL_LOW(pool->num) &&
+	    !__atomic_exchange_n(&pool->refill, 1, __ATOMIC_ACQ_REL))
+		pool_wake();
+
+	return UADK_P_SUCCESS;
+}
+
+void uadk_prov_pool_uninit(void)
+{
+	struct uadk_prov_pool *pool, *next;
+	int running;
+
+	pthread_mutex_lock(&g_pool.mutex);
+	running = g_pool.pid == getpid();
+	g_pool.stop = 1;
+	pthread_cond_signal(&g_pool.cond);
+	pthread_mutex_unlock(&g_pool.mutex);
+
+	if (running)
+		pthread_join(g_pool.thread, NULL);
+
+	pthread_mutex_lock(&g_pool.mutex);
+	pool = g_pool.head;
+	g_pool.head = NULL;
+	g_pool.pid = 0;
+	g_pool.stop = 0;
+	g_keypool_num = 0;
+	pthread_mutex_unlock(&g_pool.mutex);
+
+	for (; pool; pool = next) {
+		next = pool->link;
+		UADK_INFO("%s pool: %llu hits, %llu misses\n", pool->name,
+			  pool->hits, pool->misses);
+		pool_free_items(pool);
+		OPENSSL_free(pool->next);
+		OPENSSL_free(pool);
+	}
+}
+
+static const char *keypool_kind(enum uadk_keypool_type type)
+{
+	return type == UADK_KEYPOOL_ECDSA ? "ecdsa precomputation" : "key pair";
+}
+
+static void keypool_add(const char *name, unsigned int num, enum uadk_keypool_type type)
+{
+	char pool_name[UADK_KEYPOOL_NAME_LEN];
+	uadk_prov_pool_fill_fn fill;
+	struct uadk_prov_pool *pool;
+	int nid, i;
+	size_t size;
+
+	nid = EC_curve_nist2nid(name);
+	if (nid == NID_undef)
+		nid = OBJ_sn2nid(name);
+	if (nid == NID_undef)
+		nid = OBJ_ln2nid(name);
+
+	if (type == UADK_KEYPOOL_ECDSA) {
+		size = nid == NID_undef ? 0 : uadk_prov_ecdsa_precomp_size(nid);
+		fill = uadk_prov_ecdsa_precomp_fill;
+	} else if (nid == NID_X25519 || nid == NID_X448) {
+		size = uadk_prov_ecx_keypair_size(nid);
+		fill = uadk_prov_ecx_keypair_fill;
+	} else {
+		size = nid == NID_undef ? 0 : uadk_prov_ec_keypair_size(nid);
+		fill = uadk_prov_ec_keypair_fill;
+	}
+
+	if (!size || !num || num > UADK_POOL_MAX_NUM) {
+		UADK_INFO("invalid: %s pool %s of %u is not supported\n",
+			  keypool_kind(type), name, num);
+		return;
+	}
+
+	for (i = 0; i < g_keypool_num; i++) {
+		if (g_keypool[i].nid == nid && g_keypool[i].type == type) {
+			UADK_INFO("invalid: %s pool %s is set twice\n", keypool_kind(type), name);
+			return;
+		}
+	}
+
+	if (g_keypool_num == UADK_KEYPOOL_MAX) {
+		UADK_INFO("invalid: more than %d pools\n", UADK_KEYPOOL_MAX);
+		return;
+	}
+
+	snprintf(pool_name, sizeof(pool_name), "%s%s", OBJ_nid2sn(nid),
+		 type == UADK_KEYPOOL_ECDSA ? " ecdsa" : "");
+	pool = uadk_prov_pool_new(pool_name, size, num, fill, (void *)(intptr_t)nid);
+	if (!pool)
+		return;
+
+	g_keypool[g_keypool_num].nid = nid;
+	g_keypool[g_keypool_num].type = type;
+	g_keypool[g_keypool_num].pool = pool;
+	g_keypool_num++;
+}
+
+static void keypool_config(const char *cfg, enum uadk_keypool_type type)
+{
+	char name[UADK_KEYPOOL_NAME_LEN];
+	const char *p = cfg;
+	unsigned long num;
+	size_t len;
+	char *end;
+
+	while (p && *p) {
+		p += strspn(p, " ,");
+		len = strcspn(p, " ,:");
+		if (!len)
+			break;
+
+		if (len >= sizeof(name)) {
+			UADK_INFO("invalid: %s pool name %.*s\n", keypool_kind(type), (int)len, p);
+			p += len;
+			p += strcspn(p, ",");
+			continue;
+		}
+		memcpy(name, p, len);
+		name[len] = '\0';
+		p += len;
+
+		num = UADK_KEYPOOL_DEFAULT_NUM;
+		if (*p == ':') {
+			num = strtoul(p + 1, &end, DECIMAL);
+			if (end == p + 1)
+				num = 0;
+			p = end;
+		}
+		p += strcspn(p, ",");
+
+		keypool_add(name, num > UADK_POOL_MAX_NUM ? 0 : (unsigned int)num, type);
+	}
+}
+
+static struct uadk_prov_pool *keypool_find(int nid, enum uadk_keypool_type type)
+{
+	int i;
+
+	for (i = 0; i < g_keypool_num; i++) {
+		if (g_keypool[i].nid == nid && g_keypool[i].type == type)
+			return g_keypool[i].pool;
+	}
+
+	return NULL;
+}
+
+void uadk_prov_keypool_config(const char *cfg)
+{
+	keypool_config(cfg, UADK_KEYPOOL_KEYPAIR);
+}
+
+struct uadk_prov_pool *uadk_prov_keypool_find(int nid)
+{
+	return keypool_find(nid, UADK_KEYPOOL_KEYPAIR);
+}
+
+void uadk_prov_ecdsa_pool_config(const char *cfg)
+{
+	keypool_config(cfg, UADK_KEYPOOL_ECDSA);
+}
+
+struct uadk_prov_pool *uadk_prov_ecdsa_pool_find(int nid)
+{
+	return keypool_find(nid, UADK_KEYPOOL_ECDSA);
+}
@@ -0,0 +1,56 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/*
+ * Copyright 2024 Huawei Technologies Co.,Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef UADK_PROV_POOL_H
+#define UADK_PROV_POOL_H
+#include <stddef.h>
+
+/*
+ * Pools of secret values computed ahead of time on the accelerator, such as
+ * ephemeral key pairs or ECDSA nonces. One thread of the provider fills all
+ * the pools in the background; an operation takes an item with a lock-free
+ * pop and goes the usual way when the pool is empty. Every item is handed out once and wiped
+ * from the pool as it goes. A forked child starts with empty pools.
+ */
+
+#define UADK_POOL_MAX_NUM		65536
+#define UADK_KEYPOOL_DEFAULT_NUM	256
+
+struct uadk_prov_pool;
+
+/* makes one item, called from the pool thread only */
+typedef int (*uadk_prov_pool_fill_fn)(void *arg, unsigned char *item, size_t size);
+
+struct uadk_prov_pool *uadk_prov_pool_new(const char *name, size_t item_size,
+					  unsigned int num, uadk_prov_pool_fill_fn fill,
+					  void *arg);
+/* copies an item out, UADK_P_FAIL when the pool is empty */
+int uadk_prov_pool_get(struct uadk_prov_pool *pool, unsigned char *item);
+/* stops the pool thread, wipes and frees every pool */
+void uadk_prov_pool_uninit(void);
+
+/* "P-256:256,X25519" from KEYPAIR_POOL, a curve with an optional size */
+void uadk_prov_keypool_config(const char *cfg);
+/* the key pair pool of a curve, NULL if there is none */
+struct uadk_prov_pool *uadk_prov_keypool_find(int nid);
+
+/* "P-256:256,P-384" from ECDSA_PRECOMP, in the same form */
+void uadk_prov_ecdsa_pool_config(const char *cfg);
+/* the (k^-1, r) pool of a curve, NULL if there is none */
+struct uadk_prov_pool *uadk_prov_ecdsa_pool_find(int nid);
+
+#endif
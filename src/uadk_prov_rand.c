@@ -0,0 +1,308 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+ * Copyright 2024 Huawei Technologies Co.,Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include <pthread.h>
+#include <string.h>
+#include <time.h>
+#include <openssl/core_names.h>
+#include <openssl/crypto.h>
+#include <openssl/evp.h>
+#include <openssl/rand.h>
+#include "uadk_prov.h"
+#include "uadk_prov_rand.h"
+#include "uadk_utils.h"
+
+/*
+ * Each DRBG call of a thread also locks the primary DRBG to look for a
+ * reseed, so one call per block instead of one per scalar takes the lock
+ * 128 times less often for P-256.
+ */
+#define UADK_RAND_BLOCK		4096
+/* well below the reseed time of the DRBG, which only counts its own calls */
+#define UADK_RAND_MAX_AGE_SEC	60
+#define UADK_RAND_MAX_CNT	100
+#define BYTE_BITS		8
+
+struct uadk_rand_buf {
+	unsigned char data[UADK_RAND_BLOCK];
+	/* bytes taken, they are wiped as they go */
+	size_t pos;
+	time_t filled_at;
+	EVP_RAND_CTX *drbg;
+	unsigned int reseed;
+	struct uadk_rand_buf *next;
+};
+
+static struct {
+	pthread_mutex_t mutex;
+	pthread_key_t key;
+	int key_ready;
+	/* bumped when every block is dropped, at fork and teardown */
+	unsigned int gen;
+	unsigned long drbg_calls;
+	struct uadk_rand_buf *head;
+} g_rand = {
+	.mutex = PTHREAD_MUTEX_INITIALIZER,
+};
+
+static pthread_once_t rand_once = PTHREAD_ONCE_INIT;
+static __thread struct uadk_rand_buf *rand_buf;
+static __thread unsigned int rand_buf_gen;
+
+static void rand_buf_free(struct uadk_rand_buf *buf)
+{
+	if (CRYPTO_secure_allocated(buf))
+		OPENSSL_secure_clear_free(buf, sizeof(*buf));
+	else
+		OPENSSL_clear_free(buf, sizeof(*buf));
+}
+
+/* with g_rand.mutex held */
+static void rand_buf_free_all(void)
+{
+	struct uadk_rand_buf *buf, *next;
+
+	for (buf = g_rand.head; buf; buf = next) {
+		next = buf->next;
+		rand_buf_free(buf);
+	}
+	g_rand.head = NULL;
+	__atomic_add_fetch(&g_rand.gen, 1, __ATOMIC_RELEASE);
+}
+
+/* at thread exit, unless teardown has freed the block already */
+static void rand_buf_destructor(void *arg)
+{
+	struct uadk_rand_buf **pbuf;
+
+	pthread_mutex_lock(&g_rand.mutex);
+	for (pbuf = &g_rand.head; *pbuf; pbuf = &(*pbuf)->next) {
+		if (*pbuf == arg) {
+			*pbuf = ((struct uadk_rand_buf *)arg)->next;
+			rand_buf_free(arg);
+			break;
+		}
+	}
+	pthread_mutex_unlock(&g_rand.mutex);
+}
+
+static void rand_child_atfork(void)
+{
+	/* the child must not hand out what the parent does too */
+	pthread_mutex_init(&g_rand.mutex, NULL);
+	rand_buf_free_all();
+}
+
+static void rand_init_once(void)
+{
+	pthread_atfork(NULL, NULL, rand_child_atfork);
+}
+
+static struct uadk_rand_buf *rand_buf_get(void)
+{
+	struct uadk_rand_buf *buf;
+	unsigned int gen;
+
+	gen = __atomic_load_n(&g_rand.gen, __ATOMIC_ACQUIRE);
+	if (rand_buf && rand_buf_gen == gen)
+		return rand_buf;
+
+	/* a block of an older generation has been freed, it is not touched */
+	rand_buf = NULL;
+	pthread_once(&rand_once, rand_init_once);
+
+	buf = OPENSSL_secure_zalloc(sizeof(*buf));
+	if (!buf)
+		buf = OPENSSL_zalloc(sizeof(*buf));
+	if (!buf)
+		return NULL;
+	buf->pos = UADK_RAND_BLOCK;
+
+	pthread_mutex_lock(&g_rand.mutex);
+	if (!g_rand.key_ready) {
+		if (pthread_key_create(&g_rand.key, rand_buf_destructor)) {
+			pthread_mutex_unlock(&g_rand.mutex);
+			rand_buf_free(buf);
+			return NULL;
+		}
+		g_rand.key_ready = 1;
+	}
+	pthread_setspecific(g_rand.key, buf);
+	buf->next = g_rand.head;
+	g_rand.head = buf;
+	rand_buf_gen = g_rand.gen;
+	pthread_mutex_unlock(&g_rand.mutex);
+
+	rand_buf = buf;
+
+	return buf;
+}
+
+static time_t rand_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+	return ts.tv_sec;
+}
+
+/* the private DRBG of the thread has no lock, unlike the primary */
+static unsigned int rand_reseed_counter(EVP_RAND_CTX *drbg)
+{
+	OSSL_PARAM params[2];
+	unsigned int cnt = 0;
+
+	if (!drbg)
+		return 0;
+
+	params[0] = OSSL_PARAM_construct_uint(OSSL_DRBG_PARAM_RESEED_COUNTER, &cnt);
+	params[1] = OSSL_PARAM_construct_end();
+	if (!EVP_RAND_CTX_get_params(drbg, params))
+		return 0;
+
+	return cnt;
+}
+
+static int rand_buf_fill(struct uadk_rand_buf *buf)
+{
+	if (RAND_priv_bytes(buf->data, UADK_RAND_BLOCK) <= 0) {
+		UADK_ERR("failed to RAND_priv_bytes\n");
+		OPENSSL_cleanse(buf->data, UADK_RAND_BLOCK);
+		buf->pos = UADK_RAND_BLOCK;
+		return UADK_P_FAIL;
+	}
+	__atomic_add_fetch(&g_rand.drbg_calls, 1, __ATOMIC_RELAXED);
+
+	buf->pos = 0;
+	buf->filled_at = rand_now();
+	if (!buf->drbg)
+		buf->drbg = RAND_get0_private(NULL);
+	buf->reseed = rand_reseed_counter(buf->drbg);
+
+	return UADK_P_SUCCESS;
+}
+
+static int rand_take(unsigned char *out, size_t len)
+{
+	struct uadk_rand_buf *buf;
+
+	buf = rand_buf_get();
+	if (!buf) {
+		__atomic_add_fetch(&g_rand.drbg_calls, 1, __ATOMIC_RELAXED);
+		return RAND_priv_bytes(out, len) > 0 ? UADK_P_SUCCESS : UADK_P_FAIL;
+	}
+
+	if (buf->pos + len > UADK_RAND_BLOCK ||
+	    rand_now() - buf->filled_at >= UADK_RAND_MAX_AGE_SEC ||
+	    rand_reseed_counter(buf->drbg) != buf->reseed) {
+		if (!rand_buf_fill(buf))
+			return UADK_P_FAIL;
+	}
+
+	memcpy(out, buf->data + buf->pos, len);
+	OPENSSL_cleanse(buf->data + buf->pos, len);
+	buf->pos += len;
+
+	return UADK_P_SUCCESS;
+}
+
+int uadk_prov_rand_range(unsigned char *out, size_t out_len, const BIGNUM *range)
+{
+	unsigned char lim[UADK_RAND_MAX_BYTES];
+	unsigned char val[UADK_RAND_MAX_BYTES];
+	int bytes, bits, cnt = 0;
+	unsigned char mask;
+
+	if (!out || !range || BN_is_negative(range) || BN_is_zero(range))
+		return UADK_P_FAIL;
+
+	bits = BN_num_bits(range);
+	bytes = BN_num_bytes(range);
+	if (bytes > UADK_RAND_MAX_BYTES || (size_t)bytes > out_len ||
+	    BN_bn2bin(range, lim) != bytes)
+		return UADK_P_FAIL;
+
+	/* values of the bit length of the range, so at least half of them fit */
+	mask = 0xff >> (bytes * BYTE_BITS - bits);
+	do {
+		if (!rand_take(val, bytes))
+			goto err;
+
+		val[0] &= mask;
+		if (memcmp(val, lim, bytes) < 0) {
+			memset(out, 0, out_len - bytes);
+			memcpy(out + out_len - bytes, val, bytes);
+			OPENSSL_cleanse(val, bytes);
+			return UADK_P_SUCCESS;
+		}
+	} while (cnt++ < UADK_RAND_MAX_CNT);
+
+	UADK_ERR("failed to get a random value in range\n");
+err:
+	OPENSSL_cleanse(val, sizeof(val));
+	return UADK_P_FAIL;
+}
+
+int uadk_prov_rand_range_bn(BIGNUM *r, const BIGNUM *range)
+{
+	unsigned char val[UADK_RAND_MAX_BYTES];
+	int bytes = BN_num_bytes(range);
+	int ret = UADK_P_FAIL;
+
+	if (uadk_prov_rand_range(val, bytes, range) && BN_bin2bn(val, bytes, r))
+		ret = UADK_P_SUCCESS;
+	OPENSSL_cleanse(val, sizeof(val));
+
+	return ret;
+}
+
+int uadk_prov_rand_bits_bn(BIGNUM *r, int bits)
+{
+	unsigned char val[UADK_RAND_MAX_BYTES];
+	int bytes = (bits + BYTE_BITS - 1) / BYTE_BITS;
+	int ret = UADK_P_FAIL;
+
+	if (bits <= 0 || bytes > UADK_RAND_MAX_BYTES)
+		return UADK_P_FAIL;
+
+	if (rand_take(val, bytes)) {
+		val[0] &= 0xff >> (bytes * BYTE_BITS - bits);
+		if (BN_bin2bn(val, bytes, r))
+			ret = UADK_P_SUCCESS;
+	}
+	OPENSSL_cleanse(val, sizeof(val));
+
+	return ret;
+}
+
+void uadk_prov_rand_uninit(void)
+{
+	pthread_mutex_lock(&g_rand.mutex);
+	/* no destructor may run once the provider is gone */
+	if (g_rand.key_ready) {
+		pthread_key_delete(g_rand.key);
+		g_rand.key_ready = 0;
+	}
+	UADK_INFO("random blocks: %lu DRBG calls\n", g_rand.drbg_calls);
+	rand_buf_free_all();
+	pthread_mutex_unlock(&g_rand.mutex);
+}
+
+unsigned long uadk_prov_rand_drbg_calls(void)
+{
+	return __atomic_load_n(&g_rand.drbg_calls, __ATOMIC_RELAXED);
+}
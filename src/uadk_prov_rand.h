@@ -0,0 +1,43 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/*
+ * Copyright 2024 Huawei Technologies Co.,Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef UADK_PROV_RAND_H
+#define UADK_PROV_RAND_H
+#include <stddef.h>
+#include <openssl/bn.h>
+
+/*
+ * Random scalars carved out of blocks drawn from the private DRBG, one block
+ * per thread, instead of a DRBG call for each scalar. A block is dropped once
+ * the DRBG of the thread has reseeded or it grows old, and every block is
+ * wiped in a forked child and at teardown.
+ */
+
+/* 4096-bit DH, the longest scalar */
+#define UADK_RAND_MAX_BYTES	512
+
+/* uniform in [0, range), big-endian and padded to out_len */
+int uadk_prov_rand_range(unsigned char *out, size_t out_len, const BIGNUM *range);
+int uadk_prov_rand_range_bn(BIGNUM *r, const BIGNUM *range);
+/* uniform in [0, 2^bits) */
+int uadk_prov_rand_bits_bn(BIGNUM *r, int bits);
+/* wipes and frees the blocks of all threads */
+void uadk_prov_rand_uninit(void);
+/* number of DRBG calls made so far, for the benchmark */
+unsigned long uadk_prov_rand_drbg_calls(void);
+
+#endif
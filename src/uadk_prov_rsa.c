@@ -31,6 +31,10 @@
 
 static struct rsa_prov g_rsa_prov;
 static pthread_mutex_t rsa_mutex = PTHREAD_MUTEX_INITIALIZER;
+/* RSA ex_data index of the key session set, from first use until teardown */
+static int rsa_key_sess_idx = -1;
+static unsigned int rsa_key_sess_threads;
+static __thread int rsa_key_sess_slot_id = -1;
 
 int uadk_rsa_test_flags(const RSA *r, int flags)
 {
@@ -88,9 +92,7 @@ int check_rsa_is_crt(RSA *rsa)
 	return UN_SET;
 }
 
-int rsa_fill_prikey(RSA *rsa, struct uadk_rsa_sess *rsa_sess,
-			   struct rsa_prikey_param *pri,
-			   unsigned char *in_buf, unsigned char *to)
+static int rsa_load_prikey(handle_t sess, struct rsa_prikey_param *pri)
 {
 	struct wd_rsa_prikey *prikey = NULL;
 	struct wd_dtb *wd_qinv = NULL;
@@ -101,11 +103,11 @@ int rsa_fill_prikey(RSA *rsa, struct uadk_rsa_sess *rsa_sess,
 	struct wd_dtb *wd_n = NULL;
 	struct wd_dtb *wd_d = NULL;
 
-	if (!rsa_sess->is_prikey_ready && pri->is_crt) {
-		wd_rsa_get_prikey(rsa_sess->sess, &prikey);
-		if (!prikey)
-			return UADK_P_FAIL;
+	wd_rsa_get_prikey(sess, &prikey);
+	if (!prikey)
+		return UADK_P_FAIL;
 
+	if (pri->is_crt) {
 		wd_rsa_get_crt_prikey_params(prikey, &wd_dq, &wd_dp,
 					     &wd_qinv, &wd_q, &wd_p);
 		if (!wd_dq || !wd_dp || !wd_qinv || !wd_q || !wd_p)
@@ -121,11 +123,7 @@ int rsa_fill_prikey(RSA *rsa, struct uadk_rsa_sess *rsa_sess,
 					(unsigned char *)wd_q->data);
 		wd_qinv->dsize = BN_bn2bin(pri->iqmp,
 					   (unsigned char *)wd_qinv->data);
-	} else if (!rsa_sess->is_prikey_ready && !pri->is_crt) {
-		wd_rsa_get_prikey(rsa_sess->sess, &prikey);
-		if (!prikey)
-			return UADK_P_FAIL;
-
+	} else {
 		wd_rsa_get_prikey_params(prikey, &wd_d, &wd_n);
 		if (!wd_d || !wd_n)
 			return UADK_P_FAIL;
@@ -134,9 +132,76 @@ int rsa_fill_prikey(RSA *rsa, struct uadk_rsa_sess *rsa_sess,
 					(unsigned char *)wd_n->data);
 		wd_d->dsize = BN_bn2bin(pri->d,
 					(unsigned char *)wd_d->data);
-	} else {
+	}
+
+	return UADK_P_SUCCESS;
+}
+
+int rsa_load_pubkey(handle_t sess, struct rsa_pubkey_param *pubkey_param)
+{
+	struct wd_rsa_pubkey *pubkey = NULL;
+	struct wd_dtb *wd_n = NULL;
+	struct wd_dtb *wd_e = NULL;
+
+	wd_rsa_get_pubkey(sess, &pubkey);
+	if (!pubkey)
+		return UADK_P_FAIL;
+
+	wd_rsa_get_pubkey_params(pubkey, &wd_e, &wd_n);
+	if (!wd_n || !wd_e)
 		return UADK_P_FAIL;
+
+	wd_n->dsize = BN_bn2bin(pubkey_param->n,
+				(unsigned char *)wd_n->data);
+	wd_e->dsize = BN_bn2bin(pubkey_param->e,
+				(unsigned char *)wd_e->data);
+
+	return UADK_P_SUCCESS;
+}
+
+/*
+ * Load the key into a cached session only once. The ready flag is read
+ * without the lock, other threads may already sign with the session.
+ */
+static int rsa_key_sess_load(struct uadk_rsa_sess *rsa_sess,
+			     struct rsa_prikey_param *pri,
+			     struct rsa_pubkey_param *pub)
+{
+	struct rsa_key_sess_slot *slot = rsa_sess->slot;
+	int *ready = pri ? &slot->is_prikey_ready : &slot->is_pubkey_ready;
+	int ret = UADK_P_SUCCESS;
+
+	if (__atomic_load_n(ready, __ATOMIC_ACQUIRE))
+		return UADK_P_SUCCESS;
+
+	pthread_mutex_lock(&rsa_sess->key_sess->lock);
+	if (!*ready) {
+		if (pri)
+			ret = rsa_load_prikey(slot->sess, pri);
+		else
+			ret = rsa_load_pubkey(slot->sess, pub);
+		if (ret)
+			__atomic_store_n(ready, IS_SET, __ATOMIC_RELEASE);
 	}
+	pthread_mutex_unlock(&rsa_sess->key_sess->lock);
+
+	return ret;
+}
+
+int rsa_fill_prikey(RSA *rsa, struct uadk_rsa_sess *rsa_sess,
+			   struct rsa_prikey_param *pri,
+			   unsigned char *in_buf, unsigned char *to)
+{
+	int ret;
+
+	if (rsa_sess->key_sess)
+		ret = rsa_key_sess_load(rsa_sess, pri, NULL);
+	else if (!rsa_sess->is_prikey_ready)
+		ret = rsa_load_prikey(rsa_sess->sess, pri);
+	else
+		ret = UADK_P_FAIL;
+	if (!ret)
+		return UADK_P_FAIL;
 
 	rsa_sess->is_prikey_ready = IS_SET;
 	rsa_sess->req.op_type = WD_RSA_SIGN;
@@ -152,34 +217,25 @@ int rsa_fill_pubkey(struct rsa_pubkey_param *pubkey_param,
 			   struct uadk_rsa_sess *rsa_sess,
 			   unsigned char *in_buf, unsigned char *to)
 {
-	struct wd_rsa_pubkey *pubkey = NULL;
-	struct wd_dtb *wd_n = NULL;
-	struct wd_dtb *wd_e = NULL;
-
-	if (!rsa_sess->is_pubkey_ready) {
-		wd_rsa_get_pubkey(rsa_sess->sess, &pubkey);
-		if (!pubkey)
-			return UADK_P_FAIL;
-
-		wd_rsa_get_pubkey_params(pubkey, &wd_e, &wd_n);
-		if (!wd_n || !wd_e)
-			return UADK_P_FAIL;
+	int ret;
 
-		wd_n->dsize = BN_bn2bin(pubkey_param->n,
-					(unsigned char *)wd_n->data);
-		wd_e->dsize = BN_bn2bin(pubkey_param->e,
-					(unsigned char *)wd_e->data);
-		rsa_sess->req.src_bytes = rsa_sess->key_size;
-		rsa_sess->req.dst_bytes = rsa_sess->key_size;
-		rsa_sess->req.op_type = WD_RSA_VERIFY;
-		rsa_sess->is_pubkey_ready = IS_SET;
-		rsa_sess->req.src = in_buf;
-		rsa_sess->req.dst = to;
+	if (rsa_sess->key_sess)
+		ret = rsa_key_sess_load(rsa_sess, NULL, pubkey_param);
+	else if (!rsa_sess->is_pubkey_ready)
+		ret = rsa_load_pubkey(rsa_sess->sess, pubkey_param);
+	else
+		ret = UADK_P_FAIL;
+	if (!ret)
+		return UADK_P_FAIL;
 
-		return UADK_P_SUCCESS;
-	}
+	rsa_sess->req.src_bytes = rsa_sess->key_size;
+	rsa_sess->req.dst_bytes = rsa_sess->key_size;
+	rsa_sess->req.op_type = WD_RSA_VERIFY;
+	rsa_sess->is_pubkey_ready = IS_SET;
+	rsa_sess->req.src = in_buf;
+	rsa_sess->req.dst = to;
 
-	return UADK_P_FAIL;
+	return UADK_P_SUCCESS;
 }
 
 static int uadk_rsa_env_poll(void *ctx)
@@ -227,6 +283,7 @@ static int uadk_prov_rsa_init(void)
 			return ret;
 		}
 		async_register_poll_fn(ASYNC_TASK_RSA, uadk_rsa_env_poll);
+		g_rsa_prov.gen++;
 		mb();
 		g_rsa_prov.pid = getpid();
 		pthread_mutex_unlock(&rsa_mutex);
@@ -238,6 +295,15 @@ static int uadk_prov_rsa_init(void)
 void uadk_prov_destroy_rsa(void)
 {
 	pthread_mutex_lock(&rsa_mutex);
+	/*
+	 * The callbacks of the index are in this library, keys that outlive
+	 * the provider must not call them. Their session sets are leaked.
+	 */
+	if (rsa_key_sess_idx >= 0) {
+		CRYPTO_free_ex_index(CRYPTO_EX_INDEX_RSA, rsa_key_sess_idx);
+		__atomic_store_n(&rsa_key_sess_idx, -1, __ATOMIC_RELEASE);
+	}
+
 	if (g_rsa_prov.pid == getpid()) {
 		wd_rsa_uninit2();
 		g_rsa_prov.pid = 0;
@@ -245,6 +311,181 @@ void uadk_prov_destroy_rsa(void)
 	pthread_mutex_unlock(&rsa_mutex);
 }
 
+static void rsa_key_sess_put(struct uadk_rsa_key_sess *key_sess)
+{
+	int i;
+
+	if (!key_sess || __atomic_sub_fetch(&key_sess->refs, 1, __ATOMIC_ACQ_REL))
+		return;
+
+	/* sessions of the parent are not ours to free after fork */
+	if (key_sess->pid == getpid()) {
+		for (i = 0; i < RSA_KEY_SESS_SLOTS; i++) {
+			if (key_sess->slot[i].sess)
+				wd_rsa_free_sess(key_sess->slot[i].sess);
+		}
+	}
+
+	pthread_mutex_destroy(&key_sess->lock);
+	OPENSSL_free(key_sess);
+}
+
+static void rsa_key_sess_ex_free(void *parent, void *ptr, CRYPTO_EX_DATA *ad,
+				 int idx, long argl, void *argp)
+{
+	rsa_key_sess_put(ptr);
+}
+
+static int rsa_key_sess_ex_dup(CRYPTO_EX_DATA *to, const CRYPTO_EX_DATA *from,
+			       void **from_d, int idx, long argl, void *argp)
+{
+	/* a copied key builds its own sessions */
+	*(void **)from_d = NULL;
+
+	return UADK_P_SUCCESS;
+}
+
+static int rsa_key_sess_index(void)
+{
+	int idx = __atomic_load_n(&rsa_key_sess_idx, __ATOMIC_ACQUIRE);
+
+	if (idx >= 0)
+		return idx;
+
+	pthread_mutex_lock(&rsa_mutex);
+	idx = rsa_key_sess_idx;
+	if (idx < 0) {
+		idx = RSA_get_ex_new_index(0, NULL, NULL, rsa_key_sess_ex_dup,
+					   rsa_key_sess_ex_free);
+		__atomic_store_n(&rsa_key_sess_idx, idx, __ATOMIC_RELEASE);
+	}
+	pthread_mutex_unlock(&rsa_mutex);
+
+	return idx;
+}
+
+static int rsa_key_sess_valid(struct uadk_rsa_key_sess *key_sess, RSA *rsa,
+			      unsigned int bits, int is_crt)
+{
+	return key_sess && key_sess->pid == getpid() &&
+	       key_sess->gen == g_rsa_prov.gen &&
+	       key_sess->dirty_cnt == rsa->dirty_cnt &&
+	       key_sess->key_bits == bits && key_sess->is_crt == is_crt;
+}
+
+static struct uadk_rsa_key_sess *rsa_key_sess_new(RSA *rsa, unsigned int bits,
+						  int is_crt)
+{
+	struct uadk_rsa_key_sess *key_sess;
+
+	key_sess = OPENSSL_zalloc(sizeof(struct uadk_rsa_key_sess));
+	if (!key_sess)
+		return NULL;
+
+	pthread_mutex_init(&key_sess->lock, NULL);
+	key_sess->pid = getpid();
+	key_sess->gen = g_rsa_prov.gen;
+	key_sess->dirty_cnt = rsa->dirty_cnt;
+	key_sess->key_bits = bits;
+	key_sess->is_crt = is_crt;
+
+	return key_sess;
+}
+
+/*
+ * Return the key's session set with a reference held for the caller. The
+ * ex_data of the key is guarded by the key's own lock, so only users of
+ * the same key ever wait for each other, and then only for a read lock.
+ */
+static struct uadk_rsa_key_sess *rsa_key_sess_get(RSA *rsa, unsigned int bits,
+						  int is_crt)
+{
+	struct uadk_rsa_key_sess *key_sess, *old;
+	int idx;
+
+	idx = rsa_key_sess_index();
+	if (idx < 0 || !rsa->lock)
+		return NULL;
+
+	if (!CRYPTO_THREAD_read_lock(rsa->lock))
+		return NULL;
+	key_sess = RSA_get_ex_data(rsa, idx);
+	if (rsa_key_sess_valid(key_sess, rsa, bits, is_crt)) {
+		__atomic_add_fetch(&key_sess->refs, 1, __ATOMIC_RELAXED);
+		CRYPTO_THREAD_unlock(rsa->lock);
+		return key_sess;
+	}
+	CRYPTO_THREAD_unlock(rsa->lock);
+
+	key_sess = rsa_key_sess_new(rsa, bits, is_crt);
+	if (!key_sess)
+		return NULL;
+
+	if (!CRYPTO_THREAD_write_lock(rsa->lock)) {
+		key_sess->refs = 1;
+		rsa_key_sess_put(key_sess);
+		return NULL;
+	}
+	old = RSA_get_ex_data(rsa, idx);
+	if (rsa_key_sess_valid(old, rsa, bits, is_crt)) {
+		/* lost the race, use the one already attached */
+		__atomic_add_fetch(&old->refs, 1, __ATOMIC_RELAXED);
+		CRYPTO_THREAD_unlock(rsa->lock);
+		key_sess->refs = 1;
+		rsa_key_sess_put(key_sess);
+		return old;
+	}
+
+	if (!RSA_set_ex_data(rsa, idx, key_sess)) {
+		CRYPTO_THREAD_unlock(rsa->lock);
+		key_sess->refs = 1;
+		rsa_key_sess_put(key_sess);
+		return NULL;
+	}
+	/* one reference for the key, one for the caller */
+	key_sess->refs = 2;
+	CRYPTO_THREAD_unlock(rsa->lock);
+
+	/* in flight users of a stale set keep it alive until they finish */
+	rsa_key_sess_put(old);
+
+	return key_sess;
+}
+
+static struct rsa_key_sess_slot *rsa_key_sess_slot(struct uadk_rsa_key_sess *key_sess)
+{
+	struct sched_params params = {0};
+	struct wd_rsa_sess_setup setup = {0};
+	struct rsa_key_sess_slot *slot;
+	handle_t sess;
+
+	if (rsa_key_sess_slot_id < 0)
+		rsa_key_sess_slot_id = __atomic_fetch_add(&rsa_key_sess_threads, 1,
+							  __ATOMIC_RELAXED) % RSA_KEY_SESS_SLOTS;
+
+	slot = &key_sess->slot[rsa_key_sess_slot_id];
+	if (__atomic_load_n(&slot->sess, __ATOMIC_ACQUIRE))
+		return slot;
+
+	pthread_mutex_lock(&key_sess->lock);
+	if (!slot->sess) {
+		/* Use the default numa parameters */
+		params.numa_id = -1;
+		setup.sched_param = &params;
+		setup.key_bits = key_sess->key_bits;
+		setup.is_crt = key_sess->is_crt;
+		sess = wd_rsa_alloc_sess(&setup);
+		if (!sess) {
+			pthread_mutex_unlock(&key_sess->lock);
+			return NULL;
+		}
+		__atomic_store_n(&slot->sess, sess, __ATOMIC_RELEASE);
+	}
+	pthread_mutex_unlock(&key_sess->lock);
+
+	return slot;
+}
+
 static struct uadk_rsa_sess *rsa_new_eng_session(RSA *rsa)
 {
 	struct uadk_rsa_sess *rsa_sess;
@@ -270,7 +511,10 @@ void rsa_free_eng_session(struct uadk_rsa_sess *rsa_sess)
 	rsa_sess->is_pubkey_ready = UN_SET;
 	rsa_sess->is_prikey_ready = UN_SET;
 
-	wd_rsa_free_sess(rsa_sess->sess);
+	if (rsa_sess->key_sess)
+		rsa_key_sess_put(rsa_sess->key_sess);
+	else
+		wd_rsa_free_sess(rsa_sess->sess);
 	OPENSSL_free(rsa_sess);
 }
 
@@ -307,6 +551,48 @@ struct uadk_rsa_sess *rsa_get_eng_session(RSA *rsa, unsigned int bits,
 	return rsa_sess;
 }
 
+/*
+ * Like rsa_get_eng_session(), but the hardware session and its key
+ * material are cached on the RSA key and reused by later operations.
+ */
+struct uadk_rsa_sess *rsa_get_key_session(RSA *rsa, unsigned int bits,
+					  int is_crt)
+{
+	struct uadk_rsa_key_sess *key_sess;
+	struct uadk_rsa_sess *rsa_sess;
+	struct rsa_key_sess_slot *slot;
+	int ret;
+
+	ret = uadk_prov_rsa_init();
+	if (ret)
+		return NULL;
+
+	key_sess = rsa_key_sess_get(rsa, bits, is_crt);
+	if (!key_sess)
+		return rsa_get_eng_session(rsa, bits, is_crt);
+
+	slot = rsa_key_sess_slot(key_sess);
+	if (!slot) {
+		rsa_key_sess_put(key_sess);
+		return NULL;
+	}
+
+	rsa_sess = rsa_new_eng_session(rsa);
+	if (!rsa_sess) {
+		rsa_key_sess_put(key_sess);
+		return NULL;
+	}
+
+	rsa_sess->key_size = bits >> BIT_BYTES_SHIFT;
+	rsa_sess->setup.key_bits = bits;
+	rsa_sess->setup.is_crt = is_crt;
+	rsa_sess->sess = slot->sess;
+	rsa_sess->key_sess = key_sess;
+	rsa_sess->slot = slot;
+
+	return rsa_sess;
+}
+
 static void uadk_e_rsa_cb(void *req_t)
 {
 	struct wd_rsa_req *req = (struct wd_rsa_req *)req_t;
@@ -396,6 +682,103 @@ err:
 	return UADK_P_FAIL;
 }
 
+struct rsa_batch_cb {
+	struct wd_rsa_req *req;
+	int *done;
+};
+
+/* the callback slots and their counter, the hardware's until all are back */
+struct rsa_batch {
+	int done;
+	struct rsa_batch_cb cbs[];
+};
+
+static void uadk_e_rsa_batch_cb(void *req_t)
+{
+	struct wd_rsa_req *req = (struct wd_rsa_req *)req_t;
+	struct rsa_batch_cb *cb;
+
+	if (!req || !req->cb_param)
+		return;
+
+	cb = req->cb_param;
+	cb->req->status = req->status;
+	__atomic_add_fetch(cb->done, 1, __ATOMIC_RELEASE);
+}
+
+/*
+ * Send the requests of several sessions before waiting for any, then poll
+ * until every sent one has come back. Fails unless all of them made it.
+ * -ETIMEDOUT means some are still out: the sessions and the buffers of
+ * their requests must then be neither reused nor freed.
+ */
+int uadk_prov_rsa_do_crypto_batch(struct uadk_rsa_sess **rsa_sess, int num)
+{
+	struct rsa_batch *b;
+	int sent = 0, done;
+	__u32 recv;
+	__u64 cnt = 0;
+	int i, ret;
+
+	b = OPENSSL_malloc(sizeof(*b) + num * sizeof(b->cbs[0]));
+	if (!b)
+		return UADK_P_FAIL;
+
+	b->done = 0;
+	for (i = 0; i < num; i++) {
+		b->cbs[i].req = &rsa_sess[i]->req;
+		b->cbs[i].done = &b->done;
+		rsa_sess[i]->req.cb = uadk_e_rsa_batch_cb;
+		rsa_sess[i]->req.cb_param = &b->cbs[i];
+		rsa_sess[i]->req.status = POLL_ERROR;
+	}
+
+	while (sent < num) {
+		ret = wd_do_rsa_async(rsa_sess[sent]->sess, &rsa_sess[sent]->req);
+		if (likely(!ret)) {
+			sent++;
+			cnt = 0;
+			continue;
+		}
+
+		if (ret != -EBUSY) {
+			UADK_ERR("failed to do rsa batch async, ret = %d\n", ret);
+			break;
+		}
+
+		ret = wd_rsa_poll(1, &recv);
+		if (ret < 0 || unlikely(++cnt > PROV_SEND_MAX_CNT)) {
+			UADK_ERR("do rsa batch async operation timeout\n");
+			break;
+		}
+	}
+
+	/* a poll error does not give the requests back, keep on until timeout */
+	cnt = 0;
+	while ((done = __atomic_load_n(&b->done, __ATOMIC_ACQUIRE)) < sent) {
+		recv = 0;
+		ret = wd_rsa_poll(sent - done, &recv);
+		if (ret >= 0 && recv)
+			cnt = 0;
+		else if (unlikely(++cnt > PROV_SCH_RECV_MAX_CNT)) {
+			UADK_ERR("failed to recv rsa batch, ret = %d: timeout!\n", ret);
+			/* a late request still writes to it, so it is not freed */
+			return -ETIMEDOUT;
+		}
+	}
+
+	ret = sent == num ? UADK_P_SUCCESS : UADK_P_FAIL;
+	for (i = 0; i < num; i++) {
+		if (i < sent && rsa_sess[i]->req.status)
+			ret = UADK_P_FAIL;
+		rsa_sess[i]->req.cb = NULL;
+		rsa_sess[i]->req.cb_param = NULL;
+	}
+
+	OPENSSL_free(b);
+	return ret;
+}
+
 int uadk_rsa_bits(const RSA *r)
 {
 	return BN_num_bits(r->n);
@@ -38,6 +38,8 @@
 #define BN_REDO				(-2)
 #define CHECK_PADDING_FAIL		(-1)
 #define BIT_BYTES_SHIFT			3
+/* sessions kept per key, spread over the hardware queues by thread */
+#define RSA_KEY_SESS_SLOTS		16
 
 struct bignum_st {
 	BN_ULONG *d;
@@ -49,6 +51,8 @@ struct bignum_st {
 
 struct rsa_prov {
 	int pid;
+	/* bumped on every init, sessions of an older init are stale */
+	unsigned int gen;
 };
 
 struct rsa_pss_params_30_st {
@@ -128,6 +132,27 @@ struct rsa_pubkey_param {
 	const BIGNUM *n;
 };
 
+struct rsa_key_sess_slot {
+	handle_t sess;
+	int is_pubkey_ready;
+	int is_prikey_ready;
+};
+
+/*
+ * Hardware sessions with the key already loaded, attached to an RSA key
+ * through ex_data and dropped when the key is freed or changed.
+ */
+struct uadk_rsa_key_sess {
+	pthread_mutex_t lock;
+	int refs;
+	int pid;
+	unsigned int gen;
+	int dirty_cnt;
+	unsigned int key_bits;
+	int is_crt;
+	struct rsa_key_sess_slot slot[RSA_KEY_SESS_SLOTS];
+};
+
 struct uadk_rsa_sess {
 	handle_t sess;
 	struct wd_rsa_sess_setup setup;
@@ -136,6 +161,9 @@ struct uadk_rsa_sess {
 	int is_pubkey_ready;
 	int is_prikey_ready;
 	int key_size;
+	/* set when sess is borrowed from the key cache */
+	struct uadk_rsa_key_sess *key_sess;
+	struct rsa_key_sess_slot *slot;
 };
 
 enum {
@@ -158,7 +186,11 @@ int rsa_fill_pubkey(struct rsa_pubkey_param *pubkey_param,
 void rsa_free_eng_session(struct uadk_rsa_sess *rsa_sess);
 struct uadk_rsa_sess *rsa_get_eng_session(RSA *rsa, unsigned int bits,
 						 int is_crt);
+struct uadk_rsa_sess *rsa_get_key_session(RSA *rsa, unsigned int bits,
+					  int is_crt);
 int rsa_do_crypto(struct uadk_rsa_sess *rsa_sess);
+int uadk_prov_rsa_do_crypto_batch(struct uadk_rsa_sess **rsa_sess, int num);
+int rsa_load_pubkey(handle_t sess, struct rsa_pubkey_param *pubkey_param);
 int uadk_rsa_bits(const RSA *r);
 int uadk_rsa_size(const RSA *r);
 int rsa_check_bit_useful(const int bits);
@@ -229,7 +229,7 @@ static int uadk_prov_rsa_public_encrypt(int flen, const unsigned char *from,
 
 	is_crt = check_rsa_is_crt(rsa);
 
-	rsa_sess = rsa_get_eng_session(rsa, uadk_rsa_bits(rsa), is_crt);
+	rsa_sess = rsa_get_key_session(rsa, uadk_rsa_bits(rsa), is_crt);
 	if (!rsa_sess) {
 		ret = UADK_DO_SOFT;
 		goto free_pkey;
@@ -292,7 +292,7 @@ static int uadk_prov_rsa_private_decrypt(int flen, const unsigned char *from,
 
 	pri->is_crt = check_rsa_is_crt(rsa);
 
-	rsa_sess = rsa_get_eng_session(rsa, uadk_rsa_bits(rsa), pri->is_crt);
+	rsa_sess = rsa_get_key_session(rsa, uadk_rsa_bits(rsa), pri->is_crt);
 	if (!rsa_sess) {
 		ret = UADK_DO_SOFT;
 		goto free_pkey;
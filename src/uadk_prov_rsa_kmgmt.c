@@ -26,6 +26,14 @@
 #define GENCB_NEXT			2
 #define BN_CONTINUE			1
 #define BN_VALID			0
+/* odd primes below the limit sieve the candidates before the accelerator */
+#define RSA_SIEVE_LIMIT			8192
+#define RSA_SIEVE_PRIMES		1027
+#define RSA_PRIME_MAX_DELTA		(1 << 20)
+/* candidates, or miller-rabin rounds, sent to the accelerator at once */
+#define RSA_PRIME_PIPE_NUM		8
+/* as many rounds as BN_check_prime() of OpenSSL 3 does */
+#define RSA_PRIME_MR_ROUNDS(bits)	((bits) > 2048 ? 128 : 64)
 
 UADK_PKEY_KEYMGMT_DESCR(rsa, RSA);
 
@@ -46,6 +54,25 @@ struct rsa_keygen_param_bn {
 	BIGNUM *q;
 };
 
+/*
+ * Accelerator sessions with the prime size as key size. The modular
+ * exponentiations of primality tests go to them all at once, as public
+ * key operations with the candidate as modulus.
+ */
+struct rsa_prime_pipe {
+	struct uadk_rsa_sess *sess[RSA_PRIME_PIPE_NUM];
+	BIGNUM *cand[RSA_PRIME_PIPE_NUM];
+	BIGNUM *base[RSA_PRIME_PIPE_NUM];
+	BIGNUM *res[RSA_PRIME_PIPE_NUM];
+	unsigned char *in;
+	unsigned char *out;
+	BN_CTX *ctx;
+	int key_size;
+	int bits;
+	/* a request never came back, sess, in and out stay with the hardware */
+	int lost;
+};
+
 struct rsa_prime_param {
 	BIGNUM *r1;
 	BIGNUM *r2;
@@ -53,6 +80,8 @@ struct rsa_prime_param {
 	BIGNUM *rsa_q;
 	BIGNUM *prime;
 	int retries;
+	/* NULL when the primes are found in software */
+	struct rsa_prime_pipe *pipe;
 };
 
 struct rsa_gen_ctx {
@@ -74,6 +103,10 @@ struct rsa_gen_ctx {
 	void *cbarg;
 };
 
+static unsigned short rsa_sieve_primes[RSA_SIEVE_PRIMES];
+static int rsa_sieve_num;
+static pthread_once_t rsa_sieve_once = PTHREAD_ONCE_INIT;
+
 static UADK_PKEY_KEYMGMT s_keymgmt;
 static UADK_PKEY_KEYMGMT rsapss_keymgmt;
 
@@ -372,6 +405,361 @@ static int check_rsa_prime_useful(int * const n, struct rsa_prime_param *param,
 	return GET_ERR_FINISH;
 }
 
+static void rsa_sieve_init(void)
+{
+	unsigned char composite[RSA_SIEVE_LIMIT] = {0};
+	int i, j;
+
+	for (i = 3; i < RSA_SIEVE_LIMIT && rsa_sieve_num < RSA_SIEVE_PRIMES; i += 2) {
+		if (composite[i])
+			continue;
+
+		rsa_sieve_primes[rsa_sieve_num++] = i;
+		for (j = i * i; j < RSA_SIEVE_LIMIT; j += i << 1)
+			composite[j] = 1;
+	}
+}
+
+static void rsa_prime_pipe_free(struct rsa_prime_pipe *pipe)
+{
+	int i;
+
+	if (!pipe)
+		return;
+
+	for (i = 0; i < RSA_PRIME_PIPE_NUM; i++) {
+		if (!pipe->lost)
+			rsa_free_eng_session(pipe->sess[i]);
+		BN_clear_free(pipe->cand[i]);
+		BN_clear_free(pipe->base[i]);
+		BN_clear_free(pipe->res[i]);
+	}
+
+	if (!pipe->lost) {
+		OPENSSL_clear_free(pipe->in, pipe->key_size * RSA_PRIME_PIPE_NUM);
+		OPENSSL_clear_free(pipe->out, pipe->key_size * RSA_PRIME_PIPE_NUM);
+	}
+	BN_CTX_free(pipe->ctx);
+	OPENSSL_free(pipe);
+}
+
+/* NULL if the accelerator has no key size for primes of these bits */
+static struct rsa_prime_pipe *rsa_prime_pipe_new(int bits)
+{
+	struct rsa_prime_pipe *pipe;
+	int i;
+
+	if (rsa_check_bit_useful(bits) != UADK_P_SUCCESS)
+		return NULL;
+
+	pthread_once(&rsa_sieve_once, rsa_sieve_init);
+
+	pipe = OPENSSL_zalloc(sizeof(*pipe));
+	if (!pipe)
+		return NULL;
+
+	pipe->bits = bits;
+	pipe->key_size = bits >> BIT_BYTES_SHIFT;
+	pipe->in = OPENSSL_zalloc(pipe->key_size * RSA_PRIME_PIPE_NUM);
+	pipe->out = OPENSSL_zalloc(pipe->key_size * RSA_PRIME_PIPE_NUM);
+	pipe->ctx = BN_CTX_secure_new();
+	if (!pipe->in || !pipe->out || !pipe->ctx)
+		goto free_pipe;
+
+	for (i = 0; i < RSA_PRIME_PIPE_NUM; i++) {
+		pipe->cand[i] = BN_secure_new();
+		pipe->base[i] = BN_secure_new();
+		pipe->res[i] = BN_secure_new();
+		if (!pipe->cand[i] || !pipe->base[i] || !pipe->res[i])
+			goto free_pipe;
+
+		pipe->sess[i] = rsa_get_eng_session(NULL, bits, 0);
+		if (!pipe->sess[i])
+			goto free_pipe;
+	}
+
+	return pipe;
+
+free_pipe:
+	rsa_prime_pipe_free(pipe);
+	return NULL;
+}
+
+/* res[i] = base[i] ^ e[i] mod n[i] on the accelerator, num of them at once */
+static int rsa_prime_pipe_exp(struct rsa_prime_pipe *pipe, int num,
+			      const BIGNUM **e, const BIGNUM **n)
+{
+	struct rsa_pubkey_param pub;
+	struct uadk_rsa_sess *sess;
+	unsigned char *in, *out;
+	int i, ret;
+
+	for (i = 0; i < num; i++) {
+		sess = pipe->sess[i];
+		in = pipe->in + i * pipe->key_size;
+		out = pipe->out + i * pipe->key_size;
+
+		pub.e = e[i];
+		pub.n = n[i];
+		if (!rsa_load_pubkey(sess->sess, &pub) ||
+		    BN_bn2binpad(pipe->base[i], in, pipe->key_size) < 0)
+			return UADK_P_FAIL;
+
+		sess->req.op_type = WD_RSA_VERIFY;
+		sess->req.src_bytes = pipe->key_size;
+		sess->req.dst_bytes = pipe->key_size;
+		sess->req.src = in;
+		sess->req.dst = out;
+	}
+
+	ret = uadk_prov_rsa_do_crypto_batch(pipe->sess, num);
+	if (ret == -ETIMEDOUT)
+		pipe->lost = 1;
+	if (ret != UADK_P_SUCCESS)
+		return UADK_P_FAIL;
+
+	for (i = 0; i < num; i++) {
+		out = pipe->out + i * pipe->key_size;
+		if (!BN_bin2bn(out, pipe->key_size, pipe->res[i]))
+			return UADK_P_FAIL;
+	}
+
+	return UADK_P_SUCCESS;
+}
+
+/* a random odd number of the bits, with no factor below RSA_SIEVE_LIMIT */
+static int rsa_prime_candidate(BIGNUM *cand, int bits)
+{
+	BN_ULONG mods[RSA_SIEVE_PRIMES];
+	BN_ULONG delta;
+	int i;
+
+	for (;;) {
+		if (!BN_priv_rand(cand, bits, BN_RAND_TOP_TWO, BN_RAND_BOTTOM_ODD))
+			return UADK_P_FAIL;
+
+		for (i = 0; i < rsa_sieve_num; i++) {
+			mods[i] = BN_mod_word(cand, rsa_sieve_primes[i]);
+			if (mods[i] == (BN_ULONG)-1)
+				return UADK_P_FAIL;
+		}
+
+		for (delta = 0; delta < RSA_PRIME_MAX_DELTA; delta += 2) {
+			for (i = 0; i < rsa_sieve_num; i++) {
+				if (!((mods[i] + delta) % rsa_sieve_primes[i]))
+					break;
+			}
+			if (i == rsa_sieve_num)
+				break;
+		}
+
+		if (delta >= RSA_PRIME_MAX_DELTA)
+			continue;
+
+		if (!BN_add_word(cand, delta))
+			return UADK_P_FAIL;
+
+		if (BN_num_bits(cand) == bits)
+			return UADK_P_SUCCESS;
+	}
+}
+
+/* miller-rabin: y = a ^ d mod cand, with cand - 1 = d * 2 ^ s */
+static int rsa_prime_mr_pass(BIGNUM *y, const BIGNUM *cand, const BIGNUM *cand_1,
+			     int s, BN_CTX *ctx)
+{
+	int j;
+
+	if (BN_is_one(y) || !BN_cmp(y, cand_1))
+		return BN_VALID;
+
+	for (j = 1; j < s; j++) {
+		if (!BN_mod_sqr(y, y, cand, ctx))
+			return BN_ERR;
+		if (!BN_cmp(y, cand_1))
+			return BN_VALID;
+		if (BN_is_one(y))
+			break;
+	}
+
+	return BN_CONTINUE;
+}
+
+/* cand - 1 = d * 2 ^ s with d odd, returns s or 0 on error */
+static int rsa_prime_split(BIGNUM *d, BIGNUM *cand_1, const BIGNUM *cand)
+{
+	int s;
+
+	if (!BN_sub(cand_1, cand, BN_value_one()))
+		return 0;
+
+	for (s = 1; !BN_is_bit_set(cand_1, s); s++)
+		;
+
+	return BN_rshift(d, cand_1, s) ? s : 0;
+}
+
+/*
+ * Miller-rabin rounds with random bases on the accelerator, then one more
+ * in software so that a faulty device cannot pass a composite on its own.
+ * Returns BN_VALID for a probable prime, BN_CONTINUE for a composite.
+ */
+static int rsa_prime_pipe_mr(struct rsa_prime_pipe *pipe, const BIGNUM *cand,
+			     BN_GENCB *cb)
+{
+	const BIGNUM *e[RSA_PRIME_PIPE_NUM], *n[RSA_PRIME_PIPE_NUM];
+	int rounds = RSA_PRIME_MR_ROUNDS(pipe->bits);
+	BIGNUM *cand_1, *d, *range;
+	int ret = BN_ERR;
+	int i, s, r, num;
+
+	BN_CTX_start(pipe->ctx);
+	cand_1 = BN_CTX_get(pipe->ctx);
+	d = BN_CTX_get(pipe->ctx);
+	range = BN_CTX_get(pipe->ctx);
+	if (!range)
+		goto end;
+
+	s = rsa_prime_split(d, cand_1, cand);
+	/* bases in [2, cand - 2] */
+	if (!s || !BN_sub(range, cand_1, BN_value_one()) || !BN_sub_word(range, 1))
+		goto end;
+
+	for (i = 0; i < RSA_PRIME_PIPE_NUM; i++) {
+		e[i] = d;
+		n[i] = cand;
+	}
+
+	for (r = 0; r < rounds; r += num) {
+		num = rounds - r < RSA_PRIME_PIPE_NUM ? rounds - r : RSA_PRIME_PIPE_NUM;
+		for (i = 0; i < num; i++) {
+			if (!BN_priv_rand_range(pipe->base[i], range) ||
+			    !BN_add_word(pipe->base[i], 2)) {
+				ret = BN_ERR;
+				goto end;
+			}
+		}
+
+		if (!rsa_prime_pipe_exp(pipe, num, e, n)) {
+			ret = UADK_DO_SOFT;
+			goto end;
+		}
+
+		for (i = 0; i < num; i++) {
+			ret = rsa_prime_mr_pass(pipe->res[i], cand, cand_1, s, pipe->ctx);
+			if (ret != BN_VALID)
+				goto end;
+		}
+
+		if (!BN_GENCB_call(cb, 1, r)) {
+			ret = BN_ERR;
+			goto end;
+		}
+	}
+
+	if (!BN_priv_rand_range(pipe->base[0], range) || !BN_add_word(pipe->base[0], 2) ||
+	    !BN_mod_exp_mont_consttime(pipe->res[0], pipe->base[0], d, cand, pipe->ctx, NULL)) {
+		ret = BN_ERR;
+		goto end;
+	}
+
+	ret = rsa_prime_mr_pass(pipe->res[0], cand, cand_1, s, pipe->ctx);
+
+end:
+	BN_CTX_end(pipe->ctx);
+	return ret;
+}
+
+/*
+ * Sieve a set of candidates in software, give them all a base 2 miller-rabin
+ * round on the accelerator at once, and take the first one that passes
+ * through the full set of rounds.
+ */
+static int rsa_prime_pipe_gen(struct rsa_prime_pipe *pipe, BIGNUM *prime,
+			      BN_GENCB *cb)
+{
+	const BIGNUM *e[RSA_PRIME_PIPE_NUM], *n[RSA_PRIME_PIPE_NUM];
+	BIGNUM *cand_1[RSA_PRIME_PIPE_NUM], *d[RSA_PRIME_PIPE_NUM];
+	int s[RSA_PRIME_PIPE_NUM];
+	int ret = BN_ERR;
+	int i, tries = 0;
+
+	BN_CTX_start(pipe->ctx);
+	for (i = 0; i < RSA_PRIME_PIPE_NUM; i++) {
+		cand_1[i] = BN_CTX_get(pipe->ctx);
+		d[i] = BN_CTX_get(pipe->ctx);
+		e[i] = d[i];
+		n[i] = pipe->cand[i];
+	}
+	if (!d[RSA_PRIME_PIPE_NUM - 1])
+		goto end;
+
+	for (;;) {
+		for (i = 0; i < RSA_PRIME_PIPE_NUM; i++) {
+			if (!rsa_prime_candidate(pipe->cand[i], pipe->bits) ||
+			    !BN_set_word(pipe->base[i], 2))
+				goto end;
+
+			s[i] = rsa_prime_split(d[i], cand_1[i], pipe->cand[i]);
+			if (!s[i])
+				goto end;
+		}
+
+		if (!rsa_prime_pipe_exp(pipe, RSA_PRIME_PIPE_NUM, e, n)) {
+			ret = UADK_DO_SOFT;
+			goto end;
+		}
+
+		for (i = 0; i < RSA_PRIME_PIPE_NUM; i++) {
+			if (!BN_GENCB_call(cb, 0, tries++)) {
+				ret = BN_ERR;
+				goto end;
+			}
+
+			ret = rsa_prime_mr_pass(pipe->res[i], pipe->cand[i], cand_1[i],
+						s[i], pipe->ctx);
+			if (ret == BN_CONTINUE)
+				continue;
+			if (ret != BN_VALID)
+				goto end;
+
+			/* the rounds reuse the pipe, the other results are gone */
+			ret = rsa_prime_pipe_mr(pipe, pipe->cand[i], cb);
+			if (ret == BN_CONTINUE)
+				break;
+			if (ret == BN_VALID && !BN_copy(prime, pipe->cand[i]))
+				ret = BN_ERR;
+			goto end;
+		}
+	}
+
+end:
+	BN_CTX_end(pipe->ctx);
+	if (ret == BN_VALID)
+		return UADK_P_SUCCESS;
+	if (ret == UADK_DO_SOFT)
+		return UADK_DO_SOFT;
+	return UADK_P_FAIL;
+}
+
+static int rsa_generate_prime(struct rsa_prime_param *param, int bits, BN_GENCB *cb)
+{
+	int ret;
+
+	if (param->pipe && param->pipe->bits == bits) {
+		ret = rsa_prime_pipe_gen(param->pipe, param->prime, cb);
+		if (ret != UADK_DO_SOFT)
+			return ret;
+
+		/* the accelerator failed, the rest of the key is done in software */
+		UADK_ERR("failed to test rsa primes in hardware, switch to soft\n");
+		rsa_prime_pipe_free(param->pipe);
+		param->pipe = NULL;
+	}
+
+	return BN_generate_prime_ex(param->prime, bits, 0, NULL, NULL, cb);
+}
+
 static int get_rsa_prime_once(int num, const int *bitsr, int * const n,
 			      BIGNUM *e_pub, struct rsa_prime_param *param,
 			      BN_CTX *ctx, BN_GENCB *cb)
@@ -383,8 +771,7 @@ static int get_rsa_prime_once(int num, const int *bitsr, int * const n,
 
 	while (1) {
 		/* Generate prime with bitsr[num] len. */
-		if (!BN_generate_prime_ex(param->prime, bitsr[num],
-					  0, NULL, NULL, cb))
+		if (!rsa_generate_prime(param, bitsr[num], cb))
 			return BN_ERR;
 		if (!check_rsa_prime_equal(num, param->rsa_p, param->rsa_q,
 					   param->prime))
@@ -464,6 +851,8 @@ static int rsa_primes_gen(int bits, BIGNUM *e_pub, BIGNUM *p,
 	if (ret != UADK_P_SUCCESS)
 		goto free_param;
 
+	param->pipe = rsa_prime_pipe_new(bits / RSA_MAX_PRIME_NUM);
+
 	/* Divide bits into 'primes' pieces evenly */
 	quot = bits / RSA_MAX_PRIME_NUM;
 	rmd = bits % RSA_MAX_PRIME_NUM;
@@ -497,6 +886,7 @@ static int rsa_primes_gen(int bits, BIGNUM *e_pub, BIGNUM *p,
 	ret = UADK_P_SUCCESS;
 
 free_param:
+	rsa_prime_pipe_free(param->pipe);
 	OPENSSL_free(param);
 free_ctx:
 	BN_CTX_end(bnctx);
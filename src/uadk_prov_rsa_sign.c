@@ -286,7 +286,7 @@ static int uadk_prov_rsa_private_sign(int flen, const unsigned char *from,
 
 	prik->is_crt = check_rsa_is_crt(rsa);
 
-	rsa_sess = rsa_get_eng_session(rsa, uadk_rsa_bits(rsa), prik->is_crt);
+	rsa_sess = rsa_get_key_session(rsa, uadk_rsa_bits(rsa), prik->is_crt);
 	if (!rsa_sess) {
 		ret = UADK_DO_SOFT;
 		goto free_pkey;
@@ -382,7 +382,7 @@ static int uadk_prov_rsa_public_verify(int flen, const unsigned char *from,
 
 	is_crt = check_rsa_is_crt(rsa);
 
-	rsa_sess = rsa_get_eng_session(rsa, uadk_rsa_bits(rsa), is_crt);
+	rsa_sess = rsa_get_key_session(rsa, uadk_rsa_bits(rsa), is_crt);
 	if (!rsa_sess) {
 		ret = UADK_DO_SOFT;
 		goto free_pkey;
@@ -319,13 +319,11 @@ static int sm2_prov_get_hash_type(int nid_hash)
 	}
 }
 
-static int sm2_prov_alloc_sess(PROV_SM2_ASYM_CTX *vpsm2ctx, handle_t *sess)
+static int sm2_prov_get_sess(PROV_SM2_ASYM_CTX *vpsm2ctx, int key_type,
+			     struct uadk_ecc_sess **ecc_sess)
 {
-	const EC_GROUP *group = EC_KEY_get0_group(vpsm2ctx->key);
 	const EVP_MD *md = sm2_prov_digest_md(&vpsm2ctx->md);
-	const BIGNUM *order = EC_GROUP_get0_order(group);
-	struct wd_ecc_sess_setup setup = {0};
-	struct sched_params params = {0};
+	struct uadk_ecc_sess_cfg cfg = {0};
 	int md_nid = EVP_MD_get_type(md);
 	int type;
 
@@ -334,19 +332,14 @@ static int sm2_prov_alloc_sess(PROV_SM2_ASYM_CTX *vpsm2ctx, handle_t *sess)
 		UADK_ERR("uadk not support hash nid %d\n", md_nid);
 		return UADK_DO_SOFT;
 	}
-	setup.hash.type = type;
-	setup.hash.cb = sm2_prov_compute_hash;
-	setup.hash.usr = (void *)md;
+	cfg.md = md;
+	cfg.hash_type = type;
+	cfg.hash_cb = sm2_prov_compute_hash;
+	cfg.alg = "sm2";
+	cfg.key_type = key_type;
 
-	setup.rand.cb = uadk_prov_ecc_get_rand;
-	setup.rand.usr = (void *)order;
-	setup.alg = "sm2";
-
-	/* Use the default numa parameters */
-	params.numa_id = -1;
-	setup.sched_param = &params;
-	*sess = wd_ecc_alloc_sess(&setup);
-	if (*sess == (handle_t)0) {
+	*ecc_sess = uadk_prov_ecc_get_sess(vpsm2ctx->key, &cfg);
+	if (*ecc_sess == NULL) {
 		UADK_ERR("failed to alloc sess\n");
 		return UADK_P_FAIL;
 	}
@@ -354,11 +347,6 @@ static int sm2_prov_alloc_sess(PROV_SM2_ASYM_CTX *vpsm2ctx, handle_t *sess)
 	return UADK_P_SUCCESS;
 }
 
-static void sm2_prov_free_sess(handle_t sess)
-{
-	wd_ecc_free_sess(sess);
-}
-
 static int sm2_prov_encrypt_init_iot(handle_t sess, struct wd_ecc_req *req,
 				     void *in, size_t inlen)
 {
@@ -472,6 +460,7 @@ static int sm2_prov_encrypt(PROV_SM2_ASYM_CTX *vpsm2ctx,
 			    const unsigned char *in, size_t inlen)
 {
 	struct wd_ecc_point *c1 = NULL;
+	struct uadk_ecc_sess *ecc_sess;
 	struct wd_ecc_req req = {0};
 	struct wd_dtb *c2 = NULL;
 	struct wd_dtb *c3 = NULL;
@@ -490,20 +479,17 @@ static int sm2_prov_encrypt(PROV_SM2_ASYM_CTX *vpsm2ctx,
 		goto do_soft;
 	}
 
-	ret = sm2_prov_alloc_sess(vpsm2ctx, &sess);
+	ret = sm2_prov_get_sess(vpsm2ctx, UADK_ECC_SESS_PUBKEY, &ecc_sess);
 	if (ret != UADK_P_SUCCESS) {
 		UADK_ERR("failed to alloc sess in encrypt\n");
 		goto do_soft;
 	}
+	sess = ecc_sess->sess;
 
 	ret = sm2_prov_encrypt_init_iot(sess, &req, (void *)in, inlen);
 	if (ret == UADK_P_FAIL)
 		goto free_sess;
 
-	ret = uadk_prov_ecc_set_public_key(sess, vpsm2ctx->key);
-	if (ret == UADK_P_FAIL)
-		goto uninit_iot;
-
 	ret = uadk_prov_ecc_crypto(sess, &req, (void *)sess);
 	if (ret == UADK_P_FAIL) {
 		UADK_ERR("failed to do sm2 encrypt\n");
@@ -522,7 +508,7 @@ static int sm2_prov_encrypt(PROV_SM2_ASYM_CTX *vpsm2ctx,
 uninit_iot:
 	sm2_prov_uninit_iot(sess, &req);
 free_sess:
-	sm2_prov_free_sess(sess);
+	uadk_prov_ecc_put_sess(ecc_sess, ret == UADK_P_SUCCESS);
 do_soft:
 	if (ret == UADK_DO_SOFT)
 		return sm2_prov_encrypt_sw(vpsm2ctx, out, outlen, in, inlen);
@@ -682,6 +668,7 @@ static int sm2_prov_decrypt(PROV_SM2_ASYM_CTX *psm2ctx, unsigned char *out,
 {
 	const EVP_MD *md = sm2_prov_digest_md(&psm2ctx->md);
 	int md_size = EVP_MD_get_size(md);
+	struct uadk_ecc_sess *ecc_sess;
 	struct wd_ecc_req req = {0};
 	handle_t sess;
 	int ret;
@@ -698,20 +685,17 @@ static int sm2_prov_decrypt(PROV_SM2_ASYM_CTX *psm2ctx, unsigned char *out,
 		goto do_soft;
 	}
 
-	ret = sm2_prov_alloc_sess(psm2ctx, &sess);
+	ret = sm2_prov_get_sess(psm2ctx, UADK_ECC_SESS_PRIKEY, &ecc_sess);
 	if (ret != UADK_P_SUCCESS) {
-		UADK_ERR("failed to alloc sess in encrypt\n");
+		UADK_ERR("failed to alloc sess in decrypt\n");
 		goto do_soft;
 	}
+	sess = ecc_sess->sess;
 
 	ret = sm2_prov_decrypt_init_iot(sess, &req, md_size, in, inlen);
 	if (ret == UADK_P_FAIL)
 		goto free_sess;
 
-	ret = uadk_prov_ecc_set_private_key(sess, psm2ctx->key);
-	if (ret == UADK_P_FAIL)
-		goto uninit_iot;
-
 	ret = uadk_prov_ecc_crypto(sess, &req, (void *)sess);
 	if (ret == UADK_P_FAIL) {
 		UADK_ERR("failed to do sm2 decrypt\n");
@@ -724,7 +708,7 @@ static int sm2_prov_decrypt(PROV_SM2_ASYM_CTX *psm2ctx, unsigned char *out,
 uninit_iot:
 	sm2_prov_uninit_iot(sess, &req);
 free_sess:
-	sm2_prov_free_sess(sess);
+	uadk_prov_ecc_put_sess(ecc_sess, ret == UADK_P_SUCCESS);
 do_soft:
 	if (ret == UADK_DO_SOFT)
 		return sm2_prov_decrypt_sw(psm2ctx, out, outlen, in, inlen);
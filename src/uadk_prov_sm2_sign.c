@@ -77,6 +77,9 @@ typedef struct {
 	 */
 	unsigned char *id;
 	size_t id_len;
+
+	/* uadk only, kept after the fields shared with the default provider */
+	int operation;
 } PROV_SM2_SIGN_CTX;
 
 struct sm2_param {
@@ -110,6 +113,11 @@ static const OSSL_PARAM sm2_sig_known_gettable_ctx_params[] = {
 	OSSL_PARAM_octet_string(OSSL_SIGNATURE_PARAM_ALGORITHM_ID, NULL, 0),
 	OSSL_PARAM_size_t(OSSL_SIGNATURE_PARAM_DIGEST_SIZE, NULL),
 	OSSL_PARAM_utf8_string(OSSL_SIGNATURE_PARAM_DIGEST, NULL, 0),
+	OSSL_PARAM_uint(UADK_PROV_PARAM_BATCH_OP, NULL),
+	OSSL_PARAM_octet_string(UADK_PROV_PARAM_BATCH_TBS, NULL, 0),
+	OSSL_PARAM_octet_string(UADK_PROV_PARAM_BATCH_SIG, NULL, 0),
+	OSSL_PARAM_int(UADK_PROV_PARAM_BATCH_STATUS, NULL),
+	OSSL_PARAM_size_t(UADK_PROV_PARAM_BATCH_DONE, NULL),
 	OSSL_PARAM_END
 };
 
@@ -207,35 +215,14 @@ static int sm2_sig_set_mdname(PROV_SM2_SIGN_CTX *psm2ctx, const char *mdname)
 	return UADK_P_SUCCESS;
 }
 
-static handle_t sm2_alloc_sess(const EC_KEY *key)
+static struct uadk_ecc_sess *sm2_get_sess(const EC_KEY *key, int key_type)
 {
-	const EC_GROUP *group = EC_KEY_get0_group(key);
-	const BIGNUM *order = EC_GROUP_get0_order(group);
-	struct wd_ecc_sess_setup setup = {0};
-	struct sched_params params = {0};
-	handle_t sess;
-
-	setup.alg = "sm2";
-	setup.rand.cb = uadk_prov_ecc_get_rand;
-	setup.rand.usr = (void *)order;
-	if (!setup.rand.usr) {
-		UADK_ERR("failed to BN_bin2bn order\n");
-		return (handle_t)0;
-	}
+	struct uadk_ecc_sess_cfg cfg = {0};
 
-	/* Use the default numa parameters */
-	params.numa_id = -1;
-	setup.sched_param = &params;
-	sess = wd_ecc_alloc_sess(&setup);
-	if (sess == (handle_t)0)
-		UADK_ERR("failed to alloc sess\n");
+	cfg.alg = "sm2";
+	cfg.key_type = key_type;
 
-	return sess;
-}
-
-static void sm2_free_sess(handle_t sess)
-{
-	wd_ecc_free_sess(sess);
+	return uadk_prov_ecc_get_sess(key, &cfg);
 }
 
 static int sm2_locate_id_digest(PROV_SM2_SIGN_CTX *psm2ctx, const OSSL_PARAM params[])
@@ -315,7 +302,8 @@ static int uadk_signature_sm2_set_ctx_params(void *vpsm2ctx, const OSSL_PARAM pa
 	return sm2_locate_id_digest(psm2ctx, params);
 }
 
-static int sm2_signverify_init(void *vpsm2ctx, void *ec, const OSSL_PARAM params[])
+static int sm2_signverify_init(void *vpsm2ctx, void *ec, const OSSL_PARAM params[],
+			       int operation)
 {
 	PROV_SM2_SIGN_CTX *psm2ctx = (PROV_SM2_SIGN_CTX *)vpsm2ctx;
 
@@ -338,19 +326,21 @@ static int sm2_signverify_init(void *vpsm2ctx, void *ec, const OSSL_PARAM params
 		psm2ctx->key = (EC_KEY *)ec;
 	}
 
+	psm2ctx->operation = operation;
+
 	return uadk_signature_sm2_set_ctx_params(vpsm2ctx, params);
 }
 
 static int uadk_signature_sm2_sign_init(void *vpsm2ctx, void *ec,
 					const OSSL_PARAM params[])
 {
-	return sm2_signverify_init(vpsm2ctx, ec, params);
+	return sm2_signverify_init(vpsm2ctx, ec, params, EVP_PKEY_OP_SIGN);
 }
 
 static int uadk_signature_sm2_verify_init(void *vpsm2ctx, void *ec,
 					  const OSSL_PARAM params[])
 {
-	return sm2_signverify_init(vpsm2ctx, ec, params);
+	return sm2_signverify_init(vpsm2ctx, ec, params, EVP_PKEY_OP_VERIFY);
 }
 
 static int sm2_check_tbs_params(PROV_SM2_SIGN_CTX *psm2ctx,
@@ -524,6 +514,7 @@ static int sm2_sign_hw(PROV_SM2_SIGN_CTX *psm2ctx,
 		       unsigned char *sig, size_t *siglen,
 		       const unsigned char *tbs, size_t tbslen)
 {
+	struct uadk_ecc_sess *ecc_sess;
 	struct wd_ecc_req req = {0};
 	handle_t sess;
 	int ret;
@@ -535,20 +526,17 @@ static int sm2_sign_hw(PROV_SM2_SIGN_CTX *psm2ctx,
 		return UADK_DO_SOFT;
 	}
 
-	sess = sm2_alloc_sess(psm2ctx->key);
-	if (sess == (handle_t)0) {
+	ecc_sess = sm2_get_sess(psm2ctx->key, UADK_ECC_SESS_PRIKEY);
+	if (!ecc_sess) {
 		UADK_ERR("failed to alloc sess in sign\n");
 		return UADK_P_FAIL;
 	}
+	sess = ecc_sess->sess;
 
 	ret = sm2_sign_init_iot(sess, &req, (void *)tbs, tbslen);
 	if (ret == UADK_P_FAIL)
 		goto free_sess;
 
-	ret = uadk_prov_ecc_set_private_key(sess, psm2ctx->key);
-	if (ret == UADK_P_FAIL)
-		goto uninit_iot;
-
 	ret = uadk_prov_ecc_crypto(sess, &req, (void *)sess);
 	if (ret == UADK_P_FAIL) {
 		UADK_ERR("failed to do sm2 sign\n");
@@ -561,7 +549,7 @@ static int sm2_sign_hw(PROV_SM2_SIGN_CTX *psm2ctx,
 uninit_iot:
 	sm2_sign_uninit_iot(sess, &req);
 free_sess:
-	sm2_free_sess(sess);
+	uadk_prov_ecc_put_sess(ecc_sess, ret == UADK_P_SUCCESS);
 	return ret;
 }
 
@@ -673,6 +661,7 @@ static int sm2_verify_hw(PROV_SM2_SIGN_CTX *psm2ctx,
 			 const unsigned char *sig, size_t siglen,
 			 const unsigned char *tbs, size_t tbslen)
 {
+	struct uadk_ecc_sess *ecc_sess;
 	struct wd_ecc_req req = {0};
 	handle_t sess;
 	int ret;
@@ -684,11 +673,12 @@ static int sm2_verify_hw(PROV_SM2_SIGN_CTX *psm2ctx,
 		return UADK_DO_SOFT;
 	}
 
-	sess = sm2_alloc_sess(psm2ctx->key);
-	if (sess == (handle_t)0) {
+	ecc_sess = sm2_get_sess(psm2ctx->key, UADK_ECC_SESS_PUBKEY);
+	if (!ecc_sess) {
 		UADK_ERR("failed to alloc sess in verify\n");
 		return UADK_P_FAIL;
 	}
+	sess = ecc_sess->sess;
 
 	ret = sm2_verify_init_iot(sess, &req, sig, siglen, tbs, tbslen);
 	if (ret == UADK_P_FAIL) {
@@ -696,12 +686,6 @@ static int sm2_verify_hw(PROV_SM2_SIGN_CTX *psm2ctx,
 		goto free_sess;
 	}
 
-	ret = uadk_prov_ecc_set_public_key(sess, psm2ctx->key);
-	if (ret == UADK_P_FAIL) {
-		UADK_ERR("failed to uadk_prov_ecc_set_public_key\n");
-		goto uninit_iot;
-	}
-
 	ret = uadk_prov_ecc_crypto(sess, &req, (void *)sess);
 	if (req.status == WD_VERIFY_ERR) {
 		ret = UADK_P_FAIL;
@@ -710,10 +694,9 @@ static int sm2_verify_hw(PROV_SM2_SIGN_CTX *psm2ctx,
 		UADK_ERR("failed to do sm2 verify\n");
 	}
 
-uninit_iot:
 	sm2_verify_uninit_iot(sess, &req);
 free_sess:
-	sm2_free_sess(sess);
+	uadk_prov_ecc_put_sess(ecc_sess, ret == UADK_P_SUCCESS);
 
 	return ret;
 }
@@ -753,15 +736,121 @@ static int uadk_signature_sm2_verify(void *vpsm2ctx, const unsigned char *sig, s
 	return ret;
 }
 
+static int sm2_batch_sign_prepare(void *vpsm2ctx, handle_t sess,
+				  struct uadk_prov_batch_item *item,
+				  struct wd_ecc_req *req)
+{
+	PROV_SM2_SIGN_CTX *psm2ctx = (PROV_SM2_SIGN_CTX *)vpsm2ctx;
+
+	if (item->siglen < (size_t)ECDSA_size(psm2ctx->key) ||
+	    sm2_check_tbs_params(psm2ctx, item->tbs, item->tbslen) == UADK_P_FAIL)
+		return UADK_P_FAIL;
+
+	return sm2_sign_init_iot(sess, req, (void *)item->tbs, item->tbslen);
+}
+
+static int sm2_batch_sign_finish(void *vpsm2ctx, struct uadk_prov_batch_item *item,
+				 struct wd_ecc_req *req)
+{
+	if (req->status)
+		return UADK_DO_SOFT;
+
+	if (sm2_sign_bin_to_ber(req, item->sig, &item->siglen) == UADK_P_FAIL)
+		return UADK_P_FAIL;
+
+	item->status = 1;
+
+	return UADK_P_SUCCESS;
+}
+
+static int sm2_batch_sign_single(void *vpsm2ctx, struct uadk_prov_batch_item *item)
+{
+	size_t sigsize = item->siglen;
+
+	return uadk_signature_sm2_sign(vpsm2ctx, item->sig, &item->siglen, sigsize,
+				       item->tbs, item->tbslen) > 0;
+}
+
+static int sm2_batch_verify_prepare(void *vpsm2ctx, handle_t sess,
+				    struct uadk_prov_batch_item *item,
+				    struct wd_ecc_req *req)
+{
+	PROV_SM2_SIGN_CTX *psm2ctx = (PROV_SM2_SIGN_CTX *)vpsm2ctx;
+
+	if (sm2_check_tbs_params(psm2ctx, item->tbs, item->tbslen) == UADK_P_FAIL)
+		return UADK_P_FAIL;
+
+	return sm2_verify_init_iot(sess, req, item->sig, item->siglen,
+				   item->tbs, item->tbslen);
+}
+
+static int sm2_batch_verify_finish(void *vpsm2ctx, struct uadk_prov_batch_item *item,
+				   struct wd_ecc_req *req)
+{
+	/* a mismatch is an answer, as in sm2_verify_hw */
+	if (req->status && req->status != WD_VERIFY_ERR)
+		return UADK_DO_SOFT;
+
+	item->status = !req->status;
+
+	return UADK_P_SUCCESS;
+}
+
+static int sm2_batch_verify_single(void *vpsm2ctx, struct uadk_prov_batch_item *item)
+{
+	return uadk_signature_sm2_verify(vpsm2ctx, item->sig, item->siglen,
+					 item->tbs, item->tbslen) > 0;
+}
+
+static const struct uadk_ecc_batch_ops sm2_batch_sign_ops = {
+	.prepare = sm2_batch_sign_prepare,
+	.finish = sm2_batch_sign_finish,
+	.release = sm2_sign_uninit_iot,
+	.single = sm2_batch_sign_single,
+};
+
+static const struct uadk_ecc_batch_ops sm2_batch_verify_ops = {
+	.prepare = sm2_batch_verify_prepare,
+	.finish = sm2_batch_verify_finish,
+	.release = sm2_verify_uninit_iot,
+	.single = sm2_batch_verify_single,
+};
+
+static int sm2_batch(PROV_SM2_SIGN_CTX *psm2ctx, struct uadk_prov_batch *batch)
+{
+	int sign = batch->op == UADK_PROV_BATCH_SIGN;
+	struct uadk_ecc_sess *ecc_sess = NULL;
+	handle_t sess = 0;
+	int ret;
+
+	if (!psm2ctx->key) {
+		UADK_ERR("invalid: sm2 key is NULL to batch\n");
+		return UADK_P_FAIL;
+	}
+
+	/* no session sends every item through the single shot path */
+	if (uadk_prov_ecc_init("sm2") == UADK_P_SUCCESS)
+		ecc_sess = sm2_get_sess(psm2ctx->key,
+					sign ? UADK_ECC_SESS_PRIKEY : UADK_ECC_SESS_PUBKEY);
+	if (ecc_sess)
+		sess = ecc_sess->sess;
+
+	ret = uadk_prov_ecc_batch(psm2ctx, sess, batch,
+				  sign ? &sm2_batch_sign_ops : &sm2_batch_verify_ops);
+	uadk_prov_ecc_put_sess(ecc_sess, ret == UADK_P_SUCCESS);
+
+	return ret;
+}
+
 static int sm2_digest_signverify_init(void *vpsm2ctx, const char *mdname,
-				      void *ec, const OSSL_PARAM params[])
+				      void *ec, const OSSL_PARAM params[], int operation)
 {
 	PROV_SM2_SIGN_CTX *psm2ctx = (PROV_SM2_SIGN_CTX *)vpsm2ctx;
 	unsigned char *aid = NULL;
 	int md_nid;
 	WPACKET pkt;
 
-	if (!sm2_signverify_init(vpsm2ctx, ec, params) ||
+	if (!sm2_signverify_init(vpsm2ctx, ec, params, operation) ||
 	    !sm2_sig_set_mdname(psm2ctx, mdname))
 		return UADK_P_FAIL;
 
@@ -806,7 +895,7 @@ static int sm2_digest_signverify_init(void *vpsm2ctx, const char *mdname,
 static int uadk_signature_sm2_digest_sign_init(void *vpsm2ctx, const char *mdname,
 					       void *ec, const OSSL_PARAM params[])
 {
-	return sm2_digest_signverify_init(vpsm2ctx, mdname, ec, params);
+	return sm2_digest_signverify_init(vpsm2ctx, mdname, ec, params, EVP_PKEY_OP_SIGN);
 }
 
 static int sm2_get_params(struct sm2_param *params, BN_CTX *ctx)
@@ -1139,7 +1228,7 @@ static int uadk_signature_sm2_digest_sign_final(void *vpsm2ctx, unsigned char *s
 static int uadk_signature_sm2_digest_verify_init(void *vpsm2ctx, const char *mdname,
 						 void *ec, const OSSL_PARAM params[])
 {
-	return sm2_digest_signverify_init(vpsm2ctx, mdname, ec, params);
+	return sm2_digest_signverify_init(vpsm2ctx, mdname, ec, params, EVP_PKEY_OP_VERIFY);
 }
 
 static int uadk_signature_sm2_digest_verify_update(void *vpsm2ctx, const unsigned char *data,
@@ -1245,8 +1334,10 @@ static const OSSL_PARAM *uadk_signature_sm2_gettable_ctx_params(ossl_unused void
 static int uadk_signature_sm2_get_ctx_params(void *vpsm2ctx, OSSL_PARAM *params)
 {
 	PROV_SM2_SIGN_CTX *psm2ctx = (PROV_SM2_SIGN_CTX *)vpsm2ctx;
+	struct uadk_prov_batch *batch;
 	unsigned char *aid = NULL;
 	OSSL_PARAM *p;
+	int ret;
 
 	if (!psm2ctx) {
 		UADK_ERR("invalid: psm2ctx is NULL for get_ctx_params\n");
@@ -1275,7 +1366,13 @@ static int uadk_signature_sm2_get_ctx_params(void *vpsm2ctx, OSSL_PARAM *params)
 		return UADK_P_FAIL;
 	}
 
-	return UADK_P_SUCCESS;
+	batch = uadk_prov_batch_new(params, psm2ctx->operation, &ret);
+	if (!batch)
+		return ret;
+
+	(void)sm2_batch(psm2ctx, batch);
+
+	return uadk_prov_batch_free(batch);
 }
 
 static void *uadk_signature_sm2_dupctx(void *vpsm2ctx)
@@ -45,6 +45,17 @@
 #define UADK_ERR(fmt, args...)     fprintf(stderr, fmt, ##args)
 #endif
 
+struct uadk_memcpy_strategy {
+	const char *name;
+	void *(*copy)(void *dstpp, const void *srcpp, size_t len);
+	int (*supported)(void);
+	/* shorter copies are left to libc memcpy */
+	size_t threshold;
+};
+
 void *uadk_memcpy(void *dstpp, const void *srcpp, size_t len);
+int uadk_memcpy_strategy_num(void);
+const struct uadk_memcpy_strategy *uadk_memcpy_strategy_get(int idx);
+const struct uadk_memcpy_strategy *uadk_memcpy_strategy_selected(void);
 struct uacce_dev *uadk_get_accel_dev(const char *alg_name);
 #endif
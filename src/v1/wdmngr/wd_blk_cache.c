@@ -0,0 +1,309 @@
+/*
+ * Copyright (C) 2019. Huawei Technologies Co.,Ltd.All rights reserved.
+ *
+ * Description:  This file provides the lock-free block cache used by the wd queue memory pool
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <sched.h>
+#include <unistd.h>
+#include "wd_blk_cache.h"
+#include "../utils/engine_log.h"
+
+#define KAE_BLK_NONE		0xffffffffU
+#define KAE_BLK_IDX_MASK	0xffffffffULL
+#define KAE_BLK_TAG_SHIFT	32
+
+static inline unsigned int kae_blk_head_idx(unsigned long long head)
+{
+	return (unsigned int)(head & KAE_BLK_IDX_MASK);
+}
+
+static inline unsigned long long kae_blk_head_make(unsigned long long old, unsigned int idx)
+{
+	unsigned long long tag = (old >> KAE_BLK_TAG_SHIFT) + 1;
+
+	return (tag << KAE_BLK_TAG_SHIFT) | idx;
+}
+
+static void kae_blk_shared_push(struct kae_blk_cache *cache, unsigned int idx)
+{
+	unsigned long long old, new;
+
+	old = __atomic_load_n(&cache->free_head, __ATOMIC_ACQUIRE);
+	do {
+		__atomic_store_n(&cache->next[idx], kae_blk_head_idx(old), __ATOMIC_RELAXED);
+		new = kae_blk_head_make(old, idx);
+	} while (!__atomic_compare_exchange_n(&cache->free_head, &old, new, true,
+					      __ATOMIC_RELEASE, __ATOMIC_ACQUIRE));
+}
+
+static unsigned int kae_blk_shared_pop(struct kae_blk_cache *cache)
+{
+	unsigned long long old, new;
+	unsigned int idx;
+
+	old = __atomic_load_n(&cache->free_head, __ATOMIC_ACQUIRE);
+	do {
+		idx = kae_blk_head_idx(old);
+		if (idx == KAE_BLK_NONE)
+			return KAE_BLK_NONE;
+		/*
+		 * next[idx] may be rewritten by a racing pop/push pair, the tag
+		 * bumped by every push makes the exchange below fail in that case.
+		 */
+		new = kae_blk_head_make(old, __atomic_load_n(&cache->next[idx], __ATOMIC_RELAXED));
+	} while (!__atomic_compare_exchange_n(&cache->free_head, &old, new, true,
+					      __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE));
+
+	return idx;
+}
+
+/* take up to want never used blocks from the region, return the first index */
+static unsigned int kae_blk_carve(struct kae_blk_cache *cache, unsigned int want,
+				  unsigned int *got)
+{
+	unsigned int cur, num;
+
+	cur = __atomic_load_n(&cache->block_num, __ATOMIC_RELAXED);
+	do {
+		if (cur >= cache->block_max) {
+			*got = 0;
+			return KAE_BLK_NONE;
+		}
+		num = cache->block_max - cur;
+		if (num > want)
+			num = want;
+	} while (!__atomic_compare_exchange_n(&cache->block_num, &cur, cur + num, true,
+					      __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+
+	*got = num;
+	return cur;
+}
+
+static struct kae_blk_cpu_cache *kae_blk_this_cpu(struct kae_blk_cache *cache)
+{
+	int cpu = sched_getcpu();
+
+	if (cpu < 0)
+		cpu = 0;
+
+	return &cache->cpus[(unsigned int)cpu % cache->cpu_num];
+}
+
+/* called with the cpu cache locked and empty */
+static void kae_blk_refill(struct kae_blk_cache *cache, struct kae_blk_cpu_cache *c)
+{
+	unsigned int idx, first, got;
+
+	while (c->num < KAE_BLK_CACHE_BATCH) {
+		idx = kae_blk_shared_pop(cache);
+		if (idx == KAE_BLK_NONE)
+			break;
+		c->blks[c->num++] = idx;
+	}
+
+	if (c->num)
+		return;
+
+	first = kae_blk_carve(cache, KAE_BLK_CACHE_BATCH, &got);
+	while (got--)
+		c->blks[c->num++] = first++;
+}
+
+/*
+ * The pool is exhausted, pick a block parked in another cpu cache. The first
+ * pass skips busy caches, the second one waits for them: this is the slow
+ * path and a cache is only ever held for a few instructions.
+ */
+static unsigned int kae_blk_steal(struct kae_blk_cache *cache)
+{
+	struct kae_blk_cpu_cache *c;
+	unsigned int idx = KAE_BLK_NONE;
+	unsigned int i, pass;
+
+	for (pass = 0; pass < 2; pass++) {
+		for (i = 0; i < cache->cpu_num; i++) {
+			c = &cache->cpus[i];
+			if (!__atomic_load_n(&c->num, __ATOMIC_RELAXED))
+				continue;
+
+			if (pass == 0) {
+				if (!KAE_SPIN_TRYLOCK(c->lock))
+					continue;
+			} else {
+				KAE_SPIN_LOCK(c->lock);
+			}
+
+			if (c->num)
+				idx = c->blks[--c->num];
+			KAE_SPIN_UNLOCK(c->lock);
+
+			if (idx != KAE_BLK_NONE)
+				return idx;
+		}
+	}
+
+	return idx;
+}
+
+static inline void *kae_blk_addr(struct kae_blk_cache *cache, unsigned int idx)
+{
+	return (char *)cache->base + (size_t)idx * cache->block_size;
+}
+
+struct kae_blk_cache *kae_blk_cache_create(void *base, unsigned int block_size,
+					   unsigned int block_init, unsigned int block_max)
+{
+	struct kae_blk_cache *cache;
+	long cpus;
+	unsigned int i;
+
+	if (base == NULL || block_size == 0 || block_max == 0 ||
+	    block_max >= KAE_BLK_NONE || block_init > block_max) {
+		US_ERR("invalid blk cache param, size %u, init %u, max %u",
+		       block_size, block_init, block_max);
+		return NULL;
+	}
+
+	cpus = sysconf(_SC_NPROCESSORS_CONF);
+	if (cpus <= 0)
+		cpus = 1;
+	if (cpus > KAE_BLK_CACHE_MAX_CPUS)
+		cpus = KAE_BLK_CACHE_MAX_CPUS;
+
+	cache = (struct kae_blk_cache *)kae_calloc(1, sizeof(struct kae_blk_cache));
+	if (cache == NULL) {
+		US_ERR("alloc blk cache fail!");
+		return NULL;
+	}
+
+	cache->next = (unsigned int *)kae_calloc(block_max, sizeof(unsigned int));
+	if (cache->next == NULL) {
+		US_ERR("alloc blk cache link fail!");
+		goto err;
+	}
+
+	if (posix_memalign((void **)&cache->cpus, KAE_BLK_CACHE_LINE,
+			   cpus * sizeof(struct kae_blk_cpu_cache))) {
+		US_ERR("alloc blk cpu cache fail!");
+		cache->cpus = NULL;
+		goto err;
+	}
+	kae_memset(cache->cpus, 0, cpus * sizeof(struct kae_blk_cpu_cache));
+	for (i = 0; i < (unsigned int)cpus; i++)
+		KAE_SPIN_INIT(cache->cpus[i].lock);
+
+	cache->base = base;
+	cache->block_size = block_size;
+	cache->block_max = block_max;
+	cache->cpu_num = (unsigned int)cpus;
+	cache->free_head = KAE_BLK_NONE;
+
+	/* pre carve the initial blocks, in order so low addresses go first */
+	cache->block_num = block_init;
+	for (i = block_init; i > 0; i--)
+		kae_blk_shared_push(cache, i - 1);
+
+	return cache;
+
+err:
+	kae_free(cache->next);
+	kae_free(cache);
+	return NULL;
+}
+
+void kae_blk_cache_destroy(struct kae_blk_cache *cache)
+{
+	if (cache == NULL)
+		return;
+
+	kae_free(cache->cpus);
+	kae_free(cache->next);
+	kae_free(cache);
+}
+
+void *kae_blk_cache_alloc(struct kae_blk_cache *cache)
+{
+	struct kae_blk_cpu_cache *c;
+	unsigned int idx = KAE_BLK_NONE;
+	unsigned int got;
+
+	if (unlikely(cache == NULL))
+		return NULL;
+
+	c = kae_blk_this_cpu(cache);
+	if (KAE_SPIN_TRYLOCK(c->lock)) {
+		if (!c->num)
+			kae_blk_refill(cache, c);
+		if (c->num)
+			idx = c->blks[--c->num];
+		KAE_SPIN_UNLOCK(c->lock);
+		if (likely(idx != KAE_BLK_NONE))
+			return kae_blk_addr(cache, idx);
+	}
+
+	/* cpu cache busy or drained, go straight to the shared pool */
+	idx = kae_blk_shared_pop(cache);
+	if (idx == KAE_BLK_NONE)
+		idx = kae_blk_carve(cache, 1, &got);
+	if (idx == KAE_BLK_NONE)
+		idx = kae_blk_steal(cache);
+	if (idx == KAE_BLK_NONE) {
+		US_ERR_LIMIT("blk cache exhausted, %u blocks in use", cache->block_max);
+		return NULL;
+	}
+
+	return kae_blk_addr(cache, idx);
+}
+
+void kae_blk_cache_free(struct kae_blk_cache *cache, void *blk)
+{
+	struct kae_blk_cpu_cache *c;
+	size_t off;
+	unsigned int idx;
+
+	if (unlikely(cache == NULL || blk == NULL))
+		return;
+
+	off = (size_t)((char *)blk - (char *)cache->base);
+	if (unlikely(blk < cache->base || off % cache->block_size ||
+		     off / cache->block_size >= cache->block_max)) {
+		US_ERR("free blk %p not from blk cache", blk);
+		return;
+	}
+	idx = (unsigned int)(off / cache->block_size);
+
+	c = kae_blk_this_cpu(cache);
+	if (KAE_SPIN_TRYLOCK(c->lock)) {
+		/* keep the cache warm, hand a batch back when it overflows */
+		if (c->num == KAE_BLK_CACHE_DEPTH) {
+			while (c->num > KAE_BLK_CACHE_DEPTH - KAE_BLK_CACHE_BATCH)
+				kae_blk_shared_push(cache, c->blks[--c->num]);
+		}
+		c->blks[c->num++] = idx;
+		KAE_SPIN_UNLOCK(c->lock);
+		return;
+	}
+
+	kae_blk_shared_push(cache, idx);
+}
+
+unsigned int kae_blk_cache_carved(struct kae_blk_cache *cache)
+{
+	return __atomic_load_n(&cache->block_num, __ATOMIC_RELAXED);
+}
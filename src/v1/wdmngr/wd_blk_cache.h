@@ -0,0 +1,66 @@
+/*
+ * Copyright (C) 2019. Huawei Technologies Co.,Ltd.All rights reserved.
+ *
+ * Description:  This file provides the interface for wd_blk_cache.c
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __WD_BLK_CACHE_H
+#define __WD_BLK_CACHE_H
+
+#include "../utils/engine_utils.h"
+
+/* per cpu cache slots, cpus beyond this share slots by modulo */
+#define KAE_BLK_CACHE_MAX_CPUS	64
+/* max blocks held by one cpu cache */
+#define KAE_BLK_CACHE_DEPTH	16
+/* blocks moved between a cpu cache and the shared pool at once */
+#define KAE_BLK_CACHE_BATCH	8
+
+#define KAE_BLK_CACHE_LINE	64
+
+struct kae_blk_cpu_cache {
+	struct kae_spinlock lock;
+	unsigned int num;
+	unsigned int blks[KAE_BLK_CACHE_DEPTH];
+} __attribute__((aligned(KAE_BLK_CACHE_LINE)));
+
+/*
+ * Fixed size block allocator over a caller supplied memory region.
+ * Blocks are carved from the region on demand up to block_max, freed blocks
+ * go to a per cpu cache first and overflow to a lock-free shared stack.
+ * Allocation and free never wait on a lock: a busy cpu cache is bypassed,
+ * only an exhausted pool waits to drain blocks parked in other cpu caches.
+ */
+struct kae_blk_cache {
+	void *base;
+	unsigned int block_size;
+	unsigned int block_max;
+	/* blocks carved from the region so far, grows up to block_max */
+	unsigned int block_num;
+	unsigned int cpu_num;
+	/* shared free stack head: aba tag in high 32 bits, index in low 32 */
+	unsigned long long free_head;
+	unsigned int *next;
+	struct kae_blk_cpu_cache *cpus;
+};
+
+struct kae_blk_cache *kae_blk_cache_create(void *base, unsigned int block_size,
+					   unsigned int block_init, unsigned int block_max);
+void kae_blk_cache_destroy(struct kae_blk_cache *cache);
+void *kae_blk_cache_alloc(struct kae_blk_cache *cache);
+void kae_blk_cache_free(struct kae_blk_cache *cache, void *blk);
+unsigned int kae_blk_cache_carved(struct kae_blk_cache *cache);
+
+#endif
@@ -20,10 +20,6 @@
 #include "wd_queue_memory.h"
 #include "../utils/engine_utils.h"
 #include "../utils/engine_log.h"
-#include <uadk/v1/wd_bmm.h>
-
-#define MAXBLOCKSIZE   0x90000
-#define MAXRSVMEM      0x400000
 
 #define MAXBLOCKSIZE   0x90000
 #define MAXRSVMEM      0x400000
@@ -35,20 +31,19 @@ const char *g_alg_type[] = {
 	"digest",
 };
 
-struct wd_queue_mempool *wd_queue_mempool_create(struct wd_queue *q, unsigned int block_size, unsigned int block_num)
+struct wd_queue_mempool *wd_queue_mempool_create(struct wd_queue *q, unsigned int block_size,
+						 unsigned int block_num, unsigned int block_max)
 {
 	void *addr = NULL;
 	unsigned long rsv_mm_sz;
 	struct wd_queue_mempool *pool = NULL;
-	unsigned int bitmap_sz;
-	const unsigned int BLOCKS_PER_BITMAP = 32;
 
 	if (block_size > MAXBLOCKSIZE) {
 		US_ERR("error! current blk size is beyond 576k");
 		return NULL;
 	}
 
-	rsv_mm_sz = (unsigned long)block_size * (unsigned long)block_num;
+	rsv_mm_sz = (unsigned long)block_size * (unsigned long)block_max;
 	if (rsv_mm_sz > (unsigned long)MAXRSVMEM) {
 		US_ERR("error! current mem size is beyond 4M");
 		return NULL;
@@ -59,22 +54,24 @@ struct wd_queue_mempool *wd_queue_mempool_create(struct wd_queue *q, unsigned in
 		US_ERR("reserve_memory fail!");
 		return NULL;
 	}
-	kae_memset(addr, 0, rsv_mm_sz);
 
-	bitmap_sz = (block_num / BLOCKS_PER_BITMAP + 1) * sizeof(unsigned int);
-	pool = (struct wd_queue_mempool *)kae_calloc(1,
-			sizeof(struct wd_queue_mempool) + bitmap_sz);
+	pool = (struct wd_queue_mempool *)kae_calloc(1, sizeof(struct wd_queue_mempool));
 	if (pool == NULL) {
 		US_ERR("Alloc pool handle fail!");
 		return NULL;
 	}
 
+	pool->cache = kae_blk_cache_create(addr, block_size, block_num, block_max);
+	if (pool->cache == NULL) {
+		US_ERR("create blk cache fail!");
+		kae_free(pool);
+		return NULL;
+	}
+
 	pool->base = addr;
-	sem_init(&pool->mempool_sem, 0, 1);
 	pool->block_size = block_size;
 	pool->block_num = block_num;
-	pool->free_num = block_num;
-	pool->bitmap = (unsigned int *) (pool + 1);
+	pool->block_max = block_max;
 	pool->mem_size = rsv_mm_sz;
 	pool->q = q;
 
@@ -83,26 +80,30 @@ struct wd_queue_mempool *wd_queue_mempool_create(struct wd_queue *q, unsigned in
 
 struct wd_queue_mempool *create_alg_wd_queue_mempool(int algtype, struct wd_queue *q)
 {
-	struct wd_queue_mempool *mempool = NULL;
 	unsigned int block_size;
 	unsigned int block_num;
+	unsigned int block_max;
 
 	switch (algtype) {
 	case WCRYPTO_RSA:
 		block_size = RSA_BLOCK_SIZE;
 		block_num = RSA_BLOCK_NUM;
+		block_max = RSA_BLOCK_MAX_NUM;
 		break;
 	case WCRYPTO_DH:
 		block_size = DH_BLOCK_SIZE;
 		block_num = DH_BLOCK_NUM;
+		block_max = DH_BLOCK_MAX_NUM;
 		break;
 	case WCRYPTO_CIPHER:
 		block_size = CIPHER_BLOCK_SIZE;
 		block_num = CIPHER_BLOCK_NUM;
+		block_max = CIPHER_BLOCK_MAX_NUM;
 		break;
 	case WCRYPTO_DIGEST:
 		block_size = DIGEST_BLOCK_SIZE;
 		block_num = DIGEST_BLOCK_NUM;
+		block_max = DIGEST_BLOCK_MAX_NUM;
 		break;
 	case WCRYPTO_COMP:
 	case WCRYPTO_EC:
@@ -112,64 +113,58 @@ struct wd_queue_mempool *create_alg_wd_queue_mempool(int algtype, struct wd_queu
 		return NULL;
 	}
 
-#ifdef NO_WD_BLK_POOL
-	mempool = wd_queue_mempool_create(q, block_size, block_num);
-#else
-	struct wd_blkpool_setup setup;
-
-	kae_memset(&setup, 0, sizeof(setup));
-	setup.block_size = block_size;
-	setup.block_num = block_num;
-	setup.align_size = 64;   // align with 64
-
-	mempool = (struct wd_queue_mempool *)wd_blkpool_create(q, &setup);
-#endif
-
-	return mempool;
+	return wd_queue_mempool_create(q, block_size, block_num, block_max);
 }
 
 void wd_queue_mempool_destroy(struct wd_queue_mempool *pool)
 {
-	wd_blkpool_destroy(pool);
+	if (pool == NULL)
+		return;
+
+	/* the reserved memory goes away with the queue */
+	kae_blk_cache_destroy(pool->cache);
+	kae_free(pool);
 }
 
 void *kae_dma_map(void *usr, void *va, size_t sz)
 {
-	return wd_blk_iova_map(usr, va);
+	struct wd_queue_mempool *pool = (struct wd_queue_mempool *)usr;
+
+	return wd_iova_map(pool->q, va, sz);
 }
 
 void kae_dma_unmap(void *usr, void *va, void *dma, size_t sz)
 {
-	return wd_blk_iova_unmap(usr, dma, va);
+	struct wd_queue_mempool *pool = (struct wd_queue_mempool *)usr;
+
+	wd_iova_unmap(pool->q, va, dma, sz);
 }
 
 void *kae_wd_alloc_blk(void *pool, size_t size)
 {
-	if (pool == NULL) {
+	struct wd_queue_mempool *mempool = (struct wd_queue_mempool *)pool;
+
+	if (mempool == NULL) {
 		US_ERR("mem pool empty!");
 		return NULL;
 	}
 
-#ifdef NO_WD_BLK_POOL
-	struct wd_queue_mempool *mempool = (struct wd_queue_mempool *)pool;
-
 	if (size > (size_t)mempool->block_size) {
 		US_ERR("alloc size error, over one block size.");
 		return NULL;
 	}
-	return wd_queue_pool_alloc_buf((struct wd_queue_mempool *)pool);
-#else
-	return wd_alloc_blk(pool);
-#endif
+
+	return kae_blk_cache_alloc(mempool->cache);
 }
 
 void kae_wd_free_blk(void *pool, void *blk)
 {
-#ifdef NO_WD_BLK_POOL
-	wd_queue_pool_free_buf((struct wd_queue_mempool *)pool, blk);
-#else
-	wd_free_blk(pool, blk);
-#endif
+	struct wd_queue_mempool *mempool = (struct wd_queue_mempool *)pool;
+
+	if (mempool == NULL)
+		return;
+
+	kae_blk_cache_free(mempool->cache, blk);
 }
 
 KAE_QUEUE_POOL_HEAD_S *kae_init_queue_pool(int algtype)
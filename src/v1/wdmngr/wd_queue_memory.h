@@ -22,6 +22,7 @@
 #include <semaphore.h>
 #include <uadk/v1/wd.h>
 #include "wd_alg_queue.h"
+#include "wd_blk_cache.h"
 #include "../utils/engine_utils.h"
 
 #define KAE_QUEUE_POOL_MAX_SIZE    512
@@ -33,17 +34,25 @@
  * when use 4096bit rsa. block use max is 3576.
  * 3576 = sizeof(ctx)(248)+ pubkey_size(1024) + prikey_size(2304)
  * that means  max block used is 2304. set 4096 for reserve
+ *
+ * *_BLOCK_NUM blocks are ready when the pool is created, the pool grows on
+ * demand up to *_BLOCK_MAX_NUM. The whole cap is reserved from the queue up
+ * front since a v1 queue reserves its dma memory only once.
  */
 #define RSA_BLOCK_NUM       16
+#define RSA_BLOCK_MAX_NUM   64
 #define RSA_BLOCK_SIZE      4096
 
 #define DH_BLOCK_NUM       16
+#define DH_BLOCK_MAX_NUM   64
 #define DH_BLOCK_SIZE      4096
 
 #define CIPHER_BLOCK_NUM   4
+#define CIPHER_BLOCK_MAX_NUM   12
 #define CIPHER_BLOCK_SIZE  (272*1024)
 
 #define DIGEST_BLOCK_NUM   4
+#define DIGEST_BLOCK_MAX_NUM   8
 #define DIGEST_BLOCK_SIZE  (512 * 1024)
 
 typedef void (*release_engine_ctx_cb)(void *engine_ctx);
@@ -72,19 +81,15 @@ typedef struct KAE_QUEUE_POOL_HEAD {
 struct wd_queue_mempool {
 	struct wd_queue *q;
 	void *base;
-	unsigned int *bitmap;
 	unsigned int block_size;
 	unsigned int block_num;
-	unsigned int mem_size;
-	unsigned int block_align_size;
-	unsigned int free_num;
-	unsigned int fail_times;
-	unsigned long long index;
-	sem_t mempool_sem;
-	int dev;
+	unsigned int block_max;
+	unsigned long mem_size;
+	struct kae_blk_cache *cache;
 };
 
-struct wd_queue_mempool *wd_queue_mempool_create(struct wd_queue *q, unsigned int block_size, unsigned int block_num);
+struct wd_queue_mempool *wd_queue_mempool_create(struct wd_queue *q, unsigned int block_size,
+						 unsigned int block_num, unsigned int block_max);
 
 void wd_queue_mempool_destroy(struct wd_queue_mempool *pool);
 
@@ -0,0 +1,247 @@
+/*
+ * Copyright (C) 2019. Huawei Technologies Co.,Ltd.All rights reserved.
+ *
+ * Description: Stress test of the KAE block cache, runs without hardware
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Build and run:
+ * gcc -O2 -pthread -I src/v1/wdmngr test/kae_blk_cache_test.c \
+ *     src/v1/wdmngr/wd_blk_cache.c src/v1/utils/engine_log.c \
+ *     src/v1/utils/engine_config.c -o kae_blk_cache_test
+ * ./kae_blk_cache_test [threads] [loops]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+#include "wd_blk_cache.h"
+
+#define TEST_BLOCK_SIZE		256
+#define TEST_BLOCK_INIT		16
+#define TEST_BLOCK_MAX		256
+#define TEST_HOLD_MAX		8
+#define TEST_THREADS		16
+#define TEST_LOOPS		200000
+
+struct test_thread {
+	pthread_t tid;
+	struct kae_blk_cache *cache;
+	unsigned int id;
+	unsigned long loops;
+	unsigned long alloc_fail;
+	int err;
+};
+
+static int fill_check(unsigned char *blk, unsigned char tag, int check)
+{
+	unsigned int i;
+
+	for (i = 0; i < TEST_BLOCK_SIZE; i++) {
+		if (!check) {
+			blk[i] = tag;
+		} else if (blk[i] != tag) {
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+static void *test_worker(void *arg)
+{
+	struct test_thread *t = (struct test_thread *)arg;
+	unsigned char *held[TEST_HOLD_MAX];
+	unsigned char tags[TEST_HOLD_MAX];
+	unsigned int seed = t->id * 7919 + 1;
+	unsigned int num = 0;
+	unsigned long i;
+
+	for (i = 0; i < t->loops; i++) {
+		if (num < TEST_HOLD_MAX && (num == 0 || rand_r(&seed) & 1)) {
+			held[num] = kae_blk_cache_alloc(t->cache);
+			if (held[num] == NULL) {
+				t->alloc_fail++;
+				continue;
+			}
+			tags[num] = (unsigned char)(t->id + i);
+			fill_check(held[num], tags[num], 0);
+			num++;
+			continue;
+		}
+
+		num--;
+		/* a block handed to two owners at once gets its pattern overwritten */
+		if (fill_check(held[num], tags[num], 1)) {
+			fprintf(stderr, "thread %u: block %p corrupted\n", t->id, held[num]);
+			t->err = -1;
+			return NULL;
+		}
+		kae_blk_cache_free(t->cache, held[num]);
+	}
+
+	while (num--)
+		kae_blk_cache_free(t->cache, held[num]);
+
+	return NULL;
+}
+
+static int test_exhaust_and_grow(void)
+{
+	unsigned char *blks[TEST_BLOCK_MAX];
+	struct kae_blk_cache *cache;
+	unsigned int i;
+	void *base;
+	int ret = -1;
+
+	base = calloc(TEST_BLOCK_MAX, TEST_BLOCK_SIZE);
+	if (base == NULL)
+		return -1;
+
+	cache = kae_blk_cache_create(base, TEST_BLOCK_SIZE, TEST_BLOCK_INIT, TEST_BLOCK_MAX);
+	if (cache == NULL)
+		goto out;
+
+	if (kae_blk_cache_carved(cache) != TEST_BLOCK_INIT) {
+		fprintf(stderr, "initial carve %u, expect %u\n",
+			kae_blk_cache_carved(cache), TEST_BLOCK_INIT);
+		goto out_destroy;
+	}
+
+	for (i = 0; i < TEST_BLOCK_MAX; i++) {
+		blks[i] = kae_blk_cache_alloc(cache);
+		if (blks[i] == NULL) {
+			fprintf(stderr, "alloc %u of %u failed\n", i, TEST_BLOCK_MAX);
+			goto out_destroy;
+		}
+	}
+
+	if (kae_blk_cache_alloc(cache) != NULL) {
+		fprintf(stderr, "alloc beyond cap succeeded\n");
+		goto out_destroy;
+	}
+
+	for (i = 0; i < TEST_BLOCK_MAX; i++)
+		kae_blk_cache_free(cache, blks[i]);
+
+	/* every block must come back, wherever it was parked */
+	for (i = 0; i < TEST_BLOCK_MAX; i++) {
+		blks[i] = kae_blk_cache_alloc(cache);
+		if (blks[i] == NULL) {
+			fprintf(stderr, "realloc %u of %u failed\n", i, TEST_BLOCK_MAX);
+			goto out_destroy;
+		}
+	}
+	for (i = 0; i < TEST_BLOCK_MAX; i++)
+		kae_blk_cache_free(cache, blks[i]);
+
+	ret = 0;
+
+out_destroy:
+	kae_blk_cache_destroy(cache);
+out:
+	free(base);
+	return ret;
+}
+
+static int test_stress(unsigned int threads, unsigned long loops)
+{
+	struct test_thread *t;
+	struct kae_blk_cache *cache;
+	struct timespec start, end;
+	unsigned long fails = 0;
+	unsigned int i;
+	double sec;
+	void *base;
+	int ret = 0;
+
+	base = calloc(TEST_BLOCK_MAX, TEST_BLOCK_SIZE);
+	t = calloc(threads, sizeof(*t));
+	if (base == NULL || t == NULL) {
+		free(base);
+		free(t);
+		return -1;
+	}
+
+	cache = kae_blk_cache_create(base, TEST_BLOCK_SIZE, TEST_BLOCK_INIT, TEST_BLOCK_MAX);
+	if (cache == NULL) {
+		free(base);
+		free(t);
+		return -1;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < threads; i++) {
+		t[i].cache = cache;
+		t[i].id = i;
+		t[i].loops = loops;
+		if (pthread_create(&t[i].tid, NULL, test_worker, &t[i])) {
+			threads = i;
+			ret = -1;
+			break;
+		}
+	}
+
+	for (i = 0; i < threads; i++) {
+		pthread_join(t[i].tid, NULL);
+		fails += t[i].alloc_fail;
+		if (t[i].err)
+			ret = -1;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	sec = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+	printf("%u threads x %lu loops: %.3f s, %.0f ops/s, %lu alloc fails, %u blocks carved\n",
+	       threads, loops, sec, threads * loops / sec, fails,
+	       kae_blk_cache_carved(cache));
+
+	if (kae_blk_cache_carved(cache) > TEST_BLOCK_MAX)
+		ret = -1;
+	/* TEST_HOLD_MAX * threads fits the cap, so nothing may fail */
+	if (threads * TEST_HOLD_MAX <= TEST_BLOCK_MAX && fails)
+		ret = -1;
+
+	kae_blk_cache_destroy(cache);
+	free(base);
+	free(t);
+	return ret;
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned int threads = TEST_THREADS;
+	unsigned long loops = TEST_LOOPS;
+
+	if (argc > 1)
+		threads = (unsigned int)strtoul(argv[1], NULL, 0);
+	if (argc > 2)
+		loops = strtoul(argv[2], NULL, 0);
+	if (!threads || !loops) {
+		fprintf(stderr, "usage: %s [threads] [loops]\n", argv[0]);
+		return 1;
+	}
+
+	if (test_exhaust_and_grow()) {
+		printf("blk cache exhaust test failed\n");
+		return 1;
+	}
+
+	if (test_stress(threads, loops)) {
+		printf("blk cache stress test failed\n");
+		return 1;
+	}
+
+	printf("blk cache test passed\n");
+	return 0;
+}
@@ -0,0 +1,249 @@
+/*
+ * Copyright 2020-2022 Huawei Technologies Co.,Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Throughput of TLS 1.2 AES-GCM writes of 4 or 8 full records, encrypted
+ * with the multiblock ctrls as libssl does, against the same records one
+ * by one after the tls aad ctrl. The first multiblock write is decrypted
+ * record by record to check it.
+ *
+ * Build and run:
+ * gcc -O2 test/uadk_aead_multiblock_bench.c -lcrypto -o uadk_aead_multiblock_bench
+ * ./uadk_aead_multiblock_bench [provider [cipher [writes]]]
+ * e.g. ./uadk_aead_multiblock_bench uadk_provider AES-128-GCM 20000
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <openssl/evp.h>
+#include "uadk_bench.h"
+
+#define BENCH_WRITES		20000UL
+#define BENCH_FRAG		16384
+#define BENCH_MAX_RECORDS	8
+#define BENCH_HDR_LEN		5
+#define BENCH_RECORD_LEN(n)	(BENCH_HDR_LEN + EVP_GCM_TLS_EXPLICIT_IV_LEN + (n) + \
+				 EVP_GCM_TLS_TAG_LEN)
+
+static const unsigned char bench_key[EVP_MAX_KEY_LENGTH] = {1};
+static const unsigned char bench_fixed[EVP_GCM_TLS_FIXED_IV_LEN] = {2};
+
+static void bench_aad(unsigned char *aad, unsigned long seq, size_t len)
+{
+	int i;
+
+	/* sequence number, type, version and a length */
+	for (i = 7; i >= 0; i--, seq >>= 8)
+		aad[i] = (unsigned char)seq;
+	aad[8] = 0x17;
+	aad[9] = 0x03;
+	aad[10] = 0x03;
+	aad[11] = (unsigned char)(len >> 8);
+	aad[12] = (unsigned char)len;
+}
+
+static int bench_init(EVP_CIPHER_CTX *ctx, const EVP_CIPHER *cipher, int enc)
+{
+	return EVP_CipherInit_ex2(ctx, cipher, bench_key, NULL, enc, NULL) &&
+	       EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_IV_FIXED, sizeof(bench_fixed),
+				   (void *)bench_fixed) > 0;
+}
+
+/* one write of interleave records, as ssl3_write_bytes does it */
+static int bench_mb_write(EVP_CIPHER_CTX *ctx, unsigned char *out, const unsigned char *in,
+			  unsigned int interleave, unsigned long seq)
+{
+	EVP_CTRL_TLS1_1_MULTIBLOCK_PARAM param;
+	unsigned char aad[EVP_AEAD_TLS1_AAD_LEN];
+	int packlen;
+
+	bench_aad(aad, seq, 0);
+	memset(&param, 0, sizeof(param));
+	param.inp = aad;
+	param.len = (size_t)BENCH_FRAG * interleave;
+	param.interleave = interleave;
+	packlen = EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_TLS1_1_MULTIBLOCK_AAD, sizeof(param), &param);
+	if (packlen <= 0)
+		return -1;
+
+	param.out = out;
+	param.inp = in;
+	param.len = (size_t)BENCH_FRAG * interleave;
+	param.interleave = interleave;
+	if (EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_TLS1_1_MULTIBLOCK_ENCRYPT, sizeof(param),
+				&param) != packlen)
+		return -1;
+
+	return packlen;
+}
+
+static int bench_check(const EVP_CIPHER *cipher, unsigned char *out, const unsigned char *in,
+		       unsigned int interleave)
+{
+	unsigned char aad[EVP_AEAD_TLS1_AAD_LEN];
+	EVP_CIPHER_CTX *ctx;
+	unsigned char *rec;
+	unsigned int i;
+	size_t len;
+	int outl, ret = -1;
+
+	ctx = EVP_CIPHER_CTX_new();
+	if (!ctx || !bench_init(ctx, cipher, 0))
+		goto out;
+
+	for (i = 0; i < interleave; i++) {
+		rec = out + i * BENCH_RECORD_LEN(BENCH_FRAG);
+		len = rec[3] << 8 | rec[4];
+		if (rec[0] != 0x17 || len != BENCH_RECORD_LEN(BENCH_FRAG) - BENCH_HDR_LEN)
+			goto out;
+
+		bench_aad(aad, i, len);
+		if (EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_TLS1_AAD, sizeof(aad), aad) <= 0 ||
+		    !EVP_CipherUpdate(ctx, rec + BENCH_HDR_LEN, &outl, rec + BENCH_HDR_LEN, (int)len) ||
+		    outl != BENCH_FRAG ||
+		    memcmp(rec + BENCH_HDR_LEN + EVP_GCM_TLS_EXPLICIT_IV_LEN,
+			   in + i * BENCH_FRAG, BENCH_FRAG))
+			goto out;
+	}
+	ret = 0;
+
+out:
+	EVP_CIPHER_CTX_free(ctx);
+	return ret;
+}
+
+static int bench_mb(const EVP_CIPHER *cipher, unsigned char *out, const unsigned char *in,
+		    unsigned int interleave, unsigned long writes, double *mbs)
+{
+	EVP_CIPHER_CTX *ctx;
+	unsigned long i;
+	double start;
+	int ret = -1;
+
+	ctx = EVP_CIPHER_CTX_new();
+	if (!ctx || !bench_init(ctx, cipher, 1))
+		goto out;
+
+	if (bench_mb_write(ctx, out, in, interleave, 0) <= 0 ||
+	    bench_check(cipher, out, in, interleave)) {
+		fprintf(stderr, "multiblock write of %u records is wrong\n", interleave);
+		goto out;
+	}
+
+	start = bench_now();
+	for (i = 1; i <= writes; i++) {
+		if (bench_mb_write(ctx, out, in, interleave, i * interleave) <= 0)
+			goto out;
+	}
+	*mbs = (double)writes * interleave * BENCH_FRAG / (bench_now() - start) / (1 << 20);
+	ret = 0;
+
+out:
+	EVP_CIPHER_CTX_free(ctx);
+	return ret;
+}
+
+static int bench_records(const EVP_CIPHER *cipher, unsigned char *out, const unsigned char *in,
+			 unsigned int interleave, unsigned long writes, double *mbs)
+{
+	unsigned char aad[EVP_AEAD_TLS1_AAD_LEN];
+	size_t len = BENCH_RECORD_LEN(BENCH_FRAG) - BENCH_HDR_LEN;
+	EVP_CIPHER_CTX *ctx;
+	unsigned long i, seq = 0;
+	unsigned char *rec;
+	unsigned int j;
+	double start;
+	int outl, ret = -1;
+
+	ctx = EVP_CIPHER_CTX_new();
+	if (!ctx || !bench_init(ctx, cipher, 1))
+		goto out;
+
+	start = bench_now();
+	for (i = 0; i < writes; i++) {
+		for (j = 0; j < interleave; j++) {
+			rec = out + j * BENCH_RECORD_LEN(BENCH_FRAG) + BENCH_HDR_LEN;
+			memcpy(rec + EVP_GCM_TLS_EXPLICIT_IV_LEN, in + j * BENCH_FRAG, BENCH_FRAG);
+			bench_aad(aad, seq++, len);
+			if (EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_TLS1_AAD, sizeof(aad), aad) <= 0 ||
+			    !EVP_CipherUpdate(ctx, rec, &outl, rec, (int)len))
+				goto out;
+		}
+	}
+	*mbs = (double)writes * interleave * BENCH_FRAG / (bench_now() - start) / (1 << 20);
+	ret = 0;
+
+out:
+	EVP_CIPHER_CTX_free(ctx);
+	return ret;
+}
+
+int main(int argc, char *argv[])
+{
+	const char *prov_name = argc > 1 ? argv[1] : "uadk_provider";
+	const char *cipher_name = argc > 2 ? argv[2] : "AES-128-GCM";
+	unsigned long writes = argc > 3 ? strtoul(argv[3], NULL, 0) : BENCH_WRITES;
+	unsigned char *in = NULL, *out = NULL;
+	EVP_CIPHER *cipher = NULL;
+	struct bench_prov bp;
+	double mb, one;
+	unsigned int interleave;
+	size_t i;
+	int ret = 1;
+
+	if (!writes) {
+		fprintf(stderr, "usage: %s [provider [cipher [writes]]]\n", argv[0]);
+		return 1;
+	}
+
+	if (bench_load(&bp, prov_name, 0))
+		return 1;
+
+	cipher = EVP_CIPHER_fetch(NULL, cipher_name, NULL);
+	in = malloc(BENCH_MAX_RECORDS * BENCH_FRAG);
+	out = malloc(BENCH_MAX_RECORDS * BENCH_RECORD_LEN(BENCH_FRAG));
+	if (!cipher || !in || !out) {
+		fprintf(stderr, "failed to set up %s\n", cipher_name);
+		goto out;
+	}
+
+	for (i = 0; i < BENCH_MAX_RECORDS * BENCH_FRAG; i++)
+		in[i] = (unsigned char)(i * 7);
+
+	if (!(EVP_CIPHER_get_flags(cipher) & EVP_CIPH_FLAG_TLS1_1_MULTIBLOCK)) {
+		printf("%s from %s is not multiblock capable\n", cipher_name, prov_name);
+		ret = 0;
+		goto out;
+	}
+
+	printf("%s from %s, writes of %d byte records\n", cipher_name, prov_name, BENCH_FRAG);
+	printf("%8s%14s%14s\n", "records", "multiblock", "one by one");
+	for (interleave = 4; interleave <= BENCH_MAX_RECORDS; interleave <<= 1) {
+		if (bench_mb(cipher, out, in, interleave, writes, &mb) ||
+		    bench_records(cipher, out, in, interleave, writes, &one)) {
+			fprintf(stderr, "%s write failed\n", cipher_name);
+			goto out;
+		}
+		printf("%8u%14.0f%14.0f\n", interleave, mb, one);
+	}
+	printf("(MiB/s)\n");
+	ret = 0;
+
+out:
+	free(in);
+	free(out);
+	EVP_CIPHER_free(cipher);
+	bench_unload(&bp);
+	return ret;
+}
@@ -0,0 +1,352 @@
+/*
+ * Copyright 2020-2022 Huawei Technologies Co.,Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Known answers for AES-CCM (SP 800-38C), SM4-GCM and SM4-CCM (RFC 8998),
+ * then AES-GCM and AES-CCM of random messages checked against the default
+ * provider, with a corrupted tag that must be refused.
+ *
+ * Build and run:
+ * gcc -O2 test/uadk_aead_test.c -lcrypto -o uadk_aead_test
+ * ./uadk_aead_test [provider]
+ * e.g. ./uadk_aead_test uadk_provider
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <openssl/core_names.h>
+#include <openssl/evp.h>
+#include <openssl/params.h>
+#include <openssl/provider.h>
+#include <openssl/rand.h>
+
+#define TEST_MAX_LEN		4096
+#define TEST_ROUNDS		16
+#define TEST_SKIP		77
+
+struct test_kat {
+	const char *cipher;
+	const char *key;
+	const char *iv;
+	const char *aad;
+	const char *pt;
+	const char *ct;
+	const char *tag;
+};
+
+static const struct test_kat test_kats[] = {
+	{
+		"AES-128-CCM", "404142434445464748494a4b4c4d4e4f", "10111213141516",
+		"0001020304050607", "20212223", "7162015b", "4dac255d",
+	}, {
+		"AES-128-CCM", "404142434445464748494a4b4c4d4e4f", "1011121314151617",
+		"000102030405060708090a0b0c0d0e0f", "202122232425262728292a2b2c2d2e2f",
+		"d2a1f0e051ea5f62081a7792073d593d", "1fc64fbfaccd",
+	}, {
+		"SM4-GCM", "0123456789abcdeffedcba9876543210", "00001234567800000000abcd",
+		"feedfacedeadbeeffeedfacedeadbeefabaddad2",
+		"aaaaaaaaaaaaaaaabbbbbbbbbbbbbbbbccccccccccccccccdddddddddddddddd"
+		"eeeeeeeeeeeeeeeeffffffffffffffffeeeeeeeeeeeeeeeeaaaaaaaaaaaaaaaa",
+		"17f399f08c67d5ee19d0dc9969c4bb7d5fd46fd3756489069157b282bb200735"
+		"d82710ca5c22f0ccfa7cbf93d496ac15a56834cbcf98c397b4024a2691233b8d",
+		"83de3541e4c2b58177e065a9bf7b62ec",
+	}, {
+		"SM4-CCM", "0123456789abcdeffedcba9876543210", "00001234567800000000abcd",
+		"feedfacedeadbeeffeedfacedeadbeefabaddad2",
+		"aaaaaaaaaaaaaaaabbbbbbbbbbbbbbbbccccccccccccccccdddddddddddddddd"
+		"eeeeeeeeeeeeeeeeffffffffffffffffeeeeeeeeeeeeeeeeaaaaaaaaaaaaaaaa",
+		"48af93501fa62adbcd414cce6034d895dda1bf8f132f042098661572e7483094"
+		"fd12e518ce062c98acee28d95df4416bed31a2f04476c18bb40c84a74b97dc5b",
+		"16842d4fa186f56ab33256971fa110f4",
+	},
+};
+
+static const char * const test_random_ciphers[] = {
+	"AES-128-GCM", "AES-256-GCM", "AES-128-CCM", "AES-192-CCM", "AES-256-CCM",
+};
+
+struct test_msg {
+	unsigned char key[32];
+	unsigned char iv[16];
+	unsigned char aad[256];
+	unsigned char pt[TEST_MAX_LEN];
+	unsigned char ct[TEST_MAX_LEN];
+	unsigned char tag[16];
+	size_t keylen, ivlen, aadlen, len, taglen;
+};
+
+static size_t test_unhex(unsigned char *buf, const char *hex)
+{
+	size_t i, len = strlen(hex) / 2;
+	unsigned int byte;
+
+	for (i = 0; i < len; i++) {
+		sscanf(hex + i * 2, "%2x", &byte);
+		buf[i] = (unsigned char)byte;
+	}
+
+	return len;
+}
+
+static int test_ccm(const EVP_CIPHER *cipher)
+{
+	return EVP_CIPHER_get_mode(cipher) == EVP_CIPH_CCM_MODE;
+}
+
+/* ccm wants the tag length before the key and the message length up front */
+static int test_init(EVP_CIPHER_CTX *ctx, const EVP_CIPHER *cipher,
+		     struct test_msg *msg, int enc)
+{
+	OSSL_PARAM params[3], *p = params;
+	size_t ivlen = msg->ivlen;
+	int outl;
+
+	*p++ = OSSL_PARAM_construct_size_t(OSSL_CIPHER_PARAM_AEAD_IVLEN, &ivlen);
+	if (test_ccm(cipher))
+		*p++ = OSSL_PARAM_construct_octet_string(OSSL_CIPHER_PARAM_AEAD_TAG,
+							 enc ? NULL : msg->tag, msg->taglen);
+	*p = OSSL_PARAM_construct_end();
+
+	if (!EVP_CipherInit_ex2(ctx, cipher, NULL, NULL, enc, params) ||
+	    !EVP_CipherInit_ex2(ctx, NULL, msg->key, msg->iv, enc, NULL))
+		return -1;
+
+	if (test_ccm(cipher) && !EVP_CipherUpdate(ctx, NULL, &outl, NULL, (int)msg->len))
+		return -1;
+
+	if (msg->aadlen && !EVP_CipherUpdate(ctx, NULL, &outl, msg->aad, (int)msg->aadlen))
+		return -1;
+
+	return 0;
+}
+
+static int test_encrypt(const EVP_CIPHER *cipher, struct test_msg *msg)
+{
+	OSSL_PARAM params[2];
+	EVP_CIPHER_CTX *ctx;
+	int outl, finl, ret = -1;
+
+	ctx = EVP_CIPHER_CTX_new();
+	if (!ctx || test_init(ctx, cipher, msg, 1))
+		goto out;
+
+	if (!EVP_CipherUpdate(ctx, msg->ct, &outl, msg->pt, (int)msg->len) ||
+	    !EVP_CipherFinal_ex(ctx, msg->ct + outl, &finl) ||
+	    (size_t)(outl + finl) != msg->len)
+		goto out;
+
+	params[0] = OSSL_PARAM_construct_octet_string(OSSL_CIPHER_PARAM_AEAD_TAG,
+						      msg->tag, msg->taglen);
+	params[1] = OSSL_PARAM_construct_end();
+	if (!EVP_CIPHER_CTX_get_params(ctx, params))
+		goto out;
+	ret = 0;
+
+out:
+	EVP_CIPHER_CTX_free(ctx);
+	return ret;
+}
+
+/* 0 when the tag verifies and the plaintext comes back, 1 when refused */
+static int test_decrypt(const EVP_CIPHER *cipher, struct test_msg *msg)
+{
+	unsigned char pt[TEST_MAX_LEN];
+	OSSL_PARAM params[2];
+	EVP_CIPHER_CTX *ctx;
+	int outl = 0, finl = 0, ret = -1;
+
+	ctx = EVP_CIPHER_CTX_new();
+	if (!ctx || test_init(ctx, cipher, msg, 0))
+		goto out;
+
+	if (!test_ccm(cipher)) {
+		params[0] = OSSL_PARAM_construct_octet_string(OSSL_CIPHER_PARAM_AEAD_TAG,
+							      msg->tag, msg->taglen);
+		params[1] = OSSL_PARAM_construct_end();
+		if (!EVP_CIPHER_CTX_set_params(ctx, params))
+			goto out;
+	}
+
+	/* ccm checks the tag in the update, gcm in the final */
+	if (!EVP_CipherUpdate(ctx, pt, &outl, msg->ct, (int)msg->len) ||
+	    !EVP_CipherFinal_ex(ctx, pt + outl, &finl)) {
+		ret = 1;
+		goto out;
+	}
+
+	if ((size_t)(outl + finl) == msg->len && !memcmp(pt, msg->pt, msg->len))
+		ret = 0;
+
+out:
+	EVP_CIPHER_CTX_free(ctx);
+	return ret;
+}
+
+static int test_kat(const char *prov_name, const struct test_kat *kat)
+{
+	unsigned char ct[TEST_MAX_LEN];
+	struct test_msg msg;
+	EVP_CIPHER *cipher;
+	char query[64];
+	int ret = -1;
+
+	snprintf(query, sizeof(query), "provider=%s", prov_name);
+	cipher = EVP_CIPHER_fetch(NULL, kat->cipher, query);
+	if (!cipher) {
+		printf("%s: not available, skipped\n", kat->cipher);
+		return 0;
+	}
+
+	memset(&msg, 0, sizeof(msg));
+	msg.keylen = test_unhex(msg.key, kat->key);
+	msg.ivlen = test_unhex(msg.iv, kat->iv);
+	msg.aadlen = test_unhex(msg.aad, kat->aad);
+	msg.len = test_unhex(msg.pt, kat->pt);
+	test_unhex(ct, kat->ct);
+	msg.taglen = strlen(kat->tag) / 2;
+
+	if (test_encrypt(cipher, &msg) || memcmp(msg.ct, ct, msg.len)) {
+		fprintf(stderr, "%s: wrong ciphertext\n", kat->cipher);
+		goto out;
+	}
+
+	test_unhex(msg.ct, kat->tag);
+	if (memcmp(msg.tag, msg.ct, msg.taglen)) {
+		fprintf(stderr, "%s: wrong tag\n", kat->cipher);
+		goto out;
+	}
+
+	memcpy(msg.ct, ct, msg.len);
+	if (test_decrypt(cipher, &msg)) {
+		fprintf(stderr, "%s: decryption failed\n", kat->cipher);
+		goto out;
+	}
+	printf("%s: known answer ok\n", kat->cipher);
+	ret = 0;
+
+out:
+	EVP_CIPHER_free(cipher);
+	return ret;
+}
+
+static int test_random(const char *prov_name, const char *name)
+{
+	unsigned char ct[TEST_MAX_LEN], tag[16];
+	EVP_CIPHER *cipher, *ref = NULL;
+	struct test_msg msg;
+	char query[64];
+	int i, ret = -1;
+
+	snprintf(query, sizeof(query), "provider=%s", prov_name);
+	cipher = EVP_CIPHER_fetch(NULL, name, query);
+	if (!cipher) {
+		printf("%s: not available, skipped\n", name);
+		return 0;
+	}
+
+	ref = EVP_CIPHER_fetch(NULL, name, "provider=default");
+	if (!ref) {
+		fprintf(stderr, "%s: no reference cipher\n", name);
+		goto out;
+	}
+
+	for (i = 0; i < TEST_ROUNDS; i++) {
+		memset(&msg, 0, sizeof(msg));
+		if (RAND_bytes((unsigned char *)&msg, sizeof(msg)) <= 0)
+			goto out;
+
+		msg.keylen = EVP_CIPHER_get_key_length(cipher);
+		msg.len = (size_t)msg.pt[0] * 16 + msg.pt[1] % 16;
+		msg.aadlen = (size_t)msg.aad[0] % (sizeof(msg.aad) + 1);
+		if (test_ccm(cipher)) {
+			msg.ivlen = 7 + msg.iv[0] % 7;
+			msg.taglen = 4 + (msg.tag[0] % 7) * 2;
+		} else {
+			msg.ivlen = 12;
+			msg.taglen = 16;
+		}
+
+		/* the first rounds hit the empty and single block cases */
+		if (i == 0)
+			msg.len = 0;
+		else if (i == 1)
+			msg.len = 16;
+
+		if (test_encrypt(ref, &msg))
+			goto out;
+		memcpy(ct, msg.ct, msg.len);
+		memcpy(tag, msg.tag, msg.taglen);
+
+		if (test_encrypt(cipher, &msg) || memcmp(ct, msg.ct, msg.len) ||
+		    memcmp(tag, msg.tag, msg.taglen)) {
+			fprintf(stderr, "%s: mismatch at len %zu aad %zu tag %zu\n",
+				name, msg.len, msg.aadlen, msg.taglen);
+			goto out;
+		}
+
+		if (test_decrypt(cipher, &msg)) {
+			fprintf(stderr, "%s: decryption failed at len %zu\n", name, msg.len);
+			goto out;
+		}
+
+		msg.tag[0] ^= 1;
+		if (test_decrypt(cipher, &msg) != 1) {
+			fprintf(stderr, "%s: bad tag accepted at len %zu\n", name, msg.len);
+			goto out;
+		}
+	}
+	printf("%s: %d random messages ok\n", name, TEST_ROUNDS);
+	ret = 0;
+
+out:
+	EVP_CIPHER_free(ref);
+	EVP_CIPHER_free(cipher);
+	return ret;
+}
+
+int main(int argc, char *argv[])
+{
+	const char *prov_name = argc > 1 ? argv[1] : "uadk_provider";
+	OSSL_PROVIDER *prov, *def;
+	size_t i;
+	int ret = 1;
+
+	prov = OSSL_PROVIDER_load(NULL, prov_name);
+	if (!prov) {
+		printf("failed to load provider %s, skipped\n", prov_name);
+		return TEST_SKIP;
+	}
+
+	def = OSSL_PROVIDER_load(NULL, "default");
+	if (!def) {
+		fprintf(stderr, "failed to load the default provider\n");
+		goto out;
+	}
+
+	for (i = 0; i < sizeof(test_kats) / sizeof(test_kats[0]); i++) {
+		if (test_kat(prov_name, &test_kats[i]))
+			goto out;
+	}
+
+	for (i = 0; i < sizeof(test_random_ciphers) / sizeof(test_random_ciphers[0]); i++) {
+		if (test_random(prov_name, test_random_ciphers[i]))
+			goto out;
+	}
+	ret = 0;
+
+out:
+	OSSL_PROVIDER_unload(def);
+	OSSL_PROVIDER_unload(prov);
+	return ret;
+}
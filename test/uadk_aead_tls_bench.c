@@ -0,0 +1,160 @@
+/*
+ * Copyright 2020-2022 Huawei Technologies Co.,Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Per record latency of AES-GCM for TLS 1.2 records, encrypted in place
+ * after the tls aad ctrl as libssl does, against the same record as a
+ * stream of aad update, payload update, final and tag read.
+ *
+ * Build and run:
+ * gcc -O2 test/uadk_aead_tls_bench.c -lcrypto -o uadk_aead_tls_bench
+ * ./uadk_aead_tls_bench [provider [cipher [records]]]
+ * e.g. ./uadk_aead_tls_bench uadk_provider AES-128-GCM 100000
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <openssl/evp.h>
+#include "uadk_bench.h"
+
+#define BENCH_RECORDS		100000UL
+#define BENCH_MAX_PAYLOAD	16384
+#define BENCH_RECORD_LEN(n)	(EVP_GCM_TLS_EXPLICIT_IV_LEN + (n) + EVP_GCM_TLS_TAG_LEN)
+
+static const size_t bench_payloads[] = { 64, 1024, 4096, 16384 };
+
+static void bench_aad(unsigned char *aad, unsigned long seq, size_t payload)
+{
+	size_t len = BENCH_RECORD_LEN(payload);
+	int i;
+
+	/* sequence number, type, version and the length on the wire */
+	for (i = 7; i >= 0; i--, seq >>= 8)
+		aad[i] = (unsigned char)seq;
+	aad[8] = 0x17;
+	aad[9] = 0x03;
+	aad[10] = 0x03;
+	aad[11] = (unsigned char)(len >> 8);
+	aad[12] = (unsigned char)len;
+}
+
+static int bench_tls(EVP_CIPHER_CTX *ctx, const EVP_CIPHER *cipher, unsigned char *rec,
+		     size_t payload, unsigned long records, double *ns)
+{
+	unsigned char key[EVP_MAX_KEY_LENGTH] = {0};
+	unsigned char fixed[EVP_GCM_TLS_FIXED_IV_LEN] = {0};
+	unsigned char aad[EVP_AEAD_TLS1_AAD_LEN];
+	unsigned long i;
+	double start;
+	int outl;
+
+	if (!EVP_EncryptInit_ex2(ctx, cipher, key, NULL, NULL) ||
+	    EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_IV_FIXED, sizeof(fixed), fixed) <= 0)
+		return -1;
+
+	start = bench_now();
+	for (i = 0; i < records; i++) {
+		bench_aad(aad, i, payload);
+		if (EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_TLS1_AAD, sizeof(aad), aad) !=
+		    EVP_GCM_TLS_TAG_LEN)
+			return -1;
+		if (!EVP_CipherUpdate(ctx, rec, &outl, rec, (int)BENCH_RECORD_LEN(payload)) ||
+		    outl != (int)BENCH_RECORD_LEN(payload))
+			return -1;
+	}
+	*ns = (bench_now() - start) * 1e9 / records;
+
+	return 0;
+}
+
+static int bench_stream(EVP_CIPHER_CTX *ctx, const EVP_CIPHER *cipher, unsigned char *rec,
+			size_t payload, unsigned long records, double *ns)
+{
+	unsigned char key[EVP_MAX_KEY_LENGTH] = {0};
+	unsigned char iv[12] = {0};
+	unsigned char aad[EVP_AEAD_TLS1_AAD_LEN];
+	unsigned char *out = rec + EVP_GCM_TLS_EXPLICIT_IV_LEN;
+	unsigned long i;
+	double start;
+	int outl;
+
+	if (!EVP_EncryptInit_ex2(ctx, cipher, key, NULL, NULL))
+		return -1;
+
+	start = bench_now();
+	for (i = 0; i < records; i++) {
+		iv[11] = (unsigned char)i;
+		bench_aad(aad, i, payload);
+		if (!EVP_EncryptInit_ex2(ctx, NULL, NULL, iv, NULL) ||
+		    !EVP_EncryptUpdate(ctx, NULL, &outl, aad, sizeof(aad)) ||
+		    !EVP_EncryptUpdate(ctx, out, &outl, out, (int)payload) ||
+		    !EVP_EncryptFinal_ex(ctx, out + outl, &outl) ||
+		    EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_GET_TAG, EVP_GCM_TLS_TAG_LEN,
+					out + payload) <= 0)
+			return -1;
+	}
+	*ns = (bench_now() - start) * 1e9 / records;
+
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	const char *prov_name = argc > 1 ? argv[1] : "uadk_provider";
+	const char *cipher_name = argc > 2 ? argv[2] : "AES-128-GCM";
+	unsigned long records = argc > 3 ? strtoul(argv[3], NULL, 0) : BENCH_RECORDS;
+	EVP_CIPHER_CTX *ctx = NULL;
+	EVP_CIPHER *cipher = NULL;
+	unsigned char *rec = NULL;
+	struct bench_prov bp;
+	double tls, stream;
+	size_t i;
+	int ret = 1;
+
+	if (!records) {
+		fprintf(stderr, "usage: %s [provider [cipher [records]]]\n", argv[0]);
+		return 1;
+	}
+
+	if (bench_load(&bp, prov_name, 0))
+		return 1;
+
+	cipher = EVP_CIPHER_fetch(NULL, cipher_name, NULL);
+	ctx = EVP_CIPHER_CTX_new();
+	rec = calloc(1, BENCH_RECORD_LEN(BENCH_MAX_PAYLOAD));
+	if (!cipher || !ctx || !rec) {
+		fprintf(stderr, "failed to set up %s\n", cipher_name);
+		goto out;
+	}
+
+	printf("%s from %s, TLS 1.2 records\n", cipher_name, prov_name);
+	printf("%10s%14s%14s\n", "payload", "one request", "stream");
+	for (i = 0; i < sizeof(bench_payloads) / sizeof(bench_payloads[0]); i++) {
+		if (bench_tls(ctx, cipher, rec, bench_payloads[i], records, &tls) ||
+		    bench_stream(ctx, cipher, rec, bench_payloads[i], records, &stream)) {
+			fprintf(stderr, "%s record failed\n", cipher_name);
+			goto out;
+		}
+		printf("%10zu%14.0f%14.0f\n", bench_payloads[i], tls, stream);
+	}
+	printf("(ns per record)\n");
+	ret = 0;
+
+out:
+	free(rec);
+	EVP_CIPHER_CTX_free(ctx);
+	EVP_CIPHER_free(cipher);
+	bench_unload(&bp);
+	return ret;
+}
@@ -0,0 +1,77 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/*
+ * Copyright 2020-2022 Huawei Technologies Co.,Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef UADK_BENCH_H
+#define UADK_BENCH_H
+#include <stdio.h>
+#include <time.h>
+#include <openssl/opensslv.h>
+
+/* timing and provider loading shared by the benchmarks in test/ */
+
+/* seconds on the monotonic clock */
+static inline double bench_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+#if OPENSSL_VERSION_MAJOR >= 3
+#include <openssl/provider.h>
+
+struct bench_prov {
+	/* the provider under test */
+	OSSL_PROVIDER *prov;
+	/* the default one, to compare against, if asked for */
+	OSSL_PROVIDER *def;
+};
+
+static inline void bench_unload(struct bench_prov *bp)
+{
+	OSSL_PROVIDER_unload(bp->def);
+	OSSL_PROVIDER_unload(bp->prov);
+	bp->def = NULL;
+	bp->prov = NULL;
+}
+
+/* 0 once prov_name, and default if with_default is set, are loaded */
+static inline int bench_load(struct bench_prov *bp, const char *prov_name, int with_default)
+{
+	bp->def = NULL;
+	bp->prov = OSSL_PROVIDER_load(NULL, prov_name);
+	if (!bp->prov) {
+		fprintf(stderr, "failed to load provider %s\n", prov_name);
+		return 1;
+	}
+
+	if (!with_default)
+		return 0;
+
+	bp->def = OSSL_PROVIDER_load(NULL, "default");
+	if (!bp->def) {
+		fprintf(stderr, "failed to load provider default\n");
+		bench_unload(bp);
+		return 1;
+	}
+
+	return 0;
+}
+#endif
+
+#endif
@@ -0,0 +1,455 @@
+/*
+ * Copyright 2020-2022 Huawei Technologies Co.,Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * TLS 1.0 and 1.2 records through the AES-CBC-HMAC-SHA1/SHA256 ciphers,
+ * driven as libssl does, checked against the default provider ciphers of
+ * the same name. Where the default provider has none (they need AES-NI)
+ * the records are checked against AES-CBC and HMAC done separately.
+ * Decryption must give the payload back and refuse a changed record. A
+ * multiblock write must give records that decrypt to the whole payload.
+ *
+ * Build and run:
+ * gcc -O2 test/uadk_cbc_hmac_test.c -lcrypto -o uadk_cbc_hmac_test
+ * ./uadk_cbc_hmac_test [provider]
+ * e.g. ./uadk_cbc_hmac_test uadk_provider
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <openssl/core_names.h>
+#include <openssl/evp.h>
+#include <openssl/params.h>
+#include <openssl/prov_ssl.h>
+#include <openssl/provider.h>
+
+#define TEST_BLOCK		16
+#define TEST_MAX_PAYLOAD	16384
+#define TEST_MAX_RECORD		(TEST_BLOCK + TEST_MAX_PAYLOAD + 64 + TEST_BLOCK)
+#define TEST_MB_FRAG		4096
+#define TEST_SKIP		77
+
+struct test_suite {
+	const char *cipher;
+	const char *cbc;
+	const char *md;
+	size_t keylen;
+	size_t maclen;
+};
+
+static const struct test_suite test_suites[] = {
+	{ "AES-128-CBC-HMAC-SHA1", "AES-128-CBC", "SHA1", 16, 20 },
+	{ "AES-256-CBC-HMAC-SHA1", "AES-256-CBC", "SHA1", 32, 20 },
+	{ "AES-128-CBC-HMAC-SHA256", "AES-128-CBC", "SHA256", 16, 32 },
+	{ "AES-256-CBC-HMAC-SHA256", "AES-256-CBC", "SHA256", 32, 32 },
+};
+
+static const unsigned int test_versions[] = { TLS1_VERSION, TLS1_2_VERSION };
+
+/* several records on one ctx, so the cbc chain across records is checked */
+static const size_t test_payloads[] = { 0, 1, 15, 16, 100, 1000, 4096, 16384, 3 };
+
+static const unsigned char test_key[32] = {
+	0x01, 0x23, 0x45, 0x67, 0x89, 0xab, 0xcd, 0xef,
+	0xfe, 0xdc, 0xba, 0x98, 0x76, 0x54, 0x32, 0x10,
+	0x0f, 0x1e, 0x2d, 0x3c, 0x4b, 0x5a, 0x69, 0x78,
+	0x87, 0x96, 0xa5, 0xb4, 0xc3, 0xd2, 0xe1, 0xf0,
+};
+static const unsigned char test_mac_key[32] = {
+	0x5a, 0x5a, 0xa5, 0xa5, 0x11, 0x22, 0x33, 0x44,
+	0x55, 0x66, 0x77, 0x88, 0x99, 0xaa, 0xbb, 0xcc,
+	0xdd, 0xee, 0xff, 0x00, 0x13, 0x57, 0x9b, 0xdf,
+	0x24, 0x68, 0xac, 0xe0, 0x31, 0x75, 0xb9, 0xfd,
+};
+static const unsigned char test_iv[TEST_BLOCK] = {
+	0xf0, 0xe1, 0xd2, 0xc3, 0xb4, 0xa5, 0x96, 0x87,
+	0x78, 0x69, 0x5a, 0x4b, 0x3c, 0x2d, 0x1e, 0x0f,
+};
+
+struct test_chain {
+	EVP_CIPHER_CTX *ctx;
+	unsigned char iv[TEST_BLOCK];	/* the stitched reference keeps its own chain */
+};
+
+static size_t test_eiv(unsigned int version)
+{
+	return version >= TLS1_1_VERSION ? TEST_BLOCK : 0;
+}
+
+static void test_aad(unsigned char *aad, unsigned long seq, unsigned int version, size_t len)
+{
+	int i;
+
+	for (i = 7; i >= 0; i--, seq >>= 8)
+		aad[i] = (unsigned char)seq;
+	aad[8] = 0x17;
+	aad[9] = (unsigned char)(version >> 8);
+	aad[10] = (unsigned char)version;
+	aad[11] = (unsigned char)(len >> 8);
+	aad[12] = (unsigned char)len;
+}
+
+static void test_payload(unsigned char *buf, size_t len, unsigned long seq)
+{
+	size_t i;
+
+	for (i = 0; i < len; i++)
+		buf[i] = (unsigned char)(i * 31 + seq);
+}
+
+static int test_init(struct test_chain *chain, const EVP_CIPHER *cipher,
+		     const struct test_suite *suite, unsigned int version, int enc)
+{
+	OSSL_PARAM params[2];
+
+	memcpy(chain->iv, test_iv, sizeof(test_iv));
+	chain->ctx = EVP_CIPHER_CTX_new();
+	if (!chain->ctx)
+		return -1;
+
+	/* the stitched reference is driven by hand */
+	if (!cipher)
+		return 0;
+
+	params[0] = OSSL_PARAM_construct_uint(OSSL_CIPHER_PARAM_TLS_VERSION, &version);
+	params[1] = OSSL_PARAM_construct_end();
+	if (!EVP_CipherInit_ex2(chain->ctx, cipher, test_key, test_iv, enc, NULL) ||
+	    EVP_CIPHER_CTX_ctrl(chain->ctx, EVP_CTRL_AEAD_SET_MAC_KEY, (int)suite->maclen,
+				(void *)test_mac_key) <= 0 ||
+	    !EVP_CIPHER_CTX_set_params(chain->ctx, params))
+		return -1;
+
+	return 0;
+}
+
+/* AES-CBC and HMAC one after the other, as libssl does without a stitched cipher */
+static int test_stitch_record(struct test_chain *chain, const EVP_CIPHER *cbc,
+			      const struct test_suite *suite, const unsigned char *aad,
+			      unsigned char *rec, size_t payload, unsigned int version,
+			      size_t *reclen)
+{
+	unsigned char mac_aad[EVP_AEAD_TLS1_AAD_LEN];
+	size_t eiv = test_eiv(version);
+	size_t len = eiv + payload;
+	EVP_MAC_CTX *mctx = NULL;
+	OSSL_PARAM params[2];
+	EVP_MAC *mac;
+	size_t maclen, pad;
+	int outl, ret = -1;
+
+	/* the mac covers the length of the payload alone */
+	memcpy(mac_aad, aad, sizeof(mac_aad));
+	mac_aad[11] = (unsigned char)(payload >> 8);
+	mac_aad[12] = (unsigned char)payload;
+
+	params[0] = OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_DIGEST, (char *)suite->md, 0);
+	params[1] = OSSL_PARAM_construct_end();
+	mac = EVP_MAC_fetch(NULL, "HMAC", "provider=default");
+	if (mac)
+		mctx = EVP_MAC_CTX_new(mac);
+	if (!mctx || !EVP_MAC_init(mctx, test_mac_key, suite->maclen, params) ||
+	    !EVP_MAC_update(mctx, mac_aad, sizeof(mac_aad)) ||
+	    !EVP_MAC_update(mctx, rec + eiv, payload) ||
+	    !EVP_MAC_final(mctx, rec + len, &maclen, suite->maclen))
+		goto out;
+
+	len += maclen;
+	pad = TEST_BLOCK - (len - eiv) % TEST_BLOCK;
+	memset(rec + len, (int)(pad - 1), pad);
+	len += pad;
+
+	if (!EVP_CipherInit_ex2(chain->ctx, cbc, test_key, chain->iv, 1, NULL) ||
+	    !EVP_CIPHER_CTX_set_padding(chain->ctx, 0) ||
+	    !EVP_CipherUpdate(chain->ctx, rec, &outl, rec, (int)len) || (size_t)outl != len)
+		goto out;
+
+	memcpy(chain->iv, rec + len - TEST_BLOCK, TEST_BLOCK);
+	*reclen = len;
+	ret = 0;
+
+out:
+	EVP_MAC_CTX_free(mctx);
+	EVP_MAC_free(mac);
+	return ret;
+}
+
+static int test_enc_record(struct test_chain *chain, const unsigned char *aad_in,
+			   unsigned char *rec, size_t payload, unsigned int version,
+			   size_t *reclen)
+{
+	unsigned char aad[EVP_AEAD_TLS1_AAD_LEN];
+	size_t len = test_eiv(version) + payload;
+	int pad, outl;
+
+	/* the cipher may rewrite the length in the aad it is given */
+	memcpy(aad, aad_in, sizeof(aad));
+	pad = EVP_CIPHER_CTX_ctrl(chain->ctx, EVP_CTRL_AEAD_TLS1_AAD, sizeof(aad), aad);
+	if (pad <= 0)
+		return -1;
+
+	len += pad;
+	if (!EVP_CipherUpdate(chain->ctx, rec, &outl, rec, (int)len) || (size_t)outl != len)
+		return -1;
+	*reclen = len;
+
+	return 0;
+}
+
+/* 0 with the payload back in place, 1 when the record is refused */
+static int test_dec_record(struct test_chain *chain, const unsigned char *aad_in,
+			   unsigned char *rec, size_t reclen, size_t *payload)
+{
+	unsigned char aad[EVP_AEAD_TLS1_AAD_LEN];
+	int outl;
+
+	memcpy(aad, aad_in, sizeof(aad));
+	aad[11] = (unsigned char)(reclen >> 8);
+	aad[12] = (unsigned char)reclen;
+	if (EVP_CIPHER_CTX_ctrl(chain->ctx, EVP_CTRL_AEAD_TLS1_AAD, sizeof(aad), aad) <= 0)
+		return -1;
+
+	if (!EVP_CipherUpdate(chain->ctx, rec, &outl, rec, (int)reclen))
+		return 1;
+	*payload = (size_t)outl;
+
+	return 0;
+}
+
+static int test_records(const char *prov_name, const struct test_suite *suite,
+			unsigned int version)
+{
+	unsigned char aad[EVP_AEAD_TLS1_AAD_LEN];
+	struct test_chain enc = {0}, ref = {0}, dec = {0}, bad = {0};
+	EVP_CIPHER *cipher, *def, *cbc = NULL;
+	unsigned char *rec, *refrec, *tmp;
+	size_t eiv = test_eiv(version);
+	size_t i, reclen, reflen, out;
+	char query[64];
+	int ret = -1;
+
+	snprintf(query, sizeof(query), "provider=%s", prov_name);
+	cipher = EVP_CIPHER_fetch(NULL, suite->cipher, query);
+	if (!cipher) {
+		printf("%s: not available, skipped\n", suite->cipher);
+		return 0;
+	}
+
+	def = EVP_CIPHER_fetch(NULL, suite->cipher, "provider=default");
+	if (!def)
+		cbc = EVP_CIPHER_fetch(NULL, suite->cbc, "provider=default");
+
+	rec = malloc(TEST_MAX_RECORD);
+	refrec = malloc(TEST_MAX_RECORD);
+	tmp = malloc(TEST_MAX_RECORD);
+	if (!rec || !refrec || !tmp || (!def && !cbc) ||
+	    test_init(&enc, cipher, suite, version, 1) ||
+	    test_init(&ref, def, suite, version, 1) ||
+	    test_init(&dec, cipher, suite, version, 0) ||
+	    test_init(&bad, cipher, suite, version, 0)) {
+		fprintf(stderr, "%s: failed to set up\n", suite->cipher);
+		goto out;
+	}
+
+	for (i = 0; i < sizeof(test_payloads) / sizeof(test_payloads[0]); i++) {
+		test_aad(aad, i, version, eiv + test_payloads[i]);
+		memset(rec, 0xee, eiv);
+		test_payload(rec + eiv, test_payloads[i], i);
+		memcpy(refrec, rec, eiv + test_payloads[i]);
+
+		if (test_enc_record(&enc, aad, rec, test_payloads[i], version, &reclen) ||
+		    (def ? test_enc_record(&ref, aad, refrec, test_payloads[i], version, &reflen) :
+		     test_stitch_record(&ref, cbc, suite, aad, refrec, test_payloads[i],
+					version, &reflen))) {
+			fprintf(stderr, "%s: encryption failed at %zu bytes\n",
+				suite->cipher, test_payloads[i]);
+			goto out;
+		}
+
+		if (reclen != reflen || memcmp(rec, refrec, reclen)) {
+			fprintf(stderr, "%s: record of %zu bytes differs from the reference\n",
+				suite->cipher, test_payloads[i]);
+			goto out;
+		}
+
+		/* a corrupted copy must be refused, on a ctx of its own */
+		memcpy(tmp, rec, reclen);
+		tmp[reclen - 1 - (i % 2) * TEST_BLOCK] ^= 0x40;
+		if (test_dec_record(&bad, aad, tmp, reclen, &out) != 1) {
+			fprintf(stderr, "%s: corrupted record of %zu bytes accepted\n",
+				suite->cipher, test_payloads[i]);
+			goto out;
+		}
+		EVP_CIPHER_CTX_free(bad.ctx);
+		bad.ctx = NULL;
+		if (test_init(&bad, cipher, suite, version, 0))
+			goto out;
+
+		test_payload(tmp, test_payloads[i], i);
+		if (test_dec_record(&dec, aad, rec, reclen, &out) || out != test_payloads[i] ||
+		    memcmp(rec + eiv, tmp, out)) {
+			fprintf(stderr, "%s: decryption failed at %zu bytes\n",
+				suite->cipher, test_payloads[i]);
+			goto out;
+		}
+	}
+
+	printf("%s: TLS %s records ok against %s\n", suite->cipher,
+	       version == TLS1_VERSION ? "1.0" : "1.2",
+	       def ? "the default provider" : "AES-CBC and HMAC");
+	ret = 0;
+
+out:
+	EVP_CIPHER_CTX_free(bad.ctx);
+	EVP_CIPHER_CTX_free(dec.ctx);
+	EVP_CIPHER_CTX_free(ref.ctx);
+	EVP_CIPHER_CTX_free(enc.ctx);
+	free(tmp);
+	free(refrec);
+	free(rec);
+	EVP_CIPHER_free(cbc);
+	EVP_CIPHER_free(def);
+	EVP_CIPHER_free(cipher);
+	return ret;
+}
+
+/*
+ * One TLS 1.2 write through the multiblock ctrls, as libssl sends it: the
+ * records that come back must decrypt, in order, to the whole payload.
+ */
+static int test_multiblock(const char *prov_name, const struct test_suite *suite)
+{
+	EVP_CTRL_TLS1_1_MULTIBLOCK_PARAM mb = {0};
+	unsigned char aad[EVP_AEAD_TLS1_AAD_LEN];
+	unsigned char *buf = NULL, *in = NULL;
+	struct test_chain enc = {0}, dec = {0};
+	size_t nw = 4 * TEST_MB_FRAG + 3;
+	size_t off = 0, got = 0, reclen, out;
+	int bufsize, packlen, enc_len;
+	unsigned int i;
+	EVP_CIPHER *cipher;
+	char query[64];
+	int ret = -1;
+
+	snprintf(query, sizeof(query), "provider=%s", prov_name);
+	cipher = EVP_CIPHER_fetch(NULL, suite->cipher, query);
+	if (!cipher)
+		return 0;
+
+	if (test_init(&enc, cipher, suite, TLS1_2_VERSION, 1) ||
+	    test_init(&dec, cipher, suite, TLS1_2_VERSION, 0))
+		goto out;
+
+	bufsize = EVP_CIPHER_CTX_ctrl(enc.ctx, EVP_CTRL_TLS1_1_MULTIBLOCK_MAX_BUFSIZE,
+				      TEST_MB_FRAG, NULL);
+	if (bufsize <= 0) {
+		printf("%s: no multiblock, skipped\n", suite->cipher);
+		ret = 0;
+		goto out;
+	}
+
+	buf = malloc((size_t)bufsize * 8);
+	in = malloc(nw);
+	if (!buf || !in)
+		goto out;
+	test_payload(in, nw, 7);
+
+	/* the aad carries the first sequence number, its length is unused */
+	test_aad(aad, 7, TLS1_2_VERSION, 0);
+	mb.inp = aad;
+	mb.len = nw;
+	mb.interleave = 4;
+	packlen = EVP_CIPHER_CTX_ctrl(enc.ctx, EVP_CTRL_TLS1_1_MULTIBLOCK_AAD, sizeof(mb), &mb);
+	if (packlen <= 0 || packlen > bufsize * 8) {
+		fprintf(stderr, "%s: multiblock aad failed\n", suite->cipher);
+		goto out;
+	}
+
+	mb.out = buf;
+	mb.inp = in;
+	mb.len = nw;
+	enc_len = EVP_CIPHER_CTX_ctrl(enc.ctx, EVP_CTRL_TLS1_1_MULTIBLOCK_ENCRYPT, sizeof(mb), &mb);
+	if (enc_len != packlen) {
+		fprintf(stderr, "%s: multiblock write of %d bytes, %d expected\n",
+			suite->cipher, enc_len, packlen);
+		goto out;
+	}
+
+	for (i = 0; i < mb.interleave; i++) {
+		if (off + 5 > (size_t)enc_len || buf[off] != 0x17 ||
+		    (buf[off + 1] << 8 | buf[off + 2]) != TLS1_2_VERSION)
+			break;
+		reclen = (size_t)(buf[off + 3] << 8 | buf[off + 4]);
+		off += 5;
+		if (off + reclen > (size_t)enc_len)
+			break;
+
+		test_aad(aad, 7 + i, TLS1_2_VERSION, 0);
+		if (test_dec_record(&dec, aad, buf + off, reclen, &out) ||
+		    got + out > nw || memcmp(buf + off + TEST_BLOCK, in + got, out))
+			break;
+		got += out;
+		off += reclen;
+	}
+
+	if (i != mb.interleave || off != (size_t)enc_len || got != nw) {
+		fprintf(stderr, "%s: multiblock record %u does not decrypt\n", suite->cipher, i);
+		goto out;
+	}
+
+	printf("%s: TLS 1.2 multiblock write of %u records ok\n", suite->cipher, mb.interleave);
+	ret = 0;
+
+out:
+	EVP_CIPHER_CTX_free(dec.ctx);
+	EVP_CIPHER_CTX_free(enc.ctx);
+	free(in);
+	free(buf);
+	EVP_CIPHER_free(cipher);
+	return ret;
+}
+
+int main(int argc, char *argv[])
+{
+	const char *prov_name = argc > 1 ? argv[1] : "uadk_provider";
+	OSSL_PROVIDER *prov, *def;
+	size_t i, j;
+	int ret = 1;
+
+	prov = OSSL_PROVIDER_load(NULL, prov_name);
+	if (!prov) {
+		printf("failed to load provider %s, skipped\n", prov_name);
+		return TEST_SKIP;
+	}
+
+	def = OSSL_PROVIDER_load(NULL, "default");
+	if (!def) {
+		fprintf(stderr, "failed to load the default provider\n");
+		goto out;
+	}
+
+	for (i = 0; i < sizeof(test_suites) / sizeof(test_suites[0]); i++) {
+		for (j = 0; j < sizeof(test_versions) / sizeof(test_versions[0]); j++) {
+			if (test_records(prov_name, &test_suites[i], test_versions[j]))
+				goto out;
+		}
+		if (test_multiblock(prov_name, &test_suites[i]))
+			goto out;
+	}
+	ret = 0;
+
+out:
+	OSSL_PROVIDER_unload(def);
+	OSSL_PROVIDER_unload(prov);
+	return ret;
+}
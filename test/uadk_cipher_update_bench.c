@@ -0,0 +1,116 @@
+/*
+ * Copyright 2020-2022 Huawei Technologies Co.,Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Throughput of many small EVP_CipherUpdate calls on one context, with an
+ * iv only reinit every few updates as TLS does per record.
+ *
+ * Build and run:
+ * gcc -O2 test/uadk_cipher_update_bench.c -lcrypto -o uadk_cipher_update_bench
+ * ./uadk_cipher_update_bench [provider [cipher [update bytes [updates per iv]]]]
+ * e.g. ./uadk_cipher_update_bench uadk_provider AES-128-CTR 1024 16
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <openssl/evp.h>
+#include "uadk_bench.h"
+
+#define BENCH_BYTES		(256UL << 20)
+#define BENCH_MAX_UPDATE	(64 * 1024)
+
+static int bench_run(EVP_CIPHER_CTX *ctx, const EVP_CIPHER *cipher, unsigned char *out,
+		     const unsigned char *in, size_t len, unsigned long per_iv,
+		     unsigned long loops)
+{
+	unsigned char key[EVP_MAX_KEY_LENGTH] = {0};
+	unsigned char iv[EVP_MAX_IV_LENGTH] = {0};
+	unsigned long i;
+	int outl;
+
+	if (!EVP_EncryptInit_ex2(ctx, cipher, key, iv, NULL))
+		return -1;
+
+	for (i = 0; i < loops; i++) {
+		if (i && !(i % per_iv)) {
+			/* same key, next record's iv */
+			iv[0]++;
+			if (!EVP_EncryptInit_ex2(ctx, NULL, NULL, iv, NULL))
+				return -1;
+		}
+		if (!EVP_EncryptUpdate(ctx, out, &outl, in, (int)len))
+			return -1;
+	}
+
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	const char *prov_name = argc > 1 ? argv[1] : "uadk_provider";
+	const char *cipher_name = argc > 2 ? argv[2] : "AES-128-CTR";
+	size_t len = argc > 3 ? strtoul(argv[3], NULL, 0) : 1024;
+	unsigned long per_iv = argc > 4 ? strtoul(argv[4], NULL, 0) : 16;
+	unsigned char *in = NULL, *out = NULL;
+	EVP_CIPHER_CTX *ctx = NULL;
+	EVP_CIPHER *cipher = NULL;
+	struct bench_prov bp;
+	unsigned long loops;
+	double start, secs;
+	int ret = 1;
+
+	if (!len || len > BENCH_MAX_UPDATE || !per_iv) {
+		fprintf(stderr, "usage: %s [provider [cipher [update bytes [updates per iv]]]]\n",
+			argv[0]);
+		return 1;
+	}
+
+	if (bench_load(&bp, prov_name, 0))
+		return 1;
+
+	cipher = EVP_CIPHER_fetch(NULL, cipher_name, NULL);
+	ctx = EVP_CIPHER_CTX_new();
+	in = calloc(1, BENCH_MAX_UPDATE);
+	out = malloc(BENCH_MAX_UPDATE + EVP_MAX_BLOCK_LENGTH);
+	if (!cipher || !ctx || !in || !out) {
+		fprintf(stderr, "failed to set up %s\n", cipher_name);
+		goto out;
+	}
+
+	loops = BENCH_BYTES / len;
+	/* warm up the session and the queues first */
+	if (bench_run(ctx, cipher, out, in, len, per_iv, loops / 16 + 1))
+		goto fail;
+
+	start = bench_now();
+	if (bench_run(ctx, cipher, out, in, len, per_iv, loops))
+		goto fail;
+	secs = bench_now() - start;
+
+	printf("%s from %s, %zu bytes per update, new iv every %lu updates\n",
+	       cipher_name, prov_name, len, per_iv);
+	printf("%.0f updates/s, %.2f MiB/s\n", loops / secs, loops * len / secs / (1 << 20));
+	ret = 0;
+	goto out;
+
+fail:
+	fprintf(stderr, "%s update failed\n", cipher_name);
+out:
+	free(in);
+	free(out);
+	EVP_CIPHER_CTX_free(ctx);
+	EVP_CIPHER_free(cipher);
+	bench_unload(&bp);
+	return ret;
+}
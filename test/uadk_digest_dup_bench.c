@@ -0,0 +1,159 @@
+/*
+ * Copyright 2020-2022 Huawei Technologies Co.,Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Cost of the ctx duplication a TLS handshake does: the transcript hash is
+ * copied and finalised after each message, and the finished key HMAC ctx
+ * is duplicated for each verify_data.
+ *
+ * Build and run:
+ * gcc -O2 test/uadk_digest_dup_bench.c -lcrypto -o uadk_digest_dup_bench
+ * ./uadk_digest_dup_bench [provider [digest [handshakes]]]
+ * e.g. ./uadk_digest_dup_bench uadk_provider SHA256 20000
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <openssl/core_names.h>
+#include <openssl/evp.h>
+#include <openssl/params.h>
+#include "uadk_bench.h"
+
+#define BENCH_HANDSHAKES	20000UL
+#define BENCH_MSGS		8
+#define BENCH_MSG_LEN		512
+
+static int bench_transcript(const EVP_MD *md, const unsigned char *msg,
+			    unsigned long handshakes, double *ns)
+{
+	unsigned char out[EVP_MAX_MD_SIZE];
+	EVP_MD_CTX *ctx, *tmp;
+	unsigned long i;
+	unsigned int outl;
+	double start;
+	int j, ret = -1;
+
+	ctx = EVP_MD_CTX_new();
+	tmp = EVP_MD_CTX_new();
+	if (!ctx || !tmp)
+		goto out;
+
+	start = bench_now();
+	for (i = 0; i < handshakes; i++) {
+		if (!EVP_DigestInit_ex2(ctx, md, NULL))
+			goto out;
+		for (j = 0; j < BENCH_MSGS; j++) {
+			/* the running hash is read after every message */
+			if (!EVP_DigestUpdate(ctx, msg, BENCH_MSG_LEN) ||
+			    !EVP_MD_CTX_copy_ex(tmp, ctx) ||
+			    !EVP_DigestFinal_ex(tmp, out, &outl))
+				goto out;
+		}
+	}
+	*ns = (bench_now() - start) * 1e9 / handshakes;
+	ret = 0;
+
+out:
+	EVP_MD_CTX_free(tmp);
+	EVP_MD_CTX_free(ctx);
+	return ret;
+}
+
+static int bench_finished(EVP_MAC *mac, const char *digest, const unsigned char *msg,
+			  unsigned long handshakes, double *ns)
+{
+	unsigned char out[EVP_MAX_MD_SIZE];
+	EVP_MAC_CTX *ctx, *tmp;
+	OSSL_PARAM params[2];
+	unsigned long i;
+	double start;
+	size_t outl;
+	int ret = -1;
+
+	params[0] = OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_DIGEST,
+						     (char *)digest, 0);
+	params[1] = OSSL_PARAM_construct_end();
+
+	ctx = EVP_MAC_CTX_new(mac);
+	if (!ctx || !EVP_MAC_init(ctx, msg, 32, params))
+		goto out;
+
+	start = bench_now();
+	for (i = 0; i < handshakes; i++) {
+		/* client and server verify_data from the same keyed ctx */
+		tmp = EVP_MAC_CTX_dup(ctx);
+		if (!tmp)
+			goto out;
+		if (!EVP_MAC_update(tmp, msg, 32) ||
+		    !EVP_MAC_final(tmp, out, &outl, sizeof(out))) {
+			EVP_MAC_CTX_free(tmp);
+			goto out;
+		}
+		EVP_MAC_CTX_free(tmp);
+	}
+	*ns = (bench_now() - start) * 1e9 / handshakes;
+	ret = 0;
+
+out:
+	EVP_MAC_CTX_free(ctx);
+	return ret;
+}
+
+int main(int argc, char *argv[])
+{
+	const char *prov_name = argc > 1 ? argv[1] : "uadk_provider";
+	const char *digest = argc > 2 ? argv[2] : "SHA256";
+	unsigned long handshakes = argc > 3 ? strtoul(argv[3], NULL, 0) : BENCH_HANDSHAKES;
+	unsigned char msg[BENCH_MSG_LEN];
+	double transcript, finished;
+	struct bench_prov bp;
+	EVP_MAC *mac = NULL;
+	EVP_MD *md = NULL;
+	int ret = 1;
+
+	if (!handshakes) {
+		fprintf(stderr, "usage: %s [provider [digest [handshakes]]]\n", argv[0]);
+		return 1;
+	}
+
+	if (bench_load(&bp, prov_name, 0))
+		return 1;
+
+	md = EVP_MD_fetch(NULL, digest, NULL);
+	mac = EVP_MAC_fetch(NULL, "HMAC", NULL);
+	if (!md || !mac) {
+		fprintf(stderr, "failed to fetch %s or HMAC\n", digest);
+		goto out;
+	}
+
+	memset(msg, 0x5a, sizeof(msg));
+
+	if (bench_transcript(md, msg, handshakes, &transcript) ||
+	    bench_finished(mac, digest, msg, handshakes, &finished)) {
+		fprintf(stderr, "%s dup failed\n", digest);
+		goto out;
+	}
+
+	printf("%s from %s\n", digest, prov_name);
+	printf("transcript, %d messages of %d bytes: %.0f ns per handshake\n",
+	       BENCH_MSGS, BENCH_MSG_LEN, transcript);
+	printf("finished mac dup + update + final: %.0f ns\n", finished);
+	ret = 0;
+
+out:
+	EVP_MAC_free(mac);
+	EVP_MD_free(md);
+	bench_unload(&bp);
+	return ret;
+}
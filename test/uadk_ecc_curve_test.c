@@ -0,0 +1,356 @@
+/*
+ * Copyright 2020-2022 Huawei Technologies Co.,Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Check the cached named curve parameters against the published values of
+ * the curves, and against the generic path taken for explicit curves, no
+ * hardware needed.
+ *
+ * Build and run:
+ * gcc -O2 -pthread -I src test/uadk_ecc_curve_test.c src/uadk_ecc_curve.c \
+ *     -lcrypto -o uadk_ecc_curve_test
+ * ./uadk_ecc_curve_test
+ */
+#include <stdio.h>
+#include <string.h>
+#include <openssl/bn.h>
+#include <openssl/ec.h>
+#include <openssl/obj_mac.h>
+#include <openssl/objects.h>
+#include "uadk_ecc_curve.h"
+
+#define TEST_HEX_BASE		16
+
+/*
+ * p, a, b, g.x, g.y and n as the standards print them, leading zeros
+ * dropped: the hardware takes big-endian values with no leading zero byte
+ * and one zero byte for zero.
+ */
+struct test_curve_ref {
+	int nid;
+	const char *hex[UADK_ECC_CURVE_PARAM_NUM];
+};
+
+static const struct test_curve_ref test_refs[] = {
+	/* prime192v1, SEC 2 */
+	{ NID_X9_62_prime192v1, {
+		"FFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFEFFFFFFFFFFFFFFFF",
+		"FFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFEFFFFFFFFFFFFFFFC",
+		"64210519E59C80E70FA7E9AB72243049FEB8DEECC146B9B1",
+		"188DA80EB03090F67CBF20EB43A18800F4FF0AFD82FF1012",
+		"7192B95FFC8DA78631011ED6B24CDD573F977A11E794811",
+		"FFFFFFFFFFFFFFFFFFFFFFFF99DEF836146BC9B1B4D22831",
+	} },
+	/* secp224r1, SEC 2 */
+	{ NID_secp224r1, {
+		"FFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFF000000000000000000000001",
+		"FFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFEFFFFFFFFFFFFFFFFFFFFFFFE",
+		"B4050A850C04B3ABF54132565044B0B7D7BFD8BA270B39432355FFB4",
+		"B70E0CBD6BB4BF7F321390B94A03C1D356C21122343280D6115C1D21",
+		"BD376388B5F723FB4C22DFE6CD4375A05A07476444D5819985007E34",
+		"FFFFFFFFFFFFFFFFFFFFFFFFFFFF16A2E0B8F03E13DD29455C5C2A3D",
+	} },
+	/* prime256v1, SEC 2 */
+	{ NID_X9_62_prime256v1, {
+		"FFFFFFFF00000001000000000000000000000000FFFFFFFFFFFFFFFFFFFFFFFF",
+		"FFFFFFFF00000001000000000000000000000000FFFFFFFFFFFFFFFFFFFFFFFC",
+		"5AC635D8AA3A93E7B3EBBD55769886BC651D06B0CC53B0F63BCE3C3E27D2604B",
+		"6B17D1F2E12C4247F8BCE6E563A440F277037D812DEB33A0F4A13945D898C296",
+		"4FE342E2FE1A7F9B8EE7EB4A7C0F9E162BCE33576B315ECECBB6406837BF51F5",
+		"FFFFFFFF00000000FFFFFFFFFFFFFFFFBCE6FAADA7179E84F3B9CAC2FC632551",
+	} },
+	/* secp256k1, SEC 2 */
+	{ NID_secp256k1, {
+		"FFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFEFFFFFC2F",
+		"0",
+		"7",
+		"79BE667EF9DCBBAC55A06295CE870B07029BFCDB2DCE28D959F2815B16F81798",
+		"483ADA7726A3C4655DA4FBFC0E1108A8FD17B448A68554199C47D08FFB10D4B8",
+		"FFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFEBAAEDCE6AF48A03BBFD25E8CD0364141",
+	} },
+	/* secp384r1, SEC 2 */
+	{ NID_secp384r1, {
+		"FFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFE"
+		"FFFFFFFF0000000000000000FFFFFFFF",
+		"FFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFE"
+		"FFFFFFFF0000000000000000FFFFFFFC",
+		"B3312FA7E23EE7E4988E056BE3F82D19181D9C6EFE8141120314088F5013875A"
+		"C656398D8A2ED19D2A85C8EDD3EC2AEF",
+		"AA87CA22BE8B05378EB1C71EF320AD746E1D3B628BA79B9859F741E082542A38"
+		"5502F25DBF55296C3A545E3872760AB7",
+		"3617DE4A96262C6F5D9E98BF9292DC29F8F41DBD289A147CE9DA3113B5F0B8C0"
+		"0A60B1CE1D7E819D7A431D7C90EA0E5F",
+		"FFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFC7634D81F4372DDF"
+		"581A0DB248B0A77AECEC196ACCC52973",
+	} },
+	/* secp521r1, SEC 2 */
+	{ NID_secp521r1, {
+		"1FFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFF"
+		"FFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFF"
+		"FFF",
+		"1FFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFF"
+		"FFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFF"
+		"FFC",
+		"51953EB9618E1C9A1F929A21A0B68540EEA2DA725B99B315F3B8B489918EF109"
+		"E156193951EC7E937B1652C0BD3BB1BF073573DF883D2C34F1EF451FD46B503F"
+		"00",
+		"C6858E06B70404E9CD9E3ECB662395B4429C648139053FB521F828AF606B4D3D"
+		"BAA14B5E77EFE75928FE1DC127A2FFA8DE3348B3C1856A429BF97E7E31C2E5BD"
+		"66",
+		"11839296A789A3BC0045C8A5FB42C7D1BD998F54449579B446817AFBD17273E6"
+		"62C97EE72995EF42640C550B9013FAD0761353C7086A272C24088BE94769FD16"
+		"650",
+		"1FFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFF"
+		"FFA51868783BF2F966B7FCC0148F709A5D03BB5C9B8899C47AEBB6FB71E91386"
+		"409",
+	} },
+	/* sm2, GB/T 32918.5 */
+	{ NID_sm2, {
+		"FFFFFFFEFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFF00000000FFFFFFFFFFFFFFFF",
+		"FFFFFFFEFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFF00000000FFFFFFFFFFFFFFFC",
+		"28E9FA9E9D9F5E344D5A9E4BCF6509A7F39789F515AB8F92DDBCBD414D940E93",
+		"32C4AE2C1F1981195F9904466A39C9948FE30BBFF2660BE1715A4589334C74C7",
+		"BC3736A2F4F6779C59BDCEE36B692153D0A9877CC62A474002DF32E52139F0A0",
+		"FFFFFFFEFFFFFFFFFFFFFFFFFFFFFFFF7203DF6B21C6052B53BBF40939D54123",
+	} },
+	/* brainpoolP256r1, RFC 5639 */
+	{ NID_brainpoolP256r1, {
+		"A9FB57DBA1EEA9BC3E660A909D838D726E3BF623D52620282013481D1F6E5377",
+		"7D5A0975FC2C3057EEF67530417AFFE7FB8055C126DC5C6CE94A4B44F330B5D9",
+		"26DC5C6CE94A4B44F330B5D9BBD77CBF958416295CF7E1CE6BCCDC18FF8C07B6",
+		"8BD2AEB9CB7E57CB2C4B482FFC81B7AFB9DE27E1E3BD23C23A4453BD9ACE3262",
+		"547EF835C3DAC4FD97F8461A14611DC9C27745132DED8E545C1D54C72F046997",
+		"A9FB57DBA1EEA9BC3E660A909D838D718C397AA3B561A6F7901E0E82974856A7",
+	} },
+	/* brainpoolP320r1, RFC 5639 */
+	{ NID_brainpoolP320r1, {
+		"D35E472036BC4FB7E13C785ED201E065F98FCFA6F6F40DEF4F92B9EC7893EC28"
+		"FCD412B1F1B32E27",
+		"3EE30B568FBAB0F883CCEBD46D3F3BB8A2A73513F5EB79DA66190EB085FFA9F4"
+		"92F375A97D860EB4",
+		"520883949DFDBC42D3AD198640688A6FE13F41349554B49ACC31DCCD88453981"
+		"6F5EB4AC8FB1F1A6",
+		"43BD7E9AFB53D8B85289BCC48EE5BFE6F20137D10A087EB6E7871E2A10A599C7"
+		"10AF8D0D39E20611",
+		"14FDD05545EC1CC8AB4093247F77275E0743FFED117182EAA9C77877AAAC6AC7"
+		"D35245D1692E8EE1",
+		"D35E472036BC4FB7E13C785ED201E065F98FCFA5B68F12A32D482EC7EE8658E9"
+		"8691555B44C59311",
+	} },
+	/* brainpoolP384r1, RFC 5639 */
+	{ NID_brainpoolP384r1, {
+		"8CB91E82A3386D280F5D6F7E50E641DF152F7109ED5456B412B1DA197FB71123"
+		"ACD3A729901D1A71874700133107EC53",
+		"7BC382C63D8C150C3C72080ACE05AFA0C2BEA28E4FB22787139165EFBA91F90F"
+		"8AA5814A503AD4EB04A8C7DD22CE2826",
+		"4A8C7DD22CE28268B39B55416F0447C2FB77DE107DCD2A62E880EA53EEB62D57"
+		"CB4390295DBC9943AB78696FA504C11",
+		"1D1C64F068CF45FFA2A63A81B7C13F6B8847A3E77EF14FE3DB7FCAFE0CBD10E8"
+		"E826E03436D646AAEF87B2E247D4AF1E",
+		"8ABE1D7520F9C2A45CB1EB8E95CFD55262B70B29FEEC5864E19C054FF9912928"
+		"0E4646217791811142820341263C5315",
+		"8CB91E82A3386D280F5D6F7E50E641DF152F7109ED5456B31F166E6CAC0425A7"
+		"CF3AB6AF6B7FC3103B883202E9046565",
+	} },
+};
+
+static const char * const test_param_names[UADK_ECC_CURVE_PARAM_NUM] = {
+	"p", "a", "b", "g.x", "g.y", "n",
+};
+
+/* the same curve with its parameters spelt out, so it has no nid */
+static EC_GROUP *test_explicit_group(const EC_GROUP *named)
+{
+	BIGNUM *p, *a, *b, *x, *y, *cofactor;
+	EC_GROUP *group = NULL;
+	EC_POINT *g = NULL;
+
+	p = BN_new();
+	a = BN_new();
+	b = BN_new();
+	x = BN_new();
+	y = BN_new();
+	cofactor = BN_new();
+	if (!p || !a || !b || !x || !y || !cofactor)
+		goto out;
+
+	if (!EC_GROUP_get_curve(named, p, a, b, NULL) ||
+	    !EC_GROUP_get_cofactor(named, cofactor, NULL) ||
+	    !EC_POINT_get_affine_coordinates(named, EC_GROUP_get0_generator(named),
+					     x, y, NULL))
+		goto out;
+
+	/* a generic GFp group, the named one may use an optimised method */
+	group = EC_GROUP_new_curve_GFp(p, a, b, NULL);
+	if (!group)
+		goto out;
+
+	g = EC_POINT_new(group);
+	if (!g || !EC_POINT_set_affine_coordinates(group, g, x, y, NULL) ||
+	    !EC_GROUP_set_generator(group, g, EC_GROUP_get0_order(named), cofactor)) {
+		EC_GROUP_free(group);
+		group = NULL;
+	}
+
+out:
+	EC_POINT_free(g);
+	BN_free(p);
+	BN_free(a);
+	BN_free(b);
+	BN_free(x);
+	BN_free(y);
+	BN_free(cofactor);
+	return group;
+}
+
+static int test_hex_val(char c)
+{
+	if (c >= '0' && c <= '9')
+		return c - '0';
+	if (c >= 'A' && c <= 'F')
+		return c - 'A' + 10;
+
+	return -1;
+}
+
+/* no BN on purpose, the code under test converts with BN */
+static int test_hex2bin(const char *hex, unsigned char *out, size_t out_len)
+{
+	size_t len = strlen(hex);
+	size_t i, n = (len + 1) / 2;
+	int hi, lo;
+
+	if (n > out_len)
+		return -1;
+
+	/* an odd number of digits has a lone high nibble of zero */
+	for (i = 0; i < n; i++) {
+		hi = (len & 1) && !i ? 0 : test_hex_val(*hex++);
+		lo = test_hex_val(*hex++);
+		if (hi < 0 || lo < 0)
+			return -1;
+		out[i] = (unsigned char)(hi * TEST_HEX_BASE + lo);
+	}
+
+	return (int)n;
+}
+
+static int test_check_ref(const char *name, const struct wd_ecc_curve *cached,
+			  const struct test_curve_ref *ref)
+{
+	const struct wd_dtb *c = (const struct wd_dtb *)cached;
+	unsigned char want[UADK_ECC_CURVE_MAX_BYTES];
+	int i, len;
+
+	for (i = 0; i < UADK_ECC_CURVE_PARAM_NUM; i++) {
+		len = test_hex2bin(ref->hex[i], want, sizeof(want));
+		if (len < 0) {
+			printf("%s: bad reference for %s\n", name, test_param_names[i]);
+			return -1;
+		}
+
+		if (c[i].dsize != (unsigned int)len || c[i].bsize < c[i].dsize ||
+		    memcmp(c[i].data, want, len)) {
+			printf("%s: %s differs from the published value\n",
+			       name, test_param_names[i]);
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+static int test_compare(const char *name, const struct wd_ecc_curve *cached,
+			const struct wd_ecc_curve *generic)
+{
+	const struct wd_dtb *c = (const struct wd_dtb *)cached;
+	const struct wd_dtb *g = (const struct wd_dtb *)generic;
+	int i;
+
+	for (i = 0; i < UADK_ECC_CURVE_PARAM_NUM; i++) {
+		if (c[i].dsize != g[i].dsize || c[i].bsize != g[i].bsize ||
+		    memcmp(c[i].data, g[i].data, c[i].dsize)) {
+			printf("%s: %s differs between cached and generic path\n",
+			       name, test_param_names[i]);
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+static int test_curve(const struct test_curve_ref *ref)
+{
+	const struct wd_ecc_curve *cached, *again, *generic;
+	struct uadk_ecc_curve_buf buf, explicit_buf;
+	const char *name = OBJ_nid2sn(ref->nid);
+	EC_GROUP *named, *explicit;
+	int ret = -1;
+
+	named = EC_GROUP_new_by_curve_name(ref->nid);
+	if (!named) {
+		/* e.g. sm2 in a build without it */
+		printf("%s: not available, skipped\n", name);
+		return 0;
+	}
+
+	explicit = test_explicit_group(named);
+	if (!explicit || EC_GROUP_get_curve_name(explicit) != NID_undef) {
+		printf("%s: failed to build explicit group\n", name);
+		goto out;
+	}
+
+	cached = uadk_ecc_curve_get(named, &buf);
+	again = uadk_ecc_curve_get(named, &buf);
+	generic = uadk_ecc_curve_get(explicit, &explicit_buf);
+	if (!cached || !generic) {
+		printf("%s: failed to get curve parameters\n", name);
+		goto out;
+	}
+
+	if (cached == &buf.param || cached != again) {
+		printf("%s: named curve not served from the cache\n", name);
+		goto out;
+	}
+
+	if (generic != &explicit_buf.param) {
+		printf("%s: explicit curve not filled into the caller's buffer\n", name);
+		goto out;
+	}
+
+	if (test_check_ref(name, cached, ref))
+		goto out;
+
+	ret = test_compare(name, cached, generic);
+
+out:
+	EC_GROUP_free(explicit);
+	EC_GROUP_free(named);
+	return ret;
+}
+
+int main(void)
+{
+	size_t i;
+
+	for (i = 0; i < sizeof(test_refs) / sizeof(test_refs[0]); i++) {
+		if (test_curve(&test_refs[i])) {
+			printf("ecc curve test failed\n");
+			return 1;
+		}
+	}
+
+	printf("ecc curve test passed\n");
+	return 0;
+}
@@ -0,0 +1,190 @@
+/*
+ * Copyright 2020-2022 Huawei Technologies Co.,Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * ECDSA signatures of a provider, checked by the default provider, and no
+ * two of them with the same r: a nonce is never used twice. With
+ * ECDSA_PRECOMP set for the curves, the signatures run through the nonce
+ * pool, past its size and so into the refill as well. It exits 77, a skip
+ * to make check, when the provider does not load.
+ *
+ * Build and run:
+ * gcc -O2 test/uadk_ecdsa_precomp_test.c -lcrypto -o uadk_ecdsa_precomp_test
+ * ./uadk_ecdsa_precomp_test [provider]
+ * e.g. ./uadk_ecdsa_precomp_test uadk_provider
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <openssl/bn.h>
+#include <openssl/ecdsa.h>
+#include <openssl/evp.h>
+#include <openssl/provider.h>
+
+/* more than a default pool of 256 */
+#define TEST_SIGNS		600
+#define TEST_MAX_SIG		160
+#define TEST_DIGEST_LEN		64
+#define TEST_SKIP		77
+
+static const char * const test_curves[] = { "P-256", "P-384", "P-521" };
+
+static BIGNUM *test_r[TEST_SIGNS];
+
+static EVP_PKEY *test_key(const char *curve)
+{
+	EVP_PKEY_CTX *ctx;
+	EVP_PKEY *pkey = NULL;
+
+	ctx = EVP_PKEY_CTX_new_from_name(NULL, "EC", "provider=default");
+	if (!ctx)
+		return NULL;
+
+	if (EVP_PKEY_keygen_init(ctx) <= 0 ||
+	    EVP_PKEY_CTX_set_group_name(ctx, curve) <= 0 ||
+	    EVP_PKEY_keygen(ctx, &pkey) <= 0)
+		pkey = NULL;
+	EVP_PKEY_CTX_free(ctx);
+
+	return pkey;
+}
+
+static EVP_PKEY_CTX *test_ctx(const char *prov_name, EVP_PKEY *pkey, int sign)
+{
+	EVP_PKEY_CTX *ctx;
+	char query[64];
+
+	snprintf(query, sizeof(query), "provider=%s", prov_name);
+	ctx = EVP_PKEY_CTX_new_from_pkey(NULL, pkey, query);
+	if (!ctx)
+		return NULL;
+
+	if ((sign ? EVP_PKEY_sign_init(ctx) : EVP_PKEY_verify_init(ctx)) <= 0) {
+		EVP_PKEY_CTX_free(ctx);
+		return NULL;
+	}
+
+	return ctx;
+}
+
+static int test_cmp_r(const void *a, const void *b)
+{
+	return BN_cmp(*(const BIGNUM * const *)a, *(const BIGNUM * const *)b);
+}
+
+static int test_curve(const char *prov_name, const char *curve)
+{
+	unsigned char sig[TEST_MAX_SIG], tbs[TEST_DIGEST_LEN];
+	EVP_PKEY_CTX *sctx = NULL, *def = NULL;
+	const unsigned char *p;
+	const BIGNUM *r;
+	ECDSA_SIG *esig;
+	EVP_PKEY *pkey;
+	size_t i, j, siglen;
+	int ret = -1;
+
+	pkey = test_key(curve);
+	if (!pkey) {
+		printf("ECDSA %s: no key, skipped\n", curve);
+		return 0;
+	}
+
+	sctx = test_ctx(prov_name, pkey, 1);
+	def = test_ctx("default", pkey, 0);
+	if (!sctx || !def) {
+		printf("ECDSA %s: not available, skipped\n", curve);
+		ret = 0;
+		goto out;
+	}
+
+	for (i = 0; i < TEST_SIGNS; i++) {
+		for (j = 0; j < TEST_DIGEST_LEN; j++)
+			tbs[j] = (unsigned char)(i * 37 + j * 11 + 1);
+
+		siglen = sizeof(sig);
+		if (EVP_PKEY_sign(sctx, sig, &siglen, tbs, TEST_DIGEST_LEN) <= 0) {
+			fprintf(stderr, "ECDSA %s: sign %zu failed\n", curve, i);
+			goto out;
+		}
+
+		if (EVP_PKEY_verify(def, sig, siglen, tbs, TEST_DIGEST_LEN) != 1) {
+			fprintf(stderr, "ECDSA %s: signature %zu is bad\n", curve, i);
+			goto out;
+		}
+
+		p = sig;
+		esig = d2i_ECDSA_SIG(NULL, &p, (long)siglen);
+		if (!esig) {
+			fprintf(stderr, "ECDSA %s: signature %zu does not parse\n", curve, i);
+			goto out;
+		}
+		ECDSA_SIG_get0(esig, &r, NULL);
+		test_r[i] = BN_dup(r);
+		ECDSA_SIG_free(esig);
+		if (!test_r[i])
+			goto out;
+	}
+
+	qsort(test_r, TEST_SIGNS, sizeof(test_r[0]), test_cmp_r);
+	for (i = 1; i < TEST_SIGNS; i++) {
+		if (!BN_cmp(test_r[i - 1], test_r[i])) {
+			fprintf(stderr, "ECDSA %s: a nonce is used twice\n", curve);
+			goto out;
+		}
+	}
+
+	printf("ECDSA %s: ok\n", curve);
+	ret = 0;
+
+out:
+	for (i = 0; i < TEST_SIGNS; i++) {
+		BN_free(test_r[i]);
+		test_r[i] = NULL;
+	}
+	EVP_PKEY_CTX_free(def);
+	EVP_PKEY_CTX_free(sctx);
+	EVP_PKEY_free(pkey);
+	return ret;
+}
+
+int main(int argc, char *argv[])
+{
+	const char *prov_name = argc > 1 ? argv[1] : "uadk_provider";
+	OSSL_PROVIDER *prov, *def;
+	int ret = 1;
+	size_t i;
+
+	prov = OSSL_PROVIDER_load(NULL, prov_name);
+	if (!prov) {
+		printf("failed to load provider %s, skipped\n", prov_name);
+		return TEST_SKIP;
+	}
+
+	def = OSSL_PROVIDER_load(NULL, "default");
+	if (!def) {
+		fprintf(stderr, "failed to load provider default\n");
+		goto out;
+	}
+
+	for (i = 0; i < sizeof(test_curves) / sizeof(test_curves[0]); i++) {
+		if (test_curve(prov_name, test_curves[i]))
+			goto out;
+	}
+	ret = 0;
+
+out:
+	OSSL_PROVIDER_unload(def);
+	OSSL_PROVIDER_unload(prov);
+	return ret;
+}
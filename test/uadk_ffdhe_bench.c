@@ -0,0 +1,171 @@
+/*
+ * Copyright 2020-2022 Huawei Technologies Co.,Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * FFDHE key exchanges per second of a provider against the default one,
+ * for each RFC 7919 group. A handshake is what both ends of a TLS 1.3
+ * FFDHE exchange do: two key generations from the group name and two
+ * derivations, whose shared secrets have to match.
+ *
+ * Build and run:
+ * gcc -O2 test/uadk_ffdhe_bench.c -lcrypto -o uadk_ffdhe_bench
+ * ./uadk_ffdhe_bench [provider [seconds]]
+ * e.g. ./uadk_ffdhe_bench uadk_provider 3
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <openssl/evp.h>
+#include "uadk_bench.h"
+
+#define BENCH_SECONDS		3
+#define BENCH_MAX_SECRET	1024
+
+static const char * const bench_groups[] = {
+	"ffdhe2048", "ffdhe3072", "ffdhe4096", "ffdhe6144", "ffdhe8192",
+};
+
+static EVP_PKEY *bench_keygen(const char *query, const char *group)
+{
+	EVP_PKEY_CTX *ctx;
+	EVP_PKEY *pkey = NULL;
+
+	ctx = EVP_PKEY_CTX_new_from_name(NULL, "DH", query);
+	if (!ctx)
+		return NULL;
+
+	if (EVP_PKEY_keygen_init(ctx) <= 0 ||
+	    EVP_PKEY_CTX_set_group_name(ctx, group) <= 0 ||
+	    EVP_PKEY_keygen(ctx, &pkey) <= 0)
+		pkey = NULL;
+	EVP_PKEY_CTX_free(ctx);
+
+	return pkey;
+}
+
+static size_t bench_derive(const char *query, EVP_PKEY *pkey, EVP_PKEY *peer,
+			   unsigned char *secret)
+{
+	size_t len = BENCH_MAX_SECRET;
+	EVP_PKEY_CTX *ctx;
+
+	ctx = EVP_PKEY_CTX_new_from_pkey(NULL, pkey, query);
+	if (!ctx)
+		return 0;
+
+	if (EVP_PKEY_derive_init(ctx) <= 0 ||
+	    EVP_PKEY_derive_set_peer(ctx, peer) <= 0 ||
+	    EVP_PKEY_derive(ctx, secret, &len) <= 0)
+		len = 0;
+	EVP_PKEY_CTX_free(ctx);
+
+	return len;
+}
+
+/* 1 when the provider has no such group */
+static int bench_handshake(const char *query, const char *group)
+{
+	unsigned char client_secret[BENCH_MAX_SECRET], server_secret[BENCH_MAX_SECRET];
+	EVP_PKEY *client, *server = NULL;
+	size_t client_len, server_len;
+	int ret = -1;
+
+	client = bench_keygen(query, group);
+	if (!client)
+		return 1;
+
+	server = bench_keygen(query, group);
+	if (!server)
+		goto out;
+
+	client_len = bench_derive(query, client, server, client_secret);
+	server_len = bench_derive(query, server, client, server_secret);
+	if (client_len && client_len == server_len &&
+	    !memcmp(client_secret, server_secret, client_len))
+		ret = 0;
+
+out:
+	EVP_PKEY_free(server);
+	EVP_PKEY_free(client);
+	return ret;
+}
+
+static int bench_run(const char *prov_name, const char *group, double seconds,
+		     double *rate)
+{
+	unsigned long n = 0;
+	double start, now;
+	char query[64];
+	int ret;
+
+	snprintf(query, sizeof(query), "provider=%s", prov_name);
+	start = bench_now();
+	do {
+		ret = bench_handshake(query, group);
+		if (ret)
+			return ret;
+		n++;
+		now = bench_now();
+	} while (now - start < seconds);
+
+	*rate = n / (now - start);
+
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	const char *prov_name = argc > 1 ? argv[1] : "uadk_provider";
+	double seconds = argc > 2 ? atof(argv[2]) : BENCH_SECONDS;
+	double prov_rate, def_rate;
+	struct bench_prov bp;
+	int ret = 1;
+	size_t i;
+
+	if (seconds <= 0) {
+		fprintf(stderr, "usage: %s [provider [seconds]]\n", argv[0]);
+		return 1;
+	}
+
+	if (bench_load(&bp, prov_name, 1))
+		return 1;
+
+	printf("%s against default, one thread\n", prov_name);
+	printf("%-12s%14s%14s%10s\n", "group", prov_name, "default", "ratio");
+	for (i = 0; i < sizeof(bench_groups) / sizeof(bench_groups[0]); i++) {
+		switch (bench_run(prov_name, bench_groups[i], seconds, &prov_rate)) {
+		case 0:
+			break;
+		case 1:
+			printf("%s: not available, skipped\n", bench_groups[i]);
+			continue;
+		default:
+			fprintf(stderr, "%s: handshake failed\n", bench_groups[i]);
+			goto out;
+		}
+
+		if (bench_run("default", bench_groups[i], seconds, &def_rate)) {
+			fprintf(stderr, "%s: default handshake failed\n", bench_groups[i]);
+			goto out;
+		}
+		printf("%-12s%14.1f%14.1f%10.2f\n", bench_groups[i], prov_rate, def_rate,
+		       prov_rate / def_rate);
+	}
+	printf("(handshakes per second)\n");
+	ret = 0;
+
+out:
+	bench_unload(&bp);
+	return ret;
+}
@@ -0,0 +1,119 @@
+/*
+ * Copyright 2020-2022 Huawei Technologies Co.,Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Cost of HMAC init with keys around the block size, on a reused ctx and
+ * on a new ctx each time as hkdf does.
+ *
+ * Build and run:
+ * gcc -O2 test/uadk_hmac_init_bench.c -lcrypto -o uadk_hmac_init_bench
+ * ./uadk_hmac_init_bench [provider [digest [inits]]]
+ * e.g. ./uadk_hmac_init_bench uadk_provider SHA256 100000
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <openssl/core_names.h>
+#include <openssl/evp.h>
+#include <openssl/params.h>
+#include "uadk_bench.h"
+
+#define BENCH_INITS		100000UL
+#define BENCH_MAX_KEY		256
+
+static const size_t bench_keylens[] = { 32, 64, 128, 200 };
+
+static int bench_one(EVP_MAC *mac, const char *digest, const unsigned char *key,
+		     size_t keylen, unsigned long inits, int reuse, double *ns)
+{
+	unsigned char out[EVP_MAX_MD_SIZE];
+	EVP_MAC_CTX *ctx = NULL;
+	OSSL_PARAM params[2];
+	unsigned long i;
+	double start;
+	size_t outl;
+	int ret = -1;
+
+	params[0] = OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_DIGEST,
+						     (char *)digest, 0);
+	params[1] = OSSL_PARAM_construct_end();
+
+	start = bench_now();
+	for (i = 0; i < inits; i++) {
+		if (!ctx || !reuse) {
+			EVP_MAC_CTX_free(ctx);
+			ctx = EVP_MAC_CTX_new(mac);
+			if (!ctx)
+				return -1;
+		}
+		if (!EVP_MAC_init(ctx, key, keylen, params) ||
+		    !EVP_MAC_update(ctx, key, 32) ||
+		    !EVP_MAC_final(ctx, out, &outl, sizeof(out)))
+			goto out;
+	}
+	*ns = (bench_now() - start) * 1e9 / inits;
+	ret = 0;
+
+out:
+	EVP_MAC_CTX_free(ctx);
+	return ret;
+}
+
+int main(int argc, char *argv[])
+{
+	const char *prov_name = argc > 1 ? argv[1] : "uadk_provider";
+	const char *digest = argc > 2 ? argv[2] : "SHA256";
+	unsigned long inits = argc > 3 ? strtoul(argv[3], NULL, 0) : BENCH_INITS;
+	unsigned char key[BENCH_MAX_KEY];
+	double reused, fresh;
+	struct bench_prov bp;
+	EVP_MAC *mac;
+	size_t i;
+	int ret = 1;
+
+	if (!inits) {
+		fprintf(stderr, "usage: %s [provider [digest [inits]]]\n", argv[0]);
+		return 1;
+	}
+
+	if (bench_load(&bp, prov_name, 0))
+		return 1;
+
+	mac = EVP_MAC_fetch(NULL, "HMAC", NULL);
+	if (!mac) {
+		fprintf(stderr, "failed to fetch HMAC\n");
+		goto out;
+	}
+
+	for (i = 0; i < sizeof(key); i++)
+		key[i] = (unsigned char)(i * 13 + 1);
+
+	printf("HMAC-%s from %s, init + 32 byte update + final\n", digest, prov_name);
+	printf("%8s%14s%14s\n", "keylen", "reused ctx", "new ctx");
+	for (i = 0; i < sizeof(bench_keylens) / sizeof(bench_keylens[0]); i++) {
+		if (bench_one(mac, digest, key, bench_keylens[i], inits, 1, &reused) ||
+		    bench_one(mac, digest, key, bench_keylens[i], inits, 0, &fresh)) {
+			fprintf(stderr, "HMAC-%s failed\n", digest);
+			goto out;
+		}
+		printf("%8zu%14.0f%14.0f\n", bench_keylens[i], reused, fresh);
+	}
+	printf("(ns per operation)\n");
+	ret = 0;
+
+out:
+	EVP_MAC_free(mac);
+	bench_unload(&bp);
+	return ret;
+}
@@ -0,0 +1,348 @@
+/*
+ * Copyright 2020-2022 Huawei Technologies Co.,Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * HKDF, TLS13-KDF and TLS1-PRF of a provider against the RFC 5869 vectors,
+ * then against the default provider in every mode, with output lengths
+ * from one byte to long expansion chains and inputs on both sides of the
+ * small packet threshold.
+ *
+ * Build and run:
+ * gcc -O2 test/uadk_kdf_test.c -lcrypto -o uadk_kdf_test
+ * ./uadk_kdf_test [provider]
+ * e.g. ./uadk_kdf_test uadk_provider
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <openssl/core_names.h>
+#include <openssl/evp.h>
+#include <openssl/kdf.h>
+#include <openssl/params.h>
+#include <openssl/provider.h>
+
+#define TEST_MAX_OUT	8160
+#define TEST_PARAMS	12
+#define TEST_SKIP	77
+
+struct test_kat {
+	const char *digest;
+	const char *ikm;
+	const char *salt;
+	const char *info;
+	const char *okm;
+};
+
+/* RFC 5869 appendix A */
+static const struct test_kat test_kats[] = {
+	{ "SHA256", "0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b",
+	  "000102030405060708090a0b0c", "f0f1f2f3f4f5f6f7f8f9",
+	  "3cb25f25faacd57a90434f64d0362f2a2d2d0a90cf1a5a4c5db02d56ecc4c5bf"
+	  "34007208d5b887185865" },
+	{ "SHA256",
+	  "000102030405060708090a0b0c0d0e0f101112131415161718191a1b1c1d1e1f"
+	  "202122232425262728292a2b2c2d2e2f303132333435363738393a3b3c3d3e3f"
+	  "404142434445464748494a4b4c4d4e4f",
+	  "606162636465666768696a6b6c6d6e6f707172737475767778797a7b7c7d7e7f"
+	  "808182838485868788898a8b8c8d8e8f909192939495969798999a9b9c9d9e9f"
+	  "a0a1a2a3a4a5a6a7a8a9aaabacadaeaf",
+	  "b0b1b2b3b4b5b6b7b8b9babbbcbdbebfc0c1c2c3c4c5c6c7c8c9cacbcccdcecf"
+	  "d0d1d2d3d4d5d6d7d8d9dadbdcdddedfe0e1e2e3e4e5e6e7e8e9eaebecedeeef"
+	  "f0f1f2f3f4f5f6f7f8f9fafbfcfdfeff",
+	  "b11e398dc80327a1c8e7f78c596a49344f012eda2d4efad8a050cc4c19afa97c"
+	  "59045a99cac7827271cb41c65e590e09da3275600c2f09b8367793a9aca3db71"
+	  "cc30c58179ec3e87c14c01d5c1f3434f1d87" },
+	{ "SHA256", "0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b", "", "",
+	  "8da4e775a563c18f715f802a063c5a31b8a11f5c5ee1879ec3454e5f3c738d2d"
+	  "9d201395faa4b61a96c8" },
+	{ "SHA1", "0b0b0b0b0b0b0b0b0b0b0b", "000102030405060708090a0b0c",
+	  "f0f1f2f3f4f5f6f7f8f9",
+	  "085a01ea1b10f36933068b56efa5ad81a4f14b822f5b091568a9cdd4f155fda2"
+	  "c22e422478d305f3f896" },
+};
+
+struct test_case {
+	const char *kdf;
+	const char *digest;
+	int mode;
+	size_t keylen;
+	size_t seedlen;
+};
+
+static const struct test_case test_cases[] = {
+	{ "HKDF", "SHA256", EVP_KDF_HKDF_MODE_EXTRACT_AND_EXPAND, 32, 16 },
+	{ "HKDF", "SHA256", EVP_KDF_HKDF_MODE_EXTRACT_AND_EXPAND, 32, 600 },
+	{ "HKDF", "SHA384", EVP_KDF_HKDF_MODE_EXTRACT_ONLY, 48, 0 },
+	{ "HKDF", "SHA512", EVP_KDF_HKDF_MODE_EXTRACT_ONLY, 1024, 0 },
+	{ "HKDF", "SHA256", EVP_KDF_HKDF_MODE_EXPAND_ONLY, 32, 100 },
+	{ "HKDF", "SM3", EVP_KDF_HKDF_MODE_EXPAND_ONLY, 32, 1000 },
+	{ "TLS13-KDF", "SHA256", EVP_KDF_HKDF_MODE_EXPAND_ONLY, 32, 32 },
+	{ "TLS13-KDF", "SHA384", EVP_KDF_HKDF_MODE_EXPAND_ONLY, 48, 48 },
+	{ "TLS13-KDF", "SHA256", EVP_KDF_HKDF_MODE_EXTRACT_ONLY, 32, 0 },
+	{ "TLS13-KDF", "SHA384", EVP_KDF_HKDF_MODE_EXTRACT_ONLY, 0, 0 },
+	{ "TLS1-PRF", "SHA256", 0, 48, 77 },
+	{ "TLS1-PRF", "SHA384", 0, 48, 700 },
+	{ "TLS1-PRF", "MD5-SHA1", 0, 48, 77 },
+	{ "TLS1-PRF", "MD5-SHA1", 0, 47, 600 },
+};
+
+static const size_t test_lens[] = {
+	1, 12, 32, 48, 100, 256, 1000, TEST_MAX_OUT,
+};
+
+static size_t test_hex(unsigned char *buf, const char *hex)
+{
+	size_t i, len = strlen(hex) / 2;
+	unsigned int c;
+
+	for (i = 0; i < len; i++) {
+		sscanf(hex + 2 * i, "%2x", &c);
+		buf[i] = (unsigned char)c;
+	}
+
+	return len;
+}
+
+static EVP_KDF_CTX *test_new(const char *prov_name, const char *kdf_name)
+{
+	EVP_KDF_CTX *ctx;
+	char query[64];
+	EVP_KDF *kdf;
+
+	snprintf(query, sizeof(query), "provider=%s", prov_name);
+	kdf = EVP_KDF_fetch(NULL, kdf_name, query);
+	if (!kdf)
+		return NULL;
+
+	ctx = EVP_KDF_CTX_new(kdf);
+	EVP_KDF_free(kdf);
+
+	return ctx;
+}
+
+static int test_kat(const char *prov_name, const struct test_kat *kat)
+{
+	unsigned char ikm[80], salt[80], info[80], okm[82], out[82];
+	size_t ikmlen, saltlen, infolen, okmlen;
+	OSSL_PARAM params[6], *p = params;
+	EVP_KDF_CTX *ctx;
+	int ret = -1;
+
+	ikmlen = test_hex(ikm, kat->ikm);
+	saltlen = test_hex(salt, kat->salt);
+	infolen = test_hex(info, kat->info);
+	okmlen = test_hex(okm, kat->okm);
+
+	ctx = test_new(prov_name, "HKDF");
+	if (!ctx) {
+		printf("HKDF: not available, skipped\n");
+		return 0;
+	}
+
+	*p++ = OSSL_PARAM_construct_utf8_string(OSSL_KDF_PARAM_DIGEST, (char *)kat->digest, 0);
+	*p++ = OSSL_PARAM_construct_octet_string(OSSL_KDF_PARAM_KEY, ikm, ikmlen);
+	if (saltlen)
+		*p++ = OSSL_PARAM_construct_octet_string(OSSL_KDF_PARAM_SALT, salt, saltlen);
+	if (infolen)
+		*p++ = OSSL_PARAM_construct_octet_string(OSSL_KDF_PARAM_INFO, info, infolen);
+	*p = OSSL_PARAM_construct_end();
+
+	if (EVP_KDF_derive(ctx, out, okmlen, params) <= 0 || memcmp(out, okm, okmlen)) {
+		fprintf(stderr, "HKDF %s: known answer of %zu bytes failed\n",
+			kat->digest, okmlen);
+		goto out;
+	}
+	ret = 0;
+
+out:
+	EVP_KDF_CTX_free(ctx);
+	return ret;
+}
+
+/* libssl passes the label prefix and the seed in pieces, do the same */
+static void test_params(const struct test_case *tc, OSSL_PARAM *params,
+			unsigned char *key, unsigned char *seed)
+{
+	static const char prefix[] = "tls13 ";
+	static const char label[] = "derived";
+	OSSL_PARAM *p = params;
+	int *mode = (int *)&tc->mode;
+
+	*p++ = OSSL_PARAM_construct_utf8_string(OSSL_KDF_PARAM_DIGEST, (char *)tc->digest, 0);
+	if (!strcmp(tc->kdf, "TLS1-PRF")) {
+		*p++ = OSSL_PARAM_construct_octet_string(OSSL_KDF_PARAM_SECRET, key, tc->keylen);
+		*p++ = OSSL_PARAM_construct_octet_string(OSSL_KDF_PARAM_SEED, seed, 13);
+		*p++ = OSSL_PARAM_construct_octet_string(OSSL_KDF_PARAM_SEED, seed + 13,
+							 tc->seedlen - 13);
+		*p = OSSL_PARAM_construct_end();
+		return;
+	}
+
+	*p++ = OSSL_PARAM_construct_int(OSSL_KDF_PARAM_MODE, mode);
+	if (tc->keylen)
+		*p++ = OSSL_PARAM_construct_octet_string(OSSL_KDF_PARAM_KEY, key, tc->keylen);
+
+	if (!strcmp(tc->kdf, "HKDF")) {
+		*p++ = OSSL_PARAM_construct_octet_string(OSSL_KDF_PARAM_SALT, seed + 1, 20);
+		if (tc->seedlen) {
+			*p++ = OSSL_PARAM_construct_octet_string(OSSL_KDF_PARAM_INFO, seed, 5);
+			*p++ = OSSL_PARAM_construct_octet_string(OSSL_KDF_PARAM_INFO, seed + 5,
+								 tc->seedlen - 5);
+		}
+		*p = OSSL_PARAM_construct_end();
+		return;
+	}
+
+	*p++ = OSSL_PARAM_construct_octet_string(OSSL_KDF_PARAM_PREFIX, (void *)prefix,
+						 sizeof(prefix) - 1);
+	*p++ = OSSL_PARAM_construct_octet_string(OSSL_KDF_PARAM_LABEL, (void *)label,
+						 sizeof(label) - 1);
+	if (tc->mode == EVP_KDF_HKDF_MODE_EXTRACT_ONLY)
+		*p++ = OSSL_PARAM_construct_octet_string(OSSL_KDF_PARAM_SALT, seed, 48);
+	else
+		*p++ = OSSL_PARAM_construct_octet_string(OSSL_KDF_PARAM_DATA, seed, tc->seedlen);
+	*p = OSSL_PARAM_construct_end();
+}
+
+static int test_derive(const char *prov_name, const struct test_case *tc,
+		       const OSSL_PARAM *params, unsigned char *out, size_t len, int copy)
+{
+	EVP_KDF_CTX *ctx, *dup;
+	int ret = -1;
+
+	ctx = test_new(prov_name, tc->kdf);
+	if (!ctx)
+		return 1;
+
+	if (!EVP_KDF_CTX_set_params(ctx, params))
+		goto out;
+
+	/* a copy of the set up ctx must derive the same, the default HKDF of 3.0 has none */
+	if (copy) {
+		dup = EVP_KDF_CTX_dup(ctx);
+		if (!dup)
+			goto out;
+		EVP_KDF_CTX_free(ctx);
+		ctx = dup;
+	}
+
+	if (EVP_KDF_derive(ctx, out, len, NULL) > 0)
+		ret = 0;
+
+out:
+	EVP_KDF_CTX_free(ctx);
+	return ret;
+}
+
+static size_t test_size(const char *prov_name, const struct test_case *tc,
+			const OSSL_PARAM *params)
+{
+	EVP_KDF_CTX *ctx;
+	size_t size = 0;
+
+	ctx = test_new(prov_name, tc->kdf);
+	if (ctx && EVP_KDF_CTX_set_params(ctx, params))
+		size = EVP_KDF_CTX_get_kdf_size(ctx);
+	EVP_KDF_CTX_free(ctx);
+
+	return size;
+}
+
+static int test_case(const char *prov_name, const struct test_case *tc,
+		     unsigned char *out, unsigned char *ref)
+{
+	static const char * const modes[] = { "", ", extract", ", expand" };
+	unsigned char key[1024], seed[1024];
+	OSSL_PARAM params[TEST_PARAMS];
+	size_t i, len, size;
+	int ret;
+
+	for (i = 0; i < sizeof(key); i++) {
+		key[i] = (unsigned char)(i * 7 + tc->keylen);
+		seed[i] = (unsigned char)(i * 13 + tc->seedlen);
+	}
+	test_params(tc, params, key, seed);
+
+	size = test_size(prov_name, tc, params);
+	if (size != test_size("default", tc, params)) {
+		fprintf(stderr, "%s %s%s: size differs from the default provider\n",
+			tc->kdf, tc->digest, modes[tc->mode]);
+		return -1;
+	}
+
+	for (i = 0; i < sizeof(test_lens) / sizeof(test_lens[0]); i++) {
+		/* an extract gives one hash */
+		len = size != SIZE_MAX ? size : test_lens[i];
+
+		ret = test_derive(prov_name, tc, params, out, len, 1);
+		if (ret > 0) {
+			printf("%s %s: not available, skipped\n", tc->kdf, tc->digest);
+			return 0;
+		}
+
+		if (ret || test_derive("default", tc, params, ref, len, 0) ||
+		    memcmp(out, ref, len)) {
+			fprintf(stderr, "%s %s%s: %zu bytes differ from the default provider\n",
+				tc->kdf, tc->digest, modes[tc->mode], len);
+			return -1;
+		}
+	}
+
+	printf("%s %s%s, %zu byte key, %zu byte seed: ok\n", tc->kdf, tc->digest,
+	       modes[tc->mode], tc->keylen, tc->seedlen);
+
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	const char *prov_name = argc > 1 ? argv[1] : "uadk_provider";
+	unsigned char *out = NULL, *ref = NULL;
+	OSSL_PROVIDER *prov, *def;
+	size_t i;
+	int ret = 1;
+
+	prov = OSSL_PROVIDER_load(NULL, prov_name);
+	if (!prov) {
+		printf("failed to load provider %s, skipped\n", prov_name);
+		return TEST_SKIP;
+	}
+
+	def = OSSL_PROVIDER_load(NULL, "default");
+	out = malloc(TEST_MAX_OUT);
+	ref = malloc(TEST_MAX_OUT);
+	if (!def || !out || !ref) {
+		fprintf(stderr, "failed to set up\n");
+		goto out;
+	}
+
+	for (i = 0; i < sizeof(test_kats) / sizeof(test_kats[0]); i++) {
+		if (test_kat(prov_name, &test_kats[i]))
+			goto out;
+	}
+	printf("known answers: ok\n");
+
+	for (i = 0; i < sizeof(test_cases) / sizeof(test_cases[0]); i++) {
+		if (test_case(prov_name, &test_cases[i], out, ref))
+			goto out;
+	}
+	ret = 0;
+
+out:
+	free(ref);
+	free(out);
+	OSSL_PROVIDER_unload(def);
+	OSSL_PROVIDER_unload(prov);
+	return ret;
+}
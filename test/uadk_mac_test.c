@@ -0,0 +1,303 @@
+/*
+ * Copyright 2020-2022 Huawei Technologies Co.,Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * CMAC and GMAC of a provider against the RFC 4493 and NIST GCM vectors,
+ * then against the default provider for messages of many lengths fed in
+ * uneven pieces, with a copy of the ctx taken half way. The lengths cover
+ * the small packets left to software and streams too long for one request.
+ *
+ * Build and run:
+ * gcc -O2 test/uadk_mac_test.c -lcrypto -o uadk_mac_test
+ * ./uadk_mac_test [provider]
+ * e.g. ./uadk_mac_test uadk_provider
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <openssl/core_names.h>
+#include <openssl/evp.h>
+#include <openssl/params.h>
+#include <openssl/provider.h>
+
+#define TEST_MAX_MSG	((1 << 20) + 100)
+#define TEST_SKIP	77
+
+struct test_kat {
+	const char *mac;
+	const char *cipher;
+	const char *key;
+	const char *iv;
+	const char *msg;
+	const char *tag;
+};
+
+static const struct test_kat test_kats[] = {
+	/* RFC 4493 section 4 */
+	{ "CMAC", "AES-128-CBC", "2b7e151628aed2a6abf7158809cf4f3c", NULL, "",
+	  "bb1d6929e95937287fa37d129b756746" },
+	{ "CMAC", "AES-128-CBC", "2b7e151628aed2a6abf7158809cf4f3c", NULL,
+	  "6bc1bee22e409f96e93d7e117393172a",
+	  "070a16b46b4d4144f79bdd9dd04a287c" },
+	{ "CMAC", "AES-128-CBC", "2b7e151628aed2a6abf7158809cf4f3c", NULL,
+	  "6bc1bee22e409f96e93d7e117393172aae2d8a571e03ac9c9eb76fac45af8e51"
+	  "30c81c46a35ce411",
+	  "dfa66747de9ae63030ca32611497c827" },
+	{ "CMAC", "AES-128-CBC", "2b7e151628aed2a6abf7158809cf4f3c", NULL,
+	  "6bc1bee22e409f96e93d7e117393172aae2d8a571e03ac9c9eb76fac45af8e51"
+	  "30c81c46a35ce411e5fbc1191a0a52eff69f2445df4f9b17ad2b417be66c3710",
+	  "51f0bebf7e3b9d92fc49741779363cfe" },
+	/* NIST GCM test vectors, gcmEncryptExtIV128 with aad only */
+	{ "GMAC", "AES-128-GCM", "77be63708971c4e240d1cb79e8d77feb",
+	  "e0e00f19fed7ba0136a797f3", "7a43ec1d9c0a5a78a0b16533a6213cab",
+	  "209fcc8d3675ed938e9c7166709dd946" },
+};
+
+struct test_cross {
+	const char *mac;
+	const char *cipher;
+	size_t keylen;
+	size_t ivlen;
+};
+
+static const struct test_cross test_crosses[] = {
+	{ "CMAC", "AES-128-CBC", 16, 0 },
+	{ "CMAC", "AES-192-CBC", 24, 0 },
+	{ "CMAC", "AES-256-CBC", 32, 0 },
+	{ "CMAC", "SM4-CBC", 16, 0 },
+	{ "GMAC", "AES-128-GCM", 16, 12 },
+	{ "GMAC", "AES-256-GCM", 32, 12 },
+	/* not a 96 bit iv */
+	{ "GMAC", "AES-128-GCM", 16, 16 },
+};
+
+static const size_t test_lens[] = {
+	0, 1, 15, 16, 17, 64, 512, 513, 4096, 16384, 65537, 1 << 20, TEST_MAX_MSG,
+};
+
+static size_t test_hex(unsigned char *buf, const char *hex)
+{
+	size_t i, len = strlen(hex) / 2;
+	unsigned int c;
+
+	for (i = 0; i < len; i++) {
+		sscanf(hex + 2 * i, "%2x", &c);
+		buf[i] = (unsigned char)c;
+	}
+
+	return len;
+}
+
+static EVP_MAC_CTX *test_new(const char *prov_name, const char *mac_name, const char *cipher,
+			     const unsigned char *key, size_t keylen,
+			     const unsigned char *iv, size_t ivlen)
+{
+	OSSL_PARAM params[3], *p = params;
+	EVP_MAC_CTX *ctx = NULL;
+	char query[64];
+	EVP_MAC *mac;
+
+	snprintf(query, sizeof(query), "provider=%s", prov_name);
+	mac = EVP_MAC_fetch(NULL, mac_name, query);
+	if (!mac)
+		return NULL;
+
+	*p++ = OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_CIPHER, (char *)cipher, 0);
+	if (ivlen)
+		*p++ = OSSL_PARAM_construct_octet_string(OSSL_MAC_PARAM_IV, (void *)iv, ivlen);
+	*p = OSSL_PARAM_construct_end();
+
+	ctx = EVP_MAC_CTX_new(mac);
+	if (ctx && !EVP_MAC_init(ctx, key, keylen, params)) {
+		EVP_MAC_CTX_free(ctx);
+		ctx = NULL;
+	}
+	EVP_MAC_free(mac);
+
+	return ctx;
+}
+
+static int test_kat(const char *prov_name, const struct test_kat *kat)
+{
+	unsigned char key[32], iv[16], tag[16], out[EVP_MAX_MD_SIZE];
+	size_t keylen, ivlen = 0, taglen, outl;
+	unsigned char *msg;
+	EVP_MAC_CTX *ctx;
+	size_t msglen;
+	int ret = -1;
+
+	msg = malloc(strlen(kat->msg) / 2 + 1);
+	if (!msg)
+		return -1;
+
+	keylen = test_hex(key, kat->key);
+	if (kat->iv)
+		ivlen = test_hex(iv, kat->iv);
+	msglen = test_hex(msg, kat->msg);
+	taglen = test_hex(tag, kat->tag);
+
+	ctx = test_new(prov_name, kat->mac, kat->cipher, key, keylen, iv, ivlen);
+	if (!ctx) {
+		printf("%s %s: not available, skipped\n", kat->mac, kat->cipher);
+		ret = 0;
+		goto out;
+	}
+
+	if (!EVP_MAC_update(ctx, msg, msglen) ||
+	    !EVP_MAC_final(ctx, out, &outl, sizeof(out)) ||
+	    outl != taglen || memcmp(out, tag, taglen)) {
+		fprintf(stderr, "%s %s: known answer of %zu bytes failed\n",
+			kat->mac, kat->cipher, msglen);
+		goto out;
+	}
+	ret = 0;
+
+out:
+	EVP_MAC_CTX_free(ctx);
+	free(msg);
+	return ret;
+}
+
+/* feed the message in pieces of growing size, going on with a copy half way */
+static int test_stream(EVP_MAC_CTX *ctx, const unsigned char *msg, size_t len,
+		       unsigned char *out, size_t *outl)
+{
+	size_t off = 0, piece = 1;
+	EVP_MAC_CTX *dup;
+	int copied = 0;
+	int ret = -1;
+
+	while (off < len) {
+		if (piece > len - off)
+			piece = len - off;
+		if (!EVP_MAC_update(ctx, msg + off, piece))
+			goto out;
+		off += piece;
+		piece = piece * 3 + 1;
+
+		if (copied || off < len / 2)
+			continue;
+
+		dup = EVP_MAC_CTX_dup(ctx);
+		if (!dup)
+			goto out;
+
+		/* the copy must not see what the original gets after it */
+		if (!EVP_MAC_update(ctx, (const unsigned char *)"junk", 4)) {
+			EVP_MAC_CTX_free(dup);
+			goto out;
+		}
+		EVP_MAC_CTX_free(ctx);
+		ctx = dup;
+		copied = 1;
+	}
+
+	if (!EVP_MAC_final(ctx, out, outl, EVP_MAX_MD_SIZE))
+		goto out;
+	ret = 0;
+
+out:
+	EVP_MAC_CTX_free(ctx);
+	return ret;
+}
+
+static int test_cross(const char *prov_name, const struct test_cross *tc, unsigned char *msg)
+{
+	unsigned char key[32], iv[16], out[EVP_MAX_MD_SIZE], ref[EVP_MAX_MD_SIZE];
+	size_t i, outl, refl;
+	EVP_MAC_CTX *ctx, *def;
+
+	for (i = 0; i < sizeof(key); i++)
+		key[i] = (unsigned char)(i * 7 + tc->keylen);
+	for (i = 0; i < sizeof(iv); i++)
+		iv[i] = (unsigned char)(i * 13 + 1);
+
+	for (i = 0; i < sizeof(test_lens) / sizeof(test_lens[0]); i++) {
+		ctx = test_new(prov_name, tc->mac, tc->cipher, key, tc->keylen, iv, tc->ivlen);
+		def = test_new("default", tc->mac, tc->cipher, key, tc->keylen, iv, tc->ivlen);
+		if (!ctx || !def) {
+			EVP_MAC_CTX_free(ctx);
+			EVP_MAC_CTX_free(def);
+			printf("%s %s: not available, skipped\n", tc->mac, tc->cipher);
+			return 0;
+		}
+
+		/* test_stream takes the ctx */
+		if (test_stream(ctx, msg, test_lens[i], out, &outl) ||
+		    !EVP_MAC_update(def, msg, test_lens[i]) ||
+		    !EVP_MAC_final(def, ref, &refl, sizeof(ref))) {
+			EVP_MAC_CTX_free(def);
+			fprintf(stderr, "%s %s: %zu bytes failed\n", tc->mac, tc->cipher,
+				test_lens[i]);
+			return -1;
+		}
+		EVP_MAC_CTX_free(def);
+
+		if (outl != refl || memcmp(out, ref, refl)) {
+			fprintf(stderr, "%s %s: %zu bytes differ from the default provider\n",
+				tc->mac, tc->cipher, test_lens[i]);
+			return -1;
+		}
+	}
+
+	if (tc->ivlen)
+		printf("%s %s, %zu byte iv: ok\n", tc->mac, tc->cipher, tc->ivlen);
+	else
+		printf("%s %s: ok\n", tc->mac, tc->cipher);
+
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	const char *prov_name = argc > 1 ? argv[1] : "uadk_provider";
+	OSSL_PROVIDER *prov, *def;
+	unsigned char *msg = NULL;
+	size_t i;
+	int ret = 1;
+
+	prov = OSSL_PROVIDER_load(NULL, prov_name);
+	if (!prov) {
+		printf("failed to load provider %s, skipped\n", prov_name);
+		return TEST_SKIP;
+	}
+
+	def = OSSL_PROVIDER_load(NULL, "default");
+	msg = malloc(TEST_MAX_MSG);
+	if (!def || !msg) {
+		fprintf(stderr, "failed to set up\n");
+		goto out;
+	}
+
+	for (i = 0; i < TEST_MAX_MSG; i++)
+		msg[i] = (unsigned char)(i * 31 + (i >> 8));
+
+	for (i = 0; i < sizeof(test_kats) / sizeof(test_kats[0]); i++) {
+		if (test_kat(prov_name, &test_kats[i]))
+			goto out;
+	}
+	printf("known answers: ok\n");
+
+	for (i = 0; i < sizeof(test_crosses) / sizeof(test_crosses[0]); i++) {
+		if (test_cross(prov_name, &test_crosses[i], msg))
+			goto out;
+	}
+	ret = 0;
+
+out:
+	free(msg);
+	OSSL_PROVIDER_unload(def);
+	OSSL_PROVIDER_unload(prov);
+	return ret;
+}
@@ -0,0 +1,137 @@
+/*
+ * Copyright 2020-2022 Huawei Technologies Co.,Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Compare the uadk_memcpy strategies across copy sizes, no hardware needed.
+ *
+ * Build and run:
+ * gcc -O2 -I src test/uadk_memcpy_bench.c src/uadk_memcpy.c -o uadk_memcpy_bench
+ * ./uadk_memcpy_bench [total bytes per point]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "uadk_utils.h"
+#include "uadk_bench.h"
+
+#define BENCH_BYTES		(256UL << 20)
+#define BENCH_MAX_SIZE		(256 * 1024)
+/* odd offsets so unaligned head and tail handling is measured too */
+#define BENCH_SRC_OFFSET	3
+#define BENCH_DST_OFFSET	5
+
+static const size_t bench_sizes[] = {
+	64, 128, 256, 512, 1024, 2048, 4096, 8192, 16384, 65536, 262144,
+};
+
+static int bench_check(const struct uadk_memcpy_strategy *s, unsigned char *dst,
+		       const unsigned char *src)
+{
+	size_t i, len;
+
+	for (len = 0; len <= 1100; len++) {
+		memset(dst, 0, len + 64);
+		s->copy(dst, src, len);
+		if (memcmp(dst, src, len))
+			return -1;
+		for (i = len; i < len + 64; i++) {
+			if (dst[i])
+				return -1;
+		}
+	}
+
+	return 0;
+}
+
+static double bench_one(void *(*copy)(void *, const void *, size_t), unsigned char *dst,
+			const unsigned char *src, size_t len, unsigned long total)
+{
+	unsigned long loops = total / len;
+	unsigned long i;
+	double start;
+
+	/* warm the caches and branch predictors first */
+	for (i = 0; i < loops / 16 + 1; i++)
+		copy(dst, src, len);
+
+	start = bench_now();
+	for (i = 0; i < loops; i++) {
+		copy(dst, src, len);
+		__asm__ __volatile__("" : : "r"(dst) : "memory");
+	}
+
+	return loops * len / (bench_now() - start) / (1 << 30);
+}
+
+int main(int argc, char *argv[])
+{
+	const struct uadk_memcpy_strategy *s;
+	unsigned long total = BENCH_BYTES;
+	unsigned char *src, *dst;
+	size_t i;
+	int j, num;
+
+	if (argc > 1)
+		total = strtoul(argv[1], NULL, 0);
+	if (!total) {
+		fprintf(stderr, "usage: %s [total bytes per point]\n", argv[0]);
+		return 1;
+	}
+
+	src = malloc(BENCH_MAX_SIZE + 64);
+	dst = malloc(BENCH_MAX_SIZE + 64);
+	if (src == NULL || dst == NULL) {
+		free(src);
+		free(dst);
+		return 1;
+	}
+
+	for (i = 0; i < BENCH_MAX_SIZE + 64; i++)
+		src[i] = (unsigned char)(i * 31 + 7);
+
+	num = uadk_memcpy_strategy_num();
+	printf("selected: %s, threshold %zu\n", uadk_memcpy_strategy_selected()->name,
+	       uadk_memcpy_strategy_selected()->threshold);
+
+	printf("%8s", "size");
+	for (j = 0; j < num; j++) {
+		s = uadk_memcpy_strategy_get(j);
+		if (!s->supported())
+			continue;
+		if (bench_check(s, dst, src)) {
+			printf("\n%s: copy mismatch\n", s->name);
+			return 1;
+		}
+		printf("%10s", s->name);
+	}
+	printf("%12s\n", "uadk_memcpy");
+
+	for (i = 0; i < sizeof(bench_sizes) / sizeof(bench_sizes[0]); i++) {
+		printf("%8zu", bench_sizes[i]);
+		for (j = 0; j < num; j++) {
+			s = uadk_memcpy_strategy_get(j);
+			if (!s->supported())
+				continue;
+			printf("%10.2f", bench_one(s->copy, dst + BENCH_DST_OFFSET,
+						   src + BENCH_SRC_OFFSET, bench_sizes[i], total));
+		}
+		printf("%12.2f\n", bench_one(uadk_memcpy, dst + BENCH_DST_OFFSET,
+					     src + BENCH_SRC_OFFSET, bench_sizes[i], total));
+	}
+	printf("(GiB/s)\n");
+
+	free(src);
+	free(dst);
+	return 0;
+}
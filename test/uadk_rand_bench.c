@@ -0,0 +1,166 @@
+/*
+ * Copyright 2020-2022 Huawei Technologies Co.,Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Random scalars per second from a number of threads, one BN_priv_rand_range()
+ * or BN_priv_rand() per scalar against scalars carved out of per-thread
+ * blocks, as the ECC and the DH private keys take them, with the DRBG
+ * calls each way takes. Every DRBG call of a thread also takes the lock of
+ * the primary DRBG, so the calls per scalar are what the threads contend on.
+ *
+ * Build and run:
+ * gcc -O2 -Isrc test/uadk_rand_bench.c src/uadk_prov_rand.c -lcrypto -lpthread \
+ *     -o uadk_rand_bench
+ * ./uadk_rand_bench [seconds]
+ */
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <openssl/bn.h>
+#include <openssl/ec.h>
+#include <openssl/obj_mac.h>
+#include "uadk_prov_rand.h"
+#include "uadk_bench.h"
+
+#define BENCH_SECONDS		2
+#define BENCH_MAX_THREADS	64
+/* the exponent of ffdhe2048 */
+#define BENCH_FFDHE_BITS	225
+
+struct bench_arg {
+	const BIGNUM *range;
+	/* uniform below 2^bits instead when set */
+	int bits;
+	int buffered;
+	double seconds;
+	unsigned long num;
+	int err;
+};
+
+static const int bench_threads[] = { 1, 4, 16, BENCH_MAX_THREADS };
+
+static void *bench_thread(void *p)
+{
+	struct bench_arg *arg = p;
+	double start = bench_now();
+	BIGNUM *k;
+	int i, ok;
+
+	k = BN_secure_new();
+	if (!k) {
+		arg->err = 1;
+		return NULL;
+	}
+
+	do {
+		for (i = 0; i < 256; i++) {
+			if (arg->bits)
+				ok = arg->buffered ? uadk_prov_rand_bits_bn(k, arg->bits) :
+				     BN_priv_rand(k, arg->bits, BN_RAND_TOP_ANY, BN_RAND_BOTTOM_ANY);
+			else
+				ok = arg->buffered ? uadk_prov_rand_range_bn(k, arg->range) :
+				     BN_priv_rand_range(k, arg->range);
+			if (!ok) {
+				arg->err = 1;
+				goto out;
+			}
+		}
+		arg->num += i;
+	} while (bench_now() - start < arg->seconds);
+
+out:
+	BN_clear_free(k);
+	return NULL;
+}
+
+static int bench_run(const BIGNUM *range, int bits, int buffered, int threads,
+		     double seconds, double *rate, double *calls)
+{
+	struct bench_arg arg[BENCH_MAX_THREADS] = {0};
+	pthread_t tid[BENCH_MAX_THREADS];
+	unsigned long num = 0, drbg;
+	double start, end;
+	int i, ret = 0;
+
+	drbg = uadk_prov_rand_drbg_calls();
+	start = bench_now();
+	for (i = 0; i < threads; i++) {
+		arg[i].range = range;
+		arg[i].bits = bits;
+		arg[i].buffered = buffered;
+		arg[i].seconds = seconds;
+		if (pthread_create(&tid[i], NULL, bench_thread, &arg[i]))
+			return -1;
+	}
+
+	for (i = 0; i < threads; i++) {
+		pthread_join(tid[i], NULL);
+		num += arg[i].num;
+		ret |= arg[i].err;
+	}
+	end = bench_now();
+
+	*rate = num / (end - start);
+	/* the BN calls make one DRBG call for each value they try */
+	*calls = buffered ? (double)(uadk_prov_rand_drbg_calls() - drbg) / num : 1;
+
+	return ret ? -1 : 0;
+}
+
+int main(int argc, char *argv[])
+{
+	double seconds = argc > 1 ? atof(argv[1]) : BENCH_SECONDS;
+	double serial, buffered, calls, dummy;
+	const char *names[2] = { "P-256", "ffdhe2048" };
+	const int bits[2] = { 0, BENCH_FFDHE_BITS };
+	BIGNUM *order = NULL;
+	EC_GROUP *group;
+	int ret = 1;
+	size_t i, j;
+
+	if (seconds <= 0) {
+		fprintf(stderr, "usage: %s [seconds]\n", argv[0]);
+		return 1;
+	}
+
+	group = EC_GROUP_new_by_curve_name(NID_X9_62_prime256v1);
+	if (group)
+		order = BN_dup(EC_GROUP_get0_order(group));
+	EC_GROUP_free(group);
+	if (!order)
+		goto out;
+
+	printf("%-10s%8s%14s%14s%10s%14s\n", "range", "threads", "per scalar",
+	       "buffered", "ratio", "drbg/scalar");
+	for (i = 0; i < 2; i++) {
+		for (j = 0; j < sizeof(bench_threads) / sizeof(bench_threads[0]); j++) {
+			if (bench_run(order, bits[i], 0, bench_threads[j], seconds, &serial,
+				      &dummy) ||
+			    bench_run(order, bits[i], 1, bench_threads[j], seconds, &buffered,
+				      &calls)) {
+				fprintf(stderr, "%s: random failed\n", names[i]);
+				goto out;
+			}
+			printf("%-10s%8d%14.0f%14.0f%10.2f%14.4f\n", names[i], bench_threads[j],
+			       serial, buffered, buffered / serial, calls);
+		}
+	}
+	printf("(scalars per second)\n");
+	ret = 0;
+
+out:
+	uadk_prov_rand_uninit();
+	BN_free(order);
+	return ret;
+}
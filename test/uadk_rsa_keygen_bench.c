@@ -0,0 +1,134 @@
+/*
+ * Copyright 2020-2022 Huawei Technologies Co.,Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * RSA keys generated per second by a provider against the default one, for
+ * 2048, 3072 and 4096 bit keys. Every key is checked by the default provider.
+ *
+ * Build and run:
+ * gcc -O2 test/uadk_rsa_keygen_bench.c -lcrypto -o uadk_rsa_keygen_bench
+ * ./uadk_rsa_keygen_bench [provider [seconds]]
+ * e.g. ./uadk_rsa_keygen_bench uadk_provider 10
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <openssl/evp.h>
+#include <openssl/rsa.h>
+#include "uadk_bench.h"
+
+#define BENCH_SECONDS		10
+
+static const unsigned int bench_bits[] = { 2048, 3072, 4096 };
+
+static int bench_check(EVP_PKEY *pkey)
+{
+	EVP_PKEY_CTX *ctx;
+	int ret;
+
+	ctx = EVP_PKEY_CTX_new_from_pkey(NULL, pkey, "provider=default");
+	if (!ctx)
+		return 0;
+
+	ret = EVP_PKEY_pairwise_check(ctx) == 1 && EVP_PKEY_private_check(ctx) == 1;
+	EVP_PKEY_CTX_free(ctx);
+
+	return ret;
+}
+
+static int bench_run(const char *prov_name, unsigned int bits, double seconds,
+		     double *rate)
+{
+	EVP_PKEY_CTX *ctx;
+	EVP_PKEY *pkey;
+	unsigned long n = 0;
+	double start, now;
+	char query[64];
+	int ret = -1;
+
+	snprintf(query, sizeof(query), "provider=%s", prov_name);
+	ctx = EVP_PKEY_CTX_new_from_name(NULL, "RSA", query);
+	if (!ctx)
+		return 1;
+
+	if (EVP_PKEY_keygen_init(ctx) <= 0 ||
+	    EVP_PKEY_CTX_set_rsa_keygen_bits(ctx, bits) <= 0) {
+		ret = 1;
+		goto out;
+	}
+
+	start = bench_now();
+	do {
+		pkey = NULL;
+		if (EVP_PKEY_keygen(ctx, &pkey) <= 0 || !bench_check(pkey)) {
+			EVP_PKEY_free(pkey);
+			goto out;
+		}
+		EVP_PKEY_free(pkey);
+		n++;
+		now = bench_now();
+	} while (now - start < seconds);
+
+	*rate = n / (now - start);
+	ret = 0;
+
+out:
+	EVP_PKEY_CTX_free(ctx);
+	return ret;
+}
+
+int main(int argc, char *argv[])
+{
+	const char *prov_name = argc > 1 ? argv[1] : "uadk_provider";
+	double seconds = argc > 2 ? atof(argv[2]) : BENCH_SECONDS;
+	double prov_rate, def_rate;
+	struct bench_prov bp;
+	int ret = 1;
+	size_t i;
+
+	if (seconds <= 0) {
+		fprintf(stderr, "usage: %s [provider [seconds]]\n", argv[0]);
+		return 1;
+	}
+
+	if (bench_load(&bp, prov_name, 1))
+		return 1;
+
+	printf("%s against default, one thread\n", prov_name);
+	printf("%-8s%14s%14s%10s\n", "bits", prov_name, "default", "ratio");
+	for (i = 0; i < sizeof(bench_bits) / sizeof(bench_bits[0]); i++) {
+		switch (bench_run(prov_name, bench_bits[i], seconds, &prov_rate)) {
+		case 0:
+			break;
+		case 1:
+			printf("RSA-%u: not available, skipped\n", bench_bits[i]);
+			continue;
+		default:
+			fprintf(stderr, "RSA-%u: keygen failed\n", bench_bits[i]);
+			goto out;
+		}
+
+		if (bench_run("default", bench_bits[i], seconds, &def_rate)) {
+			fprintf(stderr, "RSA-%u: default keygen failed\n", bench_bits[i]);
+			goto out;
+		}
+		printf("%-8u%14.2f%14.2f%10.2f\n", bench_bits[i], prov_rate, def_rate,
+		       prov_rate / def_rate);
+	}
+	printf("(keys per second)\n");
+	ret = 0;
+
+out:
+	bench_unload(&bp);
+	return ret;
+}
@@ -0,0 +1,241 @@
+/*
+ * Copyright 2020-2022 Huawei Technologies Co.,Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Signatures and verifications per second of a provider, one EVP_PKEY_sign()
+ * or EVP_PKEY_verify() call per digest against the same digests handed over
+ * as one batch, for batches of a few to a few hundred items.
+ *
+ * Build and run:
+ * gcc -O2 -Isrc test/uadk_sign_batch_bench.c -lcrypto -o uadk_sign_batch_bench
+ * ./uadk_sign_batch_bench [provider [seconds]]
+ * e.g. ./uadk_sign_batch_bench uadk_provider 3
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <openssl/evp.h>
+#include "uadk_prov_batch.h"
+#include "uadk_bench.h"
+
+#define BENCH_SECONDS		3
+#define BENCH_MAX_BATCH		256
+#define BENCH_MAX_SIG		512
+#define BENCH_DIGEST_LEN	32
+
+struct bench_alg {
+	const char *name;
+	const char *keytype;
+	const char *param;
+};
+
+static const struct bench_alg bench_algs[] = {
+	{ "ECDSA P-256", "EC", "P-256" },
+	{ "ECDSA P-384", "EC", "P-384" },
+	{ "SM2", "SM2", NULL },
+	{ "RSA-2048", "RSA", NULL },
+};
+
+static const size_t bench_batches[] = { 8, 32, 128, BENCH_MAX_BATCH };
+
+static unsigned char bench_tbs[BENCH_MAX_BATCH][BENCH_DIGEST_LEN];
+static unsigned char bench_sig[BENCH_MAX_BATCH][BENCH_MAX_SIG];
+static struct uadk_prov_batch_item bench_items[BENCH_MAX_BATCH];
+
+static EVP_PKEY *bench_key(const struct bench_alg *alg)
+{
+	EVP_PKEY_CTX *ctx;
+	EVP_PKEY *pkey = NULL;
+
+	ctx = EVP_PKEY_CTX_new_from_name(NULL, alg->keytype, "provider=default");
+	if (!ctx)
+		return NULL;
+
+	if (EVP_PKEY_keygen_init(ctx) <= 0 ||
+	    (alg->param && EVP_PKEY_CTX_set_group_name(ctx, alg->param) <= 0) ||
+	    EVP_PKEY_keygen(ctx, &pkey) <= 0)
+		pkey = NULL;
+	EVP_PKEY_CTX_free(ctx);
+
+	return pkey;
+}
+
+static EVP_PKEY_CTX *bench_ctx(const char *prov_name, EVP_PKEY *pkey, int sign)
+{
+	EVP_PKEY_CTX *ctx;
+	char query[64];
+
+	snprintf(query, sizeof(query), "provider=%s", prov_name);
+	ctx = EVP_PKEY_CTX_new_from_pkey(NULL, pkey, query);
+	if (!ctx)
+		return NULL;
+
+	if ((sign ? EVP_PKEY_sign_init(ctx) : EVP_PKEY_verify_init(ctx)) <= 0) {
+		EVP_PKEY_CTX_free(ctx);
+		return NULL;
+	}
+
+	return ctx;
+}
+
+static int bench_serial(EVP_PKEY_CTX *ctx, int sign, size_t num)
+{
+	size_t i, siglen;
+
+	for (i = 0; i < num; i++) {
+		if (sign) {
+			siglen = BENCH_MAX_SIG;
+			if (EVP_PKEY_sign(ctx, bench_sig[i], &siglen, bench_tbs[i],
+					  BENCH_DIGEST_LEN) <= 0)
+				return -1;
+			bench_items[i].siglen = siglen;
+		} else if (EVP_PKEY_verify(ctx, bench_sig[i], bench_items[i].siglen,
+					   bench_tbs[i], BENCH_DIGEST_LEN) <= 0) {
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+static int bench_batch(EVP_PKEY_CTX *ctx, int sign, size_t num)
+{
+	size_t i;
+
+	for (i = 0; i < num; i++) {
+		if (sign)
+			bench_items[i].siglen = BENCH_MAX_SIG;
+		bench_items[i].status = 0;
+	}
+
+	if (!(sign ? uadk_prov_batch_sign(ctx, bench_items, num) :
+		     uadk_prov_batch_verify(ctx, bench_items, num)))
+		return -1;
+
+	for (i = 0; i < num; i++) {
+		if (bench_items[i].status != 1)
+			return -1;
+	}
+
+	return 0;
+}
+
+static int bench_run(EVP_PKEY_CTX *ctx, int sign, int batch, size_t num,
+		     double seconds, double *rate)
+{
+	unsigned long n = 0;
+	double start, now;
+
+	start = bench_now();
+	do {
+		if (batch ? bench_batch(ctx, sign, num) : bench_serial(ctx, sign, num))
+			return -1;
+		n += num;
+		now = bench_now();
+	} while (now - start < seconds);
+
+	*rate = n / (now - start);
+
+	return 0;
+}
+
+static int bench_alg(const char *prov_name, const struct bench_alg *alg, double seconds)
+{
+	EVP_PKEY_CTX *sctx = NULL, *vctx = NULL;
+	double serial, batch;
+	EVP_PKEY *pkey;
+	int ret = -1;
+	size_t i;
+	int sign;
+
+	pkey = bench_key(alg);
+	if (!pkey) {
+		printf("%s: no key, skipped\n", alg->name);
+		return 0;
+	}
+
+	sctx = bench_ctx(prov_name, pkey, 1);
+	vctx = bench_ctx(prov_name, pkey, 0);
+	if (!sctx || !vctx) {
+		printf("%s: not available, skipped\n", alg->name);
+		ret = 0;
+		goto out;
+	}
+
+	/* the verifications below go over these signatures */
+	if (bench_serial(sctx, 1, BENCH_MAX_BATCH)) {
+		fprintf(stderr, "%s: sign failed\n", alg->name);
+		goto out;
+	}
+
+	for (sign = 1; sign >= 0; sign--) {
+		for (i = 0; i < sizeof(bench_batches) / sizeof(bench_batches[0]); i++) {
+			if (bench_run(sign ? sctx : vctx, sign, 0, bench_batches[i], seconds,
+				      &serial) ||
+			    bench_run(sign ? sctx : vctx, sign, 1, bench_batches[i], seconds,
+				      &batch)) {
+				fprintf(stderr, "%s: %s failed\n", alg->name, sign ? "sign" : "verify");
+				goto out;
+			}
+			printf("%-12s%8s%8zu%14.0f%14.0f%10.2f\n", alg->name,
+			       sign ? "sign" : "verify", bench_batches[i], serial, batch,
+			       batch / serial);
+		}
+	}
+	ret = 0;
+
+out:
+	EVP_PKEY_CTX_free(vctx);
+	EVP_PKEY_CTX_free(sctx);
+	EVP_PKEY_free(pkey);
+	return ret;
+}
+
+int main(int argc, char *argv[])
+{
+	const char *prov_name = argc > 1 ? argv[1] : "uadk_provider";
+	double seconds = argc > 2 ? atof(argv[2]) : BENCH_SECONDS;
+	struct bench_prov bp;
+	size_t i, j;
+	int ret = 1;
+
+	if (seconds <= 0) {
+		fprintf(stderr, "usage: %s [provider [seconds]]\n", argv[0]);
+		return 1;
+	}
+
+	if (bench_load(&bp, prov_name, 1))
+		return 1;
+
+	for (i = 0; i < BENCH_MAX_BATCH; i++) {
+		for (j = 0; j < BENCH_DIGEST_LEN; j++)
+			bench_tbs[i][j] = (unsigned char)(i * 131 + j * 7 + 1);
+		bench_items[i].tbs = bench_tbs[i];
+		bench_items[i].tbslen = BENCH_DIGEST_LEN;
+		bench_items[i].sig = bench_sig[i];
+	}
+
+	printf("%s, one thread, serial EVP calls against one batch\n", prov_name);
+	printf("%-12s%8s%8s%14s%14s%10s\n", "alg", "op", "batch", "serial", "batch", "ratio");
+	for (i = 0; i < sizeof(bench_algs) / sizeof(bench_algs[0]); i++) {
+		if (bench_alg(prov_name, &bench_algs[i], seconds))
+			goto out;
+	}
+	printf("(operations per second)\n");
+	ret = 0;
+
+out:
+	bench_unload(&bp);
+	return ret;
+}
@@ -0,0 +1,217 @@
+/*
+ * Copyright 2020-2022 Huawei Technologies Co.,Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Batch signing and verification of a provider. Every signature of a batch
+ * is checked by the default provider, and a batch verification with some
+ * bad signatures among good ones has to tell them apart item by item.
+ *
+ * Build and run:
+ * gcc -O2 -Isrc test/uadk_sign_batch_test.c -lcrypto -o uadk_sign_batch_test
+ * ./uadk_sign_batch_test [provider]
+ * e.g. ./uadk_sign_batch_test uadk_provider
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <openssl/evp.h>
+#include <openssl/provider.h>
+#include "uadk_prov_batch.h"
+
+/* more than a chunk of requests in flight in the provider */
+#define TEST_BATCH		70
+#define TEST_MAX_SIG		512
+#define TEST_DIGEST_LEN		32
+#define TEST_BAD_EVERY		5
+#define TEST_SKIP		77
+
+struct test_alg {
+	const char *name;
+	const char *keytype;
+	const char *param;
+};
+
+static const struct test_alg test_algs[] = {
+	{ "ECDSA P-256", "EC", "P-256" },
+	{ "ECDSA P-521", "EC", "P-521" },
+	{ "SM2", "SM2", NULL },
+	{ "RSA-2048", "RSA", NULL },
+};
+
+static unsigned char test_tbs[TEST_BATCH][TEST_DIGEST_LEN];
+static unsigned char test_sig[TEST_BATCH][TEST_MAX_SIG];
+static struct uadk_prov_batch_item test_items[TEST_BATCH];
+
+static EVP_PKEY *test_key(const struct test_alg *alg)
+{
+	EVP_PKEY_CTX *ctx;
+	EVP_PKEY *pkey = NULL;
+
+	ctx = EVP_PKEY_CTX_new_from_name(NULL, alg->keytype, "provider=default");
+	if (!ctx)
+		return NULL;
+
+	if (EVP_PKEY_keygen_init(ctx) <= 0 ||
+	    (alg->param && EVP_PKEY_CTX_set_group_name(ctx, alg->param) <= 0) ||
+	    EVP_PKEY_keygen(ctx, &pkey) <= 0)
+		pkey = NULL;
+	EVP_PKEY_CTX_free(ctx);
+
+	return pkey;
+}
+
+static EVP_PKEY_CTX *test_ctx(const char *prov_name, EVP_PKEY *pkey, int sign)
+{
+	EVP_PKEY_CTX *ctx;
+	char query[64];
+
+	snprintf(query, sizeof(query), "provider=%s", prov_name);
+	ctx = EVP_PKEY_CTX_new_from_pkey(NULL, pkey, query);
+	if (!ctx)
+		return NULL;
+
+	if ((sign ? EVP_PKEY_sign_init(ctx) : EVP_PKEY_verify_init(ctx)) <= 0) {
+		EVP_PKEY_CTX_free(ctx);
+		return NULL;
+	}
+
+	return ctx;
+}
+
+static void test_reset(int sign)
+{
+	size_t i;
+
+	for (i = 0; i < TEST_BATCH; i++) {
+		if (sign)
+			test_items[i].siglen = TEST_MAX_SIG;
+		test_items[i].status = -1;
+	}
+}
+
+static int test_alg(const char *prov_name, const struct test_alg *alg)
+{
+	EVP_PKEY_CTX *sctx = NULL, *vctx = NULL, *def = NULL;
+	EVP_PKEY *pkey;
+	int ret = -1;
+	size_t i;
+
+	pkey = test_key(alg);
+	if (!pkey) {
+		printf("%s: no key, skipped\n", alg->name);
+		return 0;
+	}
+
+	sctx = test_ctx(prov_name, pkey, 1);
+	vctx = test_ctx(prov_name, pkey, 0);
+	def = test_ctx("default", pkey, 0);
+	if (!sctx || !vctx || !def) {
+		printf("%s: not available, skipped\n", alg->name);
+		ret = 0;
+		goto out;
+	}
+
+	test_reset(1);
+	if (!uadk_prov_batch_sign(sctx, test_items, TEST_BATCH)) {
+		fprintf(stderr, "%s: batch sign failed\n", alg->name);
+		goto out;
+	}
+
+	for (i = 0; i < TEST_BATCH; i++) {
+		if (test_items[i].status != 1 ||
+		    EVP_PKEY_verify(def, test_sig[i], test_items[i].siglen, test_tbs[i],
+				    TEST_DIGEST_LEN) != 1) {
+			fprintf(stderr, "%s: batch signature %zu is bad\n", alg->name, i);
+			goto out;
+		}
+	}
+
+	/* the same batch, with a bit flipped in some of the signatures */
+	for (i = 0; i < TEST_BATCH; i += TEST_BAD_EVERY)
+		test_sig[i][test_items[i].siglen / 2] ^= 0x10;
+
+	test_reset(0);
+	if (!uadk_prov_batch_verify(vctx, test_items, TEST_BATCH)) {
+		fprintf(stderr, "%s: batch verify failed\n", alg->name);
+		goto out;
+	}
+
+	for (i = 0; i < TEST_BATCH; i++) {
+		if (test_items[i].status != (i % TEST_BAD_EVERY ? 1 : 0)) {
+			fprintf(stderr, "%s: batch verification %zu is %d\n", alg->name, i,
+				test_items[i].status);
+			goto out;
+		}
+	}
+
+	/* a verify ctx does not sign, whichever way the batch goes */
+	test_reset(1);
+	if (uadk_prov_batch_sign(vctx, test_items, TEST_BATCH)) {
+		for (i = 0; i < TEST_BATCH; i++) {
+			if (test_items[i].status) {
+				fprintf(stderr, "%s: a verify ctx signed\n", alg->name);
+				goto out;
+			}
+		}
+	}
+
+	printf("%s: ok\n", alg->name);
+	ret = 0;
+
+out:
+	EVP_PKEY_CTX_free(def);
+	EVP_PKEY_CTX_free(vctx);
+	EVP_PKEY_CTX_free(sctx);
+	EVP_PKEY_free(pkey);
+	return ret;
+}
+
+int main(int argc, char *argv[])
+{
+	const char *prov_name = argc > 1 ? argv[1] : "uadk_provider";
+	OSSL_PROVIDER *prov, *def;
+	size_t i, j;
+	int ret = 1;
+
+	prov = OSSL_PROVIDER_load(NULL, prov_name);
+	if (!prov) {
+		printf("failed to load provider %s, skipped\n", prov_name);
+		return TEST_SKIP;
+	}
+
+	def = OSSL_PROVIDER_load(NULL, "default");
+	if (!def) {
+		fprintf(stderr, "failed to load provider default\n");
+		goto out;
+	}
+
+	for (i = 0; i < TEST_BATCH; i++) {
+		for (j = 0; j < TEST_DIGEST_LEN; j++)
+			test_tbs[i][j] = (unsigned char)(i * 29 + j * 13 + 1);
+		test_items[i].tbs = test_tbs[i];
+		test_items[i].tbslen = TEST_DIGEST_LEN;
+		test_items[i].sig = test_sig[i];
+	}
+
+	for (i = 0; i < sizeof(test_algs) / sizeof(test_algs[0]); i++) {
+		if (test_alg(prov_name, &test_algs[i]))
+			goto out;
+	}
+	ret = 0;
+
+out:
+	OSSL_PROVIDER_unload(def);
+	OSSL_PROVIDER_unload(prov);
+	return ret;
+}
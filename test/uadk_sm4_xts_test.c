@@ -0,0 +1,288 @@
+/*
+ * Copyright 2020-2022 Huawei Technologies Co.,Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SM4-XTS of a provider against the GB/T 17964-2021 and IEEE Std 1619-2007
+ * vectors of the OpenSSL test suite, then over data units from one block to
+ * the 2^20 block limit, sector by sector with a new tweak each. The result
+ * is checked against the default provider where it has SM4-XTS (3.2 on),
+ * and by decrypting it back otherwise.
+ *
+ * Build and run:
+ * gcc -O2 test/uadk_sm4_xts_test.c -lcrypto -o uadk_sm4_xts_test
+ * ./uadk_sm4_xts_test [provider]
+ * e.g. ./uadk_sm4_xts_test uadk_provider
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <openssl/core_names.h>
+#include <openssl/evp.h>
+#include <openssl/params.h>
+#include <openssl/provider.h>
+
+#ifndef OSSL_CIPHER_PARAM_XTS_STANDARD
+# define OSSL_CIPHER_PARAM_XTS_STANDARD	"xts_standard"
+#endif
+
+#define TEST_MAX_UNIT	((1 << 20) * 16)
+#define TEST_SKIP	77
+
+struct test_kat {
+	const char *standard;
+	const char *key;
+	const char *iv;
+	const char *pt;
+	const char *ct;
+};
+
+static const struct test_kat test_kats[] = {
+	/* GB/T 17964-2021 is what SM4-XTS does when no standard is given */
+	{ NULL,
+	  "2b7e151628aed2a6abf7158809cf4f3c000102030405060708090a0b0c0d0e0f",
+	  "f0f1f2f3f4f5f6f7f8f9fafbfcfdfeff",
+	  "6bc1bee22e409f96e93d7e117393172aae2d8a571e03ac9c9eb76fac45af8e51"
+	  "30c81c46a35ce411e5fbc1191a0a52eff69f2445df4f9b17",
+	  "e9538251c71d7b80bbe4483fef497bd12c5c581bd6242fc51e08964fb4f60fdb"
+	  "0ba42f63499279213d318d2c11f6886e903be7f93a1b3479" },
+	{ "GB",
+	  "2b7e151628aed2a6abf7158809cf4f3c000102030405060708090a0b0c0d0e0f",
+	  "f0f1f2f3f4f5f6f7f8f9fafbfcfdfeff",
+	  "6bc1bee22e409f96e93d7e117393172aae2d8a571e03ac9c9eb76fac45af8e51"
+	  "30c81c46a35ce411e5fbc1191a0a52eff69f2445df4f9b17",
+	  "e9538251c71d7b80bbe4483fef497bd12c5c581bd6242fc51e08964fb4f60fdb"
+	  "0ba42f63499279213d318d2c11f6886e903be7f93a1b3479" },
+	{ "IEEE",
+	  "2b7e151628aed2a6abf7158809cf4f3c000102030405060708090a0b0c0d0e0f",
+	  "f0f1f2f3f4f5f6f7f8f9fafbfcfdfeff",
+	  "6bc1bee22e409f96e93d7e117393172aae2d8a571e03ac9c9eb76fac45af8e51"
+	  "30c81c46a35ce411e5fbc1191a0a52eff69f2445df4f9b17",
+	  "e9538251c71d7b80bbe4483fef497bd1b3db1a3e60408c575d63ff7db39f8326"
+	  "0869f9e2585fec9f0b863bf8fd784b8627d16c0db6d2cfc7" },
+};
+
+/* unit lengths, with and without a stolen tail, round the small packet threshold */
+static const size_t test_units[] = {
+	16, 17, 31, 32, 192, 193, 512, 4096, 4097, 65536 + 5, TEST_MAX_UNIT,
+};
+
+static size_t test_hex(unsigned char *buf, const char *hex)
+{
+	size_t i, len = strlen(hex) / 2;
+	unsigned int c;
+
+	for (i = 0; i < len; i++) {
+		sscanf(hex + 2 * i, "%2x", &c);
+		buf[i] = (unsigned char)c;
+	}
+
+	return len;
+}
+
+static EVP_CIPHER_CTX *test_new(const char *prov_name, const char *standard, int enc,
+				const unsigned char *key, const unsigned char *iv)
+{
+	OSSL_PARAM params[2], *p = params;
+	EVP_CIPHER_CTX *ctx = NULL;
+	EVP_CIPHER *cipher;
+	char query[64];
+
+	snprintf(query, sizeof(query), "provider=%s", prov_name);
+	cipher = EVP_CIPHER_fetch(NULL, "SM4-XTS", query);
+	if (!cipher)
+		return NULL;
+
+	if (standard)
+		*p++ = OSSL_PARAM_construct_utf8_string(OSSL_CIPHER_PARAM_XTS_STANDARD,
+							(char *)standard, 0);
+	*p = OSSL_PARAM_construct_end();
+
+	ctx = EVP_CIPHER_CTX_new();
+	if (ctx && !EVP_CipherInit_ex2(ctx, cipher, key, iv, enc, params)) {
+		EVP_CIPHER_CTX_free(ctx);
+		ctx = NULL;
+	}
+	EVP_CIPHER_free(cipher);
+
+	return ctx;
+}
+
+/* one data unit in a single update, as a storage stack hands over a sector */
+static int test_unit(EVP_CIPHER_CTX *ctx, const unsigned char *iv, unsigned char *out,
+		     const unsigned char *in, size_t len)
+{
+	int outl, finl;
+
+	if (!EVP_CipherInit_ex2(ctx, NULL, NULL, iv, -1, NULL) ||
+	    !EVP_CipherUpdate(ctx, out, &outl, in, (int)len) ||
+	    !EVP_CipherFinal_ex(ctx, out + outl, &finl) ||
+	    (size_t)(outl + finl) != len)
+		return -1;
+
+	return 0;
+}
+
+static int test_kat(const char *prov_name, const struct test_kat *kat)
+{
+	unsigned char key[32], iv[16], pt[64], ct[64], out[64];
+	const char *name = kat->standard ? kat->standard : "default standard";
+	char standard[8] = "";
+	OSSL_PARAM params[2];
+	EVP_CIPHER_CTX *ctx;
+	size_t len;
+	int enc;
+
+	test_hex(key, kat->key);
+	test_hex(iv, kat->iv);
+	len = test_hex(pt, kat->pt);
+	test_hex(ct, kat->ct);
+
+	for (enc = 1; enc >= 0; enc--) {
+		ctx = test_new(prov_name, kat->standard, enc, key, iv);
+		if (!ctx) {
+			printf("SM4-XTS %s: not available, skipped\n", name);
+			return 0;
+		}
+
+		if (test_unit(ctx, iv, out, enc ? pt : ct, len) ||
+		    memcmp(out, enc ? ct : pt, len)) {
+			EVP_CIPHER_CTX_free(ctx);
+			fprintf(stderr, "SM4-XTS %s: known answer %s failed\n", name,
+				enc ? "encryption" : "decryption");
+			return -1;
+		}
+
+		params[0] = OSSL_PARAM_construct_utf8_string(OSSL_CIPHER_PARAM_XTS_STANDARD,
+							     standard, sizeof(standard));
+		params[1] = OSSL_PARAM_construct_end();
+		if (!EVP_CIPHER_CTX_get_params(ctx, params) ||
+		    strcmp(standard, kat->standard ? kat->standard : "GB")) {
+			EVP_CIPHER_CTX_free(ctx);
+			fprintf(stderr, "SM4-XTS %s: standard reads back as %s\n", name, standard);
+			return -1;
+		}
+		EVP_CIPHER_CTX_free(ctx);
+	}
+
+	return 0;
+}
+
+static int test_units_of(const char *prov_name, const char *standard, unsigned char *msg,
+			 unsigned char *out, unsigned char *ref)
+{
+	EVP_CIPHER_CTX *enc, *dec, *def;
+	unsigned char key[32], iv[16];
+	size_t i, j, len;
+	int ret = -1;
+
+	for (i = 0; i < sizeof(key); i++)
+		key[i] = (unsigned char)(i * 7 + 3);
+	memset(iv, 0, sizeof(iv));
+
+	enc = test_new(prov_name, standard, 1, key, iv);
+	dec = test_new(prov_name, standard, 0, key, iv);
+	def = test_new("default", standard, 1, key, iv);
+	if (!enc || !dec) {
+		printf("SM4-XTS %s: not available, skipped\n", standard);
+		ret = 0;
+		goto out;
+	}
+
+	for (i = 0; i < sizeof(test_units) / sizeof(test_units[0]); i++) {
+		len = test_units[i];
+
+		/* the same ctx goes through a run of sectors, each with its own tweak */
+		for (j = 0; j < 4; j++) {
+			iv[0] = (unsigned char)j;
+			iv[8] = (unsigned char)len;
+			if (test_unit(enc, iv, out, msg, len)) {
+				fprintf(stderr, "SM4-XTS %s: %zu byte unit failed\n", standard, len);
+				goto out;
+			}
+
+			if (def && (test_unit(def, iv, ref, msg, len) || memcmp(out, ref, len))) {
+				fprintf(stderr, "SM4-XTS %s: %zu byte unit differs from the default provider\n",
+					standard, len);
+				goto out;
+			}
+
+			if (test_unit(dec, iv, ref, out, len) || memcmp(ref, msg, len)) {
+				fprintf(stderr, "SM4-XTS %s: %zu byte unit does not decrypt back\n",
+					standard, len);
+				goto out;
+			}
+		}
+	}
+
+	/* less than a block, or more than 2^20 of them, is not an xts data unit */
+	if (!test_unit(enc, iv, out, msg, 15) || !test_unit(enc, iv, out, msg, TEST_MAX_UNIT + 16)) {
+		fprintf(stderr, "SM4-XTS %s: a bad unit length was taken\n", standard);
+		goto out;
+	}
+
+	printf("SM4-XTS %s: ok%s\n", standard, def ? "" : " (no default SM4-XTS, round trip only)");
+	ret = 0;
+
+out:
+	EVP_CIPHER_CTX_free(def);
+	EVP_CIPHER_CTX_free(dec);
+	EVP_CIPHER_CTX_free(enc);
+	return ret;
+}
+
+int main(int argc, char *argv[])
+{
+	const char *prov_name = argc > 1 ? argv[1] : "uadk_provider";
+	unsigned char *msg = NULL, *out = NULL, *ref = NULL;
+	OSSL_PROVIDER *prov, *def;
+	size_t i;
+	int ret = 1;
+
+	prov = OSSL_PROVIDER_load(NULL, prov_name);
+	if (!prov) {
+		printf("failed to load provider %s, skipped\n", prov_name);
+		return TEST_SKIP;
+	}
+
+	def = OSSL_PROVIDER_load(NULL, "default");
+	msg = malloc(TEST_MAX_UNIT + 16);
+	out = malloc(TEST_MAX_UNIT + 16);
+	ref = malloc(TEST_MAX_UNIT + 16);
+	if (!def || !msg || !out || !ref) {
+		fprintf(stderr, "failed to set up\n");
+		goto out;
+	}
+
+	for (i = 0; i < TEST_MAX_UNIT + 16; i++)
+		msg[i] = (unsigned char)(i * 31 + (i >> 8));
+
+	for (i = 0; i < sizeof(test_kats) / sizeof(test_kats[0]); i++) {
+		if (test_kat(prov_name, &test_kats[i]))
+			goto out;
+	}
+	printf("known answers: ok\n");
+
+	if (test_units_of(prov_name, "GB", msg, out, ref) ||
+	    test_units_of(prov_name, "IEEE", msg, out, ref))
+		goto out;
+	ret = 0;
+
+out:
+	free(ref);
+	free(out);
+	free(msg);
+	OSSL_PROVIDER_unload(def);
+	OSSL_PROVIDER_unload(prov);
+	return ret;
+}